@@ -0,0 +1,691 @@
+// Headless slicing driver: loads a model and configs, slices and exports G-code without any GUI,
+// and writes a machine readable (JSON) report with the wall clock time and the peak memory of every
+// Print / PrintObject step. Used as a repeatable benchmark driver on build machines without a display.
+
+#include "libslic3r/libslic3r.h"
+#include "libslic3r/BuildVolume.hpp"
+#include "libslic3r/Model.hpp"
+#include "libslic3r/PlaceholderParser.hpp"
+#include "libslic3r/Print.hpp"
+#include "libslic3r/PrintConfig.hpp"
+#include "libslic3r/TriangleMeshSlicer.hpp"
+#include "libslic3r/Utils.hpp"
+#include "libslic3r/FileSystem/Log.hpp"
+#include "libslic3r/Format/bbs_3mf.hpp"
+#include "libslic3r/Format/SliceCache.hpp"
+#include "libslic3r/GCode/ExportProfiler.hpp"
+#include "libslic3r/Arachne/WallToolPaths.hpp"
+#include "libslic3r/Arachne/utils/HalfEdgeGraph.hpp"
+#include "libslic3r/Fill/FillLightning.hpp"
+#include "libslic3r/Fill/Lightning/Generator.hpp"
+#include "libslic3r/Fill/Lightning/TreeNode.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/container_hash/hash.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/args.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <boost/nowide/iostream.hpp>
+
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <tuple>
+
+using namespace Slic3r;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* print_step_name(int step)
+{
+    switch (PrintStep(step)) {
+    case psWipeTower:       return "psWipeTower";
+    case psSkirtBrim:       return "psSkirtBrim";
+    case psGCodeExport:     return "psGCodeExport";
+    case psConflictCheck:   return "psConflictCheck";
+    default:                return "psUnknown";
+    }
+}
+
+const char* print_object_step_name(int step)
+{
+    switch (PrintObjectStep(step)) {
+    case posSlice:                      return "posSlice";
+    case posPerimeters:                 return "posPerimeters";
+    case posEstimateCurledExtrusions:   return "posEstimateCurledExtrusions";
+    case posPrepareInfill:              return "posPrepareInfill";
+    case posInfill:                     return "posInfill";
+    case posIroning:                    return "posIroning";
+    case posSupportMaterial:            return "posSupportMaterial";
+    case posSimplifyPath:               return "posSimplifyPath";
+    case posSimplifySupportPath:        return "posSimplifySupportPath";
+    case posDetectOverhangsForLift:     return "posDetectOverhangsForLift";
+    case posSimplifyWall:               return "posSimplifyWall";
+    case posSimplifyInfill:             return "posSimplifyInfill";
+    default:                            return "posUnknown";
+    }
+}
+
+// Samples the resident memory of the process by a background thread, so that the peak of an interval (a step, a stage)
+// is measured, not the peak over the lifetime of the process reported by process_peak_memory().
+// The intervals may overlap, each sample raises the peak of all the open intervals.
+class MemorySampler
+{
+public:
+    MemorySampler() : m_thread([this]() { this->run(); }) {}
+    ~MemorySampler()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    // Open an interval, returns its id.
+    size_t begin()
+    {
+        size_t                       rss = process_resident_memory();
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        m_peaks.emplace(m_next_id, rss);
+        return m_next_id ++;
+    }
+
+    // Close the interval, returns the peak resident memory sampled since begin().
+    size_t end(size_t id)
+    {
+        size_t                       rss = process_resident_memory();
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        auto   it   = m_peaks.find(id);
+        size_t peak = it == m_peaks.end() ? rss : std::max(it->second, rss);
+        if (it != m_peaks.end())
+            m_peaks.erase(it);
+        return peak;
+    }
+
+private:
+    static constexpr std::chrono::milliseconds sampling_period { 5 };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (! m_condition.wait_for(lock, sampling_period, [this]() { return m_stop; }))
+            if (! m_peaks.empty()) {
+                lock.unlock();
+                size_t rss = process_resident_memory();
+                lock.lock();
+                for (auto &[id, peak] : m_peaks)
+                    peak = std::max(peak, rss);
+            }
+    }
+
+    std::mutex                  m_mutex;
+    std::condition_variable     m_condition;
+    bool                        m_stop    { false };
+    size_t                      m_next_id { 0 };
+    // Peak resident memory of the open intervals.
+    std::map<size_t, size_t>    m_peaks;
+    std::thread                 m_thread;
+};
+
+// Collects the step transitions reported through PrintBase::set_step_callback().
+// PrintObject steps may run concurrently on the TBB worker threads, thus all access is guarded by a mutex.
+class StepProfiler
+{
+public:
+    struct Record {
+        std::string name;
+        std::string object;
+        double      seconds          { 0. };
+        size_t      rss_begin        { 0 };
+        size_t      rss_end          { 0 };
+        size_t      peak_rss         { 0 };
+    };
+
+    explicit StepProfiler(MemorySampler &memory) : m_memory(memory) {}
+
+    void on_step(const PrintObjectBase *print_object, int step, bool done)
+    {
+        Clock::time_point now = Clock::now();
+        size_t            rss = process_resident_memory();
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        auto key = std::make_pair(print_object, step);
+        if (! done) {
+            if (auto it = m_active.find(key); it != m_active.end())
+                // Restarted step, which was not reported as done.
+                m_memory.end(it->second.memory_interval);
+            m_active[key] = { now, rss, m_memory.begin() };
+            return;
+        }
+        auto it = m_active.find(key);
+        if (it == m_active.end())
+            return;
+        Record record;
+        record.name      = print_object ? print_object_step_name(step) : print_step_name(step);
+        record.object    = print_object ? print_object->model_object()->name : std::string();
+        record.seconds   = std::chrono::duration<double>(now - it->second.begin).count();
+        record.rss_begin = it->second.rss_begin;
+        record.rss_end   = rss;
+        record.peak_rss  = m_memory.end(it->second.memory_interval);
+        m_records.emplace_back(std::move(record));
+        m_active.erase(it);
+    }
+
+    nlohmann::json to_json() const
+    {
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        // Per step totals in the order of the first step occurence.
+        nlohmann::json         steps = nlohmann::json::array();
+        std::map<std::string, size_t> step_index;
+        for (const Record &record : m_records) {
+            auto it = step_index.find(record.name);
+            if (it == step_index.end()) {
+                it = step_index.emplace(record.name, steps.size()).first;
+                steps.push_back({ { "step", record.name }, { "time_s", 0. }, { "peak_rss_bytes", 0 }, { "count", 0 } });
+            }
+            nlohmann::json &step = steps[it->second];
+            step["time_s"]         = step["time_s"].get<double>() + record.seconds;
+            step["peak_rss_bytes"] = std::max(step["peak_rss_bytes"].get<size_t>(), record.peak_rss);
+            step["count"]          = step["count"].get<int>() + 1;
+        }
+        nlohmann::json records = nlohmann::json::array();
+        for (const Record &record : m_records) {
+            nlohmann::json j = { { "step", record.name }, { "time_s", record.seconds },
+                                 { "rss_begin_bytes", record.rss_begin }, { "rss_end_bytes", record.rss_end }, { "peak_rss_bytes", record.peak_rss } };
+            if (! record.object.empty())
+                j["object"] = record.object;
+            records.push_back(std::move(j));
+        }
+        return { { "steps", std::move(steps) }, { "records", std::move(records) } };
+    }
+
+private:
+    struct ActiveStep {
+        Clock::time_point   begin;
+        size_t              rss_begin       { 0 };
+        size_t              memory_interval { 0 };
+    };
+
+    MemorySampler                                                                   &m_memory;
+    mutable std::mutex                                                              m_mutex;
+    std::map<std::pair<const PrintObjectBase*, int>, ActiveStep>                    m_active;
+    std::vector<Record>                                                             m_records;
+};
+
+struct CliParams
+{
+    std::vector<std::string> input_files;
+    std::vector<std::string> config_files;
+    std::string              output_gcode { "out.gcode" };
+    std::string              report_file;
+    int                      threads      { 0 };
+    bool                     use_cache    { false };
+    bool                     bench_mesh_slicing { false };
+    bool                     report_conflicts   { false };
+    bool                     bench_lightning    { false };
+    bool                     bench_arachne      { false };
+    std::string              export_trace;
+    std::string              replay_stage;
+    int                      replay_runs        { 5 };
+    bool                     single_pass_finalize { false };
+    std::string              bench_placeholder_parser;
+    std::string              slice_cache;
+    size_t                   slice_cache_size_mb  { 2048 };
+};
+
+void print_usage()
+{
+    boost::nowide::cout <<
+        "Usage: LightMakerSlicerCli [options] <model.3mf|model.stl|model.obj>...\n"
+        "  --load <config.json>   Apply a printer / filament / process config on top of the project config, may be repeated\n"
+        "  --output <file.gcode>  Output G-code path (default out.gcode)\n"
+        "  --report <file.json>   Write the per-step timing and memory report as JSON\n"
+        "  --threads <N>          Limit the TBB worker pool to N threads\n"
+        "  --use-cache            Slice through Print::process(..., use_cache = true)\n"
+        "  --bench-mesh-slicing   Compare collecting the mesh slicing lines with locks and into buckets, then exit\n"
+        "  --report-conflicts     List every pair of objects with conflicting paths and its z range in the report\n"
+        "  --bench-lightning      After slicing, rebuild the lightning infill trees with pooled and with heap allocated nodes\n"
+        "  --bench-arachne        After slicing, generate the Arachne walls of all layers with an arena per graph and per thread\n"
+        "  --export-trace <file.json>  Profile the stages of the G-code export pipeline, write a Chrome trace\n"
+        "  --replay-stage <stage>      Replay the input of a G-code export stage through the stage after export\n"
+        "                              (spiral_vase, pressure_equalizer, cooling, fan_mover, pa_processor)\n"
+        "  --replay-runs <N>           Number of replays of --replay-stage (default 5)\n"
+        "  --single-pass-finalize      Fill the remaining times into slots reserved in the G-code instead of rewriting the G-code file\n"
+        "  --bench-placeholder-parser <profiles dir>  Process the custom G-code of the vendor profiles with and without the compiled\n"
+        "                              templates for every layer, then exit. The model files are optional.\n"
+        "  --slice-cache <dir>         Load the objects sliced before with the same geometry and settings from a persistent cache\n"
+        "                              in dir, store the newly sliced objects there\n"
+        "  --slice-cache-size <MB>     Size limit of --slice-cache, the least recently used objects are evicted (default 2048)\n";
+}
+
+bool parse_params(int argc, char **argv, CliParams &params)
+{
+    for (int i = 1; i < argc; ++ i) {
+        std::string arg  = argv[i];
+        auto        next = [&](std::string &out) { if (i + 1 >= argc) return false; out = argv[++ i]; return true; };
+        std::string value;
+        if (arg == "--load") {
+            if (! next(value)) return false;
+            params.config_files.emplace_back(value);
+        } else if (arg == "--output") {
+            if (! next(params.output_gcode)) return false;
+        } else if (arg == "--report") {
+            if (! next(params.report_file)) return false;
+        } else if (arg == "--threads") {
+            if (! next(value)) return false;
+            params.threads = std::atoi(value.c_str());
+        } else if (arg == "--use-cache") {
+            params.use_cache = true;
+        } else if (arg == "--bench-mesh-slicing") {
+            params.bench_mesh_slicing = true;
+        } else if (arg == "--report-conflicts") {
+            params.report_conflicts = true;
+        } else if (arg == "--bench-lightning") {
+            params.bench_lightning = true;
+        } else if (arg == "--bench-arachne") {
+            params.bench_arachne = true;
+        } else if (arg == "--export-trace") {
+            if (! next(params.export_trace)) return false;
+        } else if (arg == "--replay-stage") {
+            if (! next(params.replay_stage)) return false;
+            const GCodeExportProfiler::Stage stage = GCodeExportProfiler::stage_from_name(params.replay_stage);
+            if (stage != GCodeExportProfiler::Stage::SpiralVase && stage != GCodeExportProfiler::Stage::PressureEqualizer && stage != GCodeExportProfiler::Stage::Cooling &&
+                stage != GCodeExportProfiler::Stage::FanMover && stage != GCodeExportProfiler::Stage::PAProcessor) {
+                boost::nowide::cerr << "Stage " << params.replay_stage << " cannot be replayed" << std::endl;
+                return false;
+            }
+        } else if (arg == "--replay-runs") {
+            if (! next(value)) return false;
+            params.replay_runs = std::atoi(value.c_str());
+        } else if (arg == "--single-pass-finalize") {
+            params.single_pass_finalize = true;
+        } else if (arg == "--bench-placeholder-parser") {
+            if (! next(params.bench_placeholder_parser)) return false;
+        } else if (arg == "--slice-cache") {
+            if (! next(params.slice_cache)) return false;
+        } else if (arg == "--slice-cache-size") {
+            if (! next(value)) return false;
+            params.slice_cache_size_mb = size_t(std::max(0, std::atoi(value.c_str())));
+        } else if (arg == "--help" || arg == "-h") {
+            return false;
+        } else if (! arg.empty() && arg.front() == '-') {
+            boost::nowide::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        } else
+            params.input_files.emplace_back(arg);
+    }
+    return ! params.input_files.empty() || ! params.bench_placeholder_parser.empty();
+}
+
+// Runs each of the variants of a benchmark a few times, run(variant_idx) returns the result of a run, which is passed
+// to signature() outside of the timed section. Reports the best time of each variant and whether the signatures
+// of all the variants are equal.
+template<typename Run, typename Signature>
+nlohmann::json bench_variants(const std::vector<std::string> &variants, Run run, Signature signature)
+{
+    static constexpr int num_runs = 3;
+    nlohmann::json       out;
+    decltype(signature(run(0))) first;
+    bool                 identical = true;
+    for (size_t variant_idx = 0; variant_idx < variants.size(); ++ variant_idx) {
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < num_runs; ++ i) {
+            Clock::time_point t      = Clock::now();
+            auto              result = run(variant_idx);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - t).count());
+            auto sig = signature(result);
+            if (variant_idx == 0 && i == 0)
+                first = std::move(sig);
+            else
+                identical &= sig == first;
+        }
+        out[variants[variant_idx] + "_time_s"] = best;
+    }
+    out["identical"] = identical;
+    return out;
+}
+
+// Intersects the mesh of every object with the layers of the configured layer height, collecting the lines into per face
+// range buckets and into per layer vectors guarded by mutexes, both on the same threads. The lines of a layer are sorted
+// outside of the timed section, as the order of the locked collection is nondeterministic.
+nlohmann::json bench_mesh_slicing(const Model &model, const DynamicPrintConfig &config)
+{
+    const float          layer_height = float(config.opt_float("layer_height"));
+    nlohmann::json       out = nlohmann::json::array();
+    for (const ModelObject *model_object : model.objects) {
+        indexed_triangle_set its = model_object->raw_indexed_triangle_set();
+        if (its.indices.empty() || layer_height <= 0.f)
+            continue;
+        float min_z = std::numeric_limits<float>::max(), max_z = std::numeric_limits<float>::lowest();
+        for (const stl_vertex &v : its.vertices) {
+            min_z = std::min(min_z, v.z());
+            max_z = std::max(max_z, v.z());
+        }
+        std::vector<float> zs;
+        for (float z = min_z + 0.5f * layer_height; z < max_z; z += layer_height)
+            zs.emplace_back(z);
+
+        nlohmann::json  j = bench_variants({ "locked", "bucketed" },
+            [&its, &zs](size_t variant_idx) {
+                return slice_mesh_lines(its, zs, variant_idx == 0 ? MeshSlicingLineCollection::Locked : MeshSlicingLineCollection::Bucketed);
+            },
+            [](std::vector<Lines> layers) {
+                for (Lines &lines : layers)
+                    std::sort(lines.begin(), lines.end(), [](const Line &l1, const Line &l2) {
+                        return std::make_tuple(l1.a.x(), l1.a.y(), l1.b.x(), l1.b.y()) < std::make_tuple(l2.a.x(), l2.a.y(), l2.b.x(), l2.b.y());
+                    });
+                return layers;
+            });
+        j["threads"] = tbb::this_task_arena::max_concurrency();
+        j["object"] = model_object->name;
+        j["facets"] = its.indices.size();
+        j["layers"] = zs.size();
+        out.push_back(std::move(j));
+    }
+    return out;
+}
+
+// Rebuilds the lightning infill trees of every sliced object with lightning infill, with the nodes allocated from
+// the NodePool of the generator and from the heap. The trees are compared by the number and the length of their branches.
+nlohmann::json bench_lightning(const Print &print)
+{
+    nlohmann::json out = nlohmann::json::array();
+    for (const PrintObject *print_object : print.objects()) {
+        bool has_lightning = false;
+        for (size_t region_id = 0; region_id < print_object->num_printing_regions(); ++ region_id)
+            if (const PrintRegionConfig &config = print_object->printing_region(region_id).config(); config.sparse_infill_density > 0 && config.sparse_infill_pattern == ipLightning)
+                has_lightning = true;
+        if (! has_lightning)
+            continue;
+        nlohmann::json j = bench_variants({ "heap", "pool" },
+            [print_object](size_t variant_idx) { return FillLightning::build_generator(*print_object, []() {}, variant_idx == 1); },
+            [print_object](const FillLightning::GeneratorPtr &generator) {
+                std::pair<size_t, double> branches { 0, 0. };
+                for (size_t layer_id = 0; layer_id < print_object->layer_count(); ++ layer_id)
+                    for (const FillLightning::NodeSPtr &root : generator->getTreesForLayer(layer_id).tree_roots)
+                        root->visitBranches([&branches](const Point &a, const Point &b) { ++ branches.first; branches.second += (b - a).cast<double>().norm(); });
+                return branches;
+            });
+        j["object"] = print_object->model_object()->name;
+        j["layers"] = print_object->layer_count();
+        out.push_back(std::move(j));
+    }
+    return out;
+}
+
+// Generates the Arachne walls of the islands of every layer of every sliced object, with the half-edge graphs of
+// SkeletalTrapezoidation allocated from an arena of their own and from an arena reused by the following layers,
+// as PrintObject::make_perimeters() does per thread. The layers are processed serially to time the wall generation itself.
+nlohmann::json bench_arachne(const Print &print)
+{
+    nlohmann::json out = nlohmann::json::array();
+    for (const PrintObject *print_object : print.objects()) {
+        Arachne::HalfEdgeGraphArena arena;
+        nlohmann::json j = bench_variants({ "graph_arena", "thread_arena" },
+            [&print, print_object, &arena](size_t variant_idx) {
+                // Number of extrusion lines and of their junctions over all layers, to compare the walls of both variants.
+                std::pair<size_t, size_t> walls { 0, 0 };
+                for (const Layer *layer : print_object->layers()) {
+                    if (layer->regions().empty() || layer->lslices.empty())
+                        continue;
+                    std::optional<Arachne::HalfEdgeGraphArenaScope> arena_scope;
+                    if (variant_idx == 1)
+                        arena_scope.emplace(arena);
+                    const LayerRegion  *layerm = layer->regions().front();
+                    Arachne::WallToolPaths wall_tool_paths(to_polygons(layer->lslices), layerm->flow(frExternalPerimeter).scaled_width(),
+                        layerm->flow(frPerimeter).scaled_spacing(), size_t(std::max(1, layerm->region().config().wall_loops.value)), 0, layer->height,
+                        Arachne::make_paths_params(layer->id(), print_object->config(), print.config()));
+                    for (const Arachne::VariableWidthLines &lines : wall_tool_paths.getToolPaths()) {
+                        walls.first += lines.size();
+                        for (const Arachne::ExtrusionLine &line : lines)
+                            walls.second += line.size();
+                    }
+                }
+                return walls;
+            },
+            [](const std::pair<size_t, size_t> &walls) { return walls; });
+        j["object"] = print_object->model_object()->name;
+        j["layers"] = print_object->layer_count();
+        out.push_back(std::move(j));
+    }
+    return out;
+}
+
+// Processes the custom G-code templates of all the profiles found in profiles_dir for a number of layers, as the G-code export does,
+// with the compiled templates and with the grammar run over the whole templates. Reports the best of a few runs of each
+// and whether both produced the same G-code.
+nlohmann::json bench_placeholder_parser(const DynamicPrintConfig &config, const std::string &profiles_dir)
+{
+    static constexpr int num_layers = 200;
+    std::set<std::string> templates;
+    for (const boost::filesystem::directory_entry &entry : boost::filesystem::recursive_directory_iterator(profiles_dir)) {
+        if (! boost::filesystem::is_regular_file(entry.status()) || entry.path().extension() != ".json")
+            continue;
+        nlohmann::json profile;
+        try {
+            boost::nowide::ifstream ifs(entry.path().string());
+            profile = nlohmann::json::parse(ifs);
+        } catch (const std::exception &) {
+            continue;
+        }
+        if (! profile.is_object())
+            continue;
+        for (const auto &[key, value] : profile.items())
+            if (boost::ends_with(key, "_gcode")) {
+                if (value.is_string())
+                    templates.emplace(value.get<std::string>());
+                else if (value.is_array())
+                    for (const nlohmann::json &item : value)
+                        if (item.is_string())
+                            templates.emplace(item.get<std::string>());
+            }
+    }
+
+    // The scalar placeholders the G-code export defines for the custom G-code.
+    DynamicConfig config_override;
+    for (const auto &[key, def] : custom_gcode_specific_config_def.options)
+        if (def.type != coNone && ! (def.type & coVectorType))
+            config_override.set_key_value(key, def.create_empty_option());
+    PlaceholderParser parser(&config);
+    // Only the templates, which process with the config and the placeholders above, are timed.
+    std::vector<std::string> valid;
+    for (const std::string &templ : templates)
+        try {
+            PlaceholderParser::ContextData context;
+            context.global_config = std::make_unique<DynamicConfig>();
+            parser.process(templ, 0, &config_override, nullptr, &context);
+            valid.emplace_back(templ);
+        } catch (const std::exception &) {
+        }
+
+    // One cache per template, as the G-code export keeps one per custom G-code.
+    std::vector<PlaceholderParser::CachedTemplate> cached(valid.size());
+    nlohmann::json out = bench_variants({ "whole", "compiled" },
+        [&parser, &valid, &config_override, &cached](size_t variant_idx) {
+            PlaceholderParser::ContextData context;
+            context.global_config = std::make_unique<DynamicConfig>();
+            size_t output_hash = 0;
+            for (int layer_id = 0; layer_id < num_layers; ++ layer_id) {
+                config_override.set_key_value("layer_num", new ConfigOptionInt(layer_id + 1));
+                config_override.set_key_value("layer_z", new ConfigOptionFloat(0.2 * (layer_id + 1)));
+                for (size_t idx = 0; idx < valid.size(); ++ idx)
+                    boost::hash_combine(output_hash, variant_idx == 1 ?
+                        parser.process(valid[idx], cached[idx], 0, &config_override, nullptr, &context) :
+                        parser.process(valid[idx], 0, &config_override, nullptr, &context));
+            }
+            return output_hash;
+        },
+        [](size_t output_hash) { return output_hash; });
+    out["templates"] = templates.size();
+    out["processed"] = valid.size();
+    out["layers"]    = num_layers;
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    boost::nowide::args a(argc, argv);
+
+    CliParams params;
+    if (! parse_params(argc, argv, params)) {
+        print_usage();
+        return 1;
+    }
+
+    std::unique_ptr<tbb::global_control> thread_limit;
+    if (params.threads > 0)
+        thread_limit = std::make_unique<tbb::global_control>(tbb::global_control::max_allowed_parallelism, size_t(params.threads));
+
+    nlohmann::json report;
+    report["inputs"]  = params.input_files;
+    report["configs"] = params.config_files;
+    report["threads"] = params.threads;
+
+    Clock::time_point time_start = Clock::now();
+    MemorySampler     memory;
+    struct StageStart {
+        Clock::time_point   time;
+        size_t              memory_interval;
+    };
+    auto stage_start = [&memory]() { return StageStart { Clock::now(), memory.begin() }; };
+    auto stage = [&report, &memory](const char *name, const StageStart &start) {
+        report["stages"][name] = { { "time_s", std::chrono::duration<double>(Clock::now() - start.time).count() },
+                                   { "rss_bytes", process_resident_memory() }, { "peak_rss_bytes", memory.end(start.memory_interval) } };
+    };
+
+    int exit_code = 0;
+    try {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+
+        // Load the models, the project config embedded in a 3MF is applied over the defaults.
+        StageStart        t = stage_start();
+        Model             model;
+        for (const std::string &input : params.input_files) {
+            DynamicPrintConfig        project_config;
+            ConfigSubstitutionContext substitutions(ForwardCompatibilitySubstitutionRule::EnableSilent);
+            PlateDataPtrs             plate_data;
+            Model loaded = Model::read_from_file(input, &project_config, &substitutions,
+                LoadStrategy::LoadModel | LoadStrategy::LoadConfig | LoadStrategy::AddDefaultInstances | LoadStrategy::Silence, &plate_data);
+            release_PlateData_list(plate_data);
+            config.apply(project_config, true);
+            for (ModelObject *model_object : loaded.objects)
+                model.add_object(*model_object);
+        }
+        for (const std::string &config_file : params.config_files) {
+            DynamicPrintConfig cfg;
+            cfg.load(config_file, ForwardCompatibilitySubstitutionRule::EnableSilent);
+            config.apply(cfg, true);
+        }
+        stage("load", t);
+
+        if (! params.bench_placeholder_parser.empty())
+            report["placeholder_parser"] = bench_placeholder_parser(config, params.bench_placeholder_parser);
+        else if (params.bench_mesh_slicing)
+            report["mesh_slicing"] = bench_mesh_slicing(model, config);
+        else {
+            const std::vector<Vec2d> &printable_area = config.option<ConfigOptionPoints>("printable_area")->values;
+            BuildVolume build_volume({ printable_area }, config.opt_float("printable_height"));
+            // Models without placement (STL, OBJ) are put into the middle of the bed.
+            for (ModelObject *model_object : model.objects)
+                model_object->ensure_on_bed();
+            if (! params.input_files.empty() && ! boost::iends_with(params.input_files.front(), ".3mf"))
+                model.center_instances_around_point(build_volume.bounding_volume2d().center());
+            model.update_print_volume_state(build_volume);
+
+            StepProfiler        profiler(memory);
+            GCodeExportProfiler export_profiler;
+            Print               print;
+            print.set_status_silent();
+            print.set_report_all_conflicts(params.report_conflicts);
+            print.set_single_pass_gcode_finalization(params.single_pass_finalize);
+            if (! params.replay_stage.empty())
+                export_profiler.set_replay(GCodeExportProfiler::stage_from_name(params.replay_stage), params.replay_runs);
+            if (! params.export_trace.empty() || ! params.replay_stage.empty())
+                print.set_gcode_export_profiler(&export_profiler);
+            std::unique_ptr<SliceCacheStore> slice_cache;
+            if (! params.slice_cache.empty()) {
+                slice_cache = std::make_unique<SliceCacheStore>(params.slice_cache, params.slice_cache_size_mb << 20);
+                print.set_slice_cache_store(slice_cache.get());
+            }
+            print.set_step_callback([&profiler](const PrintObjectBase *print_object, int step, bool done) { profiler.on_step(print_object, step, done); });
+
+            t = stage_start();
+            print.apply(model, config);
+            StringObjectException err = print.validate();
+            if (! err.string.empty())
+                throw Slic3r::SlicingError(err.string);
+            stage("apply", t);
+
+            t = stage_start();
+            print.process(nullptr, params.use_cache);
+            stage("process", t);
+            if (slice_cache)
+                report["slice_cache"] = { { "directory", slice_cache->directory() }, { "max_bytes", slice_cache->max_bytes() },
+                                          { "hits", slice_cache->hits() }, { "misses", slice_cache->misses() },
+                                          { "stored", slice_cache->stored() }, { "evicted", slice_cache->evicted() } };
+            if (params.bench_lightning)
+                report["lightning"] = bench_lightning(print);
+            if (params.bench_arachne)
+                report["arachne"] = bench_arachne(print);
+            if (params.report_conflicts) {
+                nlohmann::json conflicts = nlohmann::json::array();
+                for (const ConflictResult &conflict : print.get_all_conflict_results())
+                    conflicts.push_back({ { "object1", conflict._objName1 }, { "object2", conflict._objName2 },
+                                          { "z_min", conflict._height }, { "z_max", conflict._last_height } });
+                report["conflicts"] = std::move(conflicts);
+            }
+
+            t = stage_start();
+            GCodeProcessorResult result;
+            print.export_gcode(params.output_gcode, &result, nullptr);
+            stage("export_gcode", t);
+            if (print.gcode_export_profiler() != nullptr) {
+                report["export_pipeline"] = export_profiler.summary();
+                if (! params.export_trace.empty()) {
+                    boost::nowide::ofstream trace(params.export_trace);
+                    trace << export_profiler.chrome_trace().dump() << std::endl;
+                }
+            }
+
+            nlohmann::json steps = profiler.to_json();
+            report["steps"]   = std::move(steps["steps"]);
+            report["records"] = std::move(steps["records"]);
+            report["output"]  = params.output_gcode;
+        }
+        report["status"]  = "ok";
+    } catch (const std::exception &ex) {
+        boost::nowide::cerr << ex.what() << std::endl;
+        report["status"] = "error";
+        report["error"]  = ex.what();
+        exit_code = 2;
+    }
+
+    report["total_time_s"]   = std::chrono::duration<double>(Clock::now() - time_start).count();
+    report["peak_rss_bytes"] = process_peak_memory();
+
+    if (params.report_file.empty())
+        boost::nowide::cout << report.dump(2) << std::endl;
+    else {
+        boost::nowide::ofstream out(params.report_file);
+        out << report.dump(2) << std::endl;
+    }
+    return exit_code;
+}
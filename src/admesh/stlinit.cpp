@@ -26,10 +26,23 @@
 #include <math.h>
 #include <assert.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/predef/other/endian.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+
+#include <fast_float/fast_float.h>
+
 #include "stl.h"
 #include "libslic3r/Format/STL.hpp"
 
@@ -44,6 +57,8 @@ extern void stl_internal_reverse_quads(char *buf, size_t cnt);
 #endif /* BOOST_ENDIAN_BIG_BYTE */
 
 const int LOAD_STL_UNIT_NUM           = 5;
+// ASCII STL files are split into chunks of roughly this size, which are parsed in parallel.
+const size_t STL_ASCII_CHUNK_SIZE     = 4 * 1024 * 1024;
 static std::string model_id           = "";
 static std::string country_code       = "";
 
@@ -302,6 +317,365 @@ static bool stl_read(stl_file *stl, FILE *fp, int first_facet, bool first, Impor
   	return true;
 }
 
+enum class StlMappedReadResult {
+    Success,
+    // Canceled by the progress callback.
+    Canceled,
+    // The file could not be mapped or it uses a syntax the parallel parser does not understand, use the stdio based reader.
+    Fallback,
+};
+
+static bool stl_facet_has_nan(const stl_facet &facet)
+{
+    for (size_t j = 0; j < 3; ++ j)
+        if (isnan(facet.vertex[j](0)) || isnan(facet.vertex[j](1)) || isnan(facet.vertex[j](2)))
+            return true;
+    return false;
+}
+
+// Bounding box of the facets decoded by a single worker, the same values stl_facet_stats() accumulates.
+struct StlFacetBounds
+{
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    stl_vertex  min         = stl_vertex::Zero();
+    stl_vertex  max         = stl_vertex::Zero();
+    // Index of the first facet accounted for, stl_stats::shortest_edge is measured on this facet.
+    uint32_t    first_facet = NONE;
+
+    void add(uint32_t facet_idx, const stl_facet &facet) {
+        if (first_facet == NONE) {
+            min = facet.vertex[0];
+            max = facet.vertex[0];
+            first_facet = facet_idx;
+        }
+        for (size_t i = 0; i < 3; ++ i) {
+            min = min.cwiseMin(facet.vertex[i]);
+            max = max.cwiseMax(facet.vertex[i]);
+        }
+    }
+
+    void merge(const StlFacetBounds &rhs, uint32_t rhs_facet_offset = 0) {
+        if (rhs.first_facet == NONE)
+            return;
+        if (first_facet == NONE) {
+            min = rhs.min;
+            max = rhs.max;
+        } else {
+            min = min.cwiseMin(rhs.min);
+            max = max.cwiseMax(rhs.max);
+        }
+        first_facet = std::min(first_facet, rhs.first_facet + rhs_facet_offset);
+    }
+
+    void apply(stl_file *stl) const {
+        if (first_facet != NONE) {
+            const stl_facet &facet = stl->facet_start[first_facet];
+            stl_vertex diff = (facet.vertex[1] - facet.vertex[0]).cwiseAbs();
+            stl->stats.shortest_edge = std::max(diff(0), std::max(diff(1), diff(2)));
+            stl->stats.min = min;
+            stl->stats.max = max;
+        }
+        stl->stats.size = stl->stats.max - stl->stats.min;
+        stl->stats.bounding_diameter = stl->stats.size.norm();
+    }
+};
+
+// Decode a memory mapped binary STL. The facets are copied straight from the mapped file into stl->facet_start in parallel.
+static StlMappedReadResult stl_read_binary_mapped(stl_file *stl, const char *data, size_t file_size, const char *file, ImportstlProgressFn stlFn, int custom_header_length)
+{
+    const size_t header_size = custom_header_length + NUM_FACET_SIZE;
+    if (file_size < STL_MIN_FILE_SIZE || (file_size - header_size) % SIZEOF_STL_FACET != 0)
+        // Let the stdio based reader report the error.
+        return StlMappedReadResult::Fallback;
+    const uint32_t num_facets = uint32_t((file_size - header_size) / SIZEOF_STL_FACET);
+
+    memcpy(stl->stats.header.data(), data, custom_header_length);
+    stl->stats.header[custom_header_length] = '\0';
+    uint32_t header_num_facets;
+    memcpy(&header_num_facets, data + custom_header_length, sizeof(uint32_t));
+#if BOOST_ENDIAN_BIG_BYTE
+    // Convert from little endian to big endian.
+    stl_internal_reverse_quads((char*)&header_num_facets, 4);
+#endif /* BOOST_ENDIAN_BIG_BYTE */
+    if (num_facets != header_num_facets)
+        BOOST_LOG_TRIVIAL(info) << "stl_read_binary_mapped: Warning: File size doesn't match number of facets in the header: " << file;
+
+    stl->stats.type                = binary;
+    stl->stats.number_of_facets    = num_facets;
+    stl->stats.original_num_facets = num_facets;
+    stl_allocate(stl);
+    model_id     = "";
+    country_code = "";
+
+    const char     *facets_data = data + header_size;
+    const uint32_t  unit        = num_facets / LOAD_STL_UNIT_NUM + 1;
+    StlFacetBounds  bounds;
+    // Decode by units of facets, so that the progress is reported and the cancellation is checked as often as by stl_read().
+    for (uint32_t unit_begin = 0; unit_begin < num_facets; unit_begin += unit) {
+        if (stlFn) {
+            bool cb_cancel = false;
+            stlFn(unit_begin, num_facets, cb_cancel, model_id, country_code);
+            if (cb_cancel)
+                return StlMappedReadResult::Canceled;
+        }
+        bounds.merge(tbb::parallel_reduce(tbb::blocked_range<uint32_t>(unit_begin, std::min(num_facets, unit_begin + unit), 4096), StlFacetBounds(),
+            [stl, facets_data](const tbb::blocked_range<uint32_t> &range, StlFacetBounds bounds) {
+                for (uint32_t i = range.begin(); i < range.end(); ++ i) {
+                    // The facets are packed by 50 bytes, thus they are not aligned in the file.
+                    stl_facet facet;
+                    memcpy(&facet, facets_data + size_t(i) * SIZEOF_STL_FACET, SIZEOF_STL_FACET);
+#if BOOST_ENDIAN_BIG_BYTE
+                    // Convert the loaded little endian data to big endian.
+                    stl_internal_reverse_quads((char*)&facet, 48);
+#endif /* BOOST_ENDIAN_BIG_BYTE */
+                    // Write the facet into memory if none of facet vertices is NAN.
+                    if (stl_facet_has_nan(facet))
+                        continue;
+                    stl->facet_start[i] = facet;
+                    bounds.add(i, facet);
+                }
+                return bounds;
+            },
+            [](StlFacetBounds lhs, const StlFacetBounds &rhs) { lhs.merge(rhs); return lhs; }));
+    }
+    bounds.apply(stl);
+    return StlMappedReadResult::Success;
+}
+
+// Parser of a range of an ASCII STL file starting at a "facet" keyword or at the start of the file.
+// Only the canonical syntax is accepted, anything unexpected makes the caller fall back to the fscanf() based stl_read().
+class StlAsciiParser
+{
+public:
+    StlAsciiParser(const char *begin, const char *end) : m_ptr(begin), m_end(end) {}
+
+    bool parse(std::vector<stl_facet> &facets, StlFacetBounds &bounds)
+    {
+        for (;;) {
+            this->skip_whitespaces();
+            if (m_ptr == m_end)
+                return true;
+            // Skip solid/endsolid lines as broken STL file generators may put several of them.
+            if (this->starts_with("endsolid") || this->starts_with("solid")) {
+                this->skip_line();
+                continue;
+            }
+            stl_facet facet;
+            if (! this->keyword("facet") || ! this->keyword("normal"))
+                return false;
+            bool normal_valid = true;
+            for (int i = 0; i < 3; ++ i)
+                if (! this->number(facet.normal(i))) {
+                    // Normal was mangled. Maybe denormals or "not a number" were stored?
+                    // Just reset the normal and silently ignore it.
+                    normal_valid = false;
+                    this->skip_word();
+                }
+            if (! normal_valid)
+                memset(&facet.normal, 0, sizeof(facet.normal));
+            if (! this->keyword("outer") || ! this->keyword("loop"))
+                return false;
+            for (int j = 0; j < 3; ++ j)
+                if (! this->keyword("vertex") || ! this->number(facet.vertex[j](0)) || ! this->number(facet.vertex[j](1)) || ! this->number(facet.vertex[j](2)))
+                    return false;
+            // Some G-code generators tend to produce text after "endloop" and "endfacet". Just ignore it.
+            if (! this->keyword("endloop"))
+                return false;
+            this->skip_line();
+            if (! this->keyword("endfacet"))
+                return false;
+            this->skip_line();
+            facet.extra[0] = facet.extra[1] = 0;
+            if (stl_facet_has_nan(facet)) {
+                // Keep the facet count in sync with stl_read(), which leaves the facets with NAN vertices zeroed.
+                facets.emplace_back(stl_facet());
+            } else {
+                bounds.add(uint32_t(facets.size()), facet);
+                facets.emplace_back(facet);
+            }
+        }
+    }
+
+    static bool is_whitespace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    // Find the first line starting with the "facet" keyword after ptr.
+    static const char* next_facet(const char *ptr, const char *end)
+    {
+        while (ptr < end) {
+            ptr = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+            if (ptr == nullptr)
+                return end;
+            const char *line = ++ ptr;
+            while (line < end && (*line == ' ' || *line == '\t' || *line == '\r'))
+                ++ line;
+            if (end - line > 5 && memcmp(line, "facet", 5) == 0 && is_whitespace(line[5]))
+                return line;
+        }
+        return end;
+    }
+
+private:
+    void skip_whitespaces() { while (m_ptr != m_end && is_whitespace(*m_ptr)) ++ m_ptr; }
+    void skip_word()        { while (m_ptr != m_end && ! is_whitespace(*m_ptr)) ++ m_ptr; }
+    void skip_line()
+    {
+        const char *eol = static_cast<const char*>(memchr(m_ptr, '\n', m_end - m_ptr));
+        m_ptr = eol == nullptr ? m_end : eol + 1;
+    }
+
+    bool starts_with(const char *prefix) const
+    {
+        size_t len = strlen(prefix);
+        return size_t(m_end - m_ptr) >= len && memcmp(m_ptr, prefix, len) == 0;
+    }
+
+    // Consume a keyword followed by a white space or by the end of the range.
+    bool keyword(const char *name)
+    {
+        this->skip_whitespaces();
+        size_t len = strlen(name);
+        if (! this->starts_with(name) || (m_ptr + len != m_end && ! is_whitespace(m_ptr[len])))
+            return false;
+        m_ptr += len;
+        return true;
+    }
+
+    bool number(float &out)
+    {
+        this->skip_whitespaces();
+        const char *begin = m_ptr;
+        if (begin != m_end && *begin == '+')
+            ++ begin;
+        auto [ptr, ec] = fast_float::from_chars(begin, m_end, out);
+        if (ec != std::errc() || (ptr != m_end && ! is_whitespace(*ptr)))
+            return false;
+        m_ptr = ptr;
+        return true;
+    }
+
+    const char *m_ptr;
+    const char *m_end;
+};
+
+// Extract the MW model identification stored after the "solid" keyword of an ASCII STL.
+static void stl_ascii_parse_model_id(const std::string &first_line)
+{
+    model_id     = "";
+    country_code = "";
+    size_t solid = first_line.find_first_not_of(" \t");
+    if (solid == std::string::npos || first_line.compare(solid, 5, "solid") != 0)
+        return;
+    const char *mw_position = strstr(first_line.c_str() + solid + 5, "MW");
+    if (mw_position == nullptr || strlen(mw_position) < 3)
+        return;
+    // Extract the value after "MW"
+    char version_str[16];
+    char model_id_str[128];
+    char country_code_str[16];
+    if (sscanf(mw_position + 3, "%15s %127s %15s", version_str, model_id_str, country_code_str) == 3 && strcmp(version_str, "1.0") == 0) {
+        model_id     = model_id_str;
+        country_code = country_code_str;
+    }
+}
+
+// Parse a memory mapped ASCII STL. The file is split at "facet" lines into chunks, which are parsed in parallel with fast_float.
+static StlMappedReadResult stl_read_ascii_mapped(stl_file *stl, const char *data, size_t file_size, const char *file, ImportstlProgressFn stlFn, int custom_header_length)
+{
+    const char *end = data + file_size;
+
+    // Get the header, it is the first line up to custom_header_length characters.
+    const char *first_line_end = static_cast<const char*>(memchr(data, '\n', file_size));
+    if (first_line_end == nullptr)
+        first_line_end = end;
+    size_t header_length = std::min<size_t>(first_line_end - data, custom_header_length);
+    if (header_length > 0 && data + header_length == first_line_end && data[header_length - 1] == '\r')
+        // Lose the '\r' of the Windows line end.
+        -- header_length;
+    memcpy(stl->stats.header.data(), data, header_length);
+    stl->stats.header[header_length] = '\0';
+    stl->stats.header[custom_header_length] = '\0';
+    stl_ascii_parse_model_id(std::string(data, first_line_end));
+
+    const size_t num_chunks = std::clamp<size_t>(file_size / STL_ASCII_CHUNK_SIZE, 1, 4 * size_t(tbb::this_task_arena::max_concurrency()));
+    std::vector<const char*> splits { data };
+    for (size_t i = 1; i < num_chunks; ++ i)
+        if (const char *split = StlAsciiParser::next_facet(std::max(splits.back(), data + file_size * i / num_chunks), end); split != end)
+            splits.emplace_back(split);
+    splits.emplace_back(end);
+
+    const size_t                        num_ranges = splits.size() - 1;
+    std::vector<std::vector<stl_facet>> range_facets(num_ranges);
+    std::vector<StlFacetBounds>         range_bounds(num_ranges);
+    std::atomic<bool>                   syntax_error { false };
+    for (size_t unit = 0; unit < size_t(LOAD_STL_UNIT_NUM); ++ unit) {
+        if (stlFn) {
+            bool cb_cancel = false;
+            stlFn(int(unit), LOAD_STL_UNIT_NUM, cb_cancel, model_id, country_code);
+            if (cb_cancel)
+                return StlMappedReadResult::Canceled;
+        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(num_ranges * unit / LOAD_STL_UNIT_NUM, num_ranges * (unit + 1) / LOAD_STL_UNIT_NUM, 1),
+            [&splits, &range_facets, &range_bounds, &syntax_error](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i < range.end() && ! syntax_error; ++ i) {
+                    // Roughly 250 bytes per facet.
+                    range_facets[i].reserve((splits[i + 1] - splits[i]) / 250 + 1);
+                    if (! StlAsciiParser(splits[i], splits[i + 1]).parse(range_facets[i], range_bounds[i]))
+                        syntax_error = true;
+                }
+            });
+        if (syntax_error) {
+            BOOST_LOG_TRIVIAL(info) << "stl_read_ascii_mapped: Non canonical ASCII STL syntax, using the sequential reader: " << file;
+            return StlMappedReadResult::Fallback;
+        }
+    }
+
+    std::vector<size_t> offsets(num_ranges + 1, 0);
+    for (size_t i = 0; i < num_ranges; ++ i)
+        offsets[i + 1] = offsets[i] + range_facets[i].size();
+    if (offsets.back() == 0 || offsets.back() >= size_t(std::numeric_limits<int>::max()))
+        return StlMappedReadResult::Fallback;
+
+    stl->stats.type                = ascii;
+    stl->stats.number_of_facets    = uint32_t(offsets.back());
+    stl->stats.original_num_facets = int(offsets.back());
+    stl_allocate(stl);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_ranges, 1), [stl, &offsets, &range_facets](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            std::copy(range_facets[i].begin(), range_facets[i].end(), stl->facet_start.begin() + offsets[i]);
+            range_facets[i] = std::vector<stl_facet>();
+        }
+    });
+    StlFacetBounds bounds;
+    for (size_t i = 0; i < num_ranges; ++ i)
+        bounds.merge(range_bounds[i], uint32_t(offsets[i]));
+    bounds.apply(stl);
+    return StlMappedReadResult::Success;
+}
+
+// Read the whole file through a memory mapping, binary and ASCII files are decoded in parallel.
+static StlMappedReadResult stl_read_mapped(stl_file *stl, const char *file, ImportstlProgressFn stlFn, int custom_header_length)
+{
+    boost::iostreams::mapped_file_source mapped;
+    try {
+        mapped.open(file);
+    } catch (const std::exception &err) {
+        BOOST_LOG_TRIVIAL(info) << "stl_read_mapped: Couldn't map " << file << ", reason = " << err.what();
+        return StlMappedReadResult::Fallback;
+    }
+    const size_t header_size = custom_header_length + NUM_FACET_SIZE;
+    if (! mapped.is_open() || mapped.size() < header_size + 128)
+        // Let the stdio based reader report the error.
+        return StlMappedReadResult::Fallback;
+
+    // Check for binary or ASCII file the same way stl_open_count_facets() does.
+    const unsigned char *chtest = reinterpret_cast<const unsigned char*>(mapped.data() + header_size);
+    bool                 is_binary = std::any_of(chtest, chtest + 128, [](unsigned char c) { return c > 127; });
+    return is_binary ?
+        stl_read_binary_mapped(stl, mapped.data(), mapped.size(), file, stlFn, custom_header_length) :
+        stl_read_ascii_mapped(stl, mapped.data(), mapped.size(), file, stlFn, custom_header_length);
+}
+
 bool stl_open(stl_file *stl, const char *file, ImportstlProgressFn stlFn, int custom_header_length)
 {
     if (custom_header_length < LABEL_SIZE) { 
@@ -310,6 +684,13 @@ bool stl_open(stl_file *stl, const char *file, ImportstlProgressFn stlFn, int cu
     Slic3r::CNumericLocalesSetter locales_setter;
 	stl->clear();
     stl->stats.reset_header(custom_header_length);
+    switch (stl_read_mapped(stl, file, stlFn, custom_header_length)) {
+    case StlMappedReadResult::Success:  return true;
+    case StlMappedReadResult::Canceled: return false;
+    case StlMappedReadResult::Fallback: break;
+    }
+	stl->clear();
+    stl->stats.reset_header(custom_header_length);
     FILE *fp = stl_open_count_facets(stl, file, custom_header_length);
 	if (fp == nullptr)
 		return false;
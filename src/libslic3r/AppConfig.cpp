@@ -157,6 +157,10 @@ void AppConfig::set_defaults()
 #endif // _WIN32
     }
 
+    // Number of plates processed concurrently by "Slice all", 0 slices the plates one after another.
+    if (get("slice_all_concurrent_plates").empty())
+        set("slice_all_concurrent_plates", "0");
+
     if (get("use_perspective_camera").empty())
         set_bool("use_perspective_camera", true);
 
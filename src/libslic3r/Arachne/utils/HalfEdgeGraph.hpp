@@ -7,6 +7,9 @@
 
 #include <list>
 #include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
 
 
 
@@ -15,16 +18,209 @@
 
 namespace Slic3r::Arachne
 {
+
+/*!
+ * Arena of fixed size blocks, from which the list elements of half-edge graphs
+ * are allocated.
+ *
+ * The node and edge lists of a graph share a single arena. The erased elements
+ * are reused by the elements inserted later, as the graph of a
+ * SkeletalTrapezoidation inserts and erases many of them while it is being built
+ * and simplified. A graph built outside of a HalfEdgeGraphArenaScope gets an
+ * arena of its own, released together with its lists. Inside the scope the
+ * graphs share the arena of the scope, which keeps its blocks for the graphs
+ * of the following scopes. An arena is not thread safe, a graph is built by a
+ * single thread.
+ */
+class HalfEdgeGraphArena
+{
+public:
+    // Free list of the blocks of a single size.
+    class Pool
+    {
+    public:
+        explicit Pool(size_t block_size) : m_block_size(block_size) {}
+
+        size_t block_size() const { return m_block_size; }
+
+        void* allocate()
+        {
+            if (m_free == nullptr) {
+                m_chunks.emplace_back(new char[m_block_size * blocks_per_chunk]);
+                char *chunk = m_chunks.back().get();
+                for (size_t i = blocks_per_chunk; i > 0; -- i) {
+                    void *block = chunk + (i - 1) * m_block_size;
+                    *static_cast<void**>(block) = m_free;
+                    m_free = block;
+                }
+            }
+            void *block = m_free;
+            m_free = *static_cast<void**>(block);
+            return block;
+        }
+
+        void deallocate(void *block)
+        {
+            *static_cast<void**>(block) = m_free;
+            m_free = block;
+        }
+
+        // Return all the blocks to the free list, none of them may be in use.
+        void reset()
+        {
+            // Link the blocks in the order of their addresses, as a freshly allocated chunk is.
+            m_free = nullptr;
+            for (auto chunk = m_chunks.rbegin(); chunk != m_chunks.rend(); ++ chunk)
+                for (size_t i = blocks_per_chunk; i > 0; -- i) {
+                    void *block = chunk->get() + (i - 1) * m_block_size;
+                    *static_cast<void**>(block) = m_free;
+                    m_free = block;
+                }
+        }
+
+    private:
+        static constexpr size_t blocks_per_chunk = 256;
+
+        size_t                               m_block_size;
+        void*                                m_free { nullptr };
+        std::vector<std::unique_ptr<char[]>> m_chunks;
+    };
+
+    // Pool of the blocks of block_size, a multiple of alignof(std::max_align_t).
+    Pool& pool(size_t block_size)
+    {
+        for (std::unique_ptr<Pool> &pool : m_pools)
+            if (pool->block_size() == block_size)
+                return *pool;
+        m_pools.emplace_back(std::make_unique<Pool>(block_size));
+        return *m_pools.back();
+    }
+
+    // Make all the blocks available again, the graphs allocated from the arena must be destroyed already.
+    void reset()
+    {
+        for (std::unique_ptr<Pool> &pool : m_pools)
+            pool->reset();
+    }
+
+private:
+    friend class HalfEdgeGraphArenaScope;
+
+    // A graph allocates elements of two or three sizes.
+    std::vector<std::unique_ptr<Pool>> m_pools;
+    // Number of the HalfEdgeGraphArenaScopes of the arena alive.
+    size_t                             m_scopes { 0 };
+};
+
+/*!
+ * Makes the half-edge graphs built by the calling thread allocate from the arena
+ * while the scope is alive. Leaving the scope resets the arena, thus the graphs
+ * built inside the scope must not outlive it.
+ *
+ * The caller of WallToolPaths owns the arena, typically one per thread of a
+ * parallel loop over the layers with a scope around each layer, so the layers
+ * processed by a thread reuse the blocks of the previous ones. The memory is
+ * released when the caller destroys the arenas after the loop.
+ */
+class HalfEdgeGraphArenaScope
+{
+public:
+    explicit HalfEdgeGraphArenaScope(HalfEdgeGraphArena &arena) : m_arena(arena), m_previous(current())
+    {
+        current() = &arena;
+        ++ arena.m_scopes;
+    }
+    ~HalfEdgeGraphArenaScope()
+    {
+        current() = m_previous;
+        // A scope nested into a scope of the same arena, for example a layer task run by a thread waiting
+        // for its own nested tasks, leaves the reset to the outermost scope.
+        if (-- m_arena.m_scopes == 0)
+            m_arena.reset();
+    }
+    HalfEdgeGraphArenaScope(const HalfEdgeGraphArenaScope&) = delete;
+    HalfEdgeGraphArenaScope& operator=(const HalfEdgeGraphArenaScope&) = delete;
+
+    // Arena of the innermost scope of the calling thread, nullptr outside of a scope.
+    static HalfEdgeGraphArena*& current()
+    {
+        static thread_local HalfEdgeGraphArena *arena = nullptr;
+        return arena;
+    }
+
+private:
+    HalfEdgeGraphArena &m_arena;
+    HalfEdgeGraphArena *m_previous;
+};
+
+/*!
+ * Allocator of the node and edge lists of a half-edge graph.
+ *
+ * Single elements are taken from the arena shared by the lists of the graph,
+ * which is kept alive by the allocators. A default constructed allocator and
+ * the allocations of more than one element go to the heap.
+ */
+template<typename T>
+class HalfEdgeGraphAllocator
+{
+public:
+    using value_type = T;
+
+    HalfEdgeGraphAllocator() = default;
+    explicit HalfEdgeGraphAllocator(std::shared_ptr<HalfEdgeGraphArena> arena) :
+        m_arena(std::move(arena)), m_pool(m_arena ? &m_arena->pool(block_size) : nullptr) {}
+    template<typename U> HalfEdgeGraphAllocator(const HalfEdgeGraphAllocator<U> &other) : HalfEdgeGraphAllocator(other.arena()) {}
+
+    // A copied graph gets an arena of its own.
+    HalfEdgeGraphAllocator select_on_container_copy_construction() const
+        { return HalfEdgeGraphAllocator(m_arena ? std::make_shared<HalfEdgeGraphArena>() : nullptr); }
+
+    T* allocate(size_t n)
+    {
+        if (m_pool && n == 1)
+            return static_cast<T*>(m_pool->allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n)
+    {
+        if (m_pool && n == 1)
+            m_pool->deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+    const std::shared_ptr<HalfEdgeGraphArena>& arena() const { return m_arena; }
+
+    template<typename U> bool operator==(const HalfEdgeGraphAllocator<U> &other) const { return m_arena == other.arena(); }
+    template<typename U> bool operator!=(const HalfEdgeGraphAllocator<U> &other) const { return m_arena != other.arena(); }
+
+private:
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+    static constexpr size_t block_size = (sizeof(T) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    std::shared_ptr<HalfEdgeGraphArena> m_arena;
+    HalfEdgeGraphArena::Pool           *m_pool { nullptr };
+};
+
 template<class node_data_t, class edge_data_t, class derived_node_t, class derived_edge_t> // types of data contained in nodes and edges
 class HalfEdgeGraph
 {
 public:
     using edge_t = derived_edge_t;
     using node_t = derived_node_t;
-    using Edges = std::list<edge_t>;
-    using Nodes = std::list<node_t>;
+    using Edges = std::list<edge_t, HalfEdgeGraphAllocator<edge_t>>;
+    using Nodes = std::list<node_t, HalfEdgeGraphAllocator<node_t>>;
     Edges edges;
     Nodes nodes;
+
+    // The arena of a scope is owned by the caller, the graph only refers to it.
+    HalfEdgeGraph() : HalfEdgeGraph(HalfEdgeGraphArenaScope::current() ?
+        std::shared_ptr<HalfEdgeGraphArena>(std::shared_ptr<HalfEdgeGraphArena>(), HalfEdgeGraphArenaScope::current()) :
+        std::make_shared<HalfEdgeGraphArena>()) {}
+
+private:
+    explicit HalfEdgeGraph(const std::shared_ptr<HalfEdgeGraphArena> &arena) :
+        edges(HalfEdgeGraphAllocator<edge_t>(arena)), nodes(HalfEdgeGraphAllocator<node_t>(arena)) {}
 };
 
 } // namespace Slic3r::Arachne
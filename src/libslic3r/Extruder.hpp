@@ -71,6 +71,11 @@ public:
 
     bool   use_firmware_retraction() const;
 
+    // BBS. Shared E and retraction of a single extruder multi-material machine,
+    // to be saved and restored together with a copy of the GCodeWriter.
+    static std::pair<double, double> shared_state() { return { m_share_E, m_share_retracted }; }
+    static void set_shared_state(const std::pair<double, double> &state) { m_share_E = state.first; m_share_retracted = state.second; }
+
 private:
     // Private constructor to create a key for a search in std::set.
     Extruder(unsigned int id) : m_id(id) {}
@@ -94,6 +99,9 @@ private:
     bool          m_share_extruder;
     static double m_share_E;
     static double m_share_retracted;
+
+    // The copy constructor and the assignment of GCodeWriter rebind m_config of the copied extruders.
+    friend class GCodeWriter;
 };
 
 // Sort Extruder objects by the extruder id by default.
@@ -23,6 +23,11 @@ extern std::string log_memory_info(bool ignore_loglevel = false);
 
 // Returns the size of physical memory (RAM) in bytes.
 extern size_t total_physical_memory();
+
+// Returns the current resident memory (working set) of this process in bytes, 0 if not available.
+extern size_t process_resident_memory();
+// Returns the peak resident memory (peak working set) of this process in bytes, 0 if not available.
+extern size_t process_peak_memory();
 }
 
 #endif // SLIC3R_FileSystem_LOG_HPP_
\ No newline at end of file
@@ -26,9 +26,9 @@ void GeneratorDeleter::operator()(Generator *p) {
     delete p;
 }
 
-GeneratorPtr build_generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback)
+GeneratorPtr build_generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback, bool pool_nodes)
 {
-    return GeneratorPtr(new Generator(print_object, throw_on_cancel_callback));
+    return GeneratorPtr(new Generator(print_object, throw_on_cancel_callback, pool_nodes));
 }
 
 } // namespace Slic3r::FillAdaptive
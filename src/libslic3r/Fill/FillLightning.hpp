@@ -14,7 +14,8 @@ class Generator;
 struct GeneratorDeleter { void operator()(Generator *p); };
 using  GeneratorPtr = std::unique_ptr<Generator, GeneratorDeleter>;
 
-GeneratorPtr build_generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback);
+// The tree nodes are allocated from a pool owned by the generator, or from the heap for benchmarking.
+GeneratorPtr build_generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback, bool pool_nodes = true);
 
 class Filler : public Slic3r::Fill
 {
@@ -63,7 +63,7 @@ Slic3r::SVG draw_two_overhangs_to_svg(size_t ts_layer, const ExPolygons& overhan
 
 namespace Slic3r::FillLightning {
 
-Generator::Generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback)
+Generator::Generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback, bool pool_nodes) : m_pool_nodes(pool_nodes)
 {
     const PrintConfig         &print_config         = print_object.print()->config();
     const PrintObjectConfig   &object_config        = print_object.config();
@@ -191,6 +191,9 @@ void Generator::generateTrees(const PrintObject &print_object, const std::functi
                     append(infill_outlines[layer_id], to_polygons(surface.expolygon));
     }
 
+    // The nodes created, copied and pruned while walking the layers are allocated from the pool of this generator.
+    NodePool::Scope node_pool_scope(m_pool_nodes ? &m_node_pool : nullptr);
+
     // For various operations its beneficial to quickly locate nearby features on the polygon:
     const size_t top_layer_id = print_object.layers().size() - 1;
     EdgeGrid::Grid outlines_locator(get_extents(infill_outlines[top_layer_id]).inflated(SCALED_EPSILON));
@@ -239,6 +242,8 @@ void Generator::generateTreesforSupport(std::vector<Polygons>& contours, const s
     m_lightning_layers.resize(contours.size());
     bboxs.resize(contours.size());
 
+    NodePool::Scope node_pool_scope(m_pool_nodes ? &m_node_pool : nullptr);
+
     const auto _locator_cell_size = locator_cell_size();
     // For various operations its beneficial to quickly locate nearby features on the polygon:
     const size_t top_layer_id = contours.size() - 1;
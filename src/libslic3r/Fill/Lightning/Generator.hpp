@@ -5,6 +5,7 @@
 #define LIGHTNING_GENERATOR_H
 
 #include "Layer.hpp"
+#include "TreeNode.hpp"
 
 #include <functional>
 #include <memory>
@@ -43,8 +44,10 @@ public:
      * This generator will pre-compute things in preparation of generating
      * Lightning Infill for the infill areas in that mesh. The infill areas must
      * already be calculated at this point.
+     * The tree nodes are allocated from the pool of the generator, or from the
+     * heap if pool_nodes is false, which is kept for benchmarking.
      */
-    explicit Generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback);
+    explicit Generator(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback, bool pool_nodes = true);
 
     /*!
      * Get a tree of paths generated for a certain layer of the mesh.
@@ -122,6 +125,13 @@ protected:
      */
     std::vector<Polygons> m_overhang_per_layer;
 
+    /*!
+     * Storage of the tree nodes of all layers, declared before the layers
+     * to outlive them.
+     */
+    NodePool m_node_pool;
+    bool     m_pool_nodes { true };
+
     /*!
      * For each layer, the generated lightning paths.
      *
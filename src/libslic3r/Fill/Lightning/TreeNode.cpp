@@ -5,8 +5,58 @@
 
 #include "../../Geometry.hpp"
 
+#include <cstddef>
+
 namespace Slic3r::FillLightning {
 
+static thread_local NodePool *s_current_node_pool = nullptr;
+
+void* NodePool::allocate(size_t size)
+{
+    if (m_block_size == 0)
+        m_block_size = (std::max(size, sizeof(void*)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    else if (size > m_block_size)
+        return ::operator new(size);
+    if (m_free == nullptr) {
+        // Thread the blocks of a new chunk into the free list.
+        m_chunks.emplace_back(new char[m_block_size * blocks_per_chunk]);
+        char *chunk = m_chunks.back().get();
+        for (size_t i = blocks_per_chunk; i > 0; -- i) {
+            void *block = chunk + (i - 1) * m_block_size;
+            *static_cast<void**>(block) = m_free;
+            m_free = block;
+        }
+    }
+    void *block = m_free;
+    m_free = *static_cast<void**>(block);
+    return block;
+}
+
+void NodePool::deallocate(void *p, size_t size)
+{
+    if (size > m_block_size) {
+        ::operator delete(p);
+        return;
+    }
+    *static_cast<void**>(p) = m_free;
+    m_free = p;
+}
+
+NodePool* NodePool::current()
+{
+    return s_current_node_pool;
+}
+
+NodePool::Scope::Scope(NodePool *pool) : m_previous(s_current_node_pool)
+{
+    s_current_node_pool = pool;
+}
+
+NodePool::Scope::~Scope()
+{
+    s_current_node_pool = m_previous;
+}
+
 coord_t Node::getWeightedDistance(const Point& unsupported_location, const coord_t& supporting_radius) const
 {
     constexpr coord_t min_valence_for_boost = 0;
@@ -21,7 +71,7 @@ coord_t Node::getWeightedDistance(const Point& unsupported_location, const coord
 
 bool Node::hasOffspring(const NodeSPtr& to_be_checked) const
 {
-    if (to_be_checked == shared_from_this())
+    if (to_be_checked.get() == this)
         return true;
 
     for (auto& child_ptr : m_children)
@@ -40,7 +90,7 @@ NodeSPtr Node::addChild(const Point& child_loc)
 
 NodeSPtr Node::addChild(NodeSPtr& new_child)
 {
-    assert(new_child != shared_from_this());
+    assert(new_child.get() != this);
     //assert(p != new_child->p); // NOTE: No problem for now. Issue to solve later. Maybe even afetr final. Low prio.
     m_children.push_back(new_child);
     new_child->m_parent = shared_from_this();
@@ -60,7 +110,7 @@ void Node::propagateToNextLayer(
     tree_below->prune(prune_distance);
     tree_below->straighten(smooth_magnitude, max_remove_colinear_dist);
     if (tree_below->realign(next_outlines, outline_locator, next_trees))
-        next_trees.push_back(tree_below);
+        next_trees.push_back(std::move(tree_below));
 }
 
 // NOTE: Depth-first, as currently implemented.
@@ -68,18 +118,18 @@ void Node::propagateToNextLayer(
 void Node::visitBranches(const std::function<void(const Point&, const Point&)>& visitor) const
 {
     for (const auto& node : m_children) {
-        assert(node->m_parent.lock() == shared_from_this());
+        assert(node->m_parent.lock().get() == this);
         visitor(m_p, node->m_p);
         node->visitBranches(visitor);
     }
 }
 
 // NOTE: Depth-first, as currently implemented.
-void Node::visitNodes(const std::function<void(NodeSPtr)>& visitor)
+void Node::visitNodes(const std::function<void(const NodeSPtr&)>& visitor)
 {
     visitor(shared_from_this());
     for (const auto& node : m_children) {
-        assert(node->m_parent.lock() == shared_from_this());
+        assert(node->m_parent.lock().get() == this);
         node->visitNodes(visitor);
     }
 }
@@ -101,7 +151,7 @@ NodeSPtr Node::deepCopy() const
     {
         NodeSPtr child = node->deepCopy();
         child->m_parent = local_root;
-        local_root->m_children.push_back(child);
+        local_root->m_children.push_back(std::move(child));
     }
     return local_root;
 }
@@ -270,7 +320,7 @@ Node::RectilinearJunction Node::straighten(
                 child_p->m_parent = m_parent;
                 for (auto& sibling : parent_node->m_children)
                 { // find this node among siblings
-                    if (sibling == shared_from_this())
+                    if (sibling.get() == this)
                     {
                         sibling = child_p; // replace this node by child
                         break;
@@ -24,6 +24,69 @@ class Node;
 
 using NodeSPtr = std::shared_ptr<Node>;
 
+/*!
+ * Fixed size block pool the nodes of a Generator are allocated from.
+ *
+ * The nodes are allocated together with their shared_ptr control blocks from
+ * large chunks, which avoids a heap allocation per node and keeps the nodes of
+ * the trees close in memory. Blocks of released nodes are reused. The pool is
+ * not thread safe, the nodes are created and released by the thread generating
+ * the trees, and the pool has to outlive all the nodes allocated from it.
+ */
+class NodePool
+{
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    void* allocate(size_t size);
+    void  deallocate(void* p, size_t size);
+
+    /*!
+     * The pool Node::create() allocates from on this thread, nullptr to allocate
+     * from the heap.
+     */
+    static NodePool* current();
+
+    /*!
+     * Makes a pool the current pool of this thread for the lifetime of the scope.
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(NodePool* pool);
+        ~Scope();
+    private:
+        NodePool* m_previous;
+    };
+
+private:
+    static constexpr size_t blocks_per_chunk = 4096;
+
+    // All the blocks have the size of the first allocation, other sizes fall back to the heap.
+    size_t                               m_block_size { 0 };
+    void*                                m_free { nullptr };
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+};
+
+template<typename T>
+struct NodePoolAllocator
+{
+    using value_type = T;
+
+    explicit NodePoolAllocator(NodePool* pool) : pool(pool) {}
+    template<typename U> NodePoolAllocator(const NodePoolAllocator<U>& other) : pool(other.pool) {}
+
+    T*   allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+    template<typename U> bool operator==(const NodePoolAllocator<U>& other) const { return pool == other.pool; }
+    template<typename U> bool operator!=(const NodePoolAllocator<U>& other) const { return pool != other.pool; }
+
+    NodePool* pool;
+};
+
 // NOTE: As written, this struct will only be valid for a single layer, will have to be updated for the next.
 // NOTE: Reasons for implementing this with some separate closures:
 //       - keep clear deliniation during development
@@ -48,6 +111,8 @@ public:
         {
             explicit EnableMakeShared(Arg&&...arg) : Node(std::forward<Arg>(arg)...) {}
         };
+        if (NodePool* pool = NodePool::current())
+            return std::allocate_shared<EnableMakeShared>(NodePoolAllocator<EnableMakeShared>(pool), std::forward<Arg>(arg)...);
         return std::make_shared<EnableMakeShared>(std::forward<Arg>(arg)...);
     }
 
@@ -130,7 +195,7 @@ public:
      * \param visitor A function to execute for every node in this node's sub-
      * tree.
      */
-    void visitNodes(const std::function<void(NodeSPtr)>& visitor);
+    void visitNodes(const std::function<void(const NodeSPtr&)>& visitor);
 
     /*!
      * Get a weighted distance from an unsupported point to this node (given the current supporting radius).
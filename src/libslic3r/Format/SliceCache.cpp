@@ -0,0 +1,683 @@
+#include "../libslic3r.h"
+#include "../Exception.hpp"
+#include "../ExtrusionEntity.hpp"
+#include "../ExtrusionEntityCollection.hpp"
+#include "../Layer.hpp"
+#include "../Print.hpp"
+#include "../Surface.hpp"
+#include "../Utils.hpp"
+
+#include "SliceCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <type_traits>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/cstdio.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace Slic3r {
+
+namespace {
+
+static constexpr const char     SLICE_CACHE_MAGIC[8] = { 'L', 'M', 'S', 'L', 'C', 'A', 'C', 'H' };
+// Written as a native uint32_t, to detect a cache file written on a machine with a different byte order.
+static constexpr uint32_t       SLICE_CACHE_BYTE_ORDER = 0x01020304;
+
+// Tags of the serialized ExtrusionEntities.
+enum class EntityTag : uint8_t {
+    Path,
+    MultiPath,
+    Loop,
+    Collection
+};
+
+// The point arrays are dumped in their in-memory layout.
+static_assert(sizeof(Point) == 2 * sizeof(coord_t), "Point is expected to be tightly packed");
+static_assert(std::is_standard_layout<Point>::value, "Point is expected to have a standard layout");
+
+// Plain data stored byte by byte. Point is not trivially copyable because of its Eigen base, but its storage is plain coordinates.
+template<typename T> static constexpr bool is_plain_data = std::is_trivially_copyable<T>::value || std::is_same<T, Point>::value;
+
+class CacheWriter
+{
+public:
+    template<typename T> void pod(const T &value) {
+        static_assert(is_plain_data<T>, "CacheWriter::pod() accepts plain data only");
+        m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void size(size_t value) { this->pod<uint64_t>(uint64_t(value)); }
+    void string(const std::string &value) { this->size(value.size()); m_data.append(value); }
+    void points(const Points &points) {
+        this->size(points.size());
+        if (! points.empty())
+            m_data.append(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(Point));
+    }
+    void bbox(const BoundingBox &bbox) { this->pod(bbox.min); this->pod(bbox.max); }
+    void expolygon(const ExPolygon &expolygon) {
+        this->points(expolygon.contour.points);
+        this->size(expolygon.holes.size());
+        for (const Polygon &hole : expolygon.holes)
+            this->points(hole.points);
+    }
+    void expolygons(const ExPolygons &expolygons) {
+        this->size(expolygons.size());
+        for (const ExPolygon &expolygon : expolygons)
+            this->expolygon(expolygon);
+    }
+    void surfaces(const Surfaces &surfaces) {
+        this->size(surfaces.size());
+        for (const Surface &surface : surfaces) {
+            this->expolygon(surface.expolygon);
+            this->pod<int32_t>(int32_t(surface.surface_type));
+            this->pod(surface.thickness);
+            this->pod(surface.thickness_layers);
+            this->pod(surface.bridge_angle);
+            this->pod(surface.extra_perimeters);
+        }
+    }
+    void polyline(const Polyline &polyline) {
+        this->points(polyline.points);
+        this->size(polyline.fitting_result.size());
+        for (const PathFittingData &fitting : polyline.fitting_result) {
+            this->size(fitting.start_point_index);
+            this->size(fitting.end_point_index);
+            this->pod(fitting.path_type);
+            const ArcSegment &arc = fitting.arc_data;
+            this->pod<uint8_t>(arc.is_arc);
+            if (arc.is_arc) {
+                this->pod(arc.length);
+                this->pod(arc.angle_radians);
+                this->pod(arc.polar_start_theta);
+                this->pod(arc.polar_end_theta);
+                this->pod(arc.start_point);
+                this->pod(arc.end_point);
+                this->pod(arc.direction);
+                this->pod(arc.radius);
+                this->pod(arc.center);
+            }
+        }
+    }
+    void polylines(const Polylines &polylines) {
+        this->size(polylines.size());
+        for (const Polyline &polyline : polylines)
+            this->polyline(polyline);
+    }
+    void path(const ExtrusionPath &path) {
+        this->polyline(path.polyline);
+        this->pod(path.overhang_degree);
+        this->pod(path.curve_degree);
+        this->pod(path.mm3_per_mm);
+        this->pod(path.width);
+        this->pod(path.height);
+        this->pod(path.role());
+        this->pod<uint8_t>(path.is_force_no_extrusion());
+    }
+    void paths(const ExtrusionPaths &paths) {
+        this->size(paths.size());
+        for (const ExtrusionPath &path : paths)
+            this->path(path);
+    }
+    // Content of a collection without its tag, as the top level collections of LayerRegion and SupportLayer are stored.
+    void collection(const ExtrusionEntityCollection &collection) {
+        this->pod<uint8_t>(collection.no_sort);
+        this->size(collection.entities.size());
+        for (const ExtrusionEntity *entity : collection.entities)
+            this->entity(*entity);
+    }
+    void entity(const ExtrusionEntity &entity) {
+        if (const auto *collection = dynamic_cast<const ExtrusionEntityCollection*>(&entity); collection) {
+            this->pod(EntityTag::Collection);
+            this->collection(*collection);
+        } else if (const auto *path = dynamic_cast<const ExtrusionPath*>(&entity); path) {
+            this->pod(EntityTag::Path);
+            this->path(*path);
+        } else if (const auto *multipath = dynamic_cast<const ExtrusionMultiPath*>(&entity); multipath) {
+            this->pod(EntityTag::MultiPath);
+            this->paths(multipath->paths);
+        } else if (const auto *loop = dynamic_cast<const ExtrusionLoop*>(&entity); loop) {
+            this->pod(EntityTag::Loop);
+            this->pod(loop->loop_role());
+            this->paths(loop->paths);
+        } else
+            throw Slic3r::FileIOError("Unknown extrusion entity type while writing the slicing cache");
+    }
+    void layer_region(const LayerRegion &layer_region) {
+        this->surfaces(layer_region.slices.surfaces);
+        this->expolygons(layer_region.raw_slices);
+        this->collection(layer_region.thin_fills);
+        this->expolygons(layer_region.fill_expolygons);
+        this->surfaces(layer_region.fill_surfaces.surfaces);
+        this->expolygons(layer_region.fill_no_overlap_expolygons);
+        this->polylines(layer_region.unsupported_bridge_edges);
+        this->collection(layer_region.perimeters);
+        this->collection(layer_region.fills);
+    }
+    // Layer record: the prefix (id, heights, region config hashes) is read serially to create the layers,
+    // the rest is decoded in parallel.
+    void layer(const Layer &layer, size_t interface_id) {
+        this->size(layer.id());
+        this->size(interface_id);
+        this->pod(layer.height);
+        this->pod(layer.print_z);
+        this->pod(layer.slice_z);
+        this->size(layer.region_count());
+        for (const LayerRegion *layer_region : layer.regions())
+            this->size(layer_region->region().config_hash());
+        this->expolygons(layer.lslices);
+        this->size(layer.lslices_bboxes.size());
+        for (const BoundingBox &bbox : layer.lslices_bboxes)
+            this->bbox(bbox);
+        this->expolygons(layer.loverhangs);
+        this->bbox(layer.loverhangs_bbox);
+        this->size(layer.curled_lines.size());
+        for (const CurledLine &line : layer.curled_lines) {
+            this->pod(line.a);
+            this->pod(line.b);
+            this->pod(line.curled_height);
+        }
+        for (const LayerRegion *layer_region : layer.regions())
+            this->layer_region(*layer_region);
+    }
+    void support_layer(const SupportLayer &support_layer) {
+        this->layer(support_layer, support_layer.interface_id());
+        this->pod<int32_t>(int32_t(support_layer.support_type));
+        this->expolygons(support_layer.support_islands);
+        this->collection(support_layer.support_fills);
+    }
+
+    std::string&        data()       { return m_data; }
+    const std::string&  data() const { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+class CacheReader
+{
+public:
+    CacheReader(const char *begin, const char *end) : m_ptr(begin), m_end(end) {}
+
+    template<typename T> T pod() {
+        static_assert(is_plain_data<T>, "CacheReader::pod() accepts plain data only");
+        T value;
+        this->copy(&value, sizeof(T));
+        return value;
+    }
+    template<typename T> void pod(T &value) { value = this->pod<T>(); }
+    size_t size() { return size_t(this->pod<uint64_t>()); }
+    std::string string() {
+        size_t len = this->size();
+        this->check(len);
+        std::string out(m_ptr, len);
+        m_ptr += len;
+        return out;
+    }
+    void points(Points &points) {
+        size_t cnt = this->size();
+        if (cnt > size_t(m_end - m_ptr) / sizeof(Point))
+            throw Slic3r::FileIOError("Truncated slicing cache file");
+        points.resize(cnt);
+        this->copy(points.data(), cnt * sizeof(Point));
+    }
+    void bbox(BoundingBox &bbox) {
+        this->pod(bbox.min);
+        this->pod(bbox.max);
+        bbox.defined = true;
+    }
+    void expolygon(ExPolygon &expolygon) {
+        this->points(expolygon.contour.points);
+        expolygon.holes.resize(this->size());
+        for (Polygon &hole : expolygon.holes)
+            this->points(hole.points);
+    }
+    void expolygons(ExPolygons &expolygons) {
+        size_t cnt = this->size();
+        expolygons.reserve(expolygons.size() + cnt);
+        for (size_t i = 0; i < cnt; ++ i) {
+            expolygons.emplace_back();
+            this->expolygon(expolygons.back());
+        }
+    }
+    void surfaces(Surfaces &surfaces) {
+        size_t cnt = this->size();
+        surfaces.reserve(surfaces.size() + cnt);
+        for (size_t i = 0; i < cnt; ++ i) {
+            ExPolygon expolygon;
+            this->expolygon(expolygon);
+            Surface surface(SurfaceType(this->pod<int32_t>()), std::move(expolygon));
+            this->pod(surface.thickness);
+            this->pod(surface.thickness_layers);
+            this->pod(surface.bridge_angle);
+            this->pod(surface.extra_perimeters);
+            surfaces.emplace_back(std::move(surface));
+        }
+    }
+    void polyline(Polyline &polyline) {
+        this->points(polyline.points);
+        size_t cnt = this->size();
+        polyline.fitting_result.reserve(cnt);
+        for (size_t i = 0; i < cnt; ++ i) {
+            PathFittingData fitting;
+            fitting.start_point_index = this->size();
+            fitting.end_point_index   = this->size();
+            this->pod(fitting.path_type);
+            ArcSegment &arc = fitting.arc_data;
+            arc.is_arc = this->pod<uint8_t>() != 0;
+            if (arc.is_arc) {
+                this->pod(arc.length);
+                this->pod(arc.angle_radians);
+                this->pod(arc.polar_start_theta);
+                this->pod(arc.polar_end_theta);
+                this->pod(arc.start_point);
+                this->pod(arc.end_point);
+                this->pod(arc.direction);
+                this->pod(arc.radius);
+                this->pod(arc.center);
+            }
+            polyline.fitting_result.emplace_back(std::move(fitting));
+        }
+    }
+    void polylines(Polylines &polylines) {
+        size_t cnt = this->size();
+        polylines.reserve(polylines.size() + cnt);
+        for (size_t i = 0; i < cnt; ++ i) {
+            polylines.emplace_back();
+            this->polyline(polylines.back());
+        }
+    }
+    void path(ExtrusionPath &path) {
+        this->polyline(path.polyline);
+        this->pod(path.overhang_degree);
+        this->pod(path.curve_degree);
+        this->pod(path.mm3_per_mm);
+        this->pod(path.width);
+        this->pod(path.height);
+        path.set_extrusion_role(this->pod<ExtrusionRole>());
+        path.set_force_no_extrusion(this->pod<uint8_t>() != 0);
+    }
+    void paths(ExtrusionPaths &paths) {
+        paths.resize(this->size());
+        for (ExtrusionPath &path : paths)
+            this->path(path);
+    }
+    void collection(ExtrusionEntityCollection &collection) {
+        collection.no_sort = this->pod<uint8_t>() != 0;
+        size_t cnt = this->size();
+        collection.entities.reserve(collection.entities.size() + cnt);
+        for (size_t i = 0; i < cnt; ++ i)
+            collection.entities.emplace_back(this->entity());
+    }
+    ExtrusionEntity* entity() {
+        switch (this->pod<EntityTag>()) {
+        case EntityTag::Path: {
+            auto path = std::make_unique<ExtrusionPath>();
+            this->path(*path);
+            return path.release();
+        }
+        case EntityTag::MultiPath: {
+            auto multipath = std::make_unique<ExtrusionMultiPath>();
+            this->paths(multipath->paths);
+            return multipath.release();
+        }
+        case EntityTag::Loop: {
+            auto loop = std::make_unique<ExtrusionLoop>();
+            loop->set_loop_role(this->pod<ExtrusionLoopRole>());
+            this->paths(loop->paths);
+            return loop.release();
+        }
+        case EntityTag::Collection: {
+            auto collection = std::make_unique<ExtrusionEntityCollection>();
+            this->collection(*collection);
+            return collection.release();
+        }
+        default:
+            throw Slic3r::FileIOError("Unknown extrusion entity type in the slicing cache");
+        }
+    }
+    void layer_region(LayerRegion &layer_region) {
+        this->surfaces(layer_region.slices.surfaces);
+        this->expolygons(layer_region.raw_slices);
+        this->collection(layer_region.thin_fills);
+        this->expolygons(layer_region.fill_expolygons);
+        this->surfaces(layer_region.fill_surfaces.surfaces);
+        this->expolygons(layer_region.fill_no_overlap_expolygons);
+        this->polylines(layer_region.unsupported_bridge_edges);
+        this->collection(layer_region.perimeters);
+        this->collection(layer_region.fills);
+    }
+
+    struct LayerPrefix {
+        size_t              id;
+        size_t              interface_id;
+        coordf_t            height;
+        coordf_t            print_z;
+        coordf_t            slice_z;
+        std::vector<size_t> region_hashes;
+    };
+    LayerPrefix layer_prefix() {
+        LayerPrefix prefix;
+        prefix.id           = this->size();
+        prefix.interface_id = this->size();
+        this->pod(prefix.height);
+        this->pod(prefix.print_z);
+        this->pod(prefix.slice_z);
+        prefix.region_hashes.resize(this->size());
+        for (size_t &hash : prefix.region_hashes)
+            hash = this->size();
+        return prefix;
+    }
+    void layer(Layer &layer) {
+        this->layer_prefix();
+        this->expolygons(layer.lslices);
+        layer.lslices_bboxes.resize(this->size());
+        for (BoundingBox &bbox : layer.lslices_bboxes)
+            this->bbox(bbox);
+        this->expolygons(layer.loverhangs);
+        this->bbox(layer.loverhangs_bbox);
+        size_t cnt = this->size();
+        if (cnt > size_t(m_end - m_ptr) / (2 * sizeof(Point) + sizeof(float)))
+            throw Slic3r::FileIOError("Truncated slicing cache file");
+        layer.curled_lines.resize(cnt);
+        for (CurledLine &line : layer.curled_lines) {
+            this->pod(line.a);
+            this->pod(line.b);
+            this->pod(line.curled_height);
+        }
+        for (size_t region_id = 0; region_id < layer.region_count(); ++ region_id)
+            this->layer_region(*layer.get_region(int(region_id)));
+    }
+    void support_layer(SupportLayer &support_layer) {
+        this->layer(support_layer);
+        support_layer.support_type = SupportInnerType(this->pod<int32_t>());
+        this->expolygons(support_layer.support_islands);
+        this->collection(support_layer.support_fills);
+    }
+
+    const char* position() const { return m_ptr; }
+
+private:
+    void check(size_t len) const {
+        if (len > size_t(m_end - m_ptr))
+            throw Slic3r::FileIOError("Truncated slicing cache file");
+    }
+    void copy(void *dst, size_t len) {
+        this->check(len);
+        if (len > 0)
+            ::memcpy(dst, m_ptr, len);
+        m_ptr += len;
+    }
+
+    const char *m_ptr;
+    const char *m_end;
+};
+
+} // namespace
+
+void store_slice_cache(const PrintObject &print_object, size_t identify_id, const std::string &path)
+{
+    const size_t num_layers         = print_object.layer_count();
+    const size_t num_support_layers = print_object.support_layer_count();
+
+    // Serialize the layers in parallel, each into its own buffer.
+    std::vector<std::string> records(num_layers + num_support_layers);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, records.size()), [&print_object, &records, num_layers](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            CacheWriter writer;
+            if (i < num_layers)
+                writer.layer(*print_object.get_layer(int(i)), 0);
+            else
+                writer.support_layer(*print_object.support_layers()[i - num_layers]);
+            records[i] = std::move(writer.data());
+        }
+    });
+
+    CacheWriter header;
+    header.data().append(SLICE_CACHE_MAGIC, sizeof(SLICE_CACHE_MAGIC));
+    header.pod(SLICE_CACHE_VERSION);
+    header.pod(SLICE_CACHE_BYTE_ORDER);
+    header.pod<uint32_t>(sizeof(coord_t));
+    header.string(print_object.model_object()->name);
+    header.size(identify_id);
+    header.size(num_layers);
+    header.size(num_support_layers);
+
+    // First layer groups, the volume IDs are converted to indices of the volumes of the (shared) ModelObject.
+    const PrintObject *shared_object = print_object.get_shared_object() ? print_object.get_shared_object() : &print_object;
+    const ModelVolumePtrs &volumes = shared_object->model_object()->volumes;
+    const std::vector<groupedVolumeSlices> &first_layer_groups = print_object.firstLayerObjGroups();
+    header.size(first_layer_groups.size());
+    for (const groupedVolumeSlices &group : first_layer_groups) {
+        header.pod<int32_t>(group.groupId);
+        header.size(group.volume_ids.size());
+        for (const ObjectID &volume_id : group.volume_ids) {
+            size_t idx = std::find_if(volumes.begin(), volumes.end(), [&volume_id](const ModelVolume *v) { return v->id() == volume_id; }) - volumes.begin();
+            header.size(idx < volumes.size() ? idx : volume_id.id);
+        }
+        header.expolygons(group.slices);
+    }
+
+    // Offsets of the layer records relative to the end of the offset table, with one extra entry marking the end of data.
+    size_t offset = 0;
+    for (const std::string &record : records) {
+        header.size(offset);
+        offset += record.size();
+    }
+    header.size(offset);
+
+    FILE *file = boost::nowide::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        throw Slic3r::FileIOError("Failed to open " + path + " for writing the slicing cache");
+    bool ok = ::fwrite(header.data().data(), 1, header.data().size(), file) == header.data().size();
+    for (size_t i = 0; ok && i < records.size(); ++ i)
+        ok = ::fwrite(records[i].data(), 1, records[i].size(), file) == records[i].size();
+    ok &= ::fclose(file) == 0;
+    if (! ok)
+        throw Slic3r::FileIOError("Failed to write the slicing cache " + path);
+}
+
+int load_slice_cache(PrintObject &print_object, const std::string &path, const std::function<const PrintRegion*(size_t config_hash)> &find_region)
+{
+    boost::iostreams::mapped_file_source file;
+    try {
+        file.open(path);
+    } catch (const std::exception &err) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": failed to map " << path << ", reason = " << err.what();
+        return CLI_IMPORT_CACHE_LOAD_FAILED;
+    }
+    if (! file.is_open() || file.size() < sizeof(SLICE_CACHE_MAGIC) || ::memcmp(file.data(), SLICE_CACHE_MAGIC, sizeof(SLICE_CACHE_MAGIC)) != 0) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": " << path << " is not a slicing cache file";
+        return CLI_IMPORT_CACHE_LOAD_FAILED;
+    }
+
+    try {
+        CacheReader header(file.data() + sizeof(SLICE_CACHE_MAGIC), file.data() + file.size());
+        uint32_t version    = header.pod<uint32_t>();
+        uint32_t byte_order = header.pod<uint32_t>();
+        uint32_t coord_size = header.pod<uint32_t>();
+        if (version != SLICE_CACHE_VERSION || byte_order != SLICE_CACHE_BYTE_ORDER || coord_size != sizeof(coord_t)) {
+            BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << boost::format(": %1% has an incompatible version %2% or layout, expected version %3%") % path % version % SLICE_CACHE_VERSION;
+            return CLI_IMPORT_CACHE_DATA_CAN_NOT_USE;
+        }
+        std::string name               = header.string();
+        size_t      identify_id        = header.size();
+        size_t      num_layers         = header.size();
+        size_t      num_support_layers = header.size();
+        size_t      num_groups         = header.size();
+        BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": will load %1%, identify_id %2%, layer_count %3%, support_layer_count %4%, firstlayer_group_count %5%")
+            % name % identify_id % num_layers % num_support_layers % num_groups;
+
+        std::vector<groupedVolumeSlices> first_layer_groups(num_groups);
+        ModelVolumePtrs &volumes = print_object.model_object()->volumes;
+        for (groupedVolumeSlices &group : first_layer_groups) {
+            group.groupId = header.pod<int32_t>();
+            group.volume_ids.resize(header.size());
+            for (ObjectID &volume_id : group.volume_ids) {
+                size_t idx = header.size();
+                if (idx >= volumes.size()) {
+                    BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << boost::format(": can not find volume_id %1% from object file %2% in firstlayer groups, volume_count %3%!")
+                        % idx % path % volumes.size();
+                    return CLI_IMPORT_CACHE_LOAD_FAILED;
+                }
+                volume_id = volumes[idx]->id();
+            }
+            header.expolygons(group.slices);
+        }
+
+        std::vector<size_t> offsets(num_layers + num_support_layers + 1);
+        for (size_t &offset : offsets)
+            offset = header.size();
+        const char *data_begin = header.position();
+        const char *data_end   = file.data() + file.size();
+        for (size_t i = 1; i < offsets.size(); ++ i)
+            if (offsets[i] < offsets[i - 1] || offsets[i] > size_t(data_end - data_begin)) {
+                BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": corrupted offset table in " << path;
+                return CLI_IMPORT_CACHE_LOAD_FAILED;
+            }
+        auto record = [&offsets, data_begin](size_t i) { return CacheReader(data_begin + offsets[i], data_begin + offsets[i + 1]); };
+
+        // Create the layers and their regions serially, the layers are linked to their neighbours.
+        for (size_t i = 0; i < num_layers; ++ i) {
+            CacheReader::LayerPrefix prefix = record(i).layer_prefix();
+            Layer *layer = print_object.add_layer(int(prefix.id), prefix.height, prefix.print_z, prefix.slice_z);
+            if (i > 0) {
+                layer->lower_layer = print_object.get_layer(int(i - 1));
+                layer->lower_layer->upper_layer = layer;
+            }
+            for (size_t hash : prefix.region_hashes) {
+                const PrintRegion *print_region = find_region(hash);
+                if (print_region == nullptr) {
+                    BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << boost::format(": can not find region with hash %1% for layer %2% in %3%") % hash % i % path;
+                    return CLI_IMPORT_CACHE_DATA_CAN_NOT_USE;
+                }
+                layer->add_region(print_region);
+            }
+        }
+        for (size_t i = 0; i < num_support_layers; ++ i) {
+            CacheReader::LayerPrefix prefix = record(num_layers + i).layer_prefix();
+            SupportLayer *support_layer = print_object.add_support_layer(int(prefix.id), int(prefix.interface_id), prefix.height, prefix.print_z);
+            if (i > 0) {
+                support_layer->lower_layer = print_object.get_support_layer(int(i - 1));
+                support_layer->lower_layer->upper_layer = support_layer;
+            }
+        }
+
+        // Decode the layer data in parallel straight from the mapped file.
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, num_layers + num_support_layers), [&print_object, &record, num_layers](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                CacheReader reader = record(i);
+                if (i < num_layers)
+                    reader.layer(*print_object.get_layer(int(i)));
+                else
+                    reader.support_layer(*print_object.get_support_layer(int(i - num_layers)));
+            }
+        });
+
+        print_object.firstLayerObjGroupsMod() = std::move(first_layer_groups);
+        BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": loaded %1% layers and %2% support layers from %3%") % num_layers % num_support_layers % path;
+    } catch (const std::bad_alloc &err) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": load from " << path << " got a bad_alloc, reason = " << err.what();
+        return CLI_OUT_OF_MEMORY;
+    } catch (const std::exception &err) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": load from " << path << " got a generic exception, reason = " << err.what();
+        return CLI_IMPORT_CACHE_LOAD_FAILED;
+    }
+    return 0;
+}
+
+SliceCacheStore::SliceCacheStore(const std::string &directory, size_t max_bytes) : m_directory(directory), m_max_bytes(max_bytes)
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(m_directory, ec);
+    if (ec)
+        BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << ": failed to create the slicing cache directory " << m_directory << ", reason = " << ec.message();
+}
+
+std::string SliceCacheStore::path(const std::string &key) const
+{
+    return (boost::filesystem::path(m_directory) / (key + SLICE_CACHE_EXTENSION)).string();
+}
+
+bool SliceCacheStore::load(PrintObject &print_object, const std::string &key, const std::function<const PrintRegion*(size_t config_hash)> &find_region)
+{
+    const std::string         file_path = this->path(key);
+    boost::system::error_code ec;
+    if (! boost::filesystem::exists(file_path, ec)) {
+        ++ m_misses;
+        return false;
+    }
+    if (int ret = load_slice_cache(print_object, file_path, find_region); ret != 0) {
+        BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << boost::format(": failed to load %1%, ret=%2%, the object will be sliced") % file_path % ret;
+        ++ m_misses;
+        return false;
+    }
+    // The modification time orders the files for the eviction.
+    boost::filesystem::last_write_time(file_path, std::time(nullptr), ec);
+    ++ m_hits;
+    return true;
+}
+
+void SliceCacheStore::store(const PrintObject &print_object, const std::string &key)
+{
+    // Written into a temporary file and renamed, so that another process slicing the same object never maps a partially written file.
+    const std::string         file_path = this->path(key);
+    const std::string         tmp_path  = file_path + boost::filesystem::unique_path(".%%%%-%%%%.tmp").string();
+    boost::system::error_code ec;
+    try {
+        store_slice_cache(print_object, 0, tmp_path);
+        boost::filesystem::rename(tmp_path, file_path);
+        ++ m_stored;
+    } catch (const std::exception &err) {
+        BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << ": failed to store " << file_path << ", reason = " << err.what();
+        boost::filesystem::remove(tmp_path, ec);
+    }
+}
+
+void SliceCacheStore::evict()
+{
+    std::scoped_lock<std::mutex> lock(m_evict_mutex);
+
+    struct Entry {
+        std::time_t             time;
+        uintmax_t               size;
+        boost::filesystem::path path;
+    };
+    std::vector<Entry>        entries;
+    uintmax_t                 total = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(m_directory, ec), end; ! ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != SLICE_CACHE_EXTENSION)
+            continue;
+        boost::system::error_code ec_size, ec_time;
+        uintmax_t   size = boost::filesystem::file_size(it->path(), ec_size);
+        std::time_t time = boost::filesystem::last_write_time(it->path(), ec_time);
+        if (! ec_size && ! ec_time) {
+            entries.push_back({ time, size, it->path() });
+            total += size;
+        }
+    }
+    if (total <= m_max_bytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r) { return l.time < r.time; });
+    size_t num_evicted = 0;
+    for (const Entry &entry : entries) {
+        if (total <= m_max_bytes)
+            break;
+        // Removing a file mapped by another process may fail on Windows, such a file is evicted next time.
+        if (boost::filesystem::remove(entry.path, ec)) {
+            total -= entry.size;
+            ++ num_evicted;
+        }
+    }
+    m_evicted += num_evicted;
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": %1% files evicted, %2% bytes left in %3%") % num_evicted % total % m_directory;
+}
+
+} // namespace Slic3r
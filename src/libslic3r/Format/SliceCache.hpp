@@ -0,0 +1,74 @@
+#ifndef slic3r_Format_SliceCache_hpp_
+#define slic3r_Format_SliceCache_hpp_
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace Slic3r {
+
+class PrintObject;
+class PrintRegion;
+
+// Binary slicing cache of a single PrintObject: layers, layer regions, support layers and first layer groups.
+// It is the binary counterpart of the obj_<id>.json files written by Print::export_cached_data().
+// The file starts with a header and an offset table, so that the layers could be decoded in parallel
+// straight from a memory mapped file. Point arrays are stored in the in-memory layout of Slic3r::Points
+// and restored with a single memcpy, without any per coordinate parsing.
+
+// Bump when the layout of the serialized data changes. Files with a different version are rejected.
+static constexpr uint32_t SLICE_CACHE_VERSION = 2;
+// File extension of the binary cache files, the JSON cache files use ".json".
+static constexpr const char *SLICE_CACHE_EXTENSION = ".bin";
+
+// Serialize print_object into path. Throws Slic3r::FileIOError on failure.
+extern void store_slice_cache(const PrintObject &print_object, size_t identify_id, const std::string &path);
+
+// Load the layers and support layers of print_object from path. The layers of print_object are expected to be cleared.
+// find_region maps the config hash of a stored LayerRegion to a PrintRegion of print_object.
+// Returns 0 on success, otherwise one of the CLI_IMPORT_CACHE_* / CLI_OUT_OF_MEMORY error codes.
+extern int load_slice_cache(PrintObject &print_object, const std::string &path, const std::function<const PrintRegion*(size_t config_hash)> &find_region);
+
+// Persistent content addressed store of the slicing caches, shared by the prints sliced on this machine.
+// A file is named by a key of the object (see Print::slice_cache_keys()), which covers the transformed meshes
+// and every configuration option the stored object steps depend on. A file thus never goes stale, a modified object maps
+// to another key. Once the files exceed the size limit, the least recently used ones are evicted.
+class SliceCacheStore
+{
+public:
+    SliceCacheStore(const std::string &directory, size_t max_bytes);
+
+    const std::string&  directory() const { return m_directory; }
+    size_t              max_bytes() const { return m_max_bytes; }
+
+    // Load print_object stored under key, see load_slice_cache(). The layers of print_object are expected to be cleared.
+    // Returns false on a cache miss or if the stored file could not be used, the layers of print_object may be partially loaded then.
+    bool                load(PrintObject &print_object, const std::string &key, const std::function<const PrintRegion*(size_t config_hash)> &find_region);
+    // Store print_object under key. A failure is only logged, the print does not depend on the cache.
+    void                store(const PrintObject &print_object, const std::string &key);
+    // Remove the least recently used files until the stored files fit into max_bytes().
+    void                evict();
+
+    size_t              hits()   const { return m_hits; }
+    size_t              misses() const { return m_misses; }
+    size_t              stored() const { return m_stored; }
+    size_t              evicted() const { return m_evicted; }
+
+private:
+    std::string         path(const std::string &key) const;
+
+    std::string         m_directory;
+    size_t              m_max_bytes;
+    std::atomic<size_t> m_hits    { 0 };
+    std::atomic<size_t> m_misses  { 0 };
+    std::atomic<size_t> m_stored  { 0 };
+    std::atomic<size_t> m_evicted { 0 };
+    std::mutex          m_evict_mutex;
+};
+
+} // namespace Slic3r
+
+#endif /* slic3r_Format_SliceCache_hpp_ */
@@ -43,6 +43,15 @@ namespace pt = boost::property_tree;
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+#include <tbb/version.h>
+#if TBB_VERSION_MAJOR >= 2021
+    #include <tbb/parallel_pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter_mode;
+#else
+    #include <tbb/pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter;
+#endif
 
 #include <expat.h>
 #include <Eigen/Dense>
@@ -459,6 +468,131 @@ bool bbs_get_attribute_value_bool(const char** attributes, unsigned int attribut
     return (text != nullptr) ? (bool)::atoi(text) : true;
 }
 
+// Uncompressed size of an object .model file, from which on the meshes are scanned in parallel.
+static constexpr size_t IMPORT_3MF_PARALLEL_MESH_MIN_SIZE = 16 * 1024 * 1024;
+// Approximate size of a chunk of a <vertices> or <triangles> block scanned by a single worker.
+static constexpr size_t IMPORT_3MF_MESH_CHUNK_SIZE        = 1024 * 1024;
+
+// Scanner of the content of the <vertices> and <triangles> blocks of large meshes, which runs without expat,
+// so that a block split into chunks could be scanned in parallel. Only plain elements with quoted attributes
+// are accepted, anything else (text, comments, entity references) fails the scan and the block is left to expat.
+class MeshElementScanner
+{
+public:
+    MeshElementScanner(const char *begin, const char *end) : m_ptr(begin), m_end(end) {}
+
+    // Call on_element() for each element named element_name.
+    template<typename OnElement>
+    bool scan(const char *element_name, OnElement on_element)
+    {
+        const size_t name_length = strlen(element_name);
+        for (;;) {
+            this->skip_whitespaces();
+            if (m_ptr == m_end)
+                return true;
+            if (*m_ptr ++ != '<')
+                return false;
+            bool closing = m_ptr != m_end && *m_ptr == '/';
+            if (closing)
+                ++ m_ptr;
+            if (size_t(m_end - m_ptr) <= name_length || memcmp(m_ptr, element_name, name_length) != 0)
+                return false;
+            m_ptr += name_length;
+            if (closing) {
+                // Closing tag of a non-empty element.
+                this->skip_whitespaces();
+                if (m_ptr == m_end || *m_ptr ++ != '>')
+                    return false;
+                continue;
+            }
+            if (! is_whitespace(*m_ptr) && *m_ptr != '/' && *m_ptr != '>')
+                return false;
+            m_attributes.clear();
+            for (;;) {
+                this->skip_whitespaces();
+                if (m_ptr == m_end)
+                    return false;
+                if (*m_ptr == '/' || *m_ptr == '>') {
+                    if (*m_ptr == '/' && (++ m_ptr == m_end || *m_ptr != '>'))
+                        return false;
+                    ++ m_ptr;
+                    break;
+                }
+                const char *name_begin = m_ptr;
+                while (m_ptr != m_end && *m_ptr != '=' && ! is_whitespace(*m_ptr) && *m_ptr != '/' && *m_ptr != '>')
+                    ++ m_ptr;
+                std::string_view name(name_begin, m_ptr - name_begin);
+                this->skip_whitespaces();
+                if (name.empty() || m_ptr == m_end || *m_ptr ++ != '=')
+                    return false;
+                this->skip_whitespaces();
+                if (m_ptr == m_end || (*m_ptr != '"' && *m_ptr != '\''))
+                    return false;
+                const char  quote       = *m_ptr ++;
+                const char *value_begin = m_ptr;
+                while (m_ptr != m_end && *m_ptr != quote) {
+                    if (*m_ptr == '&' || *m_ptr == '<')
+                        return false;
+                    ++ m_ptr;
+                }
+                if (m_ptr == m_end)
+                    return false;
+                m_attributes.emplace_back(name, std::string_view(value_begin, m_ptr ++ - value_begin));
+            }
+            on_element(*this);
+        }
+    }
+
+    std::string_view attribute(const char *name) const
+    {
+        for (const auto &attribute : m_attributes)
+            if (attribute.first == name)
+                return attribute.second;
+        return {};
+    }
+
+    // Same conversions as bbs_get_attribute_value_float() / bbs_get_attribute_value_int(), missing values are ZERO.
+    float attribute_float(const char *name) const
+    {
+        float value = 0.0f;
+        if (std::string_view text = this->attribute(name); ! text.empty())
+            fast_float::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+
+    int attribute_int(const char *name) const
+    {
+        int value = 0;
+        if (std::string_view text = this->attribute(name); ! text.empty())
+            boost::spirit::qi::parse(text.data(), text.data() + text.size(), boost::spirit::qi::int_, value);
+        return value;
+    }
+
+    std::string attribute_string(const char *name) const { return std::string(this->attribute(name)); }
+
+    // Start of the first element after ptr, the chunks of a block are split there.
+    static const char* next_element(const char *ptr, const char *end)
+    {
+        while (ptr != end) {
+            ptr = static_cast<const char*>(memchr(ptr, '<', end - ptr));
+            if (ptr == nullptr)
+                return end;
+            if (ptr + 1 != end && ptr[1] != '/')
+                return ptr;
+            ++ ptr;
+        }
+        return end;
+    }
+
+private:
+    static bool is_whitespace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+    void skip_whitespaces() { while (m_ptr != m_end && is_whitespace(*m_ptr)) ++ m_ptr; }
+
+    const char                                                  *m_ptr;
+    const char                                                  *m_end;
+    std::vector<std::pair<std::string_view, std::string_view>>   m_attributes;
+};
+
 void add_vec3(std::stringstream &stream, const Slic3r::Vec3f &tr)
 {
     for (unsigned r = 0; r < 3; ++r) {
@@ -835,6 +969,8 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
             int object_current_color_group{-1};
             std::map<int, std::string> object_group_id_to_color;
             bool is_bbl_3mf { false };
+            // VERTICES_TAG or TRIANGLES_TAG while expat is inside of the respective block of a mesh.
+            const char *mesh_block_tag { nullptr };
 
             ObjectImporter(_BBS_3MF_Importer *importer, std::string file_path, std::string obj_path)
             {
@@ -876,6 +1012,8 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
             }
 
             bool _extract_object_from_archive(mz_zip_archive& archive, const mz_zip_archive_file_stat& stat);
+            void _parse_object_model_buffer(const char* data, size_t size, const mz_zip_archive_file_stat& stat);
+            bool _scan_mesh_block(const char* tag, const char* begin, const char* end);
 
             bool extract_object_model()
             {
@@ -4995,12 +5133,13 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
         // reset current vertices
         if (current_object)
             current_object->geometry.vertices.clear();
+        mesh_block_tag = VERTICES_TAG;
         return true;
     }
 
     bool _BBS_3MF_Importer::ObjectImporter::_handle_object_end_vertices()
     {
-        // do nothing
+        mesh_block_tag = nullptr;
         return true;
     }
 
@@ -5027,12 +5166,13 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
         // reset current triangles
         if (current_object)
             current_object->geometry.triangles.clear();
+        mesh_block_tag = TRIANGLES_TAG;
         return true;
     }
 
     bool _BBS_3MF_Importer::ObjectImporter::_handle_object_end_triangles()
     {
-        // do nothing
+        mesh_block_tag = nullptr;
         return true;
     }
 
@@ -5265,17 +5405,26 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
 
         try
         {
-            mz_file_write_func callback = [](void* pOpaque, mz_uint64 file_ofs, const void* pBuf, size_t n)->size_t {
-                CallbackData* data = (CallbackData*)pOpaque;
-                if (!XML_Parse(data->parser, (const char*)pBuf, (int)n, (file_ofs + n == data->stat.m_uncomp_size) ? 1 : 0) || data->importer.object_parse_error()) {
-                    char error_buf[1024];
-                    ::snprintf(error_buf, 1024, "Error (%s) while parsing '%s' at line %d", data->importer.object_parse_error_message(), data->stat.m_filename, (int)XML_GetCurrentLineNumber(data->parser));
-                    throw Slic3r::FileIOError(error_buf);
-                }
-                return n;
-            };
-            void* opaque = &data;
-            res = mz_zip_reader_extract_to_callback(&archive, stat.m_file_index, callback, opaque, 0);
+            if (stat.m_uncomp_size >= IMPORT_3MF_PARALLEL_MESH_MIN_SIZE) {
+                // Large mesh: inflate the whole file, so that the vertices and triangles could be scanned in parallel.
+                std::string buffer;
+                buffer.resize(stat.m_uncomp_size);
+                res = mz_zip_reader_extract_to_mem(&archive, stat.m_file_index, buffer.data(), buffer.size(), 0);
+                if (res)
+                    _parse_object_model_buffer(buffer.data(), buffer.size(), stat);
+            } else {
+                mz_file_write_func callback = [](void* pOpaque, mz_uint64 file_ofs, const void* pBuf, size_t n)->size_t {
+                    CallbackData* data = (CallbackData*)pOpaque;
+                    if (!XML_Parse(data->parser, (const char*)pBuf, (int)n, (file_ofs + n == data->stat.m_uncomp_size) ? 1 : 0) || data->importer.object_parse_error()) {
+                        char error_buf[1024];
+                        ::snprintf(error_buf, 1024, "Error (%s) while parsing '%s' at line %d", data->importer.object_parse_error_message(), data->stat.m_filename, (int)XML_GetCurrentLineNumber(data->parser));
+                        throw Slic3r::FileIOError(error_buf);
+                    }
+                    return n;
+                };
+                void* opaque = &data;
+                res = mz_zip_reader_extract_to_callback(&archive, stat.m_file_index, callback, opaque, 0);
+            }
         }
         catch (const version_error& e)
         {
@@ -5298,6 +5447,118 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
         return true;
     }
 
+    void _BBS_3MF_Importer::ObjectImporter::_parse_object_model_buffer(const char* data, size_t size, const mz_zip_archive_file_stat& stat)
+    {
+        auto parse_xml = [this, &stat](const char* begin, const char* end, bool is_final) {
+            // XML_Parse() takes an int length.
+            do {
+                const char* next = begin + std::min<size_t>(end - begin, 64 * 1024 * 1024);
+                if (!XML_Parse(object_xml_parser, begin, int(next - begin), (is_final && next == end) ? 1 : 0) || object_parse_error()) {
+                    char error_buf[1024];
+                    ::snprintf(error_buf, 1024, "Error (%s) while parsing '%s' at line %d", object_parse_error_message(), stat.m_filename, (int)XML_GetCurrentLineNumber(object_xml_parser));
+                    throw Slic3r::FileIOError(error_buf);
+                }
+                begin = next;
+            } while (begin != end);
+        };
+
+        const char*      end = data + size;
+        std::string_view document(data, size);
+        for (const char* ptr = data;;) {
+            // Find the next <vertices> or <triangles> block with some content.
+            const char* tag           = nullptr;
+            const char* content_begin = end;
+            for (const char* block_tag : { VERTICES_TAG, TRIANGLES_TAG }) {
+                std::string open_tag = std::string("<") + block_tag;
+                for (size_t pos = document.find(open_tag, ptr - data); pos != std::string_view::npos; pos = document.find(open_tag, pos + 1)) {
+                    const char* tag_end = data + pos + open_tag.size();
+                    if (tag_end != end && (*tag_end == '>' || *tag_end == ' ' || *tag_end == '\t' || *tag_end == '\r' || *tag_end == '\n')) {
+                        if (const char* gt = static_cast<const char*>(memchr(tag_end, '>', end - tag_end)); gt != nullptr && gt[-1] != '/' && gt + 1 < content_begin) {
+                            tag           = block_tag;
+                            content_begin = gt + 1;
+                        }
+                        break;
+                    }
+                }
+            }
+            const char* content_end = nullptr;
+            if (tag != nullptr) {
+                size_t pos  = document.find(std::string("</") + tag, content_begin - data);
+                content_end = pos == std::string_view::npos ? nullptr : data + pos;
+            }
+            if (content_end == nullptr) {
+                parse_xml(ptr, end, true);
+                break;
+            }
+            // Let expat process the start tag of the block, it resets the geometry of the current object.
+            parse_xml(ptr, content_begin, false);
+            if (mesh_block_tag != tag || current_object == nullptr || !_scan_mesh_block(tag, content_begin, content_end))
+                // Not inside of a mesh of a valid object or the block is not in the canonical form, let expat parse it.
+                parse_xml(content_begin, content_end, false);
+            ptr = content_end;
+        }
+    }
+
+    bool _BBS_3MF_Importer::ObjectImporter::_scan_mesh_block(const char* tag, const char* begin, const char* end)
+    {
+        std::vector<const char*> splits { begin };
+        const size_t num_chunks = std::max<size_t>(1, (end - begin) / IMPORT_3MF_MESH_CHUNK_SIZE);
+        for (size_t i = 1; i < num_chunks; ++ i)
+            if (const char* split = MeshElementScanner::next_element(std::max(splits.back() + 1, begin + (end - begin) * i / num_chunks), end); split != end)
+                splits.emplace_back(split);
+        splits.emplace_back(end);
+        const size_t      num_ranges = splits.size() - 1;
+        std::atomic<bool> failed { false };
+        Geometry&         geometry   = current_object->geometry;
+
+        if (tag == VERTICES_TAG) {
+            std::vector<std::vector<Vec3f>> vertices(num_ranges);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, num_ranges, 1), [this, &splits, &vertices, &failed](const tbb::blocked_range<size_t>& range) {
+                for (size_t i = range.begin(); i < range.end() && !failed; ++ i)
+                    if (!MeshElementScanner(splits[i], splits[i + 1]).scan(VERTEX_TAG, [this, &out = vertices[i]](const MeshElementScanner& element) {
+                            out.emplace_back(
+                                object_unit_factor * element.attribute_float(X_ATTR),
+                                object_unit_factor * element.attribute_float(Y_ATTR),
+                                object_unit_factor * element.attribute_float(Z_ATTR));
+                        }))
+                        failed = true;
+            });
+            if (failed)
+                return false;
+            for (const std::vector<Vec3f>& range_vertices : vertices)
+                append(geometry.vertices, range_vertices);
+        } else {
+            // we are ignoring the following attributes:
+            // p1
+            // p2
+            // p3
+            // pid
+            // see specifications
+            std::vector<Geometry> triangles(num_ranges);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, num_ranges, 1), [&splits, &triangles, &failed](const tbb::blocked_range<size_t>& range) {
+                for (size_t i = range.begin(); i < range.end() && !failed; ++ i)
+                    if (!MeshElementScanner(splits[i], splits[i + 1]).scan(TRIANGLE_TAG, [&out = triangles[i]](const MeshElementScanner& element) {
+                            out.triangles.emplace_back(element.attribute_int(V1_ATTR), element.attribute_int(V2_ATTR), element.attribute_int(V3_ATTR));
+                            out.custom_supports.emplace_back(element.attribute_string(CUSTOM_SUPPORTS_ATTR));
+                            out.custom_seam.emplace_back(element.attribute_string(CUSTOM_SEAM_ATTR));
+                            out.mmu_segmentation.emplace_back(element.attribute_string(MMU_SEGMENTATION_ATTR));
+                            // BBS
+                            out.face_properties.emplace_back(element.attribute_string(FACE_PROPERTY_ATTR));
+                        }))
+                        failed = true;
+            });
+            if (failed)
+                return false;
+            for (Geometry& range_triangles : triangles) {
+                append(geometry.triangles, std::move(range_triangles.triangles));
+                append(geometry.custom_supports, std::move(range_triangles.custom_supports));
+                append(geometry.custom_seam, std::move(range_triangles.custom_seam));
+                append(geometry.mmu_segmentation, std::move(range_triangles.mmu_segmentation));
+                append(geometry.face_properties, std::move(range_triangles.face_properties));
+            }
+        }
+        return true;
+    }
 
     class _BBS_3MF_Exporter : public _BBS_3MF_Base
     {
@@ -6626,6 +6887,55 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
     using coordinate_type_scientific = boost::spirit::karma::real_generator<float, coordinate_policy_scientific<float>>;
 #endif // EXPORT_3MF_USE_SPIRIT_KARMA_FP
 
+    // Number of vertices or triangles of a mesh, from which on they are formatted in parallel.
+    static constexpr size_t EXPORT_3MF_PARALLEL_MESH_MIN_ELEMENTS = 64 * 1024;
+    // Number of vertices or triangles formatted by a single worker.
+    static constexpr size_t EXPORT_3MF_MESH_CHUNK_ELEMENTS        = 16 * 1024;
+
+    // Format count mesh elements by append_element(out, idx) and hand them over to flush() in their original order.
+    // Large meshes are formatted by chunks in parallel, while the chunks already formatted are being compressed by flush().
+    template<typename AppendElementFn>
+    static bool format_mesh_elements(size_t count, std::string &output_buffer, std::function<bool(std::string &, bool)> const &flush, AppendElementFn append_element)
+    {
+        if (count < EXPORT_3MF_PARALLEL_MESH_MIN_ELEMENTS) {
+            for (size_t i = 0; i < count; ++ i) {
+                append_element(output_buffer, i);
+                if (! flush(output_buffer, false))
+                    return false;
+            }
+            return true;
+        }
+
+        const size_t num_chunks = (count + EXPORT_3MF_MESH_CHUNK_ELEMENTS - 1) / EXPORT_3MF_MESH_CHUNK_ELEMENTS;
+        size_t       next_chunk = 0;
+        bool         ok         = true;
+        tbb::parallel_pipeline(2 * size_t(tbb::this_task_arena::max_concurrency()),
+            tbb::make_filter<void, size_t>(slic3r_tbb_filtermode::serial_in_order,
+                [&next_chunk, &ok, num_chunks](tbb::flow_control &fc) -> size_t {
+                    if (next_chunk == num_chunks || ! ok) {
+                        fc.stop();
+                        return 0;
+                    }
+                    return next_chunk ++;
+                }) &
+            tbb::make_filter<size_t, std::string>(slic3r_tbb_filtermode::parallel,
+                [count, &append_element](size_t chunk) {
+                    std::string out;
+                    out.reserve(EXPORT_3MF_MESH_CHUNK_ELEMENTS * 64);
+                    for (size_t i = chunk * EXPORT_3MF_MESH_CHUNK_ELEMENTS; i < std::min(count, (chunk + 1) * EXPORT_3MF_MESH_CHUNK_ELEMENTS); ++ i)
+                        append_element(out, i);
+                    return out;
+                }) &
+            tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
+                [&output_buffer, &flush, &ok](std::string &&chunk) {
+                    if (ok) {
+                        output_buffer += chunk;
+                        ok = flush(output_buffer, false);
+                    }
+                }));
+        return ok;
+    }
+
     //BBS: change volume to seperate objects
     bool _BBS_3MF_Exporter::_add_mesh_to_object_stream(std::function<bool(std::string &, bool)> const &flush, ObjectData const &object_data) const
     {
@@ -6683,7 +6993,6 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
 
         auto const & object = *object_data.object;
 
-        char buf[256];
         unsigned int vertices_count = 0;
         //unsigned int triangles_count = 0;
         for (unsigned int index = 0; index < object.volumes.size(); index++) {
@@ -6738,11 +7047,12 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
 
             vertices_count += (int)its.vertices.size();
 
-            for (size_t i = 0; i < its.vertices.size(); ++i) {
+            if (!format_mesh_elements(its.vertices.size(), output_buffer, flush, [&its, &format_coordinate](std::string &out, size_t i) {
                 //don't save the volume's matrix into vertex data
                 //add the shared mesh logic
                 //Vec3f v = (matrix * its.vertices[i].cast<double>()).cast<float>();
                 Vec3f v = its.vertices[i];
+                char buf[256];
                 char* ptr = buf;
                 boost::spirit::karma::generate(ptr, boost::spirit::lit("     <") << VERTEX_TAG << " x=\"");
                 ptr = format_coordinate(v.x(), ptr);
@@ -6751,11 +7061,9 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
                 boost::spirit::karma::generate(ptr, "\" z=\"");
                 ptr = format_coordinate(v.z(), ptr);
                 boost::spirit::karma::generate(ptr, "\"/>\n");
-                *ptr = '\0';
-                output_buffer += buf;
-                if (!flush(output_buffer, false))
-                    return false;
-            }
+                out.append(buf, ptr - buf);
+            }))
+                return false;
         //}
 
             output_buffer += "    </";
@@ -6782,9 +7090,11 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
             //triangles_count += (int)its.indices.size();
             //unsigned int last_triangle_id = triangles_count - 1;
 
-            for (int i = 0; i < int(its.indices.size()); ++ i) {
+            if (!format_mesh_elements(its.indices.size(), output_buffer, flush, [&its, volume, is_left_handed](std::string &out, size_t triangle_idx) {
+                int i = int(triangle_idx);
                 {
                     const Vec3i32 &idx = its.indices[i];
+                    char buf[256];
                     char *ptr = buf;
                     boost::spirit::karma::generate(ptr, boost::spirit::lit("     <") << TRIANGLE_TAG <<
                         " v1=\"" << boost::spirit::int_ <<
@@ -6793,54 +7103,51 @@ void PlateData::parse_filament_info(GCodeProcessorResult *result)
                         idx[is_left_handed ? 2 : 0],
                         idx[1],
                         idx[is_left_handed ? 0 : 2]);
-                    *ptr = '\0';
-                    output_buffer += buf;
+                    out.append(buf, ptr - buf);
                 }
 
                 std::string custom_supports_data_string = volume->supported_facets.get_triangle_as_string(i);
                 if (! custom_supports_data_string.empty()) {
-                    output_buffer += " ";
-                    output_buffer += CUSTOM_SUPPORTS_ATTR;
-                    output_buffer += "=\"";
-                    output_buffer += custom_supports_data_string;
-                    output_buffer += "\"";
+                    out += " ";
+                    out += CUSTOM_SUPPORTS_ATTR;
+                    out += "=\"";
+                    out += custom_supports_data_string;
+                    out += "\"";
                 }
 
                 std::string custom_seam_data_string = volume->seam_facets.get_triangle_as_string(i);
                 if (! custom_seam_data_string.empty()) {
-                    output_buffer += " ";
-                    output_buffer += CUSTOM_SEAM_ATTR;
-                    output_buffer += "=\"";
-                    output_buffer += custom_seam_data_string;
-                    output_buffer += "\"";
+                    out += " ";
+                    out += CUSTOM_SEAM_ATTR;
+                    out += "=\"";
+                    out += custom_seam_data_string;
+                    out += "\"";
                 }
 
                 std::string mmu_painting_data_string = volume->mmu_segmentation_facets.get_triangle_as_string(i);
                 if (! mmu_painting_data_string.empty()) {
-                    output_buffer += " ";
-                    output_buffer += MMU_SEGMENTATION_ATTR;
-                    output_buffer += "=\"";
-                    output_buffer += mmu_painting_data_string;
-                    output_buffer += "\"";
+                    out += " ";
+                    out += MMU_SEGMENTATION_ATTR;
+                    out += "=\"";
+                    out += mmu_painting_data_string;
+                    out += "\"";
                 }
 
                 // BBS
                 if (i < its.properties.size()) {
                     std::string prop_str = its.properties[i].to_string();
                     if (!prop_str.empty()) {
-                        output_buffer += " ";
-                        output_buffer += FACE_PROPERTY_ATTR;
-                        output_buffer += "=\"";
-                        output_buffer += prop_str;
-                        output_buffer += "\"";
+                        out += " ";
+                        out += FACE_PROPERTY_ATTR;
+                        out += "=\"";
+                        out += prop_str;
+                        out += "\"";
                     }
                 }
 
-                output_buffer += "/>\n";
-
-                if (! flush(output_buffer, false))
-                    return false;
-            }
+                out += "/>\n";
+            }))
+                return false;
             output_buffer += "    </";
             output_buffer += TRIANGLES_TAG;
             output_buffer += ">\n   </";
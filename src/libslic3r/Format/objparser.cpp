@@ -4,12 +4,35 @@
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/cstdio.hpp>
 
+#include <fast_float/fast_float.h>
+
 #include "objparser.hpp"
 
 #include "libslic3r/LocalesUtils.hpp"
 
 namespace ObjParser {
 #define EATWS()  while (*line == ' ' || *line == '\t') ++line
+
+// Drop-in replacement of strtod() for the vertex data, parsing with fast_float is independent of the C locale
+// and several times faster. Leading white spaces have to be skipped by the caller.
+// As with strtod(), endptr points past the number or to str if no number could be parsed.
+static double obj_strtod(const char *str, char **endptr)
+{
+    const char *begin = str;
+    if (*begin == '+')
+        ++ begin;
+    const char *end = begin;
+    while (*end != ' ' && *end != '\t' && *end != 0)
+        ++ end;
+    double value = 0.;
+    auto [ptr, ec] = fast_float::from_chars(begin, end, value);
+    if (ec != std::errc()) {
+        *endptr = const_cast<char*>(str);
+        return 0.;
+    }
+    *endptr = const_cast<char*>(ptr);
+    return value;
+}
 static bool obj_parseline(const char *line, ObjData &data)
 {
 	if (*line == 0)
@@ -38,14 +61,14 @@ static bool obj_parseline(const char *line, ObjData &data)
 				return false;
 			EATWS();
 			char *endptr = 0;
-			double u = strtod(line, &endptr);
+			double u = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t'))
 				return false;
 			line = endptr;
 			EATWS();
 			double v = 0;
 			if (*line != 0) {
-				v = strtod(line, &endptr);
+				v = obj_strtod(line, &endptr);
 				if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 					return false;
 				line = endptr;
@@ -53,7 +76,7 @@ static bool obj_parseline(const char *line, ObjData &data)
 			}
 			/*double w = 0;
 			if (*line != 0) {
-				w = strtod(line, &endptr);
+				w = obj_strtod(line, &endptr);
 				if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 					return false;
 				line = endptr;
@@ -75,17 +98,17 @@ static bool obj_parseline(const char *line, ObjData &data)
 				return false;
 			EATWS();
 			char *endptr = 0;
-			double x = strtod(line, &endptr);
+			double x = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t'))
 				return false;
 			line = endptr;
 			EATWS();
-			double y = strtod(line, &endptr);
+			double y = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t'))
 				return false;
 			line = endptr;
 			EATWS();
-			double z = strtod(line, &endptr);
+			double z = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 				return false;
 			line = endptr;
@@ -105,19 +128,19 @@ static bool obj_parseline(const char *line, ObjData &data)
 				return false;
 			EATWS();
 			char *endptr = 0;
-			double u = strtod(line, &endptr);
+			double u = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 				return false;
 			line = endptr;
 			EATWS();
-			double v = strtod(line, &endptr);
+			double v = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 				return false;
 			line = endptr;
 			EATWS();
 			double w = 0;
 			if (*line != 0) {
-				w = strtod(line, &endptr);
+				w = obj_strtod(line, &endptr);
 				if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 					return false;
 				line = endptr;
@@ -137,17 +160,17 @@ static bool obj_parseline(const char *line, ObjData &data)
 				return false;
 			EATWS();
 			char *endptr = 0;
-			double x = strtod(line, &endptr);
+			double x = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t'))
 				return false;
 			line = endptr;
 			EATWS();
-			double y = strtod(line, &endptr);
+			double y = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t'))
 				return false;
 			line = endptr;
 			EATWS();
-			double z = strtod(line, &endptr);
+			double z = obj_strtod(line, &endptr);
 			if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
 				return false;
 			line = endptr;
@@ -157,24 +180,24 @@ static bool obj_parseline(const char *line, ObjData &data)
                 if (!data.has_vertex_color) {
                     data.has_vertex_color = true;
                 }
-                color_x = strtod(line, &endptr);
+                color_x = obj_strtod(line, &endptr);
                 if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
                     return false;
                 line = endptr;
                 EATWS();
-                color_y = strtod(line, &endptr);
+                color_y = obj_strtod(line, &endptr);
                 if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
                      return false;
                 line = endptr;
                 EATWS();
-                color_z = strtod(line, &endptr);
+                color_z = obj_strtod(line, &endptr);
                 if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0))
                     return false;
                 line = endptr;
                 EATWS();
                 color_w = 1.0;//default define alpha = 1.0
                 if (*line != 0) {
-                    color_w = strtod(line, &endptr);
+                    color_w = obj_strtod(line, &endptr);
                     if (endptr == 0 || (*endptr != ' ' && *endptr != '\t' && *endptr != 0)) return false;
                     line = endptr;
                     EATWS();
@@ -20,9 +20,12 @@
 #include "LocalesUtils.hpp"
 #include "libslic3r/format.hpp"
 #include "libslic3r/FileSystem/Log.hpp"
+#include "libslic3r/Base/Thread.hpp"
 #include "libslic3r/Base/Time.hpp"
 #include "GCode/ExtrusionProcessor.hpp"
+#include "GCode/ExportProfiler.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <chrono>
@@ -994,8 +997,9 @@ static std::vector<Vec2d> get_path_of_change_filament(const Print& print)
 
 #define EXTRUDER_CONFIG(OPT) m_config.OPT.get_at(m_writer.extruder()->id())
 
-void GCode::PlaceholderParserIntegration::reset()
+void GCodeGeneratorState::PlaceholderParserIntegration::reset()
 {
+    this->templates.clear();
     this->failed_templates.clear();
     this->output_config.clear();
     this->opt_position = nullptr;
@@ -1014,7 +1018,35 @@ void GCode::PlaceholderParserIntegration::reset()
     this->e_restart_extra.clear();
 }
 
-void GCode::PlaceholderParserIntegration::init(const GCodeWriter &writer)
+GCodeGeneratorState::PlaceholderParserIntegration& GCodeGeneratorState::PlaceholderParserIntegration::operator=(const PlaceholderParserIntegration &rhs)
+{
+    if (this == &rhs)
+        return *this;
+    this->parser                    = rhs.parser;
+    this->context.rng               = rhs.context.rng;
+    this->context.global_config.reset(rhs.context.global_config ? new DynamicConfig(*rhs.context.global_config) : nullptr);
+    this->templates                 = rhs.templates;
+    this->failed_templates          = rhs.failed_templates;
+    this->output_config             = rhs.output_config;
+    // The option pointers point into the configs owned by this.
+    this->opt_position              = this->output_config.option<ConfigOptionFloats>("position");
+    this->opt_e_position            = this->output_config.option<ConfigOptionFloats>("e_position");
+    this->opt_e_retracted           = this->output_config.option<ConfigOptionFloats>("e_retracted");
+    this->opt_e_restart_extra       = this->output_config.option<ConfigOptionFloats>("e_restart_extra");
+    this->opt_zhop                  = this->parser.config_writable().option<ConfigOptionFloat>("zhop");
+    this->opt_extruded_volume       = this->parser.config_writable().option<ConfigOptionFloats>("extruded_volume");
+    this->opt_extruded_weight       = this->parser.config_writable().option<ConfigOptionFloats>("extruded_weight");
+    this->opt_extruded_volume_total = this->parser.config_writable().option<ConfigOptionFloat>("extruded_volume_total");
+    this->opt_extruded_weight_total = this->parser.config_writable().option<ConfigOptionFloat>("extruded_weight_total");
+    this->num_extruders             = rhs.num_extruders;
+    this->position                  = rhs.position;
+    this->e_position                = rhs.e_position;
+    this->e_retracted               = rhs.e_retracted;
+    this->e_restart_extra           = rhs.e_restart_extra;
+    return *this;
+}
+
+void GCodeGeneratorState::PlaceholderParserIntegration::init(const GCodeWriter &writer)
 {
     this->reset();
     const std::vector<Extruder> &extruders = writer.extruders();
@@ -1050,7 +1082,7 @@ void GCode::PlaceholderParserIntegration::init(const GCodeWriter &writer)
     this->parser.set("zhop", this->opt_zhop);
 }
 
-void GCode::PlaceholderParserIntegration::update_from_gcodewriter(const GCodeWriter &writer)
+void GCodeGeneratorState::PlaceholderParserIntegration::update_from_gcodewriter(const GCodeWriter &writer)
 {
     memcpy(this->position.data(), writer.get_position().data(), sizeof(double) * 3);
     this->opt_position->values = this->position;
@@ -1089,7 +1121,7 @@ void GCode::PlaceholderParserIntegration::update_from_gcodewriter(const GCodeWri
 }
 
 // Throw if any of the output vector variables were resized by the script.
-void GCode::PlaceholderParserIntegration::validate_output_vector_variables()
+void GCodeGeneratorState::PlaceholderParserIntegration::validate_output_vector_variables()
 {
     if (this->opt_position->values.size() != 3)
         throw Slic3r::RuntimeError("\"position\" output variable must not be resized by the script.");
@@ -1451,7 +1483,8 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
 
     m_processor.initialize(path_tmp);
     m_processor.set_print(print);
-    GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"), m_processor);
+    // Parse the exported G-code on a separate thread, if there is a spare core for it.
+    GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"), m_processor, std::thread::hardware_concurrency() > 1);
     if (! file.is_open()) {
         BOOST_LOG_TRIVIAL(error) << std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n" << std::endl;
         if (!fs::exists(folder)) {
@@ -1793,6 +1826,8 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
 {
     // modifies m_silent_time_estimator_enabled
     DoExport::init_gcode_processor(print.config(), m_processor, m_silent_time_estimator_enabled);
+    m_processor.enable_single_pass_finalization(print.single_pass_gcode_finalization());
+    m_layer_time_slot = m_processor.time_slot(GCodeProcessor::ETags::Layer_M73_Slot);
     m_calib_config.clear();
     // resets analyzer's tracking data
     m_last_height  = 0.f;
@@ -1883,7 +1918,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
         // Write information on the generator.
         file.write_format("; generated by %s on %s\n", Slic3r::header_slic3r_generated().c_str(), Slic3r::Utils::local_timestamp().c_str());
         //BBS: total layer number
-        file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Total_Layer_Number_Placeholder).c_str());
+        file.write(m_processor.time_slot(GCodeProcessor::ETags::Total_Layer_Number_Placeholder));
         m_enable_exclude_object = config().exclude_object;
         //Orca: extra check for bbl printer
     {
@@ -1973,7 +2008,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
     }
 
     // adds tags for time estimators
-    file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::First_Line_M73_Placeholder).c_str());
+    file.write(m_processor.time_slot(GCodeProcessor::ETags::First_Line_M73_Placeholder));
 
     // Prepare the helper object for replacing placeholders in custom G-code and output filename.
     m_placeholder_parser_integration.parser = print.placeholder_parser();
@@ -2327,7 +2362,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
 
     //flush FanMover buffer to avoid modifying the start gcode if it's manual.
     if (!machine_start_gcode.empty() && this->m_fan_mover.get() != nullptr)
-        file.write(this->m_fan_mover.get()->process_gcode("", true));
+        file.write(this->m_fan_mover.get()->process_gcode("", true).release());
 
     // Process filament-specific gcode.
    /* if (has_wipe_tower) {
@@ -2657,9 +2692,447 @@ void GCode::check_placeholder_parser_failed()
     }
 }
 
+// Options read by the filters behind the G-code generator only (CoolingBuffer, FanMover), not by GCode::process_layer().
+// Changing them does not change the generated layers, unless a custom G-code template refers to them.
+static const std::set<std::string> s_options_after_generator {
+    "slow_down_layer_time", "slow_down_min_speed", "slow_down_for_layer_cooling", "dont_slow_down_outer_wall",
+    "reduce_fan_stop_start_freq", "overhang_fan_speed", "internal_bridge_fan_speed", "full_fan_speed_layer",
+    "fan_min_speed", "fan_max_speed", "fan_cooling_layer_time", "additional_cooling_fan_speed",
+    "fan_speedup_time", "fan_speedup_overhangs", "fan_kickstart"
+};
+
+// Output of the G-code generator for the layers of a non-sequential print without a wipe tower, together with snapshots of the
+// generator state taken every few layers. The next export of the same Print takes the layers from here up to the last snapshot
+// not following the first changed layer, restores the generator state from that snapshot and generates the rest of the layers.
+// If only the cooling or fan options were modified, all the layers are reused. The filters behind the generator (vase mode,
+// pressure equalizer, cooling buffer, fan mover) and the GCodeProcessor are always run again over all the layers, the results
+// of the GCodeProcessor are not kept per layer.
+// The G-code and the state snapshots kept by the caches of all Print instances are limited to total_physical_memory() / 8.
+// Every other snapshot is released when the limit is reached.
+struct GCodeGeneratorCache
+{
+    struct LayerKey {
+        coordf_t                            print_z;
+        size_t                              num_layers;
+        std::vector<unsigned int>           extruders;
+        unsigned int                        extruder_override;
+        bool                                has_skirt;
+        std::optional<CustomGCode::Item>    custom_gcode;
+        // The last layer is finalized differently.
+        bool                                last_layer;
+
+        bool operator==(const LayerKey &rhs) const {
+            return print_z == rhs.print_z && num_layers == rhs.num_layers && extruders == rhs.extruders &&
+                   extruder_override == rhs.extruder_override && has_skirt == rhs.has_skirt && custom_gcode == rhs.custom_gcode &&
+                   last_layer == rhs.last_layer;
+        }
+        bool operator!=(const LayerKey &rhs) const { return ! (*this == rhs); }
+    };
+
+    // Generator state before a layer is generated.
+    struct Checkpoint {
+        GCodeGeneratorState                 state;
+        // Extruder state shared by the extruders of a single extruder multi-material printer.
+        std::pair<double, double>           shared_extruder_state;
+        // Estimate of the memory of the snapshot, accounted in s_memory_used.
+        size_t                              memory;
+    };
+
+    // Maximum number of the generator state snapshots kept per cache.
+    static constexpr size_t MAX_CHECKPOINTS = 32;
+
+    GCodeGeneratorCache(const Print &print, const ToolOrdering &tool_ordering, const std::vector<std::pair<coordf_t, std::vector<GCode::LayerToPrint>>> &layers_to_print,
+                        const std::string &layer_time_slot) :
+        config(print.full_print_config()), layer_time_slot(layer_time_slot)
+    {
+        for (const PrintObject *object : print.objects()) {
+            this->object_configs.emplace_back(object->config());
+            for (size_t i = 0; i < object->num_printing_regions(); ++ i)
+                this->region_configs.emplace_back(object->printing_region(i).config());
+            this->objects += std::to_string(object->id().id) + " " + object->model_object()->name + "\n";
+            for (int step = 0; step < int(posCount); ++ step)
+                this->objects += std::to_string(object->step_state_with_timestamp(PrintObjectStep(step)).timestamp) + " ";
+            for (const PrintInstance &instance : object->instances())
+                this->objects += std::to_string(instance.model_instance->id().id) + " " + std::to_string(instance.shift.x()) + " " + std::to_string(instance.shift.y()) + " ";
+            this->objects += "\n";
+        }
+        const Vec3d plate_origin = print.get_plate_origin();
+        this->objects += std::to_string(print.step_state_with_timestamp(psWipeTower).timestamp) + " " + std::to_string(print.step_state_with_timestamp(psSkirtBrim).timestamp) + " " +
+            std::to_string(plate_origin.x()) + " " + std::to_string(plate_origin.y()) + " " + std::to_string(plate_origin.z());
+
+        this->layers.reserve(layers_to_print.size());
+        for (const std::pair<coordf_t, std::vector<GCode::LayerToPrint>> &layer : layers_to_print) {
+            const LayerTools &layer_tools = tool_ordering.tools_for_layer(layer.first);
+            this->layers.push_back({ layer.first, layer.second.size(), layer_tools.extruders, layer_tools.extruder_override, layer_tools.has_skirt,
+                layer_tools.custom_gcode ? std::make_optional(*layer_tools.custom_gcode) : std::nullopt, &layer == &layers_to_print.back() });
+        }
+        this->checkpoint_interval = std::max<size_t>(1, (this->layers.size() + MAX_CHECKPOINTS - 1) / MAX_CHECKPOINTS);
+    }
+
+    ~GCodeGeneratorCache() { s_memory_used -= this->memory; }
+
+    // Does any custom G-code refer to the option?
+    bool templates_refer_to(const std::string &opt_key) const
+    {
+        for (const t_config_option_key &key : this->config.keys())
+            if (boost::ends_with(key, "_gcode")) {
+                const ConfigOption *opt = this->config.option(key);
+                if (opt->type() == coString && static_cast<const ConfigOptionString*>(opt)->value.find(opt_key) != std::string::npos)
+                    return true;
+                if (opt->type() == coStrings)
+                    for (const std::string &templ : static_cast<const ConfigOptionStrings*>(opt)->values)
+                        if (templ.find(opt_key) != std::string::npos)
+                            return true;
+            }
+        for (const LayerKey &layer : this->layers)
+            if (layer.custom_gcode && layer.custom_gcode->extra.find(opt_key) != std::string::npos)
+                return true;
+        return false;
+    }
+
+    // Are the inputs of the generator other than the layers the same? Otherwise the reason is logged.
+    bool same_inputs(const GCodeGeneratorCache &rhs) const
+    {
+        if (this->config.keys() != rhs.config.keys()) {
+            BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: the set of options changed";
+            return false;
+        }
+        for (const t_config_option_key &key : this->config.diff(rhs.config))
+            if (s_options_after_generator.find(key) == s_options_after_generator.end() || rhs.templates_refer_to(key)) {
+                BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: option " << key << " changed";
+                return false;
+            }
+        if (this->object_configs != rhs.object_configs || this->region_configs != rhs.region_configs || this->objects != rhs.objects) {
+            BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: objects changed";
+            return false;
+        }
+        if (this->layer_time_slot != rhs.layer_time_slot) {
+            BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: single pass finalization changed";
+            return false;
+        }
+        return true;
+    }
+
+    // Take the generated layers of the previous export up to its last checkpoint not following the first changed layer
+    // and restore the generator state of that checkpoint. Returns the number of the layers taken.
+    size_t take_over(GCodeGeneratorCache &previous, const Print &print, GCode &gcodegen)
+    {
+        auto   it_changed    = std::mismatch(previous.layers.begin(), previous.layers.end(), this->layers.begin(), this->layers.end());
+        size_t first_changed = it_changed.second - this->layers.begin();
+        if (first_changed < this->layers.size())
+            BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: layer " << first_changed << " of " << this->layers.size() << " changed";
+        auto it_checkpoint = previous.checkpoints.upper_bound(first_changed);
+        if (it_checkpoint == previous.checkpoints.begin())
+            return 0;
+        -- it_checkpoint;
+        const size_t num_layers = it_checkpoint->first;
+        assert(num_layers <= previous.results.size());
+        size_t bytes = 0;
+        for (size_t i = 0; i < num_layers; ++ i) {
+            bytes += previous.results[i].gcode.size();
+            this->results.emplace_back(std::move(previous.results[i]));
+        }
+        for (auto it = previous.checkpoints.begin(); it != std::next(it_checkpoint); ++ it)
+            bytes += it->second.memory;
+        // The memory is handed over, the global budget does not change.
+        previous.memory -= bytes;
+        this->memory    += bytes;
+        this->checkpoints.insert(std::make_move_iterator(previous.checkpoints.begin()), std::make_move_iterator(std::next(it_checkpoint)));
+        previous.checkpoints.erase(previous.checkpoints.begin(), std::next(it_checkpoint));
+        this->restore(num_layers, print, gcodegen);
+        return num_layers;
+    }
+
+    // Snapshot the generator state before the layer with the index layer_idx, or after the last layer.
+    // The snapshot is skipped if it does not fit the memory limit even after releasing every other snapshot.
+    void save_checkpoint(size_t layer_idx, const GCode &gcodegen)
+    {
+        if ((layer_idx % this->checkpoint_interval == 0 || layer_idx == this->layers.size()) && this->checkpoints.find(layer_idx) == this->checkpoints.end()) {
+            const GCodeGeneratorState &state = gcodegen;
+            // The snapshots of a single export differ in size little, the first one is measured only.
+            if (this->checkpoint_memory == 0)
+                this->checkpoint_memory = state_memory(state);
+            if (this->reserve(this->checkpoint_memory))
+                this->checkpoints.emplace(layer_idx, Checkpoint{ state, Extruder::shared_state(), this->checkpoint_memory });
+        }
+    }
+
+    void restore(size_t layer_idx, const Print &print, GCode &gcodegen) const
+    {
+        const Checkpoint &checkpoint = this->checkpoints.at(layer_idx);
+        static_cast<GCodeGeneratorState&>(gcodegen) = checkpoint.state;
+        Extruder::set_shared_state(checkpoint.shared_extruder_state);
+        gcodegen.m_placeholder_parser_integration.parser.update_timestamp();
+        // The cooling and fan options may differ from the export, which generated the layers.
+        const std::vector<std::string> keys(s_options_after_generator.begin(), s_options_after_generator.end());
+        gcodegen.m_config.apply_only(print.config(), keys, true);
+        gcodegen.m_writer.config.apply_only(print.config(), keys, true);
+    }
+
+    // Keep a generated layer. Returns false if the G-code would exceed the memory limit even after releasing every other snapshot.
+    bool add_result(const LayerResult &result)
+    {
+        if (! this->reserve(result.gcode.size()))
+            return false;
+        this->results.emplace_back(result);
+        return true;
+    }
+
+    // Account bytes in the memory of this cache, release every other snapshot of this cache while the memory limit is exceeded.
+    bool reserve(size_t bytes)
+    {
+        static const size_t memory_limit = total_physical_memory() / 8;
+        for (;;) {
+            size_t used = s_memory_used.load();
+            while (used + bytes <= memory_limit)
+                if (s_memory_used.compare_exchange_weak(used, used + bytes)) {
+                    this->memory += bytes;
+                    return true;
+                }
+            if (! this->thin_checkpoints())
+                return false;
+        }
+    }
+
+    // Release every other snapshot except the one after the last layer, and take the following snapshots at twice the interval.
+    // Returns false if there was no snapshot to release.
+    bool thin_checkpoints()
+    {
+        size_t released = 0;
+        bool   odd      = false;
+        for (auto it = this->checkpoints.begin(); it != this->checkpoints.end(); odd = ! odd)
+            if (odd && it->first != this->layers.size()) {
+                released += it->second.memory;
+                it = this->checkpoints.erase(it);
+            } else
+                ++ it;
+        if (released == 0)
+            return false;
+        BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: released " << released << " bytes of generator state snapshots";
+        this->memory        -= released;
+        s_memory_used       -= released;
+        this->checkpoint_interval *= 2;
+        return true;
+    }
+
+    // Estimate of the memory of a snapshot of the generator state. The configs copied with the state dominate,
+    // the other members are counted by their own size and the size of their larger containers.
+    static size_t state_memory(const GCodeGeneratorState &state)
+    {
+        auto config_memory = [](const ConfigBase &config) {
+            size_t bytes = 0;
+            for (const t_config_option_key &key : config.keys())
+                bytes += sizeof(t_config_option_key) + key.size() + config.option(key)->serialize().size();
+            return bytes;
+        };
+        const GCodeGeneratorState::PlaceholderParserIntegration &ppi = state.m_placeholder_parser_integration;
+        size_t bytes = sizeof(Checkpoint) + config_memory(state.m_config) + config_memory(state.m_calib_config) + config_memory(state.m_writer.config) +
+            config_memory(ppi.parser.config()) + config_memory(ppi.output_config) + (ppi.context.global_config ? config_memory(*ppi.context.global_config) : 0) +
+            state.m_skirt_done.size() * sizeof(coordf_t) + state.m_label_objects_ids.size() * sizeof(size_t) +
+            (state.m_objsWithBrim.size() + state.m_objSupportsWithBrim.size()) * (sizeof(ObjectID) + 4 * sizeof(void*));
+        for (const auto &[key, templ] : ppi.templates)
+            bytes += sizeof(templ) + key.first.size();
+        return bytes;
+    }
+
+    // Inputs of the generator.
+    DynamicPrintConfig                      config;
+    std::vector<PrintObjectConfig>          object_configs;
+    std::vector<PrintRegionConfig>          region_configs;
+    // IDs, names, step time stamps and instance shifts of the PrintObjects.
+    std::string                             objects;
+    std::vector<LayerKey>                   layers;
+    // See GCode::m_layer_time_slot.
+    std::string                             layer_time_slot;
+
+    // Output of the generator.
+    std::vector<LayerResult>                results;
+    // Bytes of G-code in results and of the checkpoints, accounted in s_memory_used.
+    size_t                                  memory { 0 };
+    // Generator state before the layer of the key. The state after the last layer is keyed by layers.size().
+    std::map<size_t, Checkpoint>            checkpoints;
+    size_t                                  checkpoint_interval { 1 };
+    // Estimate of the memory of a checkpoint taken by this cache, see state_memory().
+    size_t                                  checkpoint_memory { 0 };
+
+    // Bytes of G-code and of the checkpoints kept by all caches.
+    static std::atomic<size_t>              s_memory_used;
+};
+
+std::atomic<size_t> GCodeGeneratorCache::s_memory_used { 0 };
+
+using ExportStage = GCodeExportProfiler::Stage;
+
+// Maximum number of layers in flight in the G-code export pipeline.
+static constexpr size_t EXPORT_PIPELINE_MAX_TOKENS = 12;
+
+// Wraps the body of a filter of the G-code export pipeline: If a GCodeExportProfiler is attached, the stage is timed
+// and its input and output are captured if the stage is to be replayed.
+template<typename In, typename Out, typename Body>
+static auto profiled_export_stage(GCodeExportProfiler *profiler, ExportStage stage, Body body)
+{
+    return [profiler, stage, body](In in) -> Out {
+        if (profiler == nullptr)
+            return body(std::move(in));
+        size_t token = size_t(-1);
+        if constexpr (std::is_same_v<In, LayerResult>)
+            token = in.nop_layer_result ? size_t(-1) : in.layer_id;
+        else if constexpr (! std::is_same_v<In, std::string> && ! std::is_same_v<In, GCodeLines>)
+            token = in.idx;
+        if constexpr (std::is_same_v<In, LayerResult> || std::is_same_v<In, std::string>) {
+            if (profiler->captures(stage))
+                profiler->capture_input(in);
+        } else if constexpr (std::is_same_v<In, GCodeLines>) {
+            if (profiler->captures(stage))
+                profiler->capture_input(GCodeLines(in).release());
+        }
+        GCodeExportProfiler::Clock::time_point begin = GCodeExportProfiler::Clock::now();
+        Out out = body(std::move(in));
+        GCodeExportProfiler::Clock::time_point end = GCodeExportProfiler::Clock::now();
+        size_t bytes = 0;
+        if constexpr (std::is_same_v<Out, LayerResult>)
+            bytes = out.gcode.size();
+        else if constexpr (std::is_same_v<Out, std::string>)
+            bytes = out.size();
+        else if constexpr (std::is_same_v<Out, GCodeLines>)
+            bytes = out.text_size();
+        profiler->record(stage, token, begin, end, bytes);
+        if constexpr (std::is_same_v<Out, LayerResult> || std::is_same_v<Out, std::string>) {
+            if (profiler->captures(stage))
+                profiler->capture_output(out);
+        } else if constexpr (std::is_same_v<Out, GCodeLines>) {
+            if (profiler->captures(stage))
+                profiler->capture_output(GCodeLines(out).release());
+        }
+        return out;
+    };
+}
+
+// Bodies of the post-processing filters of the G-code export pipeline, shared by the pipeline and the stage replay.
+static LayerResult process_spiral_vase(SpiralVase &spiral_vase, LayerResult &&in, size_t num_layers)
+{
+    if (in.nop_layer_result)
+        return in;
+    spiral_vase.enable(in.spiral_vase_enable);
+    bool last_layer = in.layer_id == num_layers - 1;
+    return { spiral_vase.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush };
+}
+
+static std::string process_cooling(CoolingBuffer &cooling_buffer, LayerResult &&in)
+{
+    if (in.nop_layer_result)
+        return in.gcode;
+    return cooling_buffer.process_layer(std::move(in.gcode), in.layer_id, in.cooling_buffer_flush);
+}
+
+// The layer leaves the FanMover split into lines, which the following stages edit in place, see GCodeLines.
+static GCodeLines process_fan_mover(std::unique_ptr<FanMover> &fan_mover, const FullPrintConfig &config, const GCodeWriter &writer, std::string &&in)
+{
+    if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
+        CNumericLocalesSetter locales_setter;
+        if (fan_mover.get() == nullptr)
+            fan_mover.reset(new Slic3r::FanMover(
+                writer,
+                std::abs((float)config.fan_speedup_time.value),
+                config.fan_speedup_time.value > 0,
+                config.use_relative_e_distances.value,
+                config.fan_speedup_overhangs.value,
+                (float)config.fan_kickstart.value));
+        //flush as it's a whole layer
+        return fan_mover->process_gcode(in, true);
+    }
+    return GCodeLines(std::move(in));
+}
+
+// Copies of the stateful post-processors taken before a pass of the export pipeline,
+// so that the stage input captured by the GCodeExportProfiler is replayed from the same state.
+struct GCode::ExportStageSnapshot
+{
+    std::unique_ptr<CoolingBuffer>      cooling_buffer;
+    std::unique_ptr<PressureEqualizer>  pressure_equalizer;
+};
+
+std::unique_ptr<GCode::ExportStageSnapshot> GCode::snapshot_export_stage(const GCodeExportProfiler *profiler) const
+{
+    auto snapshot = std::make_unique<ExportStageSnapshot>();
+    if (profiler != nullptr) {
+        if (profiler->replay_stage() == ExportStage::Cooling)
+            snapshot->cooling_buffer = std::make_unique<CoolingBuffer>(*m_cooling_buffer);
+        else if (profiler->replay_stage() == ExportStage::PressureEqualizer && m_pressure_equalizer)
+            snapshot->pressure_equalizer = std::make_unique<PressureEqualizer>(*m_pressure_equalizer);
+    }
+    return snapshot;
+}
+
+// Runs the input of the stage captured during the last pipeline pass through fresh copies of the stage,
+// and checks that each run reproduces the output of the pass.
+// The SpiralVase, the FanMover and the AdaptivePAProcessor are constructed anew, thus their state carried over
+// from a previous pass of a sequential print is not reproduced, nor the pressure advance resets by the tool changes.
+void GCode::replay_export_stage(const Print &print, GCodeExportProfiler &profiler, const ExportStageSnapshot &snapshot, size_t num_layers)
+{
+    const std::vector<LayerResult> &input = profiler.captured_input();
+    if (input.empty())
+        // The stage is not part of this pipeline.
+        return;
+
+    auto replay = [&profiler, &input](auto make_stage, auto process) {
+        std::vector<double> seconds;
+        bool                identical = true;
+        for (int run = 0; run < profiler.replay_runs(); ++ run) {
+            auto   stage = make_stage();
+            size_t hash  = 0;
+            double time  = 0.;
+            for (const LayerResult &in : input) {
+                LayerResult                             layer = in;
+                GCodeExportProfiler::Clock::time_point  begin = GCodeExportProfiler::Clock::now();
+                auto                                    out   = process(*stage, std::move(layer));
+                time += std::chrono::duration<double>(GCodeExportProfiler::Clock::now() - begin).count();
+                if constexpr (std::is_same_v<decltype(out), LayerResult>)
+                    GCodeExportProfiler::output_hash(hash, out.gcode);
+                else if constexpr (std::is_same_v<decltype(out), GCodeLines>)
+                    GCodeExportProfiler::output_hash(hash, out.release());
+                else
+                    GCodeExportProfiler::output_hash(hash, out);
+            }
+            seconds.emplace_back(time);
+            identical &= profiler.same_output(hash);
+        }
+        profiler.add_replay(std::move(seconds), identical);
+    };
+
+    switch (profiler.replay_stage()) {
+    case ExportStage::SpiralVase:
+        replay([this, &print]() {
+                auto spiral_vase = std::make_unique<SpiralVase>(print.config());
+                spiral_vase->set_max_xy_smoothing(m_spiral_vase->max_xy_smoothing());
+                return spiral_vase;
+            },
+            [num_layers](SpiralVase &spiral_vase, LayerResult &&in) { return process_spiral_vase(spiral_vase, std::move(in), num_layers); });
+        break;
+    case ExportStage::PressureEqualizer:
+        replay([&snapshot]() { return std::make_unique<PressureEqualizer>(*snapshot.pressure_equalizer); },
+            [](PressureEqualizer &pressure_equalizer, LayerResult &&in) { return pressure_equalizer.process_layer(std::move(in)); });
+        break;
+    case ExportStage::Cooling:
+        replay([&snapshot]() { return std::make_unique<CoolingBuffer>(*snapshot.cooling_buffer); },
+            [](CoolingBuffer &cooling_buffer, LayerResult &&in) { return process_cooling(cooling_buffer, std::move(in)); });
+        break;
+    case ExportStage::FanMover:
+        replay([]() { return std::make_unique<std::unique_ptr<FanMover>>(); },
+            [this](std::unique_ptr<FanMover> &fan_mover, LayerResult &&in) { return process_fan_mover(fan_mover, this->config(), m_writer, std::move(in.gcode)); });
+        break;
+    case ExportStage::PAProcessor:
+        replay([this]() { return std::make_unique<AdaptivePAProcessor>(*this, m_writer.extruder_ids()); },
+            [](AdaptivePAProcessor &pa_processor, LayerResult &&in) { return pa_processor.process_layer(GCodeLines(std::move(in.gcode))); });
+        break;
+    default:
+        break;
+    }
+}
+
 // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
-// Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
-// and export G-code into file.
+// Prepare the layers in parallel (see prepare_layer()), generate G-code serially, run the filters
+// (vase mode, cooling buffer), run the G-code analyser and export G-code into file.
 void GCode::process_layers(
     const Print                                                         &print,
     const ToolOrdering                                                  &tool_ordering,
@@ -2667,100 +3140,152 @@ void GCode::process_layers(
     const std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>>   &layers_to_print,
     GCodeOutputStream                                                   &output_stream)
 {
+    // Layers pass the pipeline by their index. The part of process_layer() not depending on the G-code generator state
+    // is prepared by a parallel filter ahead of the serial generator.
+    struct LayerToProcess {
+        size_t          idx { 0 };
+        PreparedLayer   prepared;
+    };
+    // Take the layers generated by the previous export up to the first changed one and record the generated layers for the next export.
+    std::unique_ptr<GCodeGeneratorCache> new_cache;
+    size_t                               num_reused_layers = 0;
+    if (! m_wipe_tower && print.calib_params().mode == CalibMode::Calib_None) {
+        new_cache = std::make_unique<GCodeGeneratorCache>(print, tool_ordering, layers_to_print, m_layer_time_slot);
+        new_cache->results.reserve(layers_to_print.size());
+        if (print.m_gcode_generator_cache && print.m_gcode_generator_cache->same_inputs(*new_cache)) {
+            num_reused_layers = new_cache->take_over(*print.m_gcode_generator_cache, print, *this);
+            BOOST_LOG_TRIVIAL(info) << "Reusing " << num_reused_layers << " of " << layers_to_print.size() << " generated G-code layers, " << new_cache->memory << " bytes";
+        }
+        // Release the rest of the previous export before generating the new layers.
+        print.m_gcode_generator_cache.reset();
+    }
+    GCodeExportProfiler *profiler = print.gcode_export_profiler();
+
     // The pipeline is variable: The vase mode filter is optional.
     size_t layer_to_print_idx = 0;
-    const auto generator = tbb::make_filter<void, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print, &layer_to_print_idx](tbb::flow_control& fc) -> LayerResult {
-            if (layer_to_print_idx >= layers_to_print.size()) {
-                if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
-                    fc.stop();
-                    return {};
-                } else {
-                    // Pressure equalizer need insert empty input. Because it returns one layer back.
-                    // Insert NOP (no operation) layer;
-                    ++layer_to_print_idx;
-                    return LayerResult::make_nop_layer_result();
-                }
-            } else {
-                const std::pair<coordf_t, std::vector<LayerToPrint>>& layer = layers_to_print[layer_to_print_idx++];
-                const LayerTools& layer_tools = tool_ordering.tools_for_layer(layer.first);
-                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(layer_to_print_idx)));
-                if (m_wipe_tower && layer_tools.has_wipe_tower)
-                    m_wipe_tower->next_layer();
-                //BBS
-                check_placeholder_parser_failed();
-                print.throw_if_canceled();
-                return this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(), &print_object_instances_ordering, size_t(-1));
+    const auto input = tbb::make_filter<void, LayerToProcess>(slic3r_tbb_filtermode::serial_in_order,
+        [this, &layers_to_print, &layer_to_print_idx, profiler](tbb::flow_control& fc) -> LayerToProcess {
+            // Pressure equalizer need insert empty input. Because it returns one layer back.
+            if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
+                fc.stop();
+                return {};
             }
+            if (profiler)
+                profiler->token_entered();
+            return { layer_to_print_idx ++ };
         });
+    const auto prepare = tbb::make_filter<LayerToProcess, LayerToProcess>(slic3r_tbb_filtermode::parallel,
+        profiled_export_stage<LayerToProcess, LayerToProcess>(profiler, ExportStage::Prepare,
+        [&print, &tool_ordering, &layers_to_print, num_reused_layers](LayerToProcess in) -> LayerToProcess {
+            if (in.idx >= num_reused_layers && in.idx < layers_to_print.size()) {
+                const std::pair<coordf_t, std::vector<LayerToPrint>>& layer = layers_to_print[in.idx];
+                in.prepared = prepare_layer(print, layer.second, tool_ordering.tools_for_layer(layer.first));
+            }
+            return in;
+        }));
+    const auto generator = tbb::make_filter<LayerToProcess, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerToProcess, LayerResult>(profiler, ExportStage::Generator,
+        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print, num_reused_layers, &new_cache](LayerToProcess in) -> LayerResult {
+            if (in.idx >= layers_to_print.size())
+                // Insert NOP (no operation) layer;
+                return LayerResult::make_nop_layer_result();
+            if (in.idx < num_reused_layers) {
+                // The reused layers precede the generated ones, thus new_cache has not been dropped yet.
+                print.throw_if_canceled();
+                return new_cache->results[in.idx];
+            }
+            const std::pair<coordf_t, std::vector<LayerToPrint>>& layer = layers_to_print[in.idx];
+            const LayerTools& layer_tools = tool_ordering.tools_for_layer(layer.first);
+            print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.idx + 1)));
+            if (m_wipe_tower && layer_tools.has_wipe_tower)
+                m_wipe_tower->next_layer();
+            //BBS
+            check_placeholder_parser_failed();
+            print.throw_if_canceled();
+            if (new_cache)
+                new_cache->save_checkpoint(in.idx, *this);
+            LayerResult result = this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(), &print_object_instances_ordering, size_t(-1), false, &in.prepared);
+            if (new_cache && ! new_cache->add_result(result)) {
+                // The G-code of all the caches would be too big to be kept in memory.
+                BOOST_LOG_TRIVIAL(debug) << "G-code generator cache: memory limit reached at layer " << in.idx;
+                new_cache.reset();
+            }
+            return result;
+        }));
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
         float max_xy_smoothing = m_config.get_abs_value("spiral_mode_max_xy_smoothing", nozzle_diameter);
         this->m_spiral_vase->set_max_xy_smoothing(max_xy_smoothing);
     }
     const auto spiral_mode = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, LayerResult>(profiler, ExportStage::SpiralVase,
         [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in) -> LayerResult {
-        	if (in.nop_layer_result)
-                return in;
-                
-            spiral_mode.enable(in.spiral_vase_enable);
-            bool last_layer = in.layer_id == layers_to_print.size() - 1;
-            return { spiral_mode.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush};
-        });
+            return process_spiral_vase(spiral_mode, std::move(in), layers_to_print.size());
+        }));
     const auto pressure_equalizer = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, LayerResult>(profiler, ExportStage::PressureEqualizer,
         [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
             return pressure_equalizer->process_layer(std::move(in));
-        });
+        }));
     const auto cooling = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, std::string>(profiler, ExportStage::Cooling,
         [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in) -> std::string {
-        	if (in.nop_layer_result)
-                return in.gcode;
-            return cooling_buffer.process_layer(std::move(in.gcode), in.layer_id, in.cooling_buffer_flush);
-        });
-    const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-            [&pa_processor = *this->m_pa_processor](std::string in) -> std::string {
+            return process_cooling(cooling_buffer, std::move(in));
+        }));
+    const auto pa_processor_filter = tbb::make_filter<GCodeLines, GCodeLines>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<GCodeLines, GCodeLines>(profiler, ExportStage::PAProcessor,
+            [&pa_processor = *this->m_pa_processor](GCodeLines in) -> GCodeLines {
                 return pa_processor.process_layer(std::move(in));
             }
-        );
-    
-    const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-        [&output_stream](std::string s) { output_stream.write(s); }
+        ));
+
+    // The text of the layer is joined once, after the last stage editing its lines.
+    const auto output = tbb::make_filter<GCodeLines, void>(slic3r_tbb_filtermode::serial_in_order,
+        [&output_stream, profiler](GCodeLines lines) {
+            std::string s = lines.release();
+            if (profiler == nullptr) {
+                output_stream.write(s);
+                return;
+            }
+            GCodeExportProfiler::Clock::time_point begin = GCodeExportProfiler::Clock::now();
+            output_stream.write(s);
+            profiler->record(ExportStage::Output, size_t(-1), begin, GCodeExportProfiler::Clock::now(), s.size());
+            profiler->token_left();
+        }
     );
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-            [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->std::string {
-
-        CNumericLocalesSetter locales_setter;
-
-        if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
-            if (fan_mover.get() == nullptr)
-                fan_mover.reset(new Slic3r::FanMover(
-                    writer,
-                    std::abs((float)config.fan_speedup_time.value),
-                    config.fan_speedup_time.value > 0,
-                    config.use_relative_e_distances.value,
-                    config.fan_speedup_overhangs.value,
-                    (float)config.fan_kickstart.value));
-            //flush as it's a whole layer
-            return fan_mover->process_gcode(in, true);
-        }
-        return in;
-    });
+    const auto fan_mover = tbb::make_filter<std::string, GCodeLines>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<std::string, GCodeLines>(profiler, ExportStage::FanMover,
+            [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->GCodeLines {
+        return process_fan_mover(fan_mover, config, writer, std::move(in));
+    }));
 
+    std::unique_ptr<ExportStageSnapshot> snapshot = this->snapshot_export_stage(profiler);
+    if (profiler)
+        profiler->begin_pass(EXPORT_PIPELINE_MAX_TOKENS);
     // The pipeline elements are joined using const references, thus no copying is performed.
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-    	tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+    	tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & spiral_mode & cooling & fan_mover & output);
     else if	(m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else
-    	tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+    	tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & cooling & fan_mover & pa_processor_filter & output);
+    if (profiler) {
+        profiler->end_pass();
+        this->replay_export_stage(print, *profiler, *snapshot, layers_to_print.size());
+    }
+
+    if (new_cache && m_placeholder_parser_integration.failed_templates.empty()) {
+        new_cache->save_checkpoint(layers_to_print.size(), *this);
+        print.m_gcode_generator_cache = std::move(new_cache);
+    }
 }
 
 // Process all layers of a single object instance (sequential mode) with a parallel pipeline:
-// Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
-// and export G-code into file.
+// Prepare the layers in parallel (see prepare_layer()), generate G-code serially, run the filters
+// (vase mode, cooling buffer), run the G-code analyser and export G-code into file.
 void GCode::process_layers(
     const Print                             &print,
     const ToolOrdering                      &tool_ordering,
@@ -2770,89 +3295,113 @@ void GCode::process_layers(
     // BBS
     const bool                               prime_extruder)
 {
+    // Layers pass the pipeline by their index. The part of process_layer() not depending on the G-code generator state
+    // is prepared by a parallel filter ahead of the serial generator.
+    struct LayerToProcess {
+        size_t                      idx { 0 };
+        std::vector<LayerToPrint>   layers;
+        PreparedLayer               prepared;
+    };
+    GCodeExportProfiler *profiler = print.gcode_export_profiler();
     // The pipeline is variable: The vase mode filter is optional.
     size_t layer_to_print_idx = 0;
-    const auto generator = tbb::make_filter<void, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [this, &print, &tool_ordering, &layers_to_print, &layer_to_print_idx, single_object_idx, prime_extruder](tbb::flow_control& fc) -> LayerResult {
-            if (layer_to_print_idx >= layers_to_print.size()) {
-                if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
-                    fc.stop();
-                    return {};
-                } else {
-                    // Pressure equalizer need insert empty input. Because it returns one layer back.
-                    // Insert NOP (no operation) layer;
-                    ++layer_to_print_idx;
-                    return LayerResult::make_nop_layer_result();
-                }
-            } else {
-                LayerToPrint &layer = layers_to_print[layer_to_print_idx ++];
-                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(layer_to_print_idx)));
-                //BBS
-                check_placeholder_parser_failed();
-                print.throw_if_canceled();
-                return this->process_layer(print, { std::move(layer) }, tool_ordering.tools_for_layer(layer.print_z()), &layer == &layers_to_print.back(), nullptr, single_object_idx, prime_extruder);
+    const auto input = tbb::make_filter<void, LayerToProcess>(slic3r_tbb_filtermode::serial_in_order,
+        [this, &layers_to_print, &layer_to_print_idx, profiler](tbb::flow_control& fc) -> LayerToProcess {
+            // Pressure equalizer need insert empty input. Because it returns one layer back.
+            if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
+                fc.stop();
+                return {};
             }
+            if (profiler)
+                profiler->token_entered();
+            return { layer_to_print_idx ++ };
         });
+    const auto prepare = tbb::make_filter<LayerToProcess, LayerToProcess>(slic3r_tbb_filtermode::parallel,
+        profiled_export_stage<LayerToProcess, LayerToProcess>(profiler, ExportStage::Prepare,
+        [&print, &tool_ordering, &layers_to_print](LayerToProcess in) -> LayerToProcess {
+            if (in.idx < layers_to_print.size()) {
+                in.layers   = { layers_to_print[in.idx] };
+                in.prepared = prepare_layer(print, in.layers, tool_ordering.tools_for_layer(in.layers.front().print_z()));
+            }
+            return in;
+        }));
+    const auto generator = tbb::make_filter<LayerToProcess, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerToProcess, LayerResult>(profiler, ExportStage::Generator,
+        [this, &print, &tool_ordering, &layers_to_print, single_object_idx, prime_extruder](LayerToProcess in) -> LayerResult {
+            if (in.idx >= layers_to_print.size())
+                // Insert NOP (no operation) layer;
+                return LayerResult::make_nop_layer_result();
+            print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.idx + 1)));
+            //BBS
+            check_placeholder_parser_failed();
+            print.throw_if_canceled();
+            const LayerTools &layer_tools = tool_ordering.tools_for_layer(in.layers.front().print_z());
+            return this->process_layer(print, in.layers, layer_tools, in.idx + 1 == layers_to_print.size(), nullptr, single_object_idx, prime_extruder, &in.prepared);
+        }));
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
         float max_xy_smoothing = m_config.get_abs_value("spiral_mode_max_xy_smoothing", nozzle_diameter);
         this->m_spiral_vase->set_max_xy_smoothing(max_xy_smoothing);
     }
     const auto spiral_mode = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, LayerResult>(profiler, ExportStage::SpiralVase,
         [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in)->LayerResult {
-            if (in.nop_layer_result)
-                return in;
-            spiral_mode.enable(in.spiral_vase_enable);
-            bool last_layer = in.layer_id == layers_to_print.size() - 1;
-            return { spiral_mode.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush };
-        });
+            return process_spiral_vase(spiral_mode, std::move(in), layers_to_print.size());
+        }));
     const auto pressure_equalizer = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, LayerResult>(profiler, ExportStage::PressureEqualizer,
         [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
              return pressure_equalizer->process_layer(std::move(in));
-        });
+        }));
     const auto cooling = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<LayerResult, std::string>(profiler, ExportStage::Cooling,
         [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in)->std::string {
-            if (in.nop_layer_result)
-                return in.gcode;
-            return cooling_buffer.process_layer(std::move(in.gcode), in.layer_id, in.cooling_buffer_flush);
-        });
-    const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&pa_processor = *this->m_pa_processor](std::string in) -> std::string {
+            return process_cooling(cooling_buffer, std::move(in));
+        }));
+    const auto pa_processor_filter = tbb::make_filter<GCodeLines, GCodeLines>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<GCodeLines, GCodeLines>(profiler, ExportStage::PAProcessor,
+        [&pa_processor = *this->m_pa_processor](GCodeLines in) -> GCodeLines {
             return pa_processor.process_layer(std::move(in));
         }
-    );
-    
-    const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-        [&output_stream](std::string s) { output_stream.write(s); }
-    );
+    ));
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->std::string {
-
-        if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
-            if (fan_mover.get() == nullptr)
-                fan_mover.reset(new Slic3r::FanMover(
-                    writer,
-                    std::abs((float)config.fan_speedup_time.value),
-                    config.fan_speedup_time.value > 0,
-                    config.use_relative_e_distances.value,
-                    config.fan_speedup_overhangs.value,
-                    (float)config.fan_kickstart.value));
-            //flush as it's a whole layer
-            return fan_mover->process_gcode(in, true);
+    // The text of the layer is joined once, after the last stage editing its lines.
+    const auto output = tbb::make_filter<GCodeLines, void>(slic3r_tbb_filtermode::serial_in_order,
+        [&output_stream, profiler](GCodeLines lines) {
+            std::string s = lines.release();
+            if (profiler == nullptr) {
+                output_stream.write(s);
+                return;
+            }
+            GCodeExportProfiler::Clock::time_point begin = GCodeExportProfiler::Clock::now();
+            output_stream.write(s);
+            profiler->record(ExportStage::Output, size_t(-1), begin, GCodeExportProfiler::Clock::now(), s.size());
+            profiler->token_left();
         }
-        return in;
-    });
+    );
 
+    const auto fan_mover = tbb::make_filter<std::string, GCodeLines>(slic3r_tbb_filtermode::serial_in_order,
+        profiled_export_stage<std::string, GCodeLines>(profiler, ExportStage::FanMover,
+            [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->GCodeLines {
+        return process_fan_mover(fan_mover, config, writer, std::move(in));
+    }));
+
+    std::unique_ptr<ExportStageSnapshot> snapshot = this->snapshot_export_stage(profiler);
+    if (profiler)
+        profiler->begin_pass(EXPORT_PIPELINE_MAX_TOKENS);
     // The pipeline elements are joined using const references, thus no copying is performed.
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-    	tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+    	tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & spiral_mode & cooling & fan_mover & output);
     else if	(m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else
-    	tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+    	tbb::parallel_pipeline(EXPORT_PIPELINE_MAX_TOKENS, input & prepare & generator & cooling & fan_mover & pa_processor_filter & output);
+    if (profiler) {
+        profiler->end_pass();
+        this->replay_export_stage(print, *profiler, *snapshot, layers_to_print.size());
+    }
 }
 
 std::string GCode::placeholder_parser_process(const std::string &name, const std::string &templ, unsigned int current_extruder_id, const DynamicConfig *config_override)
@@ -2896,7 +3445,7 @@ std::string GCode::placeholder_parser_process(const std::string &name, const std
 PlaceholderParserIntegration &ppi = m_placeholder_parser_integration;
     try {
         ppi.update_from_gcodewriter(m_writer);
-        std::string output = ppi.parser.process(templ, current_extruder_id, config_override, &ppi.output_config, &ppi.context);
+        std::string output = ppi.parser.process(templ, ppi.templates[{ name, current_extruder_id }], current_extruder_id, config_override, &ppi.output_config, &ppi.context);
         ppi.validate_output_vector_variables();
 
         if (const std::vector<double> &pos = ppi.opt_position->values; ppi.position != pos) {
@@ -3491,65 +4040,332 @@ std::string GCode::generate_skirt(const Print &print,
 // In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
 // For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
 // and performing the extruder specific extrusions together.
-LayerResult GCode::process_layer(
-    const Print                    			&print,
-    // Set of object & print layers of the same PrintObject and with the same print_z.
-    const std::vector<LayerToPrint> 		&layers,
-    const LayerTools        		        &layer_tools,
-    const bool                               last_layer,
-    // Pairs of PrintObject index and its instance index.
-    const std::vector<const PrintInstance*> *ordering,
-    // If set to size_t(-1), then print all copies of all objects.
-    // Otherwise print a single copy of a single object.
-    const size_t                     		 single_object_instance_idx,
-    // BBS
-    const bool                               prime_extruder)
+static bool overhang_speed_enabled(const Layer &layer)
 {
-    assert(! layers.empty());
-    // Either printing all copies of all objects, or just a single copy of a single object.
-    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
+    const auto& regions = layer.regions();
+    return std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
+        return r->has_extrusions() && r->region().config().enable_overhang_speed && !r->region().config().overhang_speed_classic;
+    });
+}
 
-    // First object, support and raft layer, if available.
-    const Layer         *object_layer  = nullptr;
-    const SupportLayer  *support_layer = nullptr;
-    const SupportLayer  *raft_layer    = nullptr;
-    for (const LayerToPrint &l : layers) {
-        if (l.object_layer && ! object_layer)
-            object_layer = l.object_layer;
-        if (l.support_layer) {
-            if (! support_layer)
-                support_layer = l.support_layer;
-            if (! raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
-                raft_layer = support_layer;
+std::map<unsigned int, std::vector<GCode::ObjectByExtruder>> GCode::group_extrusions_by_extruder(
+    const Print                     &print,
+    const std::vector<LayerToPrint> &layers,
+    const LayerTools                &layer_tools)
+{
+    assert(! layer_tools.extruders.empty());
+    unsigned int first_extruder_id = layer_tools.extruders.front();
+
+    // BBS: get next extruder according to flush and soluble
+    auto get_next_extruder = [&](int current_extruder,const std::vector<unsigned int>&extruders) {
+        std::vector<float> flush_matrix(cast<float>(print.config().flush_volumes_matrix.values));
+        const unsigned int number_of_extruders = (unsigned int)(sqrt(flush_matrix.size()) + EPSILON);
+        // Extract purging volumes for each extruder pair:
+        std::vector<std::vector<float>> wipe_volumes;
+        for (unsigned int i = 0; i < number_of_extruders; ++i)
+            wipe_volumes.push_back(std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
+        unsigned int next_extruder = current_extruder;
+        float min_flush = std::numeric_limits<float>::max();
+        for (auto extruder_id : extruders) {
+            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
+                continue;
+            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
+                next_extruder = extruder_id;
+                min_flush = wipe_volumes[current_extruder][extruder_id];
+            }
         }
-    }
+        return next_extruder;
+    };
 
-    const Layer* layer_ptr = nullptr;
-    if (object_layer != nullptr)
-        layer_ptr = object_layer;
-    else if (support_layer != nullptr)
-        layer_ptr = support_layer;
-    const Layer& layer = *layer_ptr;
-    LayerResult   result { {}, layer.id(), false, last_layer };
-    if (layer_tools.extruders.empty())
-        // Nothing to extrude.
-        return result;
+    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
+    bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
+    for (const LayerToPrint &layer_to_print : layers) {
+        if (layer_to_print.support_layer != nullptr) {
+            const SupportLayer &support_layer = *layer_to_print.support_layer;
+            const PrintObject& object = *layer_to_print.original_object;
+            if (! support_layer.support_fills.entities.empty()) {
+                ExtrusionRole   role               = support_layer.support_fills.role();
+                bool            has_support        = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
+                bool            has_interface      = role == erMixed || role == erSupportMaterialInterface;
+                // Extruder ID of the support base. -1 if "don't care".
+                unsigned int    support_extruder   = object.config().support_filament.value - 1;
+                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool            support_dontcare   = object.config().support_filament.value == 0;
+                // Extruder ID of the support interface. -1 if "don't care".
+                unsigned int    interface_extruder = object.config().support_interface_filament.value - 1;
+                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool            interface_dontcare = object.config().support_interface_filament.value == 0;
 
-    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
-    coordf_t             print_z       = layer.print_z;
-    //BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
-    //support is attached above the object, and support layers has independent layer height, then the lowest support
-    //interface layer id is 0.
-    bool                 first_layer   = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
-    m_writer.set_is_first_layer(first_layer);
-    unsigned int         first_extruder_id = layer_tools.extruders.front();
+                // BBS: apply wiping overridden extruders
+                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
+                if (support_dontcare) {
+                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
+                    if (extruder_override >= 0) {
+                        support_extruder = extruder_override;
+                        support_dontcare = false;
+                    }
+                }
 
-    // Initialize config with the 1st object to be printed at this layer.
-    m_config.apply(layer.object()->config(), true);
+                if (interface_dontcare) {
+                    int extruder_override = wiping_extrusions.get_support_interface_extruder_overrides(&object);
+                    if (extruder_override >= 0) {
+                        interface_extruder = extruder_override;
+                        interface_dontcare = false;
+                    }
+                }
 
-    // Check whether it is possible to apply the spiral vase logic for this layer.
-    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
-    m_enable_loop_clipping = true;
+                // BBS: try to print support base with a filament other than interface filament
+                if (support_dontcare && !interface_dontcare) {
+                    unsigned int dontcare_extruder = first_extruder_id;
+                    for (unsigned int extruder_id : layer_tools.extruders) {
+                        if (print.config().filament_soluble.get_at(extruder_id))
+                            continue;
+
+                        //BBS: now we don't consider interface filament used in other object
+                        if (extruder_id == interface_extruder)
+                            continue;
+
+                        dontcare_extruder = extruder_id;
+                        break;
+                    }
+                #if 0
+                    //BBS: not found a suitable extruder in current layer ,dontcare_extruider==first_extruder_id==interface_extruder
+                    if (dontcare_extruder == interface_extruder && (object.config().support_interface_not_for_body && object.config().support_interface_filament.value!=0)) {
+                        // BBS : get a suitable extruder from other layer
+                        auto all_extruders = print.extruders();
+                        dontcare_extruder = get_next_extruder(dontcare_extruder, all_extruders);
+                    }
+                #endif
+
+                    if (support_dontcare)
+                        support_extruder = dontcare_extruder;
+                }
+                else if (support_dontcare || interface_dontcare) {
+                    // Some support will be printed with "don't care" material, preferably non-soluble.
+                    // Is the current extruder assigned a soluble filament?
+                    unsigned int dontcare_extruder = first_extruder_id;
+                    if (print.config().filament_soluble.get_at(dontcare_extruder)) {
+                        // The last extruder printed on the previous layer extrudes soluble filament.
+                        // Try to find a non-soluble extruder on the same layer.
+                        for (unsigned int extruder_id : layer_tools.extruders)
+                            if (! print.config().filament_soluble.get_at(extruder_id)) {
+                                dontcare_extruder = extruder_id;
+                                break;
+                            }
+                    }
+                    if (support_dontcare)
+                        support_extruder = dontcare_extruder;
+                    if (interface_dontcare)
+                        interface_extruder = dontcare_extruder;
+                }
+                // Both the support and the support interface are printed with the same extruder, therefore
+                // the interface may be interleaved with the support base.
+                bool single_extruder = ! has_support || support_extruder == interface_extruder;
+                // Assign an extruder to the base.
+                ObjectByExtruder &obj = object_by_extruder(by_extruder, has_support ? support_extruder : interface_extruder, &layer_to_print - layers.data(), layers.size());
+                obj.support = &support_layer.support_fills;
+                obj.support_extrusion_role = single_extruder ? erMixed : erSupportMaterial;
+                if (! single_extruder && has_interface) {
+                    ObjectByExtruder &obj_interface = object_by_extruder(by_extruder, interface_extruder, &layer_to_print - layers.data(), layers.size());
+                    obj_interface.support = &support_layer.support_fills;
+                    obj_interface.support_extrusion_role = erSupportMaterialInterface;
+                }
+            }
+        }
+
+        if (layer_to_print.object_layer != nullptr) {
+            const Layer &layer = *layer_to_print.object_layer;
+            // We now define a strategy for building perimeters and fills. The separation
+            // between regions doesn't matter in terms of printing order, as we follow
+            // another logic instead:
+            // - we group all extrusions by extruder so that we minimize toolchanges
+            // - we start from the last used extruder
+            // - for each extruder, we group extrusions by island
+            // - for each island, we extrude perimeters first, unless user set the infill_first
+            //   option
+            // (Still, we have to keep track of regions because we need to apply their config)
+            size_t n_slices = layer.lslices.size();
+            const std::vector<BoundingBox> &layer_surface_bboxes = layer.lslices_bboxes;
+            // Traverse the slices in an increasing order of bounding box size, so that the islands inside another islands are tested first,
+            // so we can just test a point inside ExPolygon::contour and we may skip testing the holes.
+            std::vector<size_t> slices_test_order;
+            slices_test_order.reserve(n_slices);
+            for (size_t i = 0; i < n_slices; ++ i)
+                slices_test_order.emplace_back(i);
+            std::sort(slices_test_order.begin(), slices_test_order.end(), [&layer_surface_bboxes](size_t i, size_t j) {
+                const Vec2d s1 = layer_surface_bboxes[i].size().cast<double>();
+                const Vec2d s2 = layer_surface_bboxes[j].size().cast<double>();
+                return s1.x() * s1.y() < s2.x() * s2.y();
+            });
+            auto point_inside_surface = [&layer, &layer_surface_bboxes](const size_t i, const Point &point) {
+                const BoundingBox &bbox = layer_surface_bboxes[i];
+                return point(0) >= bbox.min(0) && point(0) < bbox.max(0) &&
+                       point(1) >= bbox.min(1) && point(1) < bbox.max(1) &&
+                       layer.lslices[i].contour.contains(point);
+            };
+
+            for (size_t region_id = 0; region_id < layer.regions().size(); ++ region_id) {
+                const LayerRegion *layerm = layer.regions()[region_id];
+                if (layerm == nullptr)
+                    continue;
+                // PrintObjects own the PrintRegions, thus the pointer to PrintRegion would be unique to a PrintObject, they would not
+                // identify the content of PrintRegion accross the whole print uniquely. Translate to a Print specific PrintRegion.
+                const PrintRegion &region = print.get_print_region(layerm->region().print_region_id());
+
+                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
+                // It is also necessary to save which extrusions are part of MM wiping and which are not.
+                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
+                std::vector<unsigned int> printing_extruders;
+                for (const ObjectByExtruder::Island::Region::Type entity_type : { ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS }) {
+                    for (const ExtrusionEntity *ee : (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities) {
+                        // extrusions represents infill or perimeter extrusions of a single island.
+                        assert(dynamic_cast<const ExtrusionEntityCollection*>(ee) != nullptr);
+                        const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
+                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
+                            continue;
+
+                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
+                        int correct_extruder_id = layer_tools.extruder(*extrusions, region);
+
+                        // Let's recover vector of extruder overrides:
+                        const WipingExtrusions::ExtruderPerCopy *entity_overrides = nullptr;
+                        if (! layer_tools.has_extruder(correct_extruder_id)) {
+                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
+                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools)
+                            correct_extruder_id = layer_tools.extruders.back();
+                        }
+                        printing_extruders.clear();
+                        if (is_anything_overridden) {
+                            entity_overrides = const_cast<LayerTools&>(layer_tools).wiping_extrusions().get_extruder_overrides(extrusions, layer_to_print.original_object, correct_extruder_id, layer_to_print.object()->instances().size());
+                            if (entity_overrides == nullptr) {
+                                printing_extruders.emplace_back(correct_extruder_id);
+                            } else {
+                                printing_extruders.reserve(entity_overrides->size());
+                                for (int extruder : *entity_overrides)
+                                    printing_extruders.emplace_back(extruder >= 0 ?
+                                        // at least one copy is overridden to use this extruder
+                                        extruder :
+                                        // at least one copy would normally be printed with this extruder (see get_extruder_overrides function for explanation)
+                                        static_cast<unsigned int>(- extruder - 1));
+                                Slic3r::sort_remove_duplicates(printing_extruders);
+                            }
+                        } else
+                            printing_extruders.emplace_back(correct_extruder_id);
+
+                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
+                        for (unsigned int extruder : printing_extruders)
+                        {
+                            std::vector<ObjectByExtruder::Island> &islands = object_islands_by_extruder(
+                                by_extruder,
+                                extruder,
+                                &layer_to_print - layers.data(),
+                                layers.size(), n_slices+1);
+                            for (size_t i = 0; i <= n_slices; ++ i) {
+                                bool   last = i == n_slices;
+                                size_t island_idx = last ? n_slices : slices_test_order[i];
+                                if (// extrusions->first_point does not fit inside any slice
+                                    last ||
+                                    // extrusions->first_point fits inside ith slice
+                                    point_inside_surface(island_idx, extrusions->first_point())) {
+                                    if (islands[island_idx].by_region.empty())
+                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
+                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, extrusions, entity_overrides);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            } // for regions
+        }
+    } // for objects
+
+    return by_extruder;
+}
+
+GCode::PreparedLayer GCode::prepare_layer(const Print &print, const std::vector<LayerToPrint> &layers, const LayerTools &layer_tools)
+{
+    PreparedLayer out;
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude, process_layer() will return early.
+        return out;
+    out.extrusion_quality_distancers.assign(layers.size(), std::nullopt);
+    for (size_t layer_idx = 0; layer_idx < layers.size(); ++ layer_idx)
+        if (const Layer *object_layer = layers[layer_idx].object_layer; object_layer && overhang_speed_enabled(*object_layer))
+            out.extrusion_quality_distancers[layer_idx] = ExtrusionQualityEstimator::build_layer_distancers(*object_layer);
+    if (print.config().reduce_crossing_wall) {
+        // The boundaries of the travels depend on the sliced layers only, calculate them ahead of the G-code generator.
+        out.avoid_crossing_perimeters.reserve(layers.size());
+        for (const LayerToPrint &layer : layers)
+            out.avoid_crossing_perimeters.emplace_back(AvoidCrossingPerimeters::make_layer_data(*layer.layer(), true));
+    }
+    out.by_extruder = group_extrusions_by_extruder(print, layers, layer_tools);
+    out.valid       = true;
+    return out;
+}
+
+LayerResult GCode::process_layer(
+    const Print                    			&print,
+    // Set of object & print layers of the same PrintObject and with the same print_z.
+    const std::vector<LayerToPrint> 		&layers,
+    const LayerTools        		        &layer_tools,
+    const bool                               last_layer,
+    // Pairs of PrintObject index and its instance index.
+    const std::vector<const PrintInstance*> *ordering,
+    // If set to size_t(-1), then print all copies of all objects.
+    // Otherwise print a single copy of a single object.
+    const size_t                     		 single_object_instance_idx,
+    // BBS
+    const bool                               prime_extruder,
+    PreparedLayer                           *prepared_layer)
+{
+    assert(! layers.empty());
+    if (prepared_layer != nullptr && ! prepared_layer->valid)
+        prepared_layer = nullptr;
+    // Either printing all copies of all objects, or just a single copy of a single object.
+    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
+
+    // First object, support and raft layer, if available.
+    const Layer         *object_layer  = nullptr;
+    const SupportLayer  *support_layer = nullptr;
+    const SupportLayer  *raft_layer    = nullptr;
+    for (const LayerToPrint &l : layers) {
+        if (l.object_layer && ! object_layer)
+            object_layer = l.object_layer;
+        if (l.support_layer) {
+            if (! support_layer)
+                support_layer = l.support_layer;
+            if (! raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
+                raft_layer = support_layer;
+        }
+    }
+
+    const Layer* layer_ptr = nullptr;
+    if (object_layer != nullptr)
+        layer_ptr = object_layer;
+    else if (support_layer != nullptr)
+        layer_ptr = support_layer;
+    const Layer& layer = *layer_ptr;
+    LayerResult   result { {}, layer.id(), false, last_layer };
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude.
+        return result;
+
+    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
+    coordf_t             print_z       = layer.print_z;
+    //BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
+    //support is attached above the object, and support layers has independent layer height, then the lowest support
+    //interface layer id is 0.
+    bool                 first_layer   = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
+    m_writer.set_is_first_layer(first_layer);
+    unsigned int         first_extruder_id = layer_tools.extruders.front();
+
+    // Initialize config with the 1st object to be printed at this layer.
+    m_config.apply(layer.object()->config(), true);
+
+    // Check whether it is possible to apply the spiral vase logic for this layer.
+    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
+    m_enable_loop_clipping = true;
     if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
         bool enable = (layer.id() > 0 || !print.has_brim()) && (layer.id() >= (size_t)print.config().skirt_height.value && ! print.has_infinite_skirt());
         if (enable) {
@@ -3714,243 +4530,19 @@ LayerResult GCode::process_layer(
         gcode += ProcessLayer::emit_custom_gcode_per_print_z(*this, layer_tools.custom_gcode, m_writer.extruder()->id(), first_extruder_id, print.config());
     }
 
-    // BBS: get next extruder according to flush and soluble
-    auto get_next_extruder = [&](int current_extruder,const std::vector<unsigned int>&extruders) {
-        std::vector<float> flush_matrix(cast<float>(m_config.flush_volumes_matrix.values));
-        const unsigned int number_of_extruders = (unsigned int)(sqrt(flush_matrix.size()) + EPSILON);
-        // Extract purging volumes for each extruder pair:
-        std::vector<std::vector<float>> wipe_volumes;
-        for (unsigned int i = 0; i < number_of_extruders; ++i)
-            wipe_volumes.push_back(std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
-        unsigned int next_extruder = current_extruder;
-        float min_flush = std::numeric_limits<float>::max();
-        for (auto extruder_id : extruders) {
-            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
-                continue;
-            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
-                next_extruder = extruder_id;
-                min_flush = wipe_volumes[current_extruder][extruder_id];
-            }
-        }
-        return next_extruder;
-    };
-    
-    for (const auto &layer_to_print : layers) {
-        if (layer_to_print.object_layer) {
-            const auto& regions = layer_to_print.object_layer->regions();
-            const bool  enable_overhang_speed = std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
-                return r->has_extrusions() && r->region().config().enable_overhang_speed && !r->region().config().overhang_speed_classic;
-            });
-            if (enable_overhang_speed) {
-                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object,
-                                                                    layer_to_print.object_layer);
-            }
-        }
+    for (size_t layer_idx = 0; layer_idx < layers.size(); ++ layer_idx) {
+        const LayerToPrint &layer_to_print = layers[layer_idx];
+        if (prepared_layer != nullptr) {
+            if (std::optional<ExtrusionQualityEstimator::LayerDistancers> &distancers = prepared_layer->extrusion_quality_distancers[layer_idx]; distancers)
+                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object, std::move(*distancers));
+        } else if (layer_to_print.object_layer && overhang_speed_enabled(*layer_to_print.object_layer))
+            m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object, layer_to_print.object_layer);
     }
 
     // Group extrusions by an extruder, then by an object, an island and a region.
-    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
+    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder = prepared_layer != nullptr ?
+        std::move(prepared_layer->by_extruder) : group_extrusions_by_extruder(print, layers, layer_tools);
     bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
-    for (const LayerToPrint &layer_to_print : layers) {
-        if (layer_to_print.support_layer != nullptr) {
-            const SupportLayer &support_layer = *layer_to_print.support_layer;
-            const PrintObject& object = *layer_to_print.original_object;
-            if (! support_layer.support_fills.entities.empty()) {
-                ExtrusionRole   role               = support_layer.support_fills.role();
-                bool            has_support        = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
-                bool            has_interface      = role == erMixed || role == erSupportMaterialInterface;
-                // Extruder ID of the support base. -1 if "don't care".
-                unsigned int    support_extruder   = object.config().support_filament.value - 1;
-                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool            support_dontcare   = object.config().support_filament.value == 0;
-                // Extruder ID of the support interface. -1 if "don't care".
-                unsigned int    interface_extruder = object.config().support_interface_filament.value - 1;
-                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool            interface_dontcare = object.config().support_interface_filament.value == 0;
-
-                // BBS: apply wiping overridden extruders
-                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
-                if (support_dontcare) {
-                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
-                    if (extruder_override >= 0) {
-                        support_extruder = extruder_override;
-                        support_dontcare = false;
-                    }
-                }
-
-                if (interface_dontcare) {
-                    int extruder_override = wiping_extrusions.get_support_interface_extruder_overrides(&object);
-                    if (extruder_override >= 0) {
-                        interface_extruder = extruder_override;
-                        interface_dontcare = false;
-                    }
-                }
-
-                // BBS: try to print support base with a filament other than interface filament
-                if (support_dontcare && !interface_dontcare) {
-                    unsigned int dontcare_extruder = first_extruder_id;
-                    for (unsigned int extruder_id : layer_tools.extruders) {
-                        if (print.config().filament_soluble.get_at(extruder_id))
-                            continue;
-
-                        //BBS: now we don't consider interface filament used in other object
-                        if (extruder_id == interface_extruder)
-                            continue;
-
-                        dontcare_extruder = extruder_id;
-                        break;
-                    }
-                #if 0
-                    //BBS: not found a suitable extruder in current layer ,dontcare_extruider==first_extruder_id==interface_extruder
-                    if (dontcare_extruder == interface_extruder && (object.config().support_interface_not_for_body && object.config().support_interface_filament.value!=0)) {
-                        // BBS : get a suitable extruder from other layer
-                        auto all_extruders = print.extruders();
-                        dontcare_extruder = get_next_extruder(dontcare_extruder, all_extruders);
-                    }
-                #endif
-
-                    if (support_dontcare)
-                        support_extruder = dontcare_extruder;
-                }
-                else if (support_dontcare || interface_dontcare) {
-                    // Some support will be printed with "don't care" material, preferably non-soluble.
-                    // Is the current extruder assigned a soluble filament?
-                    unsigned int dontcare_extruder = first_extruder_id;
-                    if (print.config().filament_soluble.get_at(dontcare_extruder)) {
-                        // The last extruder printed on the previous layer extrudes soluble filament.
-                        // Try to find a non-soluble extruder on the same layer.
-                        for (unsigned int extruder_id : layer_tools.extruders)
-                            if (! print.config().filament_soluble.get_at(extruder_id)) {
-                                dontcare_extruder = extruder_id;
-                                break;
-                            }
-                    }
-                    if (support_dontcare)
-                        support_extruder = dontcare_extruder;
-                    if (interface_dontcare)
-                        interface_extruder = dontcare_extruder;
-                }
-                // Both the support and the support interface are printed with the same extruder, therefore
-                // the interface may be interleaved with the support base.
-                bool single_extruder = ! has_support || support_extruder == interface_extruder;
-                // Assign an extruder to the base.
-                ObjectByExtruder &obj = object_by_extruder(by_extruder, has_support ? support_extruder : interface_extruder, &layer_to_print - layers.data(), layers.size());
-                obj.support = &support_layer.support_fills;
-                obj.support_extrusion_role = single_extruder ? erMixed : erSupportMaterial;
-                if (! single_extruder && has_interface) {
-                    ObjectByExtruder &obj_interface = object_by_extruder(by_extruder, interface_extruder, &layer_to_print - layers.data(), layers.size());
-                    obj_interface.support = &support_layer.support_fills;
-                    obj_interface.support_extrusion_role = erSupportMaterialInterface;
-                }
-            }
-        }
-
-        if (layer_to_print.object_layer != nullptr) {
-            const Layer &layer = *layer_to_print.object_layer;
-            // We now define a strategy for building perimeters and fills. The separation
-            // between regions doesn't matter in terms of printing order, as we follow
-            // another logic instead:
-            // - we group all extrusions by extruder so that we minimize toolchanges
-            // - we start from the last used extruder
-            // - for each extruder, we group extrusions by island
-            // - for each island, we extrude perimeters first, unless user set the infill_first
-            //   option
-            // (Still, we have to keep track of regions because we need to apply their config)
-            size_t n_slices = layer.lslices.size();
-            const std::vector<BoundingBox> &layer_surface_bboxes = layer.lslices_bboxes;
-            // Traverse the slices in an increasing order of bounding box size, so that the islands inside another islands are tested first,
-            // so we can just test a point inside ExPolygon::contour and we may skip testing the holes.
-            std::vector<size_t> slices_test_order;
-            slices_test_order.reserve(n_slices);
-            for (size_t i = 0; i < n_slices; ++ i)
-                slices_test_order.emplace_back(i);
-            std::sort(slices_test_order.begin(), slices_test_order.end(), [&layer_surface_bboxes](size_t i, size_t j) {
-                const Vec2d s1 = layer_surface_bboxes[i].size().cast<double>();
-                const Vec2d s2 = layer_surface_bboxes[j].size().cast<double>();
-                return s1.x() * s1.y() < s2.x() * s2.y();
-            });
-            auto point_inside_surface = [&layer, &layer_surface_bboxes](const size_t i, const Point &point) {
-                const BoundingBox &bbox = layer_surface_bboxes[i];
-                return point(0) >= bbox.min(0) && point(0) < bbox.max(0) &&
-                       point(1) >= bbox.min(1) && point(1) < bbox.max(1) &&
-                       layer.lslices[i].contour.contains(point);
-            };
-
-            for (size_t region_id = 0; region_id < layer.regions().size(); ++ region_id) {
-                const LayerRegion *layerm = layer.regions()[region_id];
-                if (layerm == nullptr)
-                    continue;
-                // PrintObjects own the PrintRegions, thus the pointer to PrintRegion would be unique to a PrintObject, they would not
-                // identify the content of PrintRegion accross the whole print uniquely. Translate to a Print specific PrintRegion.
-                const PrintRegion &region = print.get_print_region(layerm->region().print_region_id());
-
-                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
-                // It is also necessary to save which extrusions are part of MM wiping and which are not.
-                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
-                std::vector<unsigned int> printing_extruders;
-                for (const ObjectByExtruder::Island::Region::Type entity_type : { ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS }) {
-                    for (const ExtrusionEntity *ee : (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities) {
-                        // extrusions represents infill or perimeter extrusions of a single island.
-                        assert(dynamic_cast<const ExtrusionEntityCollection*>(ee) != nullptr);
-                        const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
-                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
-                            continue;
-
-                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
-                        int correct_extruder_id = layer_tools.extruder(*extrusions, region);
-
-                        // Let's recover vector of extruder overrides:
-                        const WipingExtrusions::ExtruderPerCopy *entity_overrides = nullptr;
-                        if (! layer_tools.has_extruder(correct_extruder_id)) {
-                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
-                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools)
-                            correct_extruder_id = layer_tools.extruders.back();
-                        }
-                        printing_extruders.clear();
-                        if (is_anything_overridden) {
-                            entity_overrides = const_cast<LayerTools&>(layer_tools).wiping_extrusions().get_extruder_overrides(extrusions, layer_to_print.original_object, correct_extruder_id, layer_to_print.object()->instances().size());
-                            if (entity_overrides == nullptr) {
-                                printing_extruders.emplace_back(correct_extruder_id);
-                            } else {
-                                printing_extruders.reserve(entity_overrides->size());
-                                for (int extruder : *entity_overrides)
-                                    printing_extruders.emplace_back(extruder >= 0 ?
-                                        // at least one copy is overridden to use this extruder
-                                        extruder :
-                                        // at least one copy would normally be printed with this extruder (see get_extruder_overrides function for explanation)
-                                        static_cast<unsigned int>(- extruder - 1));
-                                Slic3r::sort_remove_duplicates(printing_extruders);
-                            }
-                        } else
-                            printing_extruders.emplace_back(correct_extruder_id);
-
-                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
-                        for (unsigned int extruder : printing_extruders)
-                        {
-                            std::vector<ObjectByExtruder::Island> &islands = object_islands_by_extruder(
-                                by_extruder,
-                                extruder,
-                                &layer_to_print - layers.data(),
-                                layers.size(), n_slices+1);
-                            for (size_t i = 0; i <= n_slices; ++ i) {
-                                bool   last = i == n_slices;
-                                size_t island_idx = last ? n_slices : slices_test_order[i];
-                                if (// extrusions->first_point does not fit inside any slice
-                                    last ||
-                                    // extrusions->first_point fits inside ith slice
-                                    point_inside_surface(island_idx, extrusions->first_point())) {
-                                    if (islands[island_idx].by_region.empty())
-                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
-                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, extrusions, entity_overrides);
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-            } // for regions
-        }
-    } // for objects
 
     if (m_wipe_tower)
         m_wipe_tower->set_is_first_print(true);
@@ -4080,8 +4672,12 @@ LayerResult GCode::process_layer(
                 m_config.apply(instance_to_print.print_object.config(), true);
                 m_layer = layer_to_print.layer();
                 m_object_layer_over_raft = object_layer_over_raft;
-                if (m_config.reduce_crossing_wall)
-                    m_avoid_crossing_perimeters.init_layer(*m_layer);
+                if (m_config.reduce_crossing_wall) {
+                    if (prepared_layer != nullptr && ! prepared_layer->avoid_crossing_perimeters.empty())
+                        m_avoid_crossing_perimeters.init_layer(prepared_layer->avoid_crossing_perimeters[instance_to_print.layer_id]);
+                    else
+                        m_avoid_crossing_perimeters.init_layer(*m_layer);
+                }
 
                 if (this->config().gcode_label_objects) {
                     gcode += std::string("; printing object ") + instance_to_print.print_object.model_object()->name +
@@ -4400,7 +4996,7 @@ std::string GCode::preamble()
 // called by GCode::process_layer()
 std::string GCode::change_layer(coordf_t print_z)
 {
-    std::string gcode;
+    std::string gcode = m_layer_time_slot;
     if (m_layer_count > 0)
         // Increment a progress bar indicator.
         gcode += m_writer.update_progress(++ m_layer_index, m_layer_count);
@@ -4892,6 +5488,18 @@ std::string GCode::extrude_support(const ExtrusionEntityCollection &support_fill
     return gcode;
 }
 
+// Size of the chunks of G-code written into the file and passed to the GCodeProcessor.
+static constexpr size_t GCODE_OUTPUT_CHUNK_SIZE      = 1024 * 1024;
+// Maximum number of chunks waiting for the asynchronous GCodeProcessor, limits the memory held by the queue.
+static constexpr size_t GCODE_OUTPUT_MAX_QUEUED      = 4;
+
+GCode::GCodeOutputStream::GCodeOutputStream(FILE *f, GCodeProcessor &processor, bool process_async) : f(f), m_processor(processor)
+{
+    m_buffer.reserve(GCODE_OUTPUT_CHUNK_SIZE + GCODE_OUTPUT_CHUNK_SIZE / 4);
+    if (f != nullptr && process_async)
+        m_thread = create_thread([this]() { this->process_thread(); });
+}
+
 bool GCode::GCodeOutputStream::is_error() const
 {
     return ::ferror(this->f);
@@ -4899,32 +5507,136 @@ bool GCode::GCodeOutputStream::is_error() const
 
 void GCode::GCodeOutputStream::flush()
 {
+    this->flush_buffer(true);
+    this->wait_processed();
     ::fflush(this->f);
 }
 
 void GCode::GCodeOutputStream::close()
 {
     if (this->f) {
+        // The remaining G-code is written into the file only, flush() is responsible for feeding the GCodeProcessor.
+        if (! m_buffer.empty())
+            ::fwrite(m_buffer.data(), 1, m_buffer.size(), this->f);
+        m_buffer.clear();
+        this->stop_processing();
         ::fclose(this->f);
         this->f = nullptr;
     }
 }
 
-void GCode::GCodeOutputStream::write(const char *what)
+void GCode::GCodeOutputStream::write(const char *what, size_t len)
 {
-    if (what != nullptr) {
-        const char* gcode = what;
-        // writes string to file
-        fwrite(gcode, 1, ::strlen(gcode), this->f);
-        //FIXME don't allocate a string, maybe process a batch of lines?
-        m_processor.process_buffer(std::string(gcode));
-    }
+    if (len == 0)
+        return;
+    m_buffer.append(what, len);
+    if (m_buffer.size() >= GCODE_OUTPUT_CHUNK_SIZE)
+        this->flush_buffer(false);
 }
 
 void GCode::GCodeOutputStream::writeln(const std::string &what)
 {
-    if (! what.empty())
-        this->write(what.back() == '\n' ? what : what + '\n');
+    if (! what.empty()) {
+        this->write(what);
+        if (what.back() != '\n')
+            this->write("\n", 1);
+    }
+}
+
+void GCode::GCodeOutputStream::flush_buffer(bool all_lines)
+{
+    // The GCodeReader parses up to the end of a line, thus only complete lines are passed to the GCodeProcessor,
+    // unless the chunk is a whole std::string, which is zero terminated.
+    size_t len = m_buffer.size();
+    if (! all_lines) {
+        size_t last_eol = m_buffer.rfind('\n');
+        if (last_eol == std::string::npos)
+            return;
+        len = last_eol + 1;
+    }
+    if (len == 0)
+        return;
+
+    ::fwrite(m_buffer.data(), 1, len, this->f);
+    if (m_thread.joinable()) {
+        // Hand the buffer over to the worker thread, keep the incomplete line.
+        std::string chunk = std::move(m_buffer);
+        m_buffer.clear();
+        m_buffer.reserve(GCODE_OUTPUT_CHUNK_SIZE + GCODE_OUTPUT_CHUNK_SIZE / 4);
+        m_buffer.append(chunk, len);
+        chunk.resize(len);
+        this->process_chunk(std::move(chunk));
+    } else {
+        m_processor.process_buffer(std::string_view(m_buffer.data(), len));
+        m_buffer.erase(0, len);
+    }
+}
+
+void GCode::GCodeOutputStream::process_chunk(std::string &&chunk)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return m_queue.size() < GCODE_OUTPUT_MAX_QUEUED; });
+    m_queue.emplace_back(std::move(chunk));
+    lock.unlock();
+    m_condition.notify_all();
+}
+
+void GCode::GCodeOutputStream::wait_processed()
+{
+    if (! m_thread.joinable())
+        return;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return m_queue.empty() && ! m_processing; });
+    if (m_exception)
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+}
+
+void GCode::GCodeOutputStream::stop_processing()
+{
+    if (! m_thread.joinable())
+        return;
+    {
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void GCode::GCodeOutputStream::process_thread()
+{
+    set_current_thread_name("gcode_processor");
+    for (;;) {
+        std::string chunk;
+        bool        failed;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || ! m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_processing = true;
+            failed       = bool(m_exception);
+        }
+        m_condition.notify_all();
+        std::exception_ptr exception;
+        // After a failure the rest of the G-code is just drained, the exception is rethrown by flush().
+        if (! failed) {
+            try {
+                m_processor.process_buffer(chunk);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+        }
+        {
+            std::scoped_lock<std::mutex> lock(m_mutex);
+            m_processing = false;
+            if (exception)
+                m_exception = exception;
+        }
+        m_condition.notify_all();
+    }
 }
 
 void GCode::GCodeOutputStream::write_format(const char* format, ...)
@@ -4946,15 +5658,13 @@ void GCode::GCodeOutputStream::write_format(const char* format, ...)
         va_end(args2);
     }
 
-    char buffer[1024];
-    bool buffer_dynamic = buflen > 1024;
-    char *bufptr = buffer_dynamic ? (char*)malloc(buflen) : buffer;
-    int res = ::vsnprintf(bufptr, buflen, format, args);
-    if (res > 0)
-        this->write(bufptr);
-
-    if (buffer_dynamic)
-        free(bufptr);
+    // Format directly into the output buffer.
+    size_t old_size = m_buffer.size();
+    m_buffer.resize(old_size + buflen);
+    int res = ::vsnprintf(m_buffer.data() + old_size, buflen, format, args);
+    m_buffer.resize(old_size + std::max(res, 0));
+    if (m_buffer.size() >= GCODE_OUTPUT_CHUNK_SIZE)
+        this->flush_buffer(false);
 
     va_end(args);
 }
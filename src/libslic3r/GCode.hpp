@@ -26,9 +26,15 @@
 #include "GCode/SmallAreaInfillFlowCompensator.hpp"
 // ORCA: post processor below used for Dynamic Pressure advance
 #include "GCode/AdaptivePAProcessor.hpp"
-
+#include <boost/thread.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <cfloat>
@@ -37,6 +43,8 @@ namespace Slic3r {
 
 // Forward declarations.
 class GCode;
+class GCodeExportProfiler;
+struct GCodeGeneratorCache;
 
 namespace { struct Item; }
 struct PrintInstance;
@@ -159,34 +167,158 @@ struct LayerResult {
     static LayerResult make_nop_layer_result() { return {"", std::numeric_limits<coord_t>::max(), false, false, true}; }
 };
 
-class GCode {
+// State of the G-code generator: the members of GCode, which are carried from one layer to the next one and to the end of the export.
+// They are kept in a single copyable struct, so that GCodeGeneratorCache may snapshot and restore the generator as a whole.
+// Members of GCode modified while generating the layers belong here, the stateless helpers and the filters stay with GCode.
+struct GCodeGeneratorState
+{
+    /* Origin of print coordinates expressed in unscaled G-code coordinates.
+       This affects the input arguments supplied to the extrude*() and travel_to()
+       methods. */
+    Vec2d                               m_origin { Vec2d::Zero() };
+    FullPrintConfig                     m_config;
+    DynamicConfig                       m_calib_config;
+    // scaled G-code resolution
+    double                              m_scaled_resolution;
+    GCodeWriter                         m_writer;
 
-public:
-    GCode() :
-    	m_origin(Vec2d::Zero()),
-        m_enable_loop_clipping(true),
-        m_enable_cooling_markers(false),
-        m_enable_extrusion_role_markers(false),
-        m_last_processor_extrusion_role(erNone),
-        m_layer_count(0),
-        m_layer_index(-1),
-        m_layer(nullptr),
-        m_object_layer_over_raft(false),
-        //m_volumetric_speed(0),
-        m_last_pos_defined(false),
-        m_last_extrusion_role(erNone),
-        m_last_width(0.0f),
+    struct PlaceholderParserIntegration {
+        void reset();
+        void init(const GCodeWriter &config);
+        void update_from_gcodewriter(const GCodeWriter &writer);
+        void validate_output_vector_variables();
+
+        PlaceholderParserIntegration() = default;
+        // The option pointers are rebound into the copied configs, the global variables of the context are copied.
+        PlaceholderParserIntegration(const PlaceholderParserIntegration &rhs) { *this = rhs; }
+        PlaceholderParserIntegration& operator=(const PlaceholderParserIntegration &rhs);
+
+        PlaceholderParser                   parser;
+        // For random number generator etc.
+        PlaceholderParser::ContextData      context;
+        // Compiled custom G-code, keyed by the custom G-code name and the extruder, see placeholder_parser_process().
+        std::map<std::pair<std::string, unsigned int>, PlaceholderParser::CachedTemplate> templates;
+        // Collection of templates, on which the placeholder substitution failed.
+        std::map<std::string, std::string>  failed_templates;
+        // Input/output from/to custom G-code block, for returning position, retraction etc.
+        DynamicConfig                       output_config;
+        ConfigOptionFloats                 *opt_position { nullptr };
+        ConfigOptionFloat                  *opt_zhop { nullptr };
+        ConfigOptionFloats                 *opt_e_position { nullptr };
+        ConfigOptionFloats                 *opt_e_retracted { nullptr };
+        ConfigOptionFloats                 *opt_e_restart_extra { nullptr };
+        ConfigOptionFloats                 *opt_extruded_volume { nullptr };
+        ConfigOptionFloats                 *opt_extruded_weight { nullptr };
+        ConfigOptionFloat                  *opt_extruded_volume_total { nullptr };
+        ConfigOptionFloat                  *opt_extruded_weight_total { nullptr };
+        // Caches of the data passed to the script.
+        size_t                              num_extruders { 0 };
+        std::vector<double>                 position;
+        std::vector<double>                 e_position;
+        std::vector<double>                 e_retracted;
+        std::vector<double>                 e_restart_extra;
+    } m_placeholder_parser_integration;
+
+    OozePrevention                      m_ooze_prevention;
+    Wipe                                m_wipe;
+    AvoidCrossingPerimeters             m_avoid_crossing_perimeters;
+    RetractWhenCrossingPerimeters       m_retract_when_crossing_perimeters;
+    bool                                m_enable_loop_clipping { true };
+    // If enabled, the G-code generator will put following comments at the ends
+    // of the G-code lines: _EXTRUDE_SET_SPEED, _WIPE, _OVERHANG_FAN_START, _OVERHANG_FAN_END
+    // Those comments are received and consumed (removed from the G-code) by the CoolingBuffer.pm Perl module.
+    bool                                m_enable_cooling_markers { false };
+    
+    bool m_enable_exclude_object;
+    std::vector<size_t> m_label_objects_ids;
+    // Orca
+    bool m_is_overhang_fan_on;
+    bool m_is_internal_bridge_fan_on; // ORCA: Add support for separate internal bridge fan speed control
+    bool m_is_supp_interface_fan_on;
+    // Markers for the Pressure Equalizer to recognize the extrusion type.
+    // The Pressure Equalizer removes the markers from the final G-code.
+    bool                                m_enable_extrusion_role_markers { false };
+    // Keeps track of the last extrusion role passed to the processor
+    ExtrusionRole                       m_last_processor_extrusion_role { erNone };
+    // Slot for the remaining time lines M73 exported by change_layer(), reserved with single pass finalization of the GCodeProcessor.
+    std::string                         m_layer_time_slot;
+    // How many times will change_layer() be called?
+    // change_layer() will update the progress bar.
+    unsigned int                        m_layer_count { 0 };
+    // Progress bar indicator. Increments from -1 up to layer_count.
+    int                                 m_layer_index { -1 };
+    // Current layer processed. In sequential printing mode, only a single copy will be printed.
+    // In non-sequential mode, all its copies will be printed.
+    const Layer*                        m_layer { nullptr };
+    // m_layer is an object layer and it is being printed over raft surface.
+    bool                                m_object_layer_over_raft { false };
+    //double                              m_volumetric_speed;
+    // Support for the extrusion role markers. Which marker is active?
+    ExtrusionRole                       m_last_extrusion_role { erNone };
+    // To ignore gapfill role for retract_lift_enforce
+    ExtrusionRole                       m_last_notgapfill_extrusion_role;
+    // Support for G-Code Processor
+    float                               m_last_height{ 0.0f };
+    float                               m_last_layer_z{ 0.0f };
+    float                               m_max_layer_z{ 0.0f };
+    float                               m_last_width{ 0.0f };
 #if ENABLE_GCODE_VIEWER_DATA_CHECKING
-        m_last_mm3_per_mm(0.0),
+    double                              m_last_mm3_per_mm { 0. };
 #endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
-        m_brim_done(false),
-        m_second_layer_things_done(false),
-        m_silent_time_estimator_enabled(false),
-        m_last_obj_copy(nullptr, Point(std::numeric_limits<coord_t>::max(), std::numeric_limits<coord_t>::max())),
-        // BBS
-        m_toolchange_count(0),
-        m_nominal_z(0.)
-        {}
+
+#if !BBL_RELEASE_TO_PUBLIC
+    std::map<std::string, std::vector<std::string>> m_placeholder_error_messages;
+#endif
+
+    Point                               m_last_pos;
+    bool                                m_last_pos_defined { false };
+
+    // Orca: Adaptive PA variables
+    // Used for adaptive PA when extruding paths with multiple, varying flow segments.
+    // This contains the sum of the mm3_per_mm values weighted by the length of each path segment.
+    // The m_multi_flow_segment_path_pa_set constrains the PA change request to the first extrusion segment.
+    // It sets the mm3_mm value for the adaptive PA post processor to be the average of that path
+    // as calculated and stored in the m_multi_segment_path_average_mm3_per_mm value
+    double          m_multi_flow_segment_path_average_mm3_per_mm = 0;
+    bool            m_multi_flow_segment_path_pa_set = false;
+    // Adaptive PA last set flow to enable issuing of PA change commands when adaptive PA for overhangs
+    // is enabled
+    double          m_last_mm3_mm = 0;
+    // Orca: Adaptive PA code segment end
+
+    std::set<ObjectID>              m_objsWithBrim; // indicates the objs with brim
+    std::set<ObjectID>              m_objSupportsWithBrim; // indicates the objs' supports with brim
+
+    ExtrusionQualityEstimator m_extrusion_quality_estimator;
+
+    // Heights (print_z) at which the skirt has already been extruded.
+    std::vector<coordf_t>               m_skirt_done;
+    // Has the brim been extruded already? Brim is being extruded only for the first object of a multi-object print.
+    bool                                m_brim_done { false };
+    // Flag indicating whether the nozzle temperature changes from 1st to 2nd layer were performed.
+    bool                                m_second_layer_things_done { false };
+    // Index of a last object copy extruded.
+    std::pair<const PrintObject*, Point> m_last_obj_copy { nullptr, Point(std::numeric_limits<coord_t>::max(), std::numeric_limits<coord_t>::max()) };
+
+    int m_timelapse_warning_code = 0;
+    bool m_support_traditional_timelapse = true;
+
+    bool m_silent_time_estimator_enabled { false };
+
+    // BBS
+    Print* m_curr_print = nullptr;
+    unsigned int m_toolchange_count { 0 };
+    coordf_t m_nominal_z { 0. };
+    bool m_need_change_layer_lift_z = false;
+    int m_start_gcode_filament = -1;
+
+    std::set<unsigned int>                  m_initial_layer_extruders;
+};
+
+class GCode : private GCodeGeneratorState {
+
+public:
+    GCode() = default;
     ~GCode() = default;
 
     // throws std::runtime_exception on error,
@@ -275,20 +407,27 @@ public:
     };
 
 private:
+    // Buffers the exported G-code into large chunks of complete lines, which are written into the file
+    // and handed over to the GCodeProcessor in one go instead of line by line.
     class GCodeOutputStream {
     public:
-        GCodeOutputStream(FILE *f, GCodeProcessor &processor) : f(f), m_processor(processor) {}
+        // With process_async, the chunks are parsed by the GCodeProcessor on a worker thread, fed through a bounded queue.
+        GCodeOutputStream(FILE *f, GCodeProcessor &processor, bool process_async = false);
         ~GCodeOutputStream() { this->close(); }
 
         bool is_open() const { return f; }
         bool is_error() const;
 
+        // Write out the buffered G-code and wait until the GCodeProcessor processed it.
+        // Rethrows an exception thrown by the GCodeProcessor on the worker thread.
         void flush();
+        // Write out the buffered G-code and close the file. Call flush() first for the GCodeProcessor to see all of it.
         void close();
 
         // Write a string into a file.
-        void write(const std::string& what) { this->write(what.c_str()); }
-        void write(const char* what);
+        void write(const std::string& what) { this->write(what.data(), what.size()); }
+        void write(const char* what) { if (what != nullptr) this->write(what, ::strlen(what)); }
+        void write(const char* what, size_t len);
 
         // Write a string into a file.
         // Add a newline, if the string does not end with a newline already.
@@ -299,8 +438,25 @@ private:
         void write_format(const char* format, ...);
 
     private:
-        FILE *f = nullptr;
-        GCodeProcessor &m_processor;
+        // Pass the complete lines of m_buffer to the file and to the GCodeProcessor, with all_lines also the trailing incomplete line.
+        void flush_buffer(bool all_lines);
+        void process_chunk(std::string &&chunk);
+        void wait_processed();
+        void stop_processing();
+        void process_thread();
+
+        FILE                    *f = nullptr;
+        GCodeProcessor          &m_processor;
+        std::string              m_buffer;
+
+        // Asynchronous processing.
+        boost::thread            m_thread;
+        std::mutex               m_mutex;
+        std::condition_variable  m_condition;
+        std::deque<std::string>  m_queue;
+        bool                     m_processing { false };
+        bool                     m_stop       { false };
+        std::exception_ptr       m_exception;
     };
     void            _do_export(Print &print, GCodeOutputStream &file, ThumbnailsGeneratorCallback thumbnail_cb);
 
@@ -314,6 +470,7 @@ private:
         const Layer& layer,
         unsigned int extruder_id);
 
+    struct PreparedLayer;
     LayerResult process_layer(
         const Print                     &print,
         // Set of object & print layers of the same PrintObject and with the same print_z.
@@ -326,10 +483,12 @@ private:
         // Otherwise print a single copy of a single object.
         const size_t                     single_object_idx = size_t(-1),
         // BBS
-        const bool                       prime_extruder = false);
+        const bool                       prime_extruder = false,
+        // Data of these layers prepared by prepare_layer(), consumed by process_layer(). If null, it is calculated in place.
+        PreparedLayer                   *prepared_layer = nullptr);
     // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
-    // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
-    // and export G-code into file.
+    // Prepare the layers in parallel (see prepare_layer()), generate G-code serially, run the filters
+    // (vase mode, cooling buffer), run the G-code analyser and export G-code into file.
     void process_layers(
         const Print                                                         &print,
         const ToolOrdering                                                  &tool_ordering,
@@ -337,8 +496,8 @@ private:
         const std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>>   &layers_to_print,
         GCodeOutputStream                                                   &output_stream);
     // Process all layers of a single object instance (sequential mode) with a parallel pipeline:
-    // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
-    // and export G-code into file.
+    // Prepare the layers in parallel (see prepare_layer()), generate G-code serially, run the filters
+    // (vase mode, cooling buffer), run the G-code analyser and export G-code into file.
     void process_layers(
         const Print                             &print,
         const ToolOrdering                      &tool_ordering,
@@ -347,6 +506,10 @@ private:
         GCodeOutputStream                       &output_stream,
         // BBS
         const bool                               prime_extruder = false);
+    // Copies of the post-processors before a pass of the export pipeline, to replay the stage input captured by a GCodeExportProfiler.
+    struct ExportStageSnapshot;
+    std::unique_ptr<ExportStageSnapshot> snapshot_export_stage(const GCodeExportProfiler *profiler) const;
+    void            replay_export_stage(const Print &print, GCodeExportProfiler &profiler, const ExportStageSnapshot &snapshot, size_t num_layers);
 
     //BBS
     void check_placeholder_parser_failed();
@@ -365,19 +528,6 @@ private:
     std::string     extrude_loop(ExtrusionLoop loop, std::string description, double speed = -1., const ExtrusionEntitiesPtr& region_perimeters = ExtrusionEntitiesPtr());
     std::string     extrude_multi_path(ExtrusionMultiPath multipath, std::string description = "", double speed = -1.);
     std::string     extrude_path(ExtrusionPath path, std::string description = "", double speed = -1.);
-    
-    // Orca: Adaptive PA variables
-    // Used for adaptive PA when extruding paths with multiple, varying flow segments.
-    // This contains the sum of the mm3_per_mm values weighted by the length of each path segment.
-    // The m_multi_flow_segment_path_pa_set constrains the PA change request to the first extrusion segment.
-    // It sets the mm3_mm value for the adaptive PA post processor to be the average of that path
-    // as calculated and stored in the m_multi_segment_path_average_mm3_per_mm value
-    double          m_multi_flow_segment_path_average_mm3_per_mm = 0;
-    bool            m_multi_flow_segment_path_pa_set = false;
-    // Adaptive PA last set flow to enable issuing of PA change commands when adaptive PA for overhangs
-    // is enabled
-    double          m_last_mm3_mm = 0;
-    // Orca: Adaptive PA code segment end
 
     // Extruding multiple objects with soluble / non-soluble / combined supports
     // on a multi-material printer, trying to minimize tool switches.
@@ -419,6 +569,26 @@ private:
         std::vector<Island>         islands;
     };
 
+    // Extrusions of a single print_z grouped by an extruder, then by an object, an island and a region.
+    static std::map<unsigned int, std::vector<ObjectByExtruder>> group_extrusions_by_extruder(
+        const Print &print, const std::vector<LayerToPrint> &layers, const LayerTools &layer_tools);
+
+    // Part of process_layer() not depending on the state of the G-code generator. process_layers() prepares it
+    // for several layers in parallel, while process_layer() emits the preceding layers serially.
+    //FIXME The G-code text is still emitted by a single thread. Emitting the layers in parallel needs the writer, wipe,
+    // retraction, travel and extruder state of GCodeGeneratorState to be layer local, followed by a serial stage fixing up
+    // the E axis, the retractions, the first travel and the tool changes at the layer boundaries.
+    struct PreparedLayer
+    {
+        bool                                                                    valid { false };
+        std::map<unsigned int, std::vector<ObjectByExtruder>>                   by_extruder;
+        // Indexed as the layers passed to prepare_layer(), set for object layers with overhang speed enabled.
+        std::vector<std::optional<ExtrusionQualityEstimator::LayerDistancers>>  extrusion_quality_distancers;
+        // Indexed as the layers passed to prepare_layer(), set with reduce_crossing_wall. Shared by the instances of an object.
+        std::vector<std::shared_ptr<AvoidCrossingPerimeters::LayerData>>       avoid_crossing_perimeters;
+    };
+    static PreparedLayer prepare_layer(const Print &print, const std::vector<LayerToPrint> &layers, const LayerTools &layer_tools);
+
 	struct InstanceToPrint
 	{
 		InstanceToPrint(ObjectByExtruder &object_by_extruder, size_t layer_id, const PrintObject &print_object, size_t instance_id, size_t label_object_id) :
@@ -451,106 +621,10 @@ private:
     // BBS
     LiftType to_lift_type(ZHopType z_hop_types);
 
-    std::set<ObjectID>              m_objsWithBrim; // indicates the objs with brim
-    std::set<ObjectID>              m_objSupportsWithBrim; // indicates the objs' supports with brim
     // Cache for custom seam enforcers/blockers for each layer.
     SeamPlacer                          m_seam_placer;
 
-    ExtrusionQualityEstimator m_extrusion_quality_estimator;
-
-
-    /* Origin of print coordinates expressed in unscaled G-code coordinates.
-       This affects the input arguments supplied to the extrude*() and travel_to()
-       methods. */
-    Vec2d                               m_origin;
-    FullPrintConfig                     m_config;
-    DynamicConfig                       m_calib_config;
-    // scaled G-code resolution
-    double                              m_scaled_resolution;
-    GCodeWriter                         m_writer;
-
-    struct PlaceholderParserIntegration {
-        void reset();
-        void init(const GCodeWriter &config);
-        void update_from_gcodewriter(const GCodeWriter &writer);
-        void validate_output_vector_variables();
-
-        PlaceholderParser                   parser;
-        // For random number generator etc.
-        PlaceholderParser::ContextData      context;
-        // Collection of templates, on which the placeholder substitution failed.
-        std::map<std::string, std::string>  failed_templates;
-        // Input/output from/to custom G-code block, for returning position, retraction etc.
-        DynamicConfig                       output_config;
-        ConfigOptionFloats                 *opt_position { nullptr };
-        ConfigOptionFloat                  *opt_zhop { nullptr };
-        ConfigOptionFloats                 *opt_e_position { nullptr };
-        ConfigOptionFloats                 *opt_e_retracted { nullptr };
-        ConfigOptionFloats                 *opt_e_restart_extra { nullptr };
-        ConfigOptionFloats                 *opt_extruded_volume { nullptr };
-        ConfigOptionFloats                 *opt_extruded_weight { nullptr };
-        ConfigOptionFloat                  *opt_extruded_volume_total { nullptr };
-        ConfigOptionFloat                  *opt_extruded_weight_total { nullptr };
-        // Caches of the data passed to the script.
-        size_t                              num_extruders;
-        std::vector<double>                 position;
-        std::vector<double>                 e_position;
-        std::vector<double>                 e_retracted;
-        std::vector<double>                 e_restart_extra;
-    } m_placeholder_parser_integration;
-
-    OozePrevention                      m_ooze_prevention;
-    Wipe                                m_wipe;
-    AvoidCrossingPerimeters             m_avoid_crossing_perimeters;
-    RetractWhenCrossingPerimeters       m_retract_when_crossing_perimeters;
-    bool                                m_enable_loop_clipping;
-    // If enabled, the G-code generator will put following comments at the ends
-    // of the G-code lines: _EXTRUDE_SET_SPEED, _WIPE, _OVERHANG_FAN_START, _OVERHANG_FAN_END
-    // Those comments are received and consumed (removed from the G-code) by the CoolingBuffer.pm Perl module.
-    bool                                m_enable_cooling_markers;
-    
-    bool m_enable_exclude_object;
-    std::vector<size_t> m_label_objects_ids;
     std::string _encode_label_ids_to_base64(std::vector<size_t> ids);
-    // Orca
-    bool m_is_overhang_fan_on;
-    bool m_is_internal_bridge_fan_on; // ORCA: Add support for separate internal bridge fan speed control
-    bool m_is_supp_interface_fan_on;
-    // Markers for the Pressure Equalizer to recognize the extrusion type.
-    // The Pressure Equalizer removes the markers from the final G-code.
-    bool                                m_enable_extrusion_role_markers;
-    // Keeps track of the last extrusion role passed to the processor
-    ExtrusionRole                       m_last_processor_extrusion_role;
-    // How many times will change_layer() be called?
-    // change_layer() will update the progress bar.
-    unsigned int                        m_layer_count;
-    // Progress bar indicator. Increments from -1 up to layer_count.
-    int                                 m_layer_index;
-    // Current layer processed. In sequential printing mode, only a single copy will be printed.
-    // In non-sequential mode, all its copies will be printed.
-    const Layer*                        m_layer;
-    // m_layer is an object layer and it is being printed over raft surface.
-    bool                                m_object_layer_over_raft;
-    //double                              m_volumetric_speed;
-    // Support for the extrusion role markers. Which marker is active?
-    ExtrusionRole                       m_last_extrusion_role;
-    // To ignore gapfill role for retract_lift_enforce
-    ExtrusionRole                       m_last_notgapfill_extrusion_role;
-    // Support for G-Code Processor
-    float                               m_last_height{ 0.0f };
-    float                               m_last_layer_z{ 0.0f };
-    float                               m_max_layer_z{ 0.0f };
-    float                               m_last_width{ 0.0f };
-#if ENABLE_GCODE_VIEWER_DATA_CHECKING
-    double                              m_last_mm3_per_mm;
-#endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
-
-#if !BBL_RELEASE_TO_PUBLIC
-    std::map<std::string, std::vector<std::string>> m_placeholder_error_messages;
-#endif
-
-    Point                               m_last_pos;
-    bool                                m_last_pos_defined;
 
     std::unique_ptr<CoolingBuffer>      m_cooling_buffer;
     std::unique_ptr<SpiralVase>         m_spiral_vase;
@@ -563,34 +637,12 @@ private:
 
     std::unique_ptr<SmallAreaInfillFlowCompensator> m_small_area_infill_flow_compensator;
     
-    // Heights (print_z) at which the skirt has already been extruded.
-    std::vector<coordf_t>               m_skirt_done;
-    // Has the brim been extruded already? Brim is being extruded only for the first object of a multi-object print.
-    bool                                m_brim_done;
-    // Flag indicating whether the nozzle temperature changes from 1st to 2nd layer were performed.
-    bool                                m_second_layer_things_done;
-    // Index of a last object copy extruded.
-    std::pair<const PrintObject*, Point> m_last_obj_copy;
-
-    int m_timelapse_warning_code = 0;
-    bool m_support_traditional_timelapse = true;
-
-    bool m_silent_time_estimator_enabled;
-
     // Processor
     GCodeProcessor m_processor;
 
     //some post-processing on the file, with their data class
     std::unique_ptr<FanMover> m_fan_mover;
 
-    // BBS
-    Print* m_curr_print = nullptr;
-    unsigned int m_toolchange_count;
-    coordf_t m_nominal_z;
-    bool m_need_change_layer_lift_z = false;
-    int m_start_gcode_filament = -1;
-
-    std::set<unsigned int>                  m_initial_layer_extruders;
     // BBS
     int get_bed_temperature(const int extruder_id, const bool is_first_layer, const BedType bed_type) const;
 
@@ -627,6 +679,7 @@ private:
     friend class PressureEqualizer;
     friend class Print;
     friend class SmallAreaInfillFlowCompensator;
+    friend struct GCodeGeneratorCache;
 };
 
 std::vector<const PrintInstance*> sort_object_instances_by_model_order(const Print& print, bool init_order = false);
@@ -7,12 +7,12 @@
 #define ADAPTIVEPAPROCESSOR_H
 
 #include <string>
-#include <sstream>
-#include <regex>
+#include <string_view>
 #include <memory>
 #include <map>
 #include <vector>
 #include "AdaptivePAInterpolator.hpp"
+#include "GCodeLines.hpp"
 
 namespace Slic3r {
 
@@ -28,8 +28,7 @@ public:
      * @brief Constructor for AdaptivePAProcessor.
      *
      * This constructor initializes the AdaptivePAProcessor with a reference to a GCode object.
-     * It also initializes the configuration reference, pressure advance interpolation object,
-     * and regular expression patterns used for processing the G-code.
+     * It also initializes the configuration reference and the pressure advance interpolation objects.
      *
      * @param gcodegen A reference to the GCode object that generates the G-code.
      */
@@ -41,10 +40,10 @@ public:
      * This method processes the G-code for a single layer, identifying the appropriate
      * pressure advance settings and applying them based on the current state and configurations.
      *
-     * @param gcode A string containing the G-code for the layer.
-     * @return A string containing the processed G-code with adaptive pressure advance applied.
+     * @param gcode The lines of the G-code for the layer, edited in place.
+     * @return The lines of the processed G-code with adaptive pressure advance applied.
      */
-    std::string process_layer(std::string &&gcode);
+    GCodeLines process_layer(GCodeLines &&gcode);
     
     /**
      * @brief Manually sets adaptive PA internal value.
@@ -64,9 +63,26 @@ private:
     double m_current_feedrate; ///< Current, latest feedrate.
     int m_last_extruder_id; ///< Last used extruder ID.
 
-    std::regex m_pa_change_pattern; ///< Regular expression to detect PA_CHANGE pattern.
-    std::regex m_g1_f_pattern; ///< Regular expression to detect G1 F pattern.
-    std::smatch m_match; ///< Match results for regular expressions.
+    /**
+     * @brief Fields of a "; PA_CHANGE" tag.
+     */
+    struct PAChange {
+        int extruder_id { 0 };
+        double mm3mm { 0. };
+        unsigned int accel { 0 };
+        int is_bridge { 0 };
+        int role_change { 0 };
+        int is_overhang { 0 };
+    };
+
+    /**
+     * @brief Parses the fields of a "; PA_CHANGE:T<id> MM3MM:<v> ACCEL:<v> BR:<v> RC:<v> OV:<v>" tag.
+     *
+     * @param line A G-code line starting with "; PA_CHANGE".
+     * @param out The parsed fields.
+     * @return True if all the fields were parsed.
+     */
+    static bool parsePAChange(std::string_view line, PAChange &out);
 
     /**
      * @brief Get the PA interpolator attached to the specified tool ID.
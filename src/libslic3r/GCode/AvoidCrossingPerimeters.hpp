@@ -5,6 +5,8 @@
 #include "../ExPolygon.hpp"
 #include "../EdgeGrid.hpp"
 
+#include <memory>
+
 namespace Slic3r {
 
 // Forward declarations.
@@ -23,7 +25,14 @@ public:
     bool        disabled_once() const   { return m_disabled_once; }
     void        reset_once_modifiers()  { m_use_external_mp_once = false; m_disabled_once = false; }
 
+    struct LayerData;
+    // Prepare for the travels of the layer, the boundaries are calculated when the first travel needs them.
     void        init_layer(const Layer &layer);
+    // Prepare for the travels of the layer with data precalculated by make_layer_data(), possibly shared by the instances of an object.
+    void        init_layer(std::shared_ptr<LayerData> layer_data) { assert(layer_data); m_layer_data = std::move(layer_data); }
+    // The data depends on the sliced layers only, thus it may be calculated ahead of the G-code generator on a worker thread.
+    // With boundaries, the boundaries for travels inside and outside of the objects are calculated as well.
+    static std::shared_ptr<LayerData> make_layer_data(const Layer &layer, bool boundaries);
 
     Polyline    travel_to(const GCode& gcodegen, const Point& point)
     {
@@ -50,6 +59,18 @@ public:
         }
     };
 
+    struct LayerData {
+        // Lslices offseted by half an external perimeter width. Used for detection if line or polyline is inside of any polygon.
+        ExPolygons               lslices_offset;
+        std::vector<BoundingBox> lslices_offset_bboxes;
+        // Used for detection of line or polyline is inside of any polygon.
+        EdgeGrid::Grid           grid_lslices_offset;
+        // Store all needed data for travels inside object
+        Boundary                 internal;
+        // Store all needed data for travels outside object
+        Boundary                 external;
+    };
+
 private:
     bool           m_use_external_mp { false };
     // just for the next travel move
@@ -58,15 +79,8 @@ private:
     // we enable it by default for the first travel move in print
     bool           m_disabled_once { true };
 
-    // Lslices offseted by half an external perimeter width. Used for detection if line or polyline is inside of any polygon.
-    ExPolygons               m_lslices_offset;
-    std::vector<BoundingBox> m_lslices_offset_bboxes;
-    // Used for detection of line or polyline is inside of any polygon.
-    EdgeGrid::Grid           m_grid_lslices_offset;
-    // Store all needed data for travels inside object
-    Boundary m_internal;
-    // Store all needed data for travels outside object
-    Boundary m_external;
+    // Data of the current layer, empty boundaries are calculated by travel_to() on demand.
+    std::shared_ptr<LayerData> m_layer_data;
 };
 
 } // namespace Slic3r
@@ -3,7 +3,7 @@
 #include <tbb/parallel_for.h>
 #include <tbb/concurrent_vector.h>
 
-#include <map>
+#include <algorithm>
 #include <functional>
 #include <atomic>
 
@@ -22,9 +22,10 @@ inline IndexPair point_map_grid_index(const Point &pt, int64_t xdist, int64_t yd
 
 inline bool nearly_equal(const Point &p1, const Point &p2) { return std::abs(p1.x() - p2.x()) < SCALED_EPSILON && std::abs(p1.y() - p2.y()) < SCALED_EPSILON; }
 
-inline Grids line_rasterization(const Line &line, int64_t xdist = scale_(1), int64_t ydist = scale_(1))
+// Appends the grid cells crossed by line to res.
+inline void line_rasterization(const Line &line, Grids &res, int64_t xdist = scale_(1), int64_t ydist = scale_(1))
 {
-    Grids     res;
+    const size_t first_idx = res.size();
     Point     rayStart     = line.a;
     Point     rayEnd       = line.b;
     IndexPair currentVoxel = point_map_grid_index(rayStart, xdist, ydist);
@@ -77,13 +78,78 @@ inline Grids line_rasterization(const Line &line, int64_t xdist = scale_(1), int
             ty += tDeltaY;
         }
         res.push_back(currentVoxel);
-        if (res.size() >= 100000) { // bug
+        if (res.size() - first_idx >= 100000) { // bug
             assert(0);
         }
     }
-
-    return res;
 }
+
+// Open addressing hash grid of the cells crossed by the lines of a single layer.
+// Every occupied slot keeps a list of the lines crossing the cell in the order of insertion.
+// The list nodes of all the cells live in a single vector, thus filling the grid does not allocate per cell.
+class LineGrid
+{
+public:
+    // num_cells is an upper bound of the number of distinct cells to be inserted.
+    explicit LineGrid(size_t num_cells)
+    {
+        size_t capacity = 16;
+        while (capacity < num_cells * 2)
+            capacity <<= 1;
+        m_slots.assign(capacity, Slot());
+        m_mask = capacity - 1;
+        m_nodes.reserve(num_cells);
+    }
+
+    // Index of the slot of the cell. An empty slot is claimed for a cell not inserted yet. The slot is occupied
+    // from then on, even before a line is pushed to it, so that the other cells probing past it do not take it over.
+    size_t slot(const IndexPair &cell)
+    {
+        uint64_t h = uint64_t(cell.first) * 0x9E3779B97F4A7C15ull ^ uint64_t(cell.second) * 0xC2B2AE3D27D4EB4Full;
+        for (size_t idx = size_t(h ^ (h >> 29)) & m_mask;; idx = (idx + 1) & m_mask) {
+            Slot &s = m_slots[idx];
+            if (! s.occupied) {
+                s.cell     = cell;
+                s.occupied = true;
+                return idx;
+            }
+            if (s.cell == cell)
+                return idx;
+        }
+    }
+    // First node of the slot, -1 if no line was pushed to the slot yet.
+    int first(size_t slot) const { return m_slots[slot].head; }
+    int next(int node) const { return m_nodes[node].next; }
+    int line(int node) const { return m_nodes[node].line; }
+    void push_back(size_t slot, int line_idx)
+    {
+        Slot &s  = m_slots[slot];
+        int   nd = int(m_nodes.size());
+        m_nodes.push_back({ line_idx, -1 });
+        if (s.head == -1)
+            s.head = nd;
+        else
+            m_nodes[s.tail].next = nd;
+        s.tail = nd;
+    }
+
+private:
+    struct Slot
+    {
+        IndexPair cell     { 0, 0 };
+        bool      occupied { false };
+        int       head     { -1 };
+        int       tail     { -1 };
+    };
+    struct Node
+    {
+        int line;
+        int next;
+    };
+    std::vector<Slot> m_slots;
+    std::vector<Node> m_nodes;
+    size_t            m_mask;
+};
 } // namespace RasterizationImpl
 
 void LinesBucketQueue::emplace_back_bucket(ExtrusionLayers &&els, const void *objPtr, Point offset)
@@ -195,29 +261,104 @@ ObjectExtrusions getAllLayersExtrusionPathsFromObject(PrintObject *obj)
     return oe;
 }
 
-ConflictComputeOpt ConflictChecker::find_inter_of_lines(const LineWithIDs &lines)
+ConflictComputeOpt ConflictChecker::find_inter_of_lines(const LineWithIDs &lines, ConflictComputeResults *all_conflicts)
 {
     using namespace RasterizationImpl;
-    std::map<IndexPair, std::vector<int>> indexToLine;
-
-    for (int i = 0; i < lines.size(); ++i) {
-        const LineWithID &l1      = lines[i];
-        auto              indexes = line_rasterization(l1._line);
-        for (auto index : indexes) {
-            const auto &possibleIntersectIdxs = indexToLine[index];
-            for (auto possibleIntersectIdx : possibleIntersectIdxs) {
-                const LineWithID &l2 = lines[possibleIntersectIdx];
-                if (auto interRes = line_intersect(l1, l2); interRes.has_value()) { return interRes; }
+    if (lines.size() < 2)
+        return {};
+
+    // Rasterize all the lines up front, so that the grid could be sized once.
+    Grids               cells;
+    std::vector<size_t> cells_begin(lines.size() + 1, 0);
+    cells.reserve(lines.size() * 2);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        line_rasterization(lines[i]._line, cells);
+        cells_begin[i + 1] = cells.size();
+    }
+
+    // Bounding boxes and ids of the lines in a structure of arrays, so that the candidates of a line are filtered
+    // by a branch free loop before the exact (and expensive) segment intersection test.
+    std::vector<coord_t>      min_x(lines.size()), min_y(lines.size()), max_x(lines.size()), max_y(lines.size());
+    std::vector<const void *> ids(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const Line &l = lines[i]._line;
+        min_x[i] = std::min(l.a.x(), l.b.x());
+        max_x[i] = std::max(l.a.x(), l.b.x());
+        min_y[i] = std::min(l.a.y(), l.b.y());
+        max_y[i] = std::max(l.a.y(), l.b.y());
+        ids[i]   = lines[i]._id;
+    }
+
+    LineGrid            grid(cells.size());
+    std::vector<size_t> slots;
+    std::vector<int>    candidates;
+    // Index of the last line a line was offered to as a candidate, to test every pair of lines only once.
+    std::vector<int>    tested(lines.size(), -1);
+    ConflictComputeOpt  first;
+    for (int i = 0; i < int(lines.size()); ++i) {
+        slots.clear();
+        candidates.clear();
+        for (size_t c = cells_begin[i]; c < cells_begin[i + 1]; ++c) {
+            size_t slot = grid.slot(cells[c]);
+            slots.push_back(slot);
+            for (int nd = grid.first(slot); nd != -1; nd = grid.next(nd))
+                candidates.push_back(grid.line(nd));
+        }
+
+        const void *id = ids[i];
+        size_t      n  = 0;
+        for (int j : candidates) {
+            bool keep = (ids[j] != id) & (tested[j] != i) &
+                        (min_x[j] <= max_x[i]) & (max_x[j] >= min_x[i]) & (min_y[j] <= max_y[i]) & (max_y[j] >= min_y[i]);
+            tested[j]       = i;
+            candidates[n]   = j;
+            n              += keep;
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            const LineWithID &l2 = lines[candidates[k]];
+            if (all_conflicts != nullptr &&
+                std::any_of(all_conflicts->begin(), all_conflicts->end(), [id, &l2](const ConflictComputeResult &r) {
+                    return (r._obj1 == id && r._obj2 == l2._id) || (r._obj1 == l2._id && r._obj2 == id);
+                }))
+                continue;
+            if (auto interRes = line_intersect(lines[i], l2); interRes.has_value()) {
+                if (all_conflicts == nullptr)
+                    return interRes;
+                all_conflicts->push_back(*interRes);
+                if (! first)
+                    first = interRes;
             }
-            indexToLine[index].push_back(i);
         }
+
+        for (size_t slot : slots)
+            grid.push_back(slot, i);
     }
-    return {};
+    return first;
+}
+
+// Names the conflicting objects, the wipe tower is always reported as the first one.
+static ConflictResult make_conflict_result(const void *ptr1, const void *ptr2, float conflictPrintZ, std::optional<const FakeWipeTower *> wtdptr)
+{
+    if (wtdptr.has_value()) {
+        const FakeWipeTower *wtdp = wtdptr.value();
+        if (ptr1 == wtdp || ptr2 == wtdp) {
+            if (ptr2 == wtdp) { std::swap(ptr1, ptr2); }
+            const PrintObject *obj2 = reinterpret_cast<const PrintObject *>(ptr2);
+            return ConflictResult("WipeTower", obj2->model_object()->name, conflictPrintZ, nullptr, ptr2);
+        }
+    }
+    const PrintObject *obj1 = reinterpret_cast<const PrintObject *>(ptr1);
+    const PrintObject *obj2 = reinterpret_cast<const PrintObject *>(ptr2);
+    return ConflictResult(obj1->model_object()->name, obj2->model_object()->name, conflictPrintZ, ptr1, ptr2);
 }
 
 ConflictResultOpt ConflictChecker::find_inter_of_lines_in_diff_objs(PrintObjectPtrs                      objs,
-                                                                    std::optional<const FakeWipeTower *> wtdptr) // find the first intersection point of lines in different objects
+                                                                    std::optional<const FakeWipeTower *> wtdptr,
+                                                                    ConflictResults                     *all_conflicts) // find the first intersection point of lines in different objects
 {
+    if (all_conflicts != nullptr)
+        all_conflicts->clear();
     if (objs.size() <= 1 && !wtdptr) { return {}; }
     LinesBucketQueue conflictQueue;
 
@@ -249,36 +390,45 @@ ConflictResultOpt ConflictChecker::find_inter_of_lines_in_diff_objs(PrintObjectP
         layersLines.push_back(std::move(lines));
     }
 
-    bool                                                          find = false;
+    if (all_conflicts != nullptr) {
+        std::vector<ConflictComputeResults> layersConflicts(layersLines.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, layersLines.size()), [&](tbb::blocked_range<size_t> range) {
+            for (size_t i = range.begin(); i < range.end(); i++)
+                find_inter_of_lines(layersLines[i], &layersConflicts[i]);
+        });
+        // Merge the per layer pairs into one entry per pair of objects, spanning from the lowest to the highest conflicting layer.
+        for (size_t i = 0; i < layersConflicts.size(); ++i)
+            for (const ConflictComputeResult &res : layersConflicts[i]) {
+                ConflictResult cr = make_conflict_result(res._obj1, res._obj2, bottomZs[i], wtdptr);
+                auto it = std::find_if(all_conflicts->begin(), all_conflicts->end(), [&cr](const ConflictResult &r) {
+                    return (r._obj1 == cr._obj1 && r._obj2 == cr._obj2) || (r._obj1 == cr._obj2 && r._obj2 == cr._obj1);
+                });
+                if (it == all_conflicts->end())
+                    all_conflicts->emplace_back(std::move(cr));
+                else
+                    it->_last_height = cr._height;
+            }
+        if (all_conflicts->empty())
+            return {};
+        return *std::min_element(all_conflicts->begin(), all_conflicts->end(), [](const ConflictResult &l, const ConflictResult &r) { return l._height < r._height; });
+    }
+
     tbb::concurrent_vector<std::pair<ConflictComputeResult, float>> conflict;
     tbb::parallel_for(tbb::blocked_range<size_t>(0, layersLines.size()), [&](tbb::blocked_range<size_t> range) {
         for (size_t i = range.begin(); i < range.end(); i++) {
             auto interRes = find_inter_of_lines(layersLines[i]);
             if (interRes.has_value()) {
-                find = true;
                 conflict.emplace_back(interRes.value(), bottomZs[i]);
                 break;
             }
         }
     });
 
-    if (find) {
-        const void *ptr1           = conflict[0].first._obj1;
-        const void *ptr2           = conflict[0].first._obj2;
-        float       conflictPrintZ = conflict[0].second;
-        if (wtdptr.has_value()) {
-            const FakeWipeTower *wtdp = wtdptr.value();
-            if (ptr1 == wtdp || ptr2 == wtdp) {
-                if (ptr2 == wtdp) { std::swap(ptr1, ptr2); }
-                const PrintObject *obj2 = reinterpret_cast<const PrintObject *>(ptr2);
-                return std::make_optional<ConflictResult>("WipeTower", obj2->model_object()->name, conflictPrintZ, nullptr, ptr2);
-            }
-        }
-        const PrintObject *obj1 = reinterpret_cast<const PrintObject *>(ptr1);
-        const PrintObject *obj2 = reinterpret_cast<const PrintObject *>(ptr2);
-        return std::make_optional<ConflictResult>(obj1->model_object()->name, obj2->model_object()->name, conflictPrintZ, ptr1, ptr2);
-    } else
+    if (conflict.empty())
         return {};
+    // Report the lowest conflict found, independent of the order the ranges were processed in.
+    auto lowest = std::min_element(conflict.begin(), conflict.end(), [](const auto &l, const auto &r) { return l.second < r.second; });
+    return make_conflict_result(lowest->first._obj1, lowest->first._obj2, lowest->second, wtdptr);
 }
 
 ConflictComputeOpt ConflictChecker::line_intersect(const LineWithID &l1, const LineWithID &l2)
@@ -140,10 +140,16 @@ using ConflictComputeOpt = std::optional<ConflictComputeResult>;
 
 using ConflictObjName = std::optional<std::pair<std::string, std::string>>;
 
+using ConflictComputeResults = std::vector<ConflictComputeResult>;
+
 struct ConflictChecker
 {
-    static ConflictResultOpt  find_inter_of_lines_in_diff_objs(PrintObjectPtrs objs, std::optional<const FakeWipeTower *> wtdptr);
-    static ConflictComputeOpt find_inter_of_lines(const LineWithIDs &lines);
+    // Returns the lowest conflict found. If all_conflicts is set, every pair of objects with conflicting paths is reported there
+    // together with the z range of the conflicting layers.
+    static ConflictResultOpt  find_inter_of_lines_in_diff_objs(PrintObjectPtrs objs, std::optional<const FakeWipeTower *> wtdptr, ConflictResults *all_conflicts = nullptr);
+    // Returns the first conflict found. If all_conflicts is set, the search does not stop at the first conflict
+    // and every conflicting pair of objects of this layer is reported there once.
+    static ConflictComputeOpt find_inter_of_lines(const LineWithIDs &lines, ConflictComputeResults *all_conflicts = nullptr);
     static ConflictComputeOpt line_intersect(const LineWithID &l1, const LineWithID &l2);
 };
 
@@ -0,0 +1,205 @@
+#include "ExportProfiler.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <string_view>
+
+#include <boost/container_hash/hash.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <tbb/task_arena.h>
+
+namespace Slic3r {
+
+const char* GCodeExportProfiler::stage_name(Stage stage)
+{
+    switch (stage) {
+    case Stage::Prepare:            return "prepare";
+    case Stage::Generator:          return "generator";
+    case Stage::SpiralVase:         return "spiral_vase";
+    case Stage::PressureEqualizer:  return "pressure_equalizer";
+    case Stage::Cooling:            return "cooling";
+    case Stage::FanMover:           return "fan_mover";
+    case Stage::PAProcessor:        return "pa_processor";
+    case Stage::Output:             return "output";
+    default:                        return "unknown";
+    }
+}
+
+GCodeExportProfiler::Stage GCodeExportProfiler::stage_from_name(const std::string &name)
+{
+    for (int i = 0; i < int(Stage::Count); ++ i)
+        if (name == stage_name(Stage(i)))
+            return Stage(i);
+    return Stage::Count;
+}
+
+void GCodeExportProfiler::set_replay(Stage stage, int num_runs)
+{
+    assert(stage == Stage::SpiralVase || stage == Stage::PressureEqualizer || stage == Stage::Cooling || stage == Stage::FanMover || stage == Stage::PAProcessor);
+    m_replay_stage = stage;
+    m_replay_runs  = std::max(1, num_runs);
+}
+
+void GCodeExportProfiler::begin_pass(size_t max_tokens)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_max_tokens       = max_tokens;
+    m_tokens_in_flight = 0;
+    m_pass_begin       = since_start(Clock::now());
+    m_next_token.fill(0);
+    m_captured_input.clear();
+    m_captured_output_hash = 0;
+    m_occupancy.push_back({ m_pass_begin, 0 });
+}
+
+void GCodeExportProfiler::end_pass()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    this->add_occupancy(Clock::now());
+    m_time_passes += m_occupancy.back().time - m_pass_begin;
+    ++ m_pass;
+}
+
+void GCodeExportProfiler::add_occupancy(Clock::time_point now)
+{
+    // Accumulate the time spent at the previous occupancy.
+    const double time = since_start(now);
+    if (! m_occupancy.empty()) {
+        const Occupancy &last = m_occupancy.back();
+        m_time_weighted_tokens += (time - last.time) * last.tokens;
+        if (last.tokens >= m_max_tokens)
+            m_time_full += time - last.time;
+    }
+    m_occupancy.push_back({ time, m_tokens_in_flight });
+}
+
+void GCodeExportProfiler::token_entered()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    ++ m_tokens_in_flight;
+    this->add_occupancy(Clock::now());
+}
+
+void GCodeExportProfiler::token_left()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    assert(m_tokens_in_flight > 0);
+    -- m_tokens_in_flight;
+    this->add_occupancy(Clock::now());
+}
+
+void GCodeExportProfiler::record(Stage stage, size_t token, Clock::time_point begin, Clock::time_point end, size_t bytes)
+{
+    const int thread = tbb::this_task_arena::current_thread_index();
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    size_t &next_token = m_next_token[size_t(stage)];
+    if (token == size_t(-1))
+        token = next_token;
+    next_token = std::max(next_token, token + 1);
+    const double t = since_start(begin);
+    m_records.push_back({ stage, token, m_pass, t, since_start(end) - t, bytes, thread });
+}
+
+void GCodeExportProfiler::capture_input(const LayerResult &in)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_captured_input.emplace_back(in);
+}
+
+void GCodeExportProfiler::capture_input(const std::string &in)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_captured_input.push_back({ in, m_captured_input.size() });
+}
+
+void GCodeExportProfiler::output_hash(size_t &seed, const std::string &out)
+{
+    boost::hash_combine(seed, std::hash<std::string_view>{}(out));
+}
+
+void GCodeExportProfiler::add_replay(std::vector<double> &&seconds, bool identical)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    size_t bytes = 0;
+    for (const LayerResult &in : m_captured_input)
+        bytes += in.gcode.size();
+    // end_pass() was called already.
+    m_replays.push_back({ m_replay_stage, m_pass - 1, m_captured_input.size(), bytes, std::move(seconds), identical });
+}
+
+nlohmann::json GCodeExportProfiler::chrome_trace() const
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    nlohmann::json events = nlohmann::json::array();
+    // One row per stage, the Prepare stage gets a row per worker thread.
+    auto row = [](const Record &record) { return record.stage == Stage::Prepare ? 100 + std::max(0, record.thread) : int(record.stage); };
+    std::vector<int> rows;
+    for (const Record &record : m_records) {
+        events.push_back({ { "name", stage_name(record.stage) }, { "cat", "gcode_export" }, { "ph", "X" },
+                           { "ts", record.begin }, { "dur", record.duration }, { "pid", 0 }, { "tid", row(record) },
+                           { "args", { { "token", record.token }, { "pass", record.pass }, { "bytes", record.bytes } } } });
+        rows.emplace_back(row(record));
+    }
+    sort_remove_duplicates(rows);
+    for (int tid : rows) {
+        std::string name = tid >= 100 ? std::string(stage_name(Stage::Prepare)) + " " + std::to_string(tid - 100) : stage_name(Stage(tid));
+        events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 0 }, { "tid", tid }, { "args", { { "name", std::move(name) } } } });
+        events.push_back({ { "name", "thread_sort_index" }, { "ph", "M" }, { "pid", 0 }, { "tid", tid }, { "args", { { "sort_index", tid } } } });
+    }
+    for (const Occupancy &occupancy : m_occupancy)
+        events.push_back({ { "name", "tokens_in_flight" }, { "ph", "C" }, { "ts", occupancy.time }, { "pid", 0 }, { "args", { { "tokens", occupancy.tokens } } } });
+    return { { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } };
+}
+
+nlohmann::json GCodeExportProfiler::summary() const
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    struct Totals {
+        size_t count    { 0 };
+        double time     { 0. };
+        double max_time { 0. };
+        size_t bytes    { 0 };
+    };
+    std::array<Totals, size_t(Stage::Count)> totals;
+    for (const Record &record : m_records) {
+        Totals &t = totals[size_t(record.stage)];
+        ++ t.count;
+        t.time    += record.duration;
+        t.max_time = std::max(t.max_time, record.duration);
+        t.bytes   += record.bytes;
+    }
+    nlohmann::json stages = nlohmann::json::array();
+    // The slowest serial stage limits the throughput of the pipeline.
+    Stage bottleneck = Stage::Count;
+    for (int i = 0; i < int(Stage::Count); ++ i)
+        if (const Totals &t = totals[i]; t.count > 0) {
+            stages.push_back({ { "stage", stage_name(Stage(i)) }, { "count", t.count }, { "time_s", t.time * 1e-6 },
+                               { "mean_ms", t.time * 1e-3 / double(t.count) }, { "max_ms", t.max_time * 1e-3 }, { "bytes", t.bytes } });
+            if (Stage(i) != Stage::Prepare && (bottleneck == Stage::Count || t.time > totals[size_t(bottleneck)].time))
+                bottleneck = Stage(i);
+        }
+    nlohmann::json out = {
+        { "passes", m_pass },
+        { "time_s", m_time_passes * 1e-6 },
+        { "max_tokens", m_max_tokens },
+        { "mean_tokens_in_flight", m_time_passes > 0. ? m_time_weighted_tokens / m_time_passes : 0. },
+        { "pipeline_full_fraction", m_time_passes > 0. ? m_time_full / m_time_passes : 0. },
+        { "bottleneck", stage_name(bottleneck) },
+        { "stages", std::move(stages) }
+    };
+    if (! m_replays.empty()) {
+        nlohmann::json replays = nlohmann::json::array();
+        for (const Replay &replay : m_replays)
+            replays.push_back({ { "stage", stage_name(replay.stage) }, { "pass", replay.pass }, { "layers", replay.layers }, { "bytes_in", replay.bytes },
+                                { "runs", replay.seconds.size() }, { "best_s", *std::min_element(replay.seconds.begin(), replay.seconds.end()) },
+                                { "mean_s", std::accumulate(replay.seconds.begin(), replay.seconds.end(), 0.) / double(replay.seconds.size()) },
+                                { "identical", replay.identical } });
+        out["replays"] = std::move(replays);
+    }
+    return out;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,131 @@
+#ifndef slic3r_GCode_ExportProfiler_hpp_
+#define slic3r_GCode_ExportProfiler_hpp_
+
+#include "../libslic3r.h"
+#include "../GCode.hpp"
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Slic3r {
+
+// Instrumentation of the G-code export pipeline of GCode::process_layers().
+// Records the wall time and the bytes produced by every stage for every pipeline token (layer),
+// and the number of tokens in flight. The records are exported as a Chrome trace (chrome://tracing, Perfetto)
+// or summarized per stage.
+// The input of one stage may be captured during the export and replayed through fresh instances of that stage
+// after each pipeline pass, to benchmark a single post-processor on a real G-code stream.
+// Attached to a Print with Print::set_gcode_export_profiler(), the pipeline is not instrumented otherwise.
+class GCodeExportProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Stage : int {
+        Prepare,
+        Generator,
+        SpiralVase,
+        PressureEqualizer,
+        Cooling,
+        FanMover,
+        PAProcessor,
+        Output,
+        Count
+    };
+
+    static const char*  stage_name(Stage stage);
+    // Stage::Count if the name does not match any stage_name().
+    static Stage        stage_from_name(const std::string &name);
+
+    GCodeExportProfiler() : m_start(Clock::now()) {}
+
+    // Capture the input of the stage to replay it num_runs times after each pipeline pass.
+    // Only the post-processors SpiralVase, PressureEqualizer, Cooling, FanMover and PAProcessor may be replayed.
+    void                set_replay(Stage stage, int num_runs);
+    Stage               replay_stage() const { return m_replay_stage; }
+    int                 replay_runs() const { return m_replay_runs; }
+    bool                captures(Stage stage) const { return stage == m_replay_stage; }
+
+    // Called by GCode::process_layers().
+    // A pipeline pass starts, a sequential print runs one pass per object instance.
+    void                begin_pass(size_t max_tokens);
+    void                end_pass();
+    // A token entered the pipeline, resp. its output was written.
+    void                token_entered();
+    void                token_left();
+    // Stage processed a token. If token is -1, the tokens are numbered in the order of their arrival at the stage.
+    void                record(Stage stage, size_t token, Clock::time_point begin, Clock::time_point end, size_t bytes);
+    // Input and output of the captured stage.
+    void                capture_input(const LayerResult &in);
+    void                capture_input(const std::string &in);
+    void                capture_output(const std::string &out) { output_hash(m_captured_output_hash, out); }
+    void                capture_output(const LayerResult &out) { output_hash(m_captured_output_hash, out.gcode); }
+    const std::vector<LayerResult>& captured_input() const { return m_captured_input; }
+    // Replaying the captured input produced the output of the pipeline pass.
+    bool                same_output(size_t hash) const { return hash == m_captured_output_hash; }
+    static void         output_hash(size_t &seed, const std::string &out);
+    void                add_replay(std::vector<double> &&seconds, bool identical);
+
+    // Complete event per stage and token, counter events for the tokens in flight.
+    nlohmann::json      chrome_trace() const;
+    // Per stage totals, occupancy of the pipeline and the replays.
+    nlohmann::json      summary() const;
+
+private:
+    struct Record {
+        Stage               stage;
+        size_t              token;
+        size_t              pass;
+        // Microseconds since construction of the profiler.
+        double              begin;
+        double              duration;
+        size_t              bytes;
+        // TBB arena slot of the thread, the Prepare stage runs in parallel.
+        int                 thread;
+    };
+    struct Occupancy {
+        double              time;
+        size_t              tokens;
+    };
+    struct Replay {
+        Stage               stage;
+        size_t              pass;
+        size_t              layers;
+        size_t              bytes;
+        std::vector<double> seconds;
+        bool                identical;
+    };
+
+    double              since_start(Clock::time_point t) const { return std::chrono::duration<double, std::micro>(t - m_start).count(); }
+    void                add_occupancy(Clock::time_point now);
+
+    const Clock::time_point                 m_start;
+    Stage                                   m_replay_stage { Stage::Count };
+    int                                     m_replay_runs  { 0 };
+
+    mutable std::mutex                      m_mutex;
+    size_t                                  m_pass { 0 };
+    size_t                                  m_max_tokens { 0 };
+    size_t                                  m_tokens_in_flight { 0 };
+    // Microseconds spent by all passes and with all tokens in flight (the input stage waits for the slowest serial stage).
+    double                                  m_pass_begin { 0. };
+    double                                  m_time_passes { 0. };
+    double                                  m_time_full { 0. };
+    double                                  m_time_weighted_tokens { 0. };
+    std::array<size_t, size_t(Stage::Count)> m_next_token {};
+    std::vector<Record>                     m_records;
+    std::vector<Occupancy>                  m_occupancy;
+
+    std::vector<LayerResult>                m_captured_input;
+    size_t                                  m_captured_output_hash { 0 };
+    std::vector<Replay>                     m_replays;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_GCode_ExportProfiler_hpp_
@@ -299,14 +299,30 @@ class ExtrusionQualityEstimator
 public:
     void set_current_object(const PrintObject *object) { current_object = object; }
 
+    // AABB trees of a single object layer. They depend on the layer only, thus they may be built ahead on another thread.
+    struct LayerDistancers
+    {
+        AABBTreeLines::LinesDistancer<Linef>      boundaries;
+        AABBTreeLines::LinesDistancer<CurledLine> curled_extrusions;
+    };
+
+    static LayerDistancers build_layer_distancers(const Layer &layer)
+    {
+        return { AABBTreeLines::LinesDistancer<Linef>{to_unscaled_linesf(layer.lslices)}, AABBTreeLines::LinesDistancer<CurledLine>{layer.curled_lines} };
+    }
+
+    void prepare_for_new_layer(const PrintObject *object, LayerDistancers &&distancers)
+    {
+        prev_layer_boundaries[object] = std::move(next_layer_boundaries[object]);
+        next_layer_boundaries[object] = std::move(distancers.boundaries);
+        prev_curled_extrusions[object] = std::move(next_curled_extrusions[object]);
+        next_curled_extrusions[object] = std::move(distancers.curled_extrusions);
+    }
+
     void prepare_for_new_layer(const PrintObject * obj, const Layer *layer)
     {
         if (layer == nullptr) return;
-        const PrintObject *object = obj;
-        prev_layer_boundaries[object] = next_layer_boundaries[object];
-        next_layer_boundaries[object] = AABBTreeLines::LinesDistancer<Linef>{to_unscaled_linesf(layer->lslices)};
-        prev_curled_extrusions[object] = next_curled_extrusions[object];
-        next_curled_extrusions[object] = AABBTreeLines::LinesDistancer<CurledLine>{layer->curled_lines};
+        this->prepare_for_new_layer(obj, build_layer_distancers(*layer));
     }
 
     std::vector<ProcessedPoint> estimate_extrusion_quality(const ExtrusionPath                &path,
@@ -19,9 +19,9 @@
 
 namespace Slic3r {
 
-const std::string& FanMover::process_gcode(const std::string& gcode, bool flush)
+GCodeLines FanMover::process_gcode(const std::string& gcode, bool flush)
 {
-    m_process_output = "";
+    m_process_output = GCodeLines();
 
     // recompute buffer time to recover from rounding
     m_buffer_time_size = 0;
@@ -33,12 +33,12 @@ const std::string& FanMover::process_gcode(const std::string& gcode, bool flush)
 
     if (flush) {
         while (!m_buffer.empty()) {
-            m_process_output += m_buffer.front().raw + "\n";
+            m_process_output.append_line(m_buffer.front().raw);
             remove_from_buffer(m_buffer.begin());
         }
     }
 
-    return m_process_output;
+    return std::move(m_process_output);
 }
 
 bool is_end_of_word(char c) {
@@ -167,13 +167,13 @@ void FanMover::_put_in_middle_G1(std::list<BufferData>::iterator item_to_split,
 void FanMover::_print_in_middle_G1(BufferData& line_to_split, float nb_sec, const std::string &line_to_write) {
     if (nb_sec < line_to_split.time * 0.1) {
         // doesn't really need to be split, print it after
-        m_process_output += line_to_split.raw + "\n";
-        m_process_output += line_to_write + (line_to_write.back() == '\n'?"":"\n");
+        m_process_output.append_line(line_to_split.raw);
+        m_process_output.append(line_to_write);
     } else if (nb_sec > line_to_split.time * 0.9) {
         // doesn't really need to be split, print it before
         //will also print before if line_to_split.time == 0
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
+        m_process_output.append(line_to_write);
+        m_process_output.append_line(line_to_split.raw);
     }else if(line_to_split.raw.size() > 2
         && line_to_split.raw[0] == 'G' && line_to_split.raw[1] == '1' && line_to_split.raw[2] == ' ') {
         float percent = nb_sec / line_to_split.time;
@@ -196,14 +196,14 @@ void FanMover::_print_in_middle_G1(BufferData& line_to_split, float nb_sec, cons
                 change_axis_value(before, 'E', line_to_split.e + line_to_split.de * percent, 5);
             }
         }
-        m_process_output += before + "\n";
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
+        m_process_output.append_line(before);
+        m_process_output.append(line_to_write);
+        m_process_output.append_line(line_to_split.raw);
 
     } else {
         //not a G1, print it before
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
+        m_process_output.append(line_to_write);
+        m_process_output.append_line(line_to_split.raw);
     }
 }
 
@@ -330,7 +330,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     _print_in_middle_G1(m_buffer.front(), m_buffer_time_size - nb_seconds_delay, _set_fan(100));//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                                     remove_from_buffer(m_buffer.begin());
                                 } else {
-                                    m_process_output += _set_fan(100);//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
+                                    m_process_output.append(_set_fan(100));//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                                 }
                                 //write it in the queue if possible
                                 const float kickstart_duration = kickstart * float(fan_speed - m_front_buffer_fan_speed) / 100.f;
@@ -361,7 +361,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     _print_in_middle_G1(m_buffer.front(), m_buffer_time_size - nb_seconds_delay, line.raw());
                                     remove_from_buffer(m_buffer.begin());
                                 } else {
-                                    m_process_output += line.raw() + "\n";
+                                    m_process_output.append_line(line.raw());
                                 }
                                 m_front_buffer_fan_speed = fan_speed;
                             }
@@ -489,11 +489,11 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
             if (frontdata.fan_speed < 0 || frontdata.fan_speed != m_front_buffer_fan_speed || frontdata.is_kickstart) {
                 if (frontdata.is_kickstart && frontdata.fan_speed < m_front_buffer_fan_speed) {
                     //you have to slow down! not kickstart! rewrite the fan speed.
-                    m_process_output += _set_fan(frontdata.fan_speed);//m_writer.set_fan(frontdata.fan_speed,true); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
+                    m_process_output.append(_set_fan(frontdata.fan_speed));//m_writer.set_fan(frontdata.fan_speed,true); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                         
                     m_front_buffer_fan_speed = frontdata.fan_speed;
                 } else {
-                    m_process_output += frontdata.raw + "\n";
+                    m_process_output.append_line(frontdata.raw);
                     if (frontdata.fan_speed >= 0) {
                         //note that this is the only place where the fan_speed is set and we print from the buffer, as if the fan_speed >= 0 => time == 0
                         //and as this flush all time == 0 lines from the back of the queue...
@@ -9,6 +9,7 @@
 #include "../Point.hpp"
 #include "../GCodeReader.hpp"
 #include "../GCodeWriter.hpp"
+#include "GCodeLines.hpp"
 #include <regex>
 
 namespace Slic3r {
@@ -57,7 +58,7 @@ private:
     double m_buffer_time_size = 0;
 
     // The output of process_layer()
-    std::string m_process_output;
+    GCodeLines m_process_output;
 
 public:
     FanMover(const GCodeWriter& writer, const float nb_seconds_delay, const bool with_D_option, const bool relative_e,
@@ -69,8 +70,9 @@ public:
         m_parser.apply_config(writer.config);
     }
 
-    // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes
-    const std::string& process_gcode(const std::string& gcode, bool flush);
+    // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes,
+    // split into lines for the stages following the FanMover.
+    GCodeLines process_gcode(const std::string& gcode, bool flush);
 
 private:
     BufferData& put_in_buffer(BufferData&& data) {
@@ -0,0 +1,114 @@
+#include "GCodeLines.hpp"
+
+#include <limits>
+
+#include <fast_float/fast_float.h>
+
+namespace Slic3r {
+
+static GCodeLines::Line classify_line(std::string_view text, size_t begin)
+{
+    using Flag = GCodeLines::LineFlag;
+    auto starts_with = [text](std::string_view prefix) { return text.substr(0, prefix.size()) == prefix; };
+    auto contains    = [text](std::string_view str) { return text.find(str) != std::string_view::npos; };
+
+    GCodeLines::Line line;
+    line.begin  = uint32_t(begin);
+    line.length = uint32_t(text.size());
+    if (starts_with("G1 ")) {
+        line.flags |= Flag::G1;
+        if (contains("X"))
+            line.flags |= Flag::HasX;
+        if (contains("Y"))
+            line.flags |= Flag::HasY;
+        if (contains("E"))
+            line.flags |= Flag::HasE;
+        if (starts_with("G1 F")) {
+            line.flags |= Flag::Feedrate;
+            // Leading spaces of the value are skipped, as by strtod().
+            size_t pos = text.find_first_not_of(' ', 4);
+            if (pos == std::string_view::npos ||
+                fast_float::from_chars(text.data() + pos, text.data() + text.size(), line.feedrate).ptr == text.data() + pos)
+                line.feedrate = std::numeric_limits<double>::quiet_NaN();
+        }
+    } else if (starts_with("; PA_CHANGE"))
+        line.flags |= Flag::PAChange;
+    if (contains("WIPE")) {
+        line.flags |= Flag::Wipe;
+        if (contains("WIPE_START"))
+            line.flags |= Flag::WipeStart;
+        if (contains("WIPE_END"))
+            line.flags |= Flag::WipeEnd;
+    }
+    return line;
+}
+
+GCodeLines::GCodeLines(std::string &&gcode) : m_buffer(std::move(gcode)), m_unchanged(true)
+{
+    m_lines.reserve(m_buffer.size() / 24);
+    for (size_t pos = 0; pos < m_buffer.size();) {
+        size_t eol = m_buffer.find('\n', pos);
+        if (eol == std::string::npos)
+            eol = m_buffer.size();
+        m_lines.emplace_back(classify_line(std::string_view(m_buffer.data() + pos, eol - pos), pos));
+        pos = eol + 1;
+    }
+}
+
+void GCodeLines::add_lines(std::vector<Line> &lines, std::string_view gcode, bool terminate)
+{
+    if (gcode.data() >= m_buffer.data() && gcode.data() < m_buffer.data() + m_buffer.size()) {
+        // The text is a part of the buffer, which may be reallocated by appending to it.
+        std::string copy(gcode);
+        this->add_lines(lines, copy, terminate);
+        return;
+    }
+    m_unchanged = false;
+    for (size_t pos = 0; pos < gcode.size() || (terminate && pos == gcode.size());) {
+        size_t eol = gcode.find('\n', pos);
+        if (eol == std::string_view::npos)
+            eol = gcode.size();
+        size_t begin = m_buffer.size();
+        m_buffer.append(gcode.data() + pos, eol - pos);
+        lines.emplace_back(classify_line(std::string_view(m_buffer.data() + begin, eol - pos), begin));
+        if (eol == gcode.size())
+            break;
+        pos = eol + 1;
+    }
+}
+
+void GCodeLines::set_lines(std::vector<Line> &&lines)
+{
+    m_lines     = std::move(lines);
+    m_unchanged = false;
+}
+
+size_t GCodeLines::text_size() const
+{
+    if (m_unchanged)
+        return m_buffer.size();
+    size_t size = 0;
+    for (const Line &line : m_lines)
+        size += line.length + 1;
+    return size;
+}
+
+std::string GCodeLines::release()
+{
+    std::string out;
+    if (m_unchanged)
+        out = std::move(m_buffer);
+    else {
+        out.reserve(this->text_size());
+        for (const Line &line : m_lines) {
+            out.append(m_buffer.data() + line.begin, line.length);
+            out += '\n';
+        }
+    }
+    m_buffer.clear();
+    m_lines.clear();
+    m_unchanged = false;
+    return out;
+}
+
+} // namespace Slic3r
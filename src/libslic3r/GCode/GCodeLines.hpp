@@ -0,0 +1,87 @@
+#ifndef slic3r_GCode_GCodeLines_hpp_
+#define slic3r_GCode_GCodeLines_hpp_
+
+#include "../libslic3r.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Slic3r {
+
+// G-code of a single layer split into lines, passed between the post-processing stages of GCode::process_layers()
+// following the CoolingBuffer (FanMover, AdaptivePAProcessor), so that each stage does not split and re-parse
+// the text of the layer again and the text is joined once by the output stage.
+// The text of the lines is stored in a single buffer, the lines address it by offsets. A stage edits the layer
+// by building a new line table from the lines kept and the lines added to the buffer, see set_lines().
+// Each line is classified once when it is added: the moves, the feedrate changes and the tags the stages look for.
+//FIXME This is a line table over text, not a binary move representation: the lines keep their text and the moves
+// are classified, not decoded. SpiralVase, PressureEqualizer and CoolingBuffer still take and return the text of
+// the layer and parse it on their own, sharing one representation by all the stages is still to be done.
+class GCodeLines
+{
+public:
+    enum LineFlag : uint16_t {
+        // "G1 " move.
+        G1          = 1 << 0,
+        // G1 move containing the letter X, Y, E.
+        HasX        = 1 << 1,
+        HasY        = 1 << 2,
+        HasE        = 1 << 3,
+        // "G1 F<feedrate>" feedrate change, the feedrate is stored in Line::feedrate.
+        Feedrate    = 1 << 4,
+        // "; PA_CHANGE" tag of the adaptive pressure advance.
+        PAChange    = 1 << 5,
+        // The line contains "WIPE", "WIPE_START", "WIPE_END".
+        Wipe        = 1 << 6,
+        WipeStart   = 1 << 7,
+        WipeEnd     = 1 << 8,
+    };
+
+    struct Line {
+        uint32_t    begin    { 0 };
+        uint32_t    length   { 0 };
+        uint16_t    flags    { 0 };
+        // mm/min, set with LineFlag::Feedrate, NaN if the value could not be parsed.
+        double      feedrate { 0. };
+
+        bool        has(uint16_t flag) const { return (flags & flag) != 0; }
+        bool        extrusion() const { return (flags & (G1 | HasX | HasY | HasE)) == (G1 | HasX | HasY | HasE); }
+        bool        travel() const { return (flags & (G1 | HasX | HasY | HasE)) == (G1 | HasX | HasY); }
+    };
+
+    GCodeLines() = default;
+    // Takes over the text of a layer and splits it into lines.
+    explicit GCodeLines(std::string &&gcode);
+
+    const std::vector<Line>&    lines() const { return m_lines; }
+    size_t                      size() const { return m_lines.size(); }
+    bool                        empty() const { return m_lines.empty(); }
+    std::string_view            text(const Line &line) const { return { m_buffer.data() + line.begin, line.length }; }
+    std::string_view            operator[](size_t idx) const { return this->text(m_lines[idx]); }
+
+    // Append text, its last line is terminated by a newline if it is not terminated already.
+    void                        append(std::string_view gcode) { this->add_lines(m_lines, gcode, false); }
+    // Append text followed by a newline. An empty text adds an empty line.
+    void                        append_line(std::string_view gcode) { this->add_lines(m_lines, gcode, true); }
+    // Add the lines of gcode to the buffer and their descriptors to lines, which replace the line table with set_lines().
+    void                        add_lines(std::vector<Line> &lines, std::string_view gcode, bool terminate);
+    void                        set_lines(std::vector<Line> &&lines);
+
+    // Size of the text joined by release().
+    size_t                      text_size() const;
+    // Join the lines into the G-code text of the layer. The text passed to the constructor is returned as is
+    // if the lines were not edited.
+    std::string                 release();
+
+private:
+    std::string                 m_buffer;
+    std::vector<Line>           m_lines;
+    // The lines are the text passed to the constructor, which is stored in m_buffer.
+    bool                        m_unchanged { false };
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_GCode_GCodeLines_hpp_
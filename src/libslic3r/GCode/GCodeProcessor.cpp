@@ -14,6 +14,7 @@
 #include <boost/nowide/fstream.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
 
 #include <fast_float/fast_float.h>
 
@@ -43,6 +44,8 @@ static const float DEFAULT_RETRACT_ACCELERATION = 1500.0f; // Prusa Firmware 1_7
 static const float DEFAULT_TRAVEL_ACCELERATION = 1250.0f;
 
 static const size_t MIN_EXTRUDERS_COUNT = 5;
+// Width of the lines of the slots reserved for single pass finalization, including the line end.
+static const size_t TIME_SLOT_LINE_WIDTH = 32;
 static const float DEFAULT_FILAMENT_DIAMETER = 1.75f;
 static const int   DEFAULT_FILAMENT_HRC = 0;
 static const float DEFAULT_FILAMENT_DENSITY = 1.245f;
@@ -70,7 +73,8 @@ const std::vector<std::string> GCodeProcessor::Reserved_Tags = {
     "_DURING_PRINT_EXHAUST_FAN",
     " WIPE_TOWER_START",
     " WIPE_TOWER_END",
-    " PA_CHANGE:"
+    " PA_CHANGE:",
+    "_GP_LAYER_M73_SLOT"
 };
 
 const std::vector<std::string> GCodeProcessor::Reserved_Tags_compatible = {
@@ -91,7 +95,8 @@ const std::vector<std::string> GCodeProcessor::Reserved_Tags_compatible = {
     "_DURING_PRINT_EXHAUST_FAN",
     " WIPE_TOWER_START",
     " WIPE_TOWER_END",
-    " PA_CHANGE:"
+    " PA_CHANGE:",
+    "_GP_LAYER_M73_SLOT"
 };
 
 
@@ -554,6 +559,7 @@ void GCodeProcessorResult::reset() {
     lock();
 
     moves.clear();
+    interpolation_points_pool.clear();
     lines_ends.clear();
     printable_area = Pointfs();
     //BBS: add bed exclude area
@@ -1089,6 +1095,132 @@ void GCodeProcessor::enable_stealth_time_estimator(bool enabled)
     m_time_processor.machines[static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Stealth)].enabled = enabled;
 }
 
+void GCodeProcessor::enable_single_pass_finalization(bool enabled)
+{
+    // The preheat lines M104 are inserted ahead of the tool changes, which shifts the lines of the whole G-code.
+    m_single_pass_finalization = enabled && ! m_result.backtrace_enabled;
+    if (enabled && m_result.backtrace_enabled)
+        BOOST_LOG_TRIVIAL(info) << "Single pass G-code finalization is not available with the preheat of the next tool, the G-code will be post-processed";
+}
+
+unsigned int GCodeProcessor::time_slot_lines(ETags tag) const
+{
+    if (tag == ETags::Total_Layer_Number_Placeholder)
+        return 1;
+    // Remaining time and time to the next stop for each time estimator.
+    unsigned int num_lines = 0;
+    for (const TimeMachine& machine : m_time_processor.machines)
+        if (machine.enabled)
+            num_lines += 2;
+    return std::max(num_lines, 1u);
+}
+
+std::string GCodeProcessor::time_slot(ETags tag) const
+{
+    assert(tag == ETags::First_Line_M73_Placeholder || tag == ETags::Total_Layer_Number_Placeholder || tag == ETags::Layer_M73_Slot);
+    if (! m_single_pass_finalization)
+        return tag == ETags::Layer_M73_Slot ? std::string() : ";" + reserved_tag(tag) + "\n";
+    if (tag == ETags::Layer_M73_Slot && m_disable_m73)
+        return std::string();
+
+    // The tag followed by empty comments, all lines padded with spaces to the fixed width.
+    std::string out;
+    const unsigned int num_lines = time_slot_lines(tag);
+    for (unsigned int i = 0; i < num_lines; ++i) {
+        std::string line = (i == 0) ? ";" + reserved_tag(tag) : std::string(";");
+        line.resize(std::max(line.size(), TIME_SLOT_LINE_WIDTH - 1), ' ');
+        out += line;
+        out += '\n';
+    }
+    return out;
+}
+
+std::vector<std::string> GCodeProcessor::time_slot_values(const TimeSlot& slot) const
+{
+    std::vector<std::string> out;
+    if (slot.tag == ETags::Total_Layer_Number_Placeholder) {
+        out.emplace_back("; total layer number: " + std::to_string(m_layer_id));
+        return out;
+    }
+    if (m_disable_m73)
+        return out;
+
+    auto time_in_minutes = [](float time_in_seconds) {
+        return int((std::max(time_in_seconds, 0.f) + 0.5f) / 60.0f);
+    };
+    auto format_line_M73 = [&out](const std::string& mask, int value1, int value2) {
+        char line_M73[64];
+        // The stop mask has a single parameter.
+        sprintf(line_M73, mask.c_str(), std::to_string(value1).c_str(), std::to_string(value2).c_str());
+        out.emplace_back(line_M73);
+        if (! out.back().empty() && out.back().back() == '\n')
+            out.back().pop_back();
+    };
+
+    for (const TimeMachine& machine : m_time_processor.machines) {
+        if (! machine.enabled)
+            continue;
+        float elapsed_time = 0.0f;
+        if (slot.tag == ETags::Layer_M73_Slot) {
+            // Time at the end of the last move before the slot.
+            auto it = std::upper_bound(machine.g1_times_cache.begin(), machine.g1_times_cache.end(), slot.g1_line_id,
+                [](unsigned int id, const TimeMachine::G1LinesCacheItem& item) { return id < item.id; });
+            if (it != machine.g1_times_cache.begin())
+                elapsed_time = std::prev(it)->elapsed_time;
+        }
+        // pair <percent, remaining time>
+        format_line_M73(machine.line_m73_main_mask, machine.time > 0.0f ? int(100.0f * elapsed_time / machine.time) : 0, time_in_minutes(machine.time - elapsed_time));
+        // remaining time to next printer stop
+        auto it_stop = std::upper_bound(machine.stop_times.begin(), machine.stop_times.end(), elapsed_time,
+            [](float value, const TimeMachine::StopTime& t) { return value < t.elapsed_time; });
+        if (it_stop != machine.stop_times.end())
+            format_line_M73(machine.line_m73_stop_mask, time_in_minutes(it_stop->elapsed_time - elapsed_time), 0);
+    }
+    return out;
+}
+
+void GCodeProcessor::fill_time_slots()
+{
+    boost::nowide::fstream out(m_result.filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (! out)
+        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for writing.\n"));
+
+    const std::vector<size_t>& lines_ends = m_result.lines_ends;
+    auto line_begin = [&lines_ends](unsigned int line_id) { return line_id > 1 ? lines_ends[line_id - 2] : size_t(0); };
+    std::string text;
+    for (const TimeSlot& slot : m_time_slots) {
+        if (slot.line_id + slot.num_lines - 1 > lines_ends.size()) {
+            assert(false);
+            continue;
+        }
+        const std::vector<std::string> values = time_slot_values(slot);
+        // Keep the width of every line of the slot, the lines ends were exported already.
+        text.clear();
+        bool fits = true;
+        for (unsigned int i = 0; i < slot.num_lines && fits; ++i) {
+            const unsigned int line_id = slot.line_id + i;
+            const size_t       width   = lines_ends[line_id - 1] - line_begin(line_id);
+            const std::string  value   = i < values.size() ? values[i] : std::string(";");
+            fits = value.size() < width;
+            if (fits) {
+                text += value;
+                text.append(width - 1 - value.size(), ' ');
+                text += '\n';
+            }
+        }
+        if (! fits) {
+            // Some G-code post-processor did not keep the slot intact.
+            BOOST_LOG_TRIVIAL(error) << "GCodeProcessor: the slot " << reserved_tag(slot.tag) << " at line " << slot.line_id << " was modified, it is left unfilled";
+            continue;
+        }
+        out.seekp(std::streamoff(line_begin(slot.line_id)));
+        out.write(text.data(), std::streamsize(text.size()));
+    }
+    out.close();
+    if (out.fail())
+        throw Slic3r::RuntimeError("GCode processor post process export failed.\nIs the disk full?");
+}
+
 void GCodeProcessor::reset()
 {
     m_units = EUnits::Millimeters;
@@ -1160,6 +1292,12 @@ void GCodeProcessor::reset()
     m_preheat_time = 0.f;
     m_preheat_steps = 1;
 
+    m_single_pass_finalization = false;
+    m_time_slots.clear();
+    m_processed_bytes = 0;
+    m_footer_line_id = 0;
+    m_footer_g1_line_id = 0;
+
 #if ENABLE_GCODE_VIEWER_DATA_CHECKING
     m_mm3_per_mm_compare.reset();
     m_height_compare.reset();
@@ -1255,9 +1393,21 @@ void GCodeProcessor::initialize(const std::string& filename)
     m_result.moves.emplace_back(GCodeProcessorResult::MoveVertex());
 }
 
-void GCodeProcessor::process_buffer(const std::string &buffer)
+static void update_lines_ends_and_out_file_pos(const std::string_view out_string, std::vector<size_t>& lines_ends, size_t* out_file_pos)
+{
+    for (size_t i = 0; i < out_string.size(); ++i) {
+        if (out_string[i] == '\n')
+            lines_ends.emplace_back((out_file_pos != nullptr) ? *out_file_pos + i + 1 : i + 1);
+    }
+    if (out_file_pos != nullptr)
+        *out_file_pos += out_string.size();
+}
+
+void GCodeProcessor::process_buffer(std::string_view buffer)
 {
-    //FIXME maybe cache GCodeLine gline to be over multiple parse_buffer() invocations.
+    if (m_single_pass_finalization)
+        // The streamed G-code is final except for the content of the slots and of the footer.
+        update_lines_ends_and_out_file_pos(buffer, m_result.lines_ends, &m_processed_bytes);
     m_parser.parse_buffer(buffer, [this](GCodeReader&, const GCodeReader::GCodeLine& line) { 
         this->process_gcode_line(line, false);
     });
@@ -1312,8 +1462,11 @@ void GCodeProcessor::finalize(bool post_process)
     //BBS: update slice warning
     update_slice_warnings();
 
-    if (post_process)
+    if (post_process) {
+        if (m_single_pass_finalization)
+            fill_time_slots();
         run_post_process();
+    }
 }
 
 float GCodeProcessor::get_time(PrintEstimatedStatistics::ETimeMode mode) const
@@ -1860,6 +2013,21 @@ void GCodeProcessor::process_tags(const std::string_view comment, bool producers
     if (producers_enabled && process_producers_tags(comment))
         return;
 
+    if (m_single_pass_finalization) {
+        // slots reserved by time_slot(), filled in by fill_time_slots()
+        for (ETags tag : { ETags::Layer_M73_Slot, ETags::First_Line_M73_Placeholder, ETags::Total_Layer_Number_Placeholder })
+            if (boost::starts_with(comment, reserved_tag(tag))) {
+                m_time_slots.push_back({ tag, m_line_id, time_slot_lines(tag), m_g1_line_id });
+                return;
+            }
+        // the footer, post-processed by run_post_process()
+        if (boost::starts_with(comment, reserved_tag(ETags::Last_Line_M73_Placeholder))) {
+            m_footer_line_id    = m_line_id;
+            m_footer_g1_line_id = m_g1_line_id;
+            return;
+        }
+    }
+
     // extrusion role tag
     if (boost::starts_with(comment, reserved_tag(ETags::Role))) {
         set_extrusion_role(ExtrusionEntity::string_to_role(comment.substr(reserved_tag(ETags::Role).length())));
@@ -3997,14 +4165,27 @@ void GCodeProcessor::process_T(const std::string_view command)
         }
     }
 }
-static void update_lines_ends_and_out_file_pos(const std::string& out_string, std::vector<size_t>& lines_ends, size_t* out_file_pos)
+// Replace the content of the file path starting at offset by the content of the file tail_path, which is removed.
+static void replace_file_tail(const std::string& path, size_t offset, const std::string& tail_path)
 {
-    for (size_t i = 0; i < out_string.size(); ++i) {
-        if (out_string[i] == '\n')
-            lines_ends.emplace_back((out_file_pos != nullptr) ? *out_file_pos + i + 1 : i + 1);
-    }
-    if (out_file_pos != nullptr)
-        *out_file_pos += out_string.size();
+    std::string tail;
+    {
+        boost::nowide::ifstream in(tail_path, std::ios::binary);
+        tail.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (in.bad())
+            throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nError while reading from file.\n"));
+    }
+    boost::nowide::remove(tail_path.c_str());
+
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(path, offset, ec);
+    if (ec)
+        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot truncate file ") + path + ": " + ec.message() + "\n");
+    boost::nowide::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write(tail.data(), std::streamsize(tail.size()));
+    out.close();
+    if (out.fail())
+        throw Slic3r::RuntimeError("GCode processor post process export failed.\nIs the disk full?");
 }
 
 void GCodeProcessor::run_post_process()
@@ -4013,6 +4194,20 @@ void GCodeProcessor::run_post_process()
     if (in.f == nullptr)
         throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for reading.\n"));
 
+    // With single pass finalization the G-code is final up to the footer, only the footer is post-processed and replaced.
+    unsigned int first_line_id = 1;
+    size_t       first_offset  = 0;
+    if (m_single_pass_finalization) {
+        first_line_id = m_footer_line_id > 0 ? m_footer_line_id : (unsigned int)m_result.lines_ends.size() + 1;
+        first_offset  = first_line_id > 1 ? m_result.lines_ends[first_line_id - 2] : 0;
+#ifdef _WIN32
+        if (::_fseeki64(in.f, __int64(first_offset), SEEK_SET) != 0)
+#else
+        if (::fseeko(in.f, off_t(first_offset), SEEK_SET) != 0)
+#endif
+            throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nError while reading from file.\n"));
+    }
+
     // temporary file to contain modified gcode
     std::string out_path = m_result.filename + ".postprocess";
     FilePtr out{ boost::nowide::fopen(out_path.c_str(), "wb") };
@@ -4079,7 +4274,7 @@ void GCodeProcessor::run_post_process()
     };
 
     std::string gcode_line;
-    size_t g1_lines_counter = 0;
+    size_t g1_lines_counter = m_single_pass_finalization ? m_footer_g1_line_id : 0;
     // keeps track of last exported pair <percent, remaining time>
     std::array<std::pair<int, int>, static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count)> last_exported_main;
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
@@ -4362,6 +4557,12 @@ void GCodeProcessor::run_post_process()
 
         size_t get_size() const { return m_size; }
 
+        // the first lines_counter lines, ending at out_file_pos, are not post-processed
+        void set_start(size_t lines_counter, size_t out_file_pos) {
+            m_added_lines_counter = lines_counter;
+            m_out_file_pos = out_file_pos;
+        }
+
     private:
         void write_to_file(FilePtr& out, const std::string& out_string, GCodeProcessorResult& result, const std::string& out_path) {
             if (!out_string.empty()) {
@@ -4379,6 +4580,7 @@ void GCodeProcessor::run_post_process()
 
     ExportLines export_lines(m_result.backtrace_enabled ? ExportLines::EWriteType::ByTime : ExportLines::EWriteType::BySize,
         m_time_processor.machines);
+    export_lines.set_start(first_line_id - 1, first_offset);
 
     // replace placeholder lines with the proper final value
     // gcode_line is in/out parameter, to reduce expensive memory allocation
@@ -4639,10 +4841,10 @@ void GCodeProcessor::run_post_process()
         }
     };
 
-    m_result.lines_ends.clear();
+    m_result.lines_ends.resize(first_line_id - 1);
     // m_result.lines_ends.emplace_back(std::vector<size_t>());
 
-    unsigned int line_id = 0;
+    unsigned int line_id = first_line_id - 1;
     // Backtrace data for Tx gcode lines
     const ExportLines::Backtrace backtrace_T = { m_preheat_time, m_preheat_steps };
     // In case there are multiple sources of backtracing, keeps track of the longest backtrack time needed
@@ -4732,6 +4934,10 @@ void GCodeProcessor::run_post_process()
     const std::string result_filename = m_result.filename;
     export_lines.synchronize_moves(m_result);
 
+    if (m_single_pass_finalization) {
+        replace_file_tail(result_filename, first_offset, out_path);
+        return;
+    }
     if (rename_file(out_path, result_filename))
         throw Slic3r::RuntimeError(std::string("Failed to rename the output G-code file from ") + out_path + " to " + result_filename + '\n' +
             "Is " + out_path + " locked?" + '\n');
@@ -4744,14 +4950,18 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
         ((type == EMoveType::Seam) ? m_last_line_id : m_line_id);
 
     //BBS: apply plate's and extruder's offset to arc interpolation points
+    unsigned int interpolation_points_offset = 0;
+    unsigned int interpolation_points_count  = 0;
     if (path_type == EMovePathType::Arc_move_cw ||
         path_type == EMovePathType::Arc_move_ccw) {
+        interpolation_points_offset = static_cast<unsigned int>(m_result.interpolation_points_pool.size());
+        interpolation_points_count  = static_cast<unsigned int>(m_interpolation_points.size());
         for (size_t i = 0; i < m_interpolation_points.size(); i++)
-            m_interpolation_points[i] =
+            m_result.interpolation_points_pool.emplace_back(
                 Vec3f(m_interpolation_points[i].x() + m_x_offset,
                       m_interpolation_points[i].y() + m_y_offset,
                       m_processing_start_custom_gcode ? m_first_layer_height : m_interpolation_points[i].z()) +
-                m_extruder_offsets[m_extruder_id];
+                m_extruder_offsets[m_extruder_id]);
     }
 
     m_result.moves.push_back({
@@ -4760,6 +4970,8 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
         m_extrusion_role,
         m_extruder_id,
         m_cp_color.current,
+        //BBS: add arc move related data
+        path_type,
         //BBS: add plate's offset to the rendering vertices
         Vec3f(m_end_position[X] + m_x_offset, m_end_position[Y] + m_y_offset, m_processing_start_custom_gcode ? m_first_layer_height : m_end_position[Z]- m_z_offset) + m_extruder_offsets[m_extruder_id],
         static_cast<float>(m_end_position[E] - m_start_position[E]),
@@ -4771,10 +4983,8 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
         m_extruder_temps[m_extruder_id],
         static_cast<float>(m_result.moves.size()),
         static_cast<float>(m_layer_id), //layer_duration: set later
-        //BBS: add arc move related data
-        path_type,
-        Vec3f(m_arc_center(0, 0) + m_x_offset, m_arc_center(1, 0) + m_y_offset, m_arc_center(2, 0)) + m_extruder_offsets[m_extruder_id],
-        m_interpolation_points,
+        interpolation_points_offset,
+        interpolation_points_count,
     });
 
     if (type == EMoveType::Seam) {
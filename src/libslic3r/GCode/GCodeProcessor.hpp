@@ -109,11 +109,13 @@ class Print;
         std::string        _objName1;
         std::string        _objName2;
         double             _height;
+        // Bottom z of the last conflicting layer, only filled in when all the conflicts are enumerated.
+        double             _last_height;
         const void *_obj1; // nullptr means wipe tower
         const void *_obj2;
         int                layer = -1;
         ConflictResult(const std::string &objName1, const std::string &objName2, double height, const void *obj1, const void *obj2)
-            : _objName1(objName1), _objName2(objName2), _height(height), _obj1(obj1), _obj2(obj2)
+            : _objName1(objName1), _objName2(objName2), _height(height), _last_height(height), _obj1(obj1), _obj2(obj2)
         {}
         ConflictResult() = default;
     };
@@ -130,6 +132,7 @@ class Print;
     };
 
     using ConflictResultOpt = std::optional<ConflictResult>;
+    using ConflictResults   = std::vector<ConflictResult>;
 
     struct GCodeProcessorResult
     {
@@ -149,6 +152,9 @@ class Print;
             }
         };
 
+        //FIXME The moves are still stored as an array of these 68 byte structs, only the arc interpolation points are pooled.
+        // A columnar store with quantized positions needs an accessor API first, as GCodeViewerData::load_toolpaths(),
+        // the time estimator and the exporters keep references to the moves and to their positions.
         struct MoveVertex
         {
             unsigned int gcode_id{ 0 };
@@ -156,6 +162,8 @@ class Print;
             ExtrusionRole extrusion_role{ erNone };
             unsigned char extruder_id{ 0 };
             unsigned char cp_color_id{ 0 };
+            //BBS: arc move related data
+            EMovePathType move_path_type{ EMovePathType::Noop_move };
             Vec3f position{ Vec3f::Zero() }; // mm
             float delta_extruder{ 0.0f }; // mm
             float feedrate{ 0.0f }; // mm/s
@@ -166,23 +174,34 @@ class Print;
             float temperature{ 0.0f }; // Celsius degrees
             float time{ 0.0f }; // s
             float layer_duration{ 0.0f }; // s (layer id before finalize)
-
-
-            //BBS: arc move related data
-            EMovePathType move_path_type{ EMovePathType::Noop_move };
-            Vec3f arc_center_position{ Vec3f::Zero() };      // mm
-            std::vector<Vec3f> interpolation_points;     // interpolation points of arc for drawing
+            // interpolation points of arc for drawing, stored in GCodeProcessorResult::interpolation_points_pool,
+            // use GCodeProcessorResult::interpolation_points() to access them.
+            unsigned int interpolation_points_offset{ 0 };
+            unsigned int interpolation_points_count{ 0 };
 
             float volumetric_rate() const { return feedrate * mm3_per_mm; }
             //BBS: new function to support arc move
             bool is_arc_move_with_interpolation_points() const {
-                return (move_path_type == EMovePathType::Arc_move_ccw || move_path_type == EMovePathType::Arc_move_cw) && interpolation_points.size();
+                return is_arc_move() && interpolation_points_count > 0;
             }
             bool is_arc_move() const {
                 return move_path_type == EMovePathType::Arc_move_ccw || move_path_type == EMovePathType::Arc_move_cw;
             }
         };
 
+        // Read only view of the interpolation points of a single move.
+        struct InterpolationPoints
+        {
+            const Vec3f *points{ nullptr };
+            size_t       count{ 0 };
+
+            size_t       size() const { return count; }
+            bool         empty() const { return count == 0; }
+            const Vec3f* begin() const { return points; }
+            const Vec3f* end() const { return points + count; }
+            const Vec3f& operator[](size_t i) const { assert(i < count); return points[i]; }
+        };
+
         struct SliceWarning {
             int         level;                  // 0: normal tips, 1: warning; 2: error
             std::string msg;                    // enum string
@@ -193,6 +212,8 @@ class Print;
         std::string filename;
         unsigned int id;
         std::vector<MoveVertex> moves;
+        // Arc interpolation points of all the moves, shared to avoid a heap allocation per arc move.
+        std::vector<Vec3f> interpolation_points_pool;
         // Positions of ends of lines of the final G-code this->filename after TimeProcessor::post_process() finalizes the G-code.
         std::vector<size_t> lines_ends;
         Pointfs printable_area;
@@ -230,6 +251,10 @@ class Print;
         
         void reset();
 
+        InterpolationPoints interpolation_points(const MoveVertex &move) const {
+            return { interpolation_points_pool.data() + move.interpolation_points_offset, move.interpolation_points_count };
+        }
+
         //BBS: add mutex for protection of gcode result
         mutable std::mutex result_mutex;
         GCodeProcessorResult& operator=(const GCodeProcessorResult &other)
@@ -237,6 +262,7 @@ class Print;
             filename = other.filename;
             id = other.id;
             moves = other.moves;
+            interpolation_points_pool = other.interpolation_points_pool;
             lines_ends = other.lines_ends;
             printable_area = other.printable_area;
             bed_exclude_area = other.bed_exclude_area;
@@ -295,6 +321,7 @@ class Print;
             Wipe_Tower_Start,
             Wipe_Tower_End,
             PA_Change,
+            Layer_M73_Slot,
         };
 
         static const std::string& reserved_tag(ETags tag) { return  Reserved_Tags_compatible[static_cast<unsigned char>(tag)]; }
@@ -730,6 +757,23 @@ class Print;
         float m_preheat_time;
         int m_preheat_steps;
         bool m_disable_m73;
+        // Single pass finalization, see enable_single_pass_finalization().
+        struct TimeSlot
+        {
+            ETags        tag;
+            // 1 based id of the first line of the slot.
+            unsigned int line_id;
+            unsigned int num_lines;
+            // Last G1 line before the slot, its elapsed time is exported.
+            unsigned int g1_line_id;
+        };
+        bool m_single_pass_finalization{ false };
+        std::vector<TimeSlot> m_time_slots;
+        // Bytes passed to process_buffer() so far.
+        size_t m_processed_bytes{ 0 };
+        // First line of the footer, which is post-processed by run_post_process().
+        unsigned int m_footer_line_id{ 0 };
+        unsigned int m_footer_g1_line_id{ 0 };
         std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time;
 
         enum class EProducer
@@ -773,6 +817,16 @@ class Print;
             return m_time_processor.machines[static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Stealth)].enabled;
         }
         void enable_machine_envelope_processing(bool enabled) { m_time_processor.machine_envelope_processing_enabled = enabled; }
+        // Finalize the streamed G-code in place: The generator reserves fixed width slots for the remaining time lines M73 and
+        // for the placeholders of the header (see time_slot()), finalize() writes the final values into the slots and post-processes
+        // the footer only, instead of run_post_process() rewriting the whole file.
+        // The lines M73 are exported once per layer. Not available with the preheat backtrace, which inserts lines into the G-code.
+        // To be called after apply_config() and enable_stealth_time_estimator().
+        void enable_single_pass_finalization(bool enabled);
+        bool is_single_pass_finalization_enabled() const { return m_single_pass_finalization; }
+        // G-code line(s) to be exported for the placeholder tag: First_Line_M73_Placeholder, Total_Layer_Number_Placeholder
+        // or Layer_M73_Slot. With single pass finalization a slot of fixed width lines, otherwise the placeholder comment.
+        std::string time_slot(ETags tag) const;
         void reset();
 
         const GCodeProcessorResult& get_result() const { return m_result; }
@@ -785,7 +839,7 @@ class Print;
 
         // Streaming interface, for processing G-codes just generated by PrusaSlicer in a pipelined fashion.
         void initialize(const std::string& filename);
-        void process_buffer(const std::string& buffer);
+        void process_buffer(std::string_view buffer);
         void finalize(bool post_process);
 
         float get_time(PrintEstimatedStatistics::ETimeMode mode) const;
@@ -943,7 +997,12 @@ class Print;
         // post process the file with the given filename to:
         // 1) add remaining time lines M73 and update moves' gcode ids accordingly
         // 2) update used filament data
+        // With single pass finalization only the footer, starting with m_footer_line_id, is post-processed.
         void run_post_process();
+        // Single pass finalization: write the final values into the slots reserved by time_slot().
+        void fill_time_slots();
+        unsigned int time_slot_lines(ETags tag) const;
+        std::vector<std::string> time_slot_values(const TimeSlot& slot) const;
 
         //BBS: different path_type is only used for arc move
         void store_move_vertex(EMoveType type, EMovePathType path_type = EMovePathType::Noop_move);
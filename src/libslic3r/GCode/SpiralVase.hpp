@@ -34,6 +34,7 @@ public:
     void set_max_xy_smoothing(float max) {
         m_max_xy_smoothing = max;
     }
+    float max_xy_smoothing() const { return m_max_xy_smoothing; }
 private:
     const PrintConfig  &m_config;
     GCodeReader 		m_reader;
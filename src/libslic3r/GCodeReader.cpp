@@ -4,6 +4,8 @@
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/fstream.hpp>
 #include <boost/nowide/cstdio.hpp>
+#include <atomic>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -13,8 +15,27 @@
 
 #include <fast_float/fast_float.h>
 
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <tbb/concurrent_queue.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/version.h>
+#if TBB_VERSION_MAJOR >= 2021
+    #include <tbb/parallel_pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter_mode;
+#else
+    #include <tbb/pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter;
+#endif
+
 namespace Slic3r {
 
+// Files smaller than this are read line by line through a stdio buffer.
+static constexpr size_t GCODE_READER_PARALLEL_MIN_SIZE = 8 * 1024 * 1024;
+// Size of a block of whole lines tokenized by a single task.
+static constexpr size_t GCODE_READER_CHUNK_SIZE        = 2 * 1024 * 1024;
+
 void GCodeReader::apply_config(const GCodeConfig &config)
 {
     m_config = config;
@@ -28,7 +49,20 @@ void GCodeReader::apply_config(const DynamicPrintConfig &config)
 const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, GCodeLine &gline, std::pair<const char*, const char*> &command)
 {
     assert(is_decimal_separator_point());
-    
+
+    const char *c = parse_line_tokens(ptr, end, gline, command);
+
+    if (gline.has(E) && m_config.use_relative_e_distances)
+        m_position[E] = 0;
+
+    if (m_verbose)
+        std::cout << gline.m_raw << std::endl;
+
+    return c;
+}
+
+const char* GCodeReader::parse_line_tokens(const char *ptr, const char *end, GCodeLine &gline, std::pair<const char*, const char*> &command)
+{
     // command and args
     const char *c = ptr;
     {
@@ -78,9 +112,6 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
                 c = skip_word(c);
         }
     }
-    
-    if (gline.has(E) && m_config.use_relative_e_distances)
-        m_position[E] = 0;
 
     // Skip the rest of the line.
     for (; ! is_end_of_line(*c); ++ c);
@@ -96,9 +127,6 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
 	if (*c == '\n')
 		++ c;
 
-    if (m_verbose)
-        std::cout << gline.m_raw << std::endl;
-
     return c;
 }
 
@@ -172,20 +200,141 @@ bool GCodeReader::parse_file_raw_internal(const std::string &filename, ParseLine
     return true;
 }
 
+// Two phase parsing of a memory mapped G-code: blocks of whole lines are tokenized and their numeric fields are parsed
+// in parallel by the worker threads, while the calling thread carries over the reader state (positions, relative E)
+// and calls the callbacks in the order of the lines in the file. The callbacks stay on the calling thread, as they may
+// depend on its state, for example on the numeric locale set by GCodeProcessor::process_file().
+template<typename ParseLineCallback, typename LineEndCallback>
+void GCodeReader::parse_mapped_internal(const char *data, size_t size, ParseLineCallback parse_line_callback, LineEndCallback line_end_callback)
+{
+    struct Chunk {
+        const char             *begin { nullptr };
+        const char             *end   { nullptr };
+        std::vector<GCodeLine>  lines;
+        // File position after the '\n' terminating the line, zero if the line is not terminated by '\n'.
+        std::vector<size_t>     lines_ends;
+    };
+
+    const size_t       num_threads = size_t(tbb::this_task_arena::max_concurrency());
+    const char        *data_end    = data + size;
+    const char        *next        = data;
+    // Tokenized chunks in the order of the file, handed over to the calling thread. A chunk without data marks the end.
+    tbb::concurrent_bounded_queue<Chunk> tokenized;
+    tokenized.set_capacity(std::ptrdiff_t(num_threads));
+    // Set by the calling thread to stop tokenizing, if a callback stopped the parsing or threw.
+    std::atomic<bool>  stop { false };
+    std::exception_ptr tokenizer_exception;
+    tbb::task_group    tokenizer;
+    tokenizer.run([&]() {
+        try {
+            tbb::parallel_pipeline(2 * num_threads,
+                tbb::make_filter<void, Chunk>(slic3r_tbb_filtermode::serial_in_order,
+                    [&next, &stop, data_end](tbb::flow_control &fc) -> Chunk {
+                        Chunk chunk;
+                        if (next == data_end || stop) {
+                            fc.stop();
+                            return chunk;
+                        }
+                        // Split after a '\n', so that "\r\n" is never torn apart.
+                        chunk.begin = next;
+                        chunk.end   = next + std::min(GCODE_READER_CHUNK_SIZE, size_t(data_end - next));
+                        if (chunk.end != data_end) {
+                            const char *eol = static_cast<const char*>(memchr(chunk.end, '\n', data_end - chunk.end));
+                            chunk.end = eol == nullptr ? data_end : eol + 1;
+                        }
+                        next = chunk.end;
+                        return chunk;
+                    }) &
+                tbb::make_filter<Chunk, Chunk>(slic3r_tbb_filtermode::parallel,
+                    [data](Chunk chunk) -> Chunk {
+                        std::pair<const char*, const char*> cmd;
+                        chunk.lines.reserve((chunk.end - chunk.begin) / 24);
+                        chunk.lines_ends.reserve(chunk.lines.capacity());
+                        for (const char *it = chunk.begin; it != chunk.end;) {
+                            const char *it_end = it;
+                            for (; it_end != chunk.end && *it_end != '\r' && *it_end != '\n'; ++ it_end);
+                            GCodeLine &gline = chunk.lines.emplace_back();
+                            if (it_end == chunk.end) {
+                                // Last line of a file not terminated by a newline, the tokenizer expects a terminating character.
+                                const std::string line(it, it_end);
+                                parse_line_tokens(skip_line_number(line.c_str()), line.c_str() + line.size(), gline, cmd);
+                            } else
+                                parse_line_tokens(skip_line_number(it), it_end, gline, cmd);
+                            // Skip EOL.
+                            it = it_end;
+                            if (it != chunk.end && *it == '\r')
+                                ++ it;
+                            size_t line_end = 0;
+                            if (it != chunk.end && *it == '\n')
+                                line_end = size_t(++ it - data);
+                            chunk.lines_ends.emplace_back(line_end);
+                        }
+                        return chunk;
+                    }) &
+                tbb::make_filter<Chunk, void>(slic3r_tbb_filtermode::serial_in_order,
+                    [&tokenized](Chunk chunk) { tokenized.push(std::move(chunk)); }));
+        } catch (...) {
+            tokenizer_exception = std::current_exception();
+        }
+        tokenized.push(Chunk());
+    });
+
+    m_parsing = true;
+    std::exception_ptr callback_exception;
+    for (Chunk chunk;;) {
+        tokenized.pop(chunk);
+        if (chunk.begin == nullptr)
+            break;
+        if (stop)
+            // Drain the queue, so that the tokenizer does not block on a full queue.
+            continue;
+        try {
+            for (size_t i = 0; i < chunk.lines.size() && m_parsing; ++ i) {
+                GCodeLine &gline = chunk.lines[i];
+                if (gline.has(E) && m_config.use_relative_e_distances)
+                    m_position[E] = 0;
+                parse_line_callback(*this, gline);
+                std::pair<const char*, const char*> cmd;
+                cmd.first  = skip_whitespaces(gline.m_raw.c_str());
+                cmd.second = skip_word(cmd.first);
+                update_coordinates(gline, cmd);
+                if (chunk.lines_ends[i] != 0)
+                    line_end_callback(chunk.lines_ends[i]);
+            }
+        } catch (...) {
+            callback_exception = std::current_exception();
+        }
+        stop = ! m_parsing || callback_exception;
+    }
+    tokenizer.wait();
+    if (callback_exception)
+        std::rethrow_exception(callback_exception);
+    if (tokenizer_exception)
+        std::rethrow_exception(tokenizer_exception);
+}
+
 template<typename ParseLineCallback, typename LineEndCallback>
 bool GCodeReader::parse_file_internal(const std::string &filename, ParseLineCallback parse_line_callback, LineEndCallback line_end_callback)
 {
+    {
+        boost::iostreams::mapped_file_source mapped;
+        try {
+            mapped.open(filename);
+        } catch (const std::exception &err) {
+            BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": couldn't map %1%, reason = %2%") % filename % err.what();
+        }
+        if (mapped.is_open() && mapped.size() >= GCODE_READER_PARALLEL_MIN_SIZE && tbb::this_task_arena::max_concurrency() > 1) {
+            assert(is_decimal_separator_point());
+            this->parse_mapped_internal(mapped.data(), mapped.size(), parse_line_callback, line_end_callback);
+            return true;
+        }
+    }
+
     GCodeLine gline;    
     return this->parse_file_raw_internal(filename, 
         [this, &gline, parse_line_callback](const char *begin, const char *end) {
             gline.reset();
-
-            const char* begin_new = begin;
-            begin_new = skip_whitespaces(begin_new);
-            if (std::toupper(*begin_new) == 'N')
-                begin_new = skip_word(begin_new);
-            begin_new = skip_whitespaces(begin_new);
-            this->parse_line(begin_new, end, gline, parse_line_callback);
+            this->parse_line(skip_line_number(begin), end, gline, parse_line_callback);
         }, 
         line_end_callback);
 }
@@ -105,20 +105,21 @@ public:
     void apply_config(const DynamicPrintConfig &config);
     const GCodeConfig& config() { return m_config; };
 
+    // The buffer has to end with a newline or it has to be zero terminated, as the lines are parsed up to their end.
     template<typename Callback>
-    void parse_buffer(const std::string &buffer, Callback callback)
+    void parse_buffer(std::string_view buffer, Callback callback)
     {
-        const char *ptr = buffer.c_str();
+        const char *ptr = buffer.data();
         const char *end = ptr + buffer.size();
         GCodeLine gline;
         m_parsing = true;
-        while (m_parsing && *ptr != 0) {
+        while (m_parsing && ptr != end && *ptr != 0) {
             gline.reset();
             ptr = this->parse_line(ptr, end, gline, callback);
         }
     }
 
-    void parse_buffer(const std::string &buffer)
+    void parse_buffer(std::string_view buffer)
         { this->parse_buffer(buffer, [](GCodeReader&, const GCodeReader::GCodeLine&){}); }
 
     template<typename Callback>
@@ -168,7 +169,12 @@ private:
     template<typename ParseLineCallback, typename LineEndCallback>
     bool        parse_file_internal(const std::string &filename, ParseLineCallback parse_line_callback, LineEndCallback line_end_callback);
 
+    template<typename ParseLineCallback, typename LineEndCallback>
+    void        parse_mapped_internal(const char *data, size_t size, ParseLineCallback parse_line_callback, LineEndCallback line_end_callback);
+
     const char* parse_line_internal(const char *ptr, const char *end, GCodeLine &gline, std::pair<const char*, const char*> &command);
+    // Tokenize a single line without touching the state of the reader, thus it may be called from worker threads.
+    static const char* parse_line_tokens(const char *ptr, const char *end, GCodeLine &gline, std::pair<const char*, const char*> &command);
     void        update_coordinates(GCodeLine &gline, std::pair<const char*, const char*> &command);
 
     static bool         is_whitespace(char c)           { return c == ' ' || c == '\t'; }
@@ -185,6 +191,13 @@ private:
             ; // silence -Wempty-body
         return c;
     }
+    // Skip the whitespaces and the optional "N<line number>" word at the start of a line.
+    static const char*  skip_line_number(const char *c) {
+        c = skip_whitespaces(c);
+        if (std::toupper(*c) == 'N')
+            c = skip_word(c);
+        return skip_whitespaces(c);
+    }
 
     GCodeConfig m_config;
     float       m_position[NUM_AXES];
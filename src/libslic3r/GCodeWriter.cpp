@@ -57,6 +57,25 @@ void GCodeWriter::set_extruders(std::vector<unsigned int> extruder_ids)
     this->multiple_extruders = (*std::max_element(extruder_ids.begin(), extruder_ids.end())) > 0;
 }
 
+GCodeWriter& GCodeWriter::operator=(const GCodeWriter &rhs)
+{
+    if (this != &rhs) {
+        GCodeWriterState::operator=(rhs);
+        this->config             = rhs.config;
+        this->multiple_extruders = rhs.multiple_extruders;
+        this->rebind_extruders(rhs);
+    }
+    return *this;
+}
+
+void GCodeWriter::rebind_extruders(const GCodeWriter &rhs)
+{
+    // The copied extruders still point to the config of rhs, the active extruder into rhs.m_extruders.
+    for (Extruder &extruder : m_extruders)
+        extruder.m_config = &this->config;
+    m_extruder = rhs.m_extruder == nullptr ? nullptr : &m_extruders[rhs.m_extruder - rhs.m_extruders.data()];
+}
+
 std::string GCodeWriter::preamble()
 {
     std::ostringstream gcode;
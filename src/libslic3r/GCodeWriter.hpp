@@ -11,22 +11,67 @@
 
 namespace Slic3r {
 
-class GCodeWriter {
+// State of GCodeWriter, which is copied member-wise. GCodeWriter copies it together with its config
+// and rebinds the copied extruders to its own config.
+class GCodeWriterState {
+protected:
+	// Extruders are sorted by their ID, so that binary search is possible.
+    std::vector<Extruder> m_extruders;
+    bool            m_single_extruder_multi_material { false };
+    Extruder*       m_extruder { nullptr };
+    unsigned int    m_last_acceleration { 0 };
+    unsigned int    m_last_travel_acceleration { 0 };
+    unsigned int    m_max_travel_acceleration { 0 };
+
+    // Limit for setting the acceleration, to respect the machine limits set for the Marlin firmware.
+    // If set to zero, the limit is not in action.
+    unsigned int    m_max_acceleration { 0 };
+    double          m_max_jerk_x { 0 };
+    double          m_max_jerk_y { 0 };
+    double          m_last_jerk { 0 };
+    double          m_max_jerk_z;
+    double          m_max_jerk_e;
+
+    unsigned int  m_travel_acceleration;
+    unsigned int  m_travel_jerk;
+
+
+    //BBS
+    unsigned int    m_last_additional_fan_speed;
+    int             m_last_bed_temperature { 0 };
+    bool            m_last_bed_temperature_reached { true };
+    double          m_lifted { 0 };
+
+    // BBS
+    double          m_to_lift { 0 };
+    LiftType        m_to_lift_type { LiftType::NormalLift };
+    Vec3d           m_pos = Vec3d::Zero();
+    //BBS: this flag is used to indicate whether the m_pos is real.
+    //A example that of the first move, the m_pos is zero, but the real position of extruder doesn't
+    //Pos must be clear after the first xyz travel move
+    bool            m_is_current_pos_clear = false;
+    //BBS: x, y offset for gcode generated
+    double          m_x_offset{ 0 };
+    double          m_y_offset{ 0 };
+    
+    std::string m_gcode_label_objects_start;
+    std::string m_gcode_label_objects_end;
+
+    //SoftFever
+    double          m_current_speed { 3600 };
+    bool            m_is_first_layer = true;
+};
+
+class GCodeWriter : private GCodeWriterState {
 public:
     GCodeConfig config;
-    bool multiple_extruders;
+    bool multiple_extruders { false };
     
-    GCodeWriter() : 
-        multiple_extruders(false), m_extruder(nullptr),
-        m_single_extruder_multi_material(false),
-        m_last_acceleration(0), m_max_acceleration(0),m_last_travel_acceleration(0), m_max_travel_acceleration(0),
-        m_last_jerk(0), m_max_jerk_x(0), m_max_jerk_y(0),
-        m_last_bed_temperature(0), m_last_bed_temperature_reached(true),
-        m_lifted(0),
-        m_to_lift(0),
-        m_to_lift_type(LiftType::NormalLift),
-        m_current_speed(3600), m_is_first_layer(true)
-        {}
+    GCodeWriter() = default;
+    // The copied extruders are rebound to this->config, the active extruder into this->m_extruders.
+    GCodeWriter(const GCodeWriter &rhs) : GCodeWriterState(rhs), config(rhs.config), multiple_extruders(rhs.multiple_extruders) { this->rebind_extruders(rhs); }
+    GCodeWriter& operator=(const GCodeWriter &rhs);
+
     Extruder*            extruder()             { return m_extruder; }
     const Extruder*      extruder()     const   { return m_extruder; }
 
@@ -118,51 +163,7 @@ public:
     // Returns whether this flavor supports separate print and travel acceleration.
     static bool supports_separate_travel_acceleration(GCodeFlavor flavor);
   private:
-	// Extruders are sorted by their ID, so that binary search is possible.
-    std::vector<Extruder> m_extruders;
-    bool            m_single_extruder_multi_material;
-    Extruder*       m_extruder;
-    unsigned int    m_last_acceleration;
-    unsigned int    m_last_travel_acceleration;
-    unsigned int    m_max_travel_acceleration;
-
-    // Limit for setting the acceleration, to respect the machine limits set for the Marlin firmware.
-    // If set to zero, the limit is not in action.
-    unsigned int    m_max_acceleration;
-    double          m_max_jerk_x;
-    double          m_max_jerk_y;
-    double          m_last_jerk;
-    double          m_max_jerk_z;
-    double          m_max_jerk_e;
-
-    unsigned int  m_travel_acceleration;
-    unsigned int  m_travel_jerk;
-
-
-    //BBS
-    unsigned int    m_last_additional_fan_speed;
-    int             m_last_bed_temperature;
-    bool            m_last_bed_temperature_reached;
-    double          m_lifted;
-
-    // BBS
-    double          m_to_lift;
-    LiftType        m_to_lift_type;
-    Vec3d           m_pos = Vec3d::Zero();
-    //BBS: this flag is used to indicate whether the m_pos is real.
-    //A example that of the first move, the m_pos is zero, but the real position of extruder doesn't
-    //Pos must be clear after the first xyz travel move
-    bool            m_is_current_pos_clear = false;
-    //BBS: x, y offset for gcode generated
-    double          m_x_offset{ 0 };
-    double          m_y_offset{ 0 };
-    
-    std::string m_gcode_label_objects_start;
-    std::string m_gcode_label_objects_end;
-
-    //SoftFever
-    double          m_current_speed;
-    bool            m_is_first_layer = true;
+    void rebind_extruders(const GCodeWriter &rhs);
 
     enum class Acceleration {
         Travel,
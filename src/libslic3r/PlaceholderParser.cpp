@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <sstream>
 #include <map>
+#include <string_view>
 #ifdef _MSC_VER
     #include <stdlib.h>  // provides **_environ
 #else
@@ -2343,10 +2344,649 @@ static std::string process_macro(const std::string &templ, client::MyContext &co
     return output;
 }
 
+// White spaces skipped inside the code blocks, see ascii_char_skipper_parser.
+static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+static bool is_identifier_char(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+// Length of the identifier starting at templ[pos], zero if there is none.
+static size_t identifier_length(const std::string &templ, size_t pos, size_t end)
+{
+    if (pos >= end || ! (std::isalpha(static_cast<unsigned char>(templ[pos])) || templ[pos] == '_'))
+        return 0;
+    size_t i = pos + 1;
+    while (i < end && is_identifier_char(templ[i]))
+        ++ i;
+    return i - pos;
+}
+
+static bool is_keyword(std::string_view name)
+{
+    return const_cast<qi::symbols<char>&>(g_macro_processor_instance.keywords).find(std::string(name)) != nullptr;
+}
+
+// Expression tree of the subset of the expression grammar used by the custom G-code for computing coordinates, speeds
+// and conditions: numeric and boolean literals, variables, arithmetic, comparisons, logical operators and the min, max,
+// int and round functions. The tree is evaluated with the same expr operations the grammar calls from its semantic actions.
+struct CompiledExpression
+{
+    enum class Op {
+        Int, Double, Bool, Variable,
+        Minus, Not, ToInt, Round,
+        Mul, Div, Mod, Add, Sub, Lower, Greater, Leq, Geq, Equal, NotEqual, And, Or, Min, Max,
+    };
+    Op                              op;
+    // Range of the expression in the template, the variable name of Variable.
+    size_t                          begin { 0 };
+    size_t                          end   { 0 };
+    int                             i     { 0 };
+    double                          d     { 0. };
+    // Operands, index of Variable.
+    std::vector<CompiledExpression> args;
+};
+
+// Recursive descent parser of CompiledExpression, following the rules of the grammar.
+// Any construct out of the supported subset fails the compilation and the code block is left to the grammar.
+class ExpressionCompiler
+{
+public:
+    ExpressionCompiler(const std::string &templ, size_t begin, size_t end) : m_templ(templ), m_pos(begin), m_end(end) {}
+
+    // Compile the whole range into an expression.
+    bool compile(CompiledExpression &out)
+    {
+        if (! this->conditional_expression(out))
+            return false;
+        this->skip();
+        return m_pos == m_end;
+    }
+
+private:
+    using Op = CompiledExpression::Op;
+
+    void skip() { while (m_pos < m_end && is_blank(m_templ[m_pos])) ++ m_pos; }
+    bool accept(std::string_view token)
+    {
+        this->skip();
+        if (m_templ.compare(m_pos, token.size(), token) != 0 || m_pos + token.size() > m_end)
+            return false;
+        m_pos += token.size();
+        return true;
+    }
+    bool accept_keyword(std::string_view keyword)
+    {
+        this->skip();
+        if (identifier_length(m_templ, m_pos, m_end) != keyword.size() || m_templ.compare(m_pos, keyword.size(), keyword) != 0)
+            return false;
+        m_pos += keyword.size();
+        return true;
+    }
+    static CompiledExpression binary(Op op, CompiledExpression &&lhs, CompiledExpression &&rhs)
+    {
+        CompiledExpression out { op, lhs.begin, rhs.end };
+        out.args.emplace_back(std::move(lhs));
+        out.args.emplace_back(std::move(rhs));
+        return out;
+    }
+    // Parse a chain of left associative binary operators.
+    template<typename Operand, typename Operator>
+    bool binary_chain(CompiledExpression &out, Operand operand, Operator op)
+    {
+        if (! operand(out))
+            return false;
+        for (Op o; op(o);) {
+            CompiledExpression rhs;
+            if (! operand(rhs))
+                return false;
+            out = binary(o, std::move(out), std::move(rhs));
+        }
+        return true;
+    }
+
+    bool conditional_expression(CompiledExpression &out)
+    {
+        // The ternary operator is left to the grammar.
+        return this->logical_or_expression(out) && ! this->accept("?");
+    }
+    bool logical_or_expression(CompiledExpression &out)
+    {
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->logical_and_expression(e); },
+            [this](Op &o) { o = Op::Or; return this->accept_keyword("or") || this->accept("||"); });
+    }
+    bool logical_and_expression(CompiledExpression &out)
+    {
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->equality_expression(e); },
+            [this](Op &o) { o = Op::And; return this->accept_keyword("and") || this->accept("&&"); });
+    }
+    bool equality_expression(CompiledExpression &out)
+    {
+        // The regular expression matching =~ and !~ is left to the grammar.
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->relational_expression(e); },
+            [this](Op &o) {
+                if (this->accept("=="))
+                    o = Op::Equal;
+                else if (this->accept("!=") || this->accept("<>"))
+                    o = Op::NotEqual;
+                else
+                    return false;
+                return true;
+            });
+    }
+    bool relational_expression(CompiledExpression &out)
+    {
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->additive_expression(e); },
+            [this](Op &o) {
+                if (this->accept("<="))
+                    o = Op::Leq;
+                else if (this->accept(">="))
+                    o = Op::Geq;
+                else if (this->accept("<"))
+                    o = Op::Lower;
+                else if (this->accept(">"))
+                    o = Op::Greater;
+                else
+                    return false;
+                return true;
+            });
+    }
+    bool additive_expression(CompiledExpression &out)
+    {
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->multiplicative_expression(e); },
+            [this](Op &o) {
+                if (this->accept("+"))
+                    o = Op::Add;
+                else if (this->accept("-"))
+                    o = Op::Sub;
+                else
+                    return false;
+                return true;
+            });
+    }
+    bool multiplicative_expression(CompiledExpression &out)
+    {
+        return this->binary_chain(out, [this](CompiledExpression &e) { return this->unary_expression(e); },
+            [this](Op &o) {
+                if (this->accept("*"))
+                    o = Op::Mul;
+                else if (this->accept("/"))
+                    o = Op::Div;
+                else if (this->accept("%"))
+                    o = Op::Mod;
+                else
+                    return false;
+                return true;
+            });
+    }
+    bool unary(Op op, size_t begin, CompiledExpression &out)
+    {
+        CompiledExpression arg;
+        if (! this->unary_expression(arg))
+            return false;
+        out = { op, begin, arg.end };
+        out.args.emplace_back(std::move(arg));
+        return true;
+    }
+    bool function(Op op, size_t begin, size_t num_params, CompiledExpression &out)
+    {
+        out = { op, begin };
+        if (! this->accept("("))
+            return false;
+        for (size_t i = 0; i < num_params; ++ i) {
+            out.args.emplace_back();
+            if ((i > 0 && ! this->accept(",")) || ! this->conditional_expression(out.args.back()))
+                return false;
+        }
+        if (! this->accept(")"))
+            return false;
+        out.end = m_pos;
+        return true;
+    }
+    bool unary_expression(CompiledExpression &out)
+    {
+        this->skip();
+        const size_t begin = m_pos;
+        if (size_t len = identifier_length(m_templ, m_pos, m_end); len > 0) {
+            std::string_view name(m_templ.data() + m_pos, len);
+            if (this->accept_keyword("not"))
+                return this->unary(Op::Not, begin, out);
+            if (this->accept_keyword("min"))
+                return this->function(Op::Min, begin, 2, out);
+            if (this->accept_keyword("max"))
+                return this->function(Op::Max, begin, 2, out);
+            if (this->accept_keyword("int"))
+                return this->function(Op::ToInt, begin, 1, out);
+            if (this->accept_keyword("round"))
+                return this->function(Op::Round, begin, 1, out);
+            if (name == "true" || name == "false") {
+                m_pos += len;
+                out = { Op::Bool, begin, m_pos, name == "true" };
+                return true;
+            }
+            if (is_keyword(name))
+                return false;
+            m_pos += len;
+            out = { Op::Variable, begin, m_pos };
+            if (this->accept("[")) {
+                // The vector index is an additive expression.
+                out.args.emplace_back();
+                if (! this->additive_expression(out.args.back()) || ! this->accept("]"))
+                    return false;
+            }
+            return true;
+        }
+        if (this->accept("(")) {
+            if (! this->conditional_expression(out) || ! this->accept(")"))
+                return false;
+            out.begin = begin;
+            out.end   = m_pos;
+            return true;
+        }
+        if (this->accept("-"))
+            return this->unary(Op::Minus, begin, out);
+        if (this->accept("+")) {
+            if (! this->unary_expression(out))
+                return false;
+            out.begin = begin;
+            return true;
+        }
+        if (this->accept("!"))
+            return this->unary(Op::Not, begin, out);
+        // The same number parsers as the grammar: A double with a decimal point first, then an integer.
+        auto it = m_templ.begin() + m_pos;
+        double d;
+        int    i;
+        if (qi::parse(it, m_templ.begin() + m_end, qi::real_parser<double, client::strict_real_policies_without_nan_inf>(), d)) {
+            m_pos = it - m_templ.begin();
+            out   = { Op::Double, begin, m_pos };
+            out.d = d;
+            return true;
+        }
+        if (qi::parse(it, m_templ.begin() + m_end, qi::int_, i)) {
+            m_pos = it - m_templ.begin();
+            out   = { Op::Int, begin, m_pos, i };
+            return true;
+        }
+        return false;
+    }
+
+    const std::string  &m_templ;
+    size_t              m_pos;
+    size_t              m_end;
+};
+
+static void evaluate_expression(const std::string &templ, const CompiledExpression &expression, client::MyContext &context, client::expr &out)
+{
+    using Op   = CompiledExpression::Op;
+    using expr = client::expr;
+    const client::Iterator begin = templ.begin() + expression.begin;
+    const client::Iterator end   = templ.begin() + expression.end;
+    switch (expression.op) {
+    case Op::Int:       out = expr(expression.i, begin, end); return;
+    case Op::Double:    out = expr(expression.d, begin, end); return;
+    case Op::Bool:      out = expr(expression.i != 0, begin, end); return;
+    case Op::Variable:
+    {
+        client::IteratorRange opt_key(begin, end);
+        client::OptWithPos    opt;
+        client::MyContext::resolve_variable(&context, opt_key, opt);
+        if (! expression.args.empty()) {
+            expr index;
+            int  idx = 0;
+            evaluate_expression(templ, expression.args.front(), context, index);
+            client::MyContext::evaluate_index(index, idx);
+            client::OptWithPos indexed;
+            client::MyContext::store_variable_index(&context, opt, idx, end, indexed);
+            opt = indexed;
+        }
+        client::MyContext::variable_value(&context, opt, out);
+        return;
+    }
+    default:
+        break;
+    }
+    expr arg;
+    evaluate_expression(templ, expression.args.front(), context, arg);
+    switch (expression.op) {
+    case Op::Minus:     out = arg.unary_minus(begin); return;
+    case Op::Not:       out = arg.unary_not(begin); return;
+    case Op::ToInt:     out = arg.unary_integer(begin); return;
+    case Op::Round:     out = arg.round(begin); return;
+    default:
+        break;
+    }
+    expr rhs;
+    evaluate_expression(templ, expression.args.back(), context, rhs);
+    switch (expression.op) {
+    case Op::Mul:       arg *= rhs; break;
+    case Op::Div:       arg /= rhs; break;
+    case Op::Mod:       arg %= rhs; break;
+    case Op::Add:       arg += rhs; break;
+    case Op::Sub:       arg -= rhs; break;
+    case Op::Lower:     expr::lower(arg, rhs); break;
+    case Op::Greater:   expr::greater(arg, rhs); break;
+    case Op::Leq:       expr::leq(arg, rhs); break;
+    case Op::Geq:       expr::geq(arg, rhs); break;
+    case Op::Equal:     expr::equal(arg, rhs); break;
+    case Op::NotEqual:  expr::not_equal(arg, rhs); break;
+    case Op::And:       expr::logical_and(arg, rhs); break;
+    case Op::Or:        expr::logical_or(arg, rhs); break;
+    case Op::Min:       expr::min(arg, rhs); break;
+    case Op::Max:       expr::max(arg, rhs); break;
+    default:            assert(false);
+    }
+    out = std::move(arg);
+}
+
+static std::unique_ptr<CompiledExpression> compile_expression(const std::string &templ, size_t begin, size_t end)
+{
+    auto out = std::make_unique<CompiledExpression>();
+    return ExpressionCompiler(templ, begin, end).compile(*out) ? std::move(out) : nullptr;
+}
+
+// A template split into literal text, legacy variable expansions, expressions, macro blocks and {if}{elsif}{else}{endif} blocks
+// enclosing text. When a compiled template is evaluated, only the code blocks out of the subset of CompiledExpression are run
+// through the grammar. The ranges index the template the segments were compiled from, thus a compiled template is only
+// evaluated together with the same template.
+struct PlaceholderParser::CompiledTemplate
+{
+    struct Segment;
+    struct Branch {
+        // Range of the condition, not set for the {else} branch.
+        size_t                              begin   { 0 };
+        size_t                              end     { 0 };
+        bool                                is_else { false };
+        // Compiled condition, the condition is evaluated by the grammar if not set.
+        std::unique_ptr<CompiledExpression> condition;
+        std::vector<Segment>                segments;
+    };
+    struct Segment {
+        enum class Type {
+            // Free-form text.
+            Text,
+            // [variable]
+            LegacyVariable,
+            // [variable[index_variable]]
+            LegacyVectorVariable,
+            // {expression}
+            Expression,
+            // {macro}, evaluated by the grammar.
+            Macro,
+            // {if condition}text{elsif condition}text{else}text{endif}
+            Conditional,
+        };
+        Type                                type;
+        // Range of the text, of the variable name or of the macro including its braces.
+        size_t                              begin       { 0 };
+        size_t                              end         { 0 };
+        // Range of the index variable of LegacyVectorVariable.
+        size_t                              index_begin { 0 };
+        size_t                              index_end   { 0 };
+        std::unique_ptr<CompiledExpression> expression;
+        std::vector<Branch>                 branches;
+    };
+    std::vector<Segment>                    segments;
+};
+using CompiledTemplate = PlaceholderParser::CompiledTemplate;
+
+enum class ChunkType { Segment, If, Elsif, Else, Endif };
+
+struct Chunk {
+    ChunkType                   type;
+    // Condition of {if} / {elsif} is stored as the range of the segment.
+    CompiledTemplate::Segment   segment;
+};
+
+// Classify a code block templ[begin] == '{' .. templ[end] == '}'.
+// Returns false if the block shall not be split from the rest of the template.
+static bool classify_block(const std::string &templ, size_t begin, size_t end, Chunk &chunk)
+{
+    using Type = CompiledTemplate::Segment::Type;
+    size_t body_begin = begin + 1;
+    size_t body_end   = end;
+    while (body_begin < body_end && is_blank(templ[body_begin]))
+        ++ body_begin;
+    while (body_end > body_begin && is_blank(templ[body_end - 1]))
+        -- body_end;
+    // Collect the if / elsif / else / endif / then words outside of the string literals and regular expressions.
+    std::vector<std::pair<std::string_view, size_t>> words;
+    auto skip_literal = [&templ, end](size_t i, char delimiter) {
+        for (++ i; i < end && templ[i] != delimiter; ++ i)
+            if (templ[i] == '\\')
+                ++ i;
+        return i;
+    };
+    bool regex_allowed = false;
+    for (size_t i = body_begin; i < body_end;) {
+        const char c = templ[i];
+        if (size_t len = identifier_length(templ, i, body_end); len > 0) {
+            std::string_view word(templ.data() + i, len);
+            if (word == "if" || word == "elsif" || word == "else" || word == "endif" || word == "then")
+                words.emplace_back(word, i);
+            i += len;
+            regex_allowed = false;
+        } else if (c == '"' || (c == '/' && regex_allowed)) {
+            // A regular expression follows the =~ and !~ operators, otherwise '/' is a division.
+            i = skip_literal(i, c) + 1;
+            regex_allowed = false;
+        } else {
+            if (c == '~' && (templ[i - 1] == '=' || templ[i - 1] == '!'))
+                regex_allowed = true;
+            else if (! is_blank(c))
+                regex_allowed = false;
+            ++ i;
+        }
+    }
+    std::string_view body(templ.data() + body_begin, body_end - body_begin);
+    if (words.empty()) {
+        chunk = { ChunkType::Segment, { Type::Expression, body_begin, body_end } };
+        if (chunk.segment.expression = compile_expression(templ, body_begin, body_end); ! chunk.segment.expression)
+            chunk.segment = { Type::Macro, begin, end + 1 };
+        return true;
+    }
+    if (body == "else" || body == "endif") {
+        chunk = { body == "else" ? ChunkType::Else : ChunkType::Endif };
+        return true;
+    }
+    if (words.size() == 1 && words.front().second == body_begin && (words.front().first == "if" || words.front().first == "elsif")) {
+        // Header of a conditional block enclosing text.
+        const size_t cond_begin = body_begin + words.front().first.size();
+        chunk = { words.front().first == "if" ? ChunkType::If : ChunkType::Elsif, { Type::Macro, cond_begin, body_end } };
+        chunk.segment.expression = compile_expression(templ, cond_begin, body_end);
+        return true;
+    }
+    // A macro block with complete "if then endif" statements.
+    int depth = 0;
+    for (const auto &word : words) {
+        if (word.first == "if")
+            ++ depth;
+        else if (word.first == "endif")
+            -- depth;
+        if (depth < 0 || (depth == 0 && word.first != "endif"))
+            return false;
+    }
+    if (depth != 0)
+        return false;
+    chunk = { ChunkType::Segment, { Type::Macro, begin, end + 1 } };
+    return true;
+}
+
+// Split the template into chunks at the braces. Returns false if the template shall be processed as a whole.
+static bool split_template(const std::string &templ, std::vector<Chunk> &chunks)
+{
+    using Type = CompiledTemplate::Segment::Type;
+    for (size_t pos = 0; pos < templ.size();) {
+        size_t next = std::min(templ.find_first_of("[{", pos), templ.size());
+        if (next > pos)
+            chunks.push_back({ ChunkType::Segment, { Type::Text, pos, next } });
+        if (next == templ.size())
+            break;
+        if (templ[next] == '[') {
+            // Only the [variable] and [variable[index_variable]] forms without white spaces are expanded directly.
+            size_t len = identifier_length(templ, next + 1, templ.size());
+            if (len == 0 || is_keyword(std::string_view(templ.data() + next + 1, len)))
+                return false;
+            size_t i = next + 1 + len;
+            if (i < templ.size() && templ[i] == ']') {
+                chunks.push_back({ ChunkType::Segment, { Type::LegacyVariable, next + 1, i } });
+                pos = i + 1;
+                continue;
+            }
+            size_t len_index = identifier_length(templ, i + 1, templ.size());
+            if (i >= templ.size() || templ[i] != '[' || len_index == 0 || is_keyword(std::string_view(templ.data() + i + 1, len_index)) ||
+                templ.compare(i + 1 + len_index, 2, "]]") != 0)
+                return false;
+            chunks.push_back({ ChunkType::Segment, { Type::LegacyVectorVariable, next + 1, i, i + 1, i + 1 + len_index } });
+            pos = i + 1 + len_index + 2;
+        } else {
+            // Find the closing brace outside of string literals and regular expressions.
+            size_t end = next + 1;
+            for (bool regex_allowed = false; end < templ.size() && templ[end] != '}'; ++ end) {
+                const char c = templ[end];
+                if (c == '{')
+                    return false;
+                if (c == '"' || (c == '/' && regex_allowed)) {
+                    for (++ end; end < templ.size() && templ[end] != c; ++ end)
+                        if (templ[end] == '\\')
+                            ++ end;
+                    if (end >= templ.size())
+                        return false;
+                    regex_allowed = false;
+                } else if (c == '~' && (templ[end - 1] == '=' || templ[end - 1] == '!'))
+                    regex_allowed = true;
+                else if (! is_blank(c))
+                    regex_allowed = false;
+            }
+            if (end >= templ.size())
+                return false;
+            Chunk chunk;
+            if (! classify_block(templ, next, end, chunk))
+                return false;
+            chunks.emplace_back(std::move(chunk));
+            pos = end + 1;
+        }
+    }
+    return true;
+}
+
+// Collect the segments up to the next {elsif}, {else} or {endif} or up to the end of the template.
+static bool build_segments(std::vector<Chunk> &chunks, size_t &i, std::vector<CompiledTemplate::Segment> &segments)
+{
+    while (i < chunks.size()) {
+        Chunk &chunk = chunks[i];
+        if (chunk.type == ChunkType::Segment) {
+            segments.emplace_back(std::move(chunk.segment));
+            ++ i;
+        } else if (chunk.type == ChunkType::If) {
+            CompiledTemplate::Segment conditional { CompiledTemplate::Segment::Type::Conditional };
+            for (;;) {
+                // chunks[i] is {if}, {elsif} or {else}.
+                Chunk &header = chunks[i];
+                CompiledTemplate::Branch branch { header.segment.begin, header.segment.end, header.type == ChunkType::Else, std::move(header.segment.expression) };
+                ++ i;
+                if (! build_segments(chunks, i, branch.segments) || i == chunks.size())
+                    return false;
+                conditional.branches.emplace_back(std::move(branch));
+                if (chunks[i].type == ChunkType::Endif) {
+                    ++ i;
+                    break;
+                }
+                if (conditional.branches.back().is_else)
+                    // {elsif} or {else} after {else}.
+                    return false;
+            }
+            segments.emplace_back(std::move(conditional));
+        } else
+            return true;
+    }
+    return true;
+}
+
+// Returns nullptr if the template cannot be split into segments and it shall be processed by the grammar as a whole.
+static std::shared_ptr<const CompiledTemplate> compile_template(const std::string &templ)
+{
+    std::vector<Chunk> chunks;
+    if (! split_template(templ, chunks))
+        return nullptr;
+    auto   compiled = std::make_shared<CompiledTemplate>();
+    size_t i        = 0;
+    if (! build_segments(chunks, i, compiled->segments) || i != chunks.size())
+        return nullptr;
+    return compiled;
+}
+
+static std::string process_range(const std::string &templ, size_t begin, size_t end, client::MyContext &context)
+{
+    std::string output;
+    phrase_parse(templ.begin() + begin, templ.begin() + end, g_macro_processor_instance(&context), client::skipper{}, output);
+    if (! context.error_message.empty())
+        throw Slic3r::PlaceholderParserError(context.error_message);
+    return output;
+}
+
+static void process_segments(const std::string &templ, const std::vector<CompiledTemplate::Segment> &segments, client::MyContext &context, std::string &output)
+{
+    using Type = CompiledTemplate::Segment::Type;
+    auto range = [&templ](size_t begin, size_t end) { return client::IteratorRange(templ.begin() + begin, templ.begin() + end); };
+    for (const CompiledTemplate::Segment &segment : segments)
+        switch (segment.type) {
+        case Type::Text:
+            output.append(templ, segment.begin, segment.end - segment.begin);
+            break;
+        case Type::LegacyVariable:
+        case Type::LegacyVectorVariable:
+        {
+            client::IteratorRange opt_key = range(segment.begin, segment.end);
+            std::string           value;
+            if (segment.type == Type::LegacyVariable)
+                client::MyContext::legacy_variable_expansion(&context, opt_key, value);
+            else {
+                client::IteratorRange opt_index = range(segment.index_begin, segment.index_end);
+                client::MyContext::legacy_variable_expansion2(&context, opt_key, opt_index, value);
+            }
+            output += value;
+            break;
+        }
+        case Type::Expression:
+        {
+            client::expr value;
+            std::string  str;
+            evaluate_expression(templ, *segment.expression, context, value);
+            client::expr::to_string2(value, str);
+            output += str;
+            break;
+        }
+        case Type::Macro:
+            output += process_range(templ, segment.begin, segment.end, context);
+            break;
+        case Type::Conditional:
+        {
+            // Same order of evaluation as by the grammar: The conditions are evaluated up to the end of the block,
+            // the first branch satisfied is expanded before the conditions following it are evaluated.
+            bool consumed = false;
+            for (const CompiledTemplate::Branch &branch : segment.branches) {
+                bool condition = branch.is_else;
+                if (! branch.is_else && branch.condition) {
+                    client::expr value;
+                    evaluate_expression(templ, *branch.condition, context, value);
+                    client::expr::evaluate_boolean(value, condition);
+                } else if (! branch.is_else) {
+                    context.just_boolean_expression = true;
+                    condition = process_range(templ, branch.begin, branch.end, context) == "true";
+                    context.just_boolean_expression = false;
+                }
+                if (condition && ! consumed) {
+                    process_segments(templ, branch.segments, context, output);
+                    consumed = true;
+                }
+            }
+            break;
+        }
+        }
+}
+
 std::string PlaceholderParser::process(const std::string &templ, unsigned int current_extruder_id, const DynamicConfig *config_override, DynamicConfig *config_outputs, ContextData *context_data) const
 {
     client::MyContext context;
-    context.external_config 	= this->external_config();
+    context.external_config     = this->external_config();
     context.config              = &this->config();
     context.config_override     = config_override;
     context.config_outputs      = config_outputs;
@@ -2355,6 +2995,50 @@ std::string PlaceholderParser::process(const std::string &templ, unsigned int cu
     return process_macro(templ, context);
 }
 
+std::string PlaceholderParser::process(const std::string &templ, CachedTemplate &cached, unsigned int current_extruder_id, const DynamicConfig *config_override, DynamicConfig *config_outputs, ContextData *context_data) const
+{
+    if (! cached.valid || cached.templ != templ) {
+        // Only a template accepted by the grammar is compiled, thus the syntax of the branches not taken
+        // by the compiled template has been verified already.
+        cached.valid = false;
+        std::string output = this->process(templ, current_extruder_id, config_override, config_outputs, context_data);
+        cached.templ    = templ;
+        cached.compiled = compile_template(templ);
+        cached.valid    = true;
+        return output;
+    }
+    if (! cached.compiled)
+        return this->process(templ, current_extruder_id, config_override, config_outputs, context_data);
+
+    client::MyContext context;
+    context.external_config     = this->external_config();
+    context.config              = &this->config();
+    context.config_override     = config_override;
+    context.config_outputs      = config_outputs;
+    context.current_extruder_id = current_extruder_id;
+    context.context_data        = context_data;
+    try {
+        std::string output;
+        process_segments(templ, cached.compiled->segments, context, output);
+        return output;
+    } catch (const std::exception &) {
+        // Let the grammar report the error with its position in the whole template. The grammar runs on copies
+        // of the outputs and of the context data, the assignments and the random numbers drawn by the failed run
+        // shall not be applied twice.
+        DynamicConfig outputs;
+        if (config_outputs)
+            outputs = *config_outputs;
+        ContextData data;
+        if (context_data) {
+            data.rng = context_data->rng;
+            if (context_data->global_config)
+                data.global_config = std::make_unique<DynamicConfig>(*context_data->global_config);
+        }
+        this->process(templ, current_extruder_id, config_override, config_outputs ? &outputs : nullptr, context_data ? &data : nullptr);
+        throw;
+    }
+}
+
 // Evaluate a boolean expression using the full expressive power of the PlaceholderParser boolean expression syntax.
 // Throws Slic3r::RuntimeError on syntax or runtime error.
 bool PlaceholderParser::evaluate_boolean_expression(const std::string &templ, const DynamicConfig &config, const DynamicConfig *config_override)
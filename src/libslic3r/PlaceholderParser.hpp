@@ -3,6 +3,7 @@
 
 #include "libslic3r.h"
 #include <map>
+#include <memory>
 #include <random>
 #include <string>
 #include <string_view>
@@ -62,6 +63,20 @@ public:
     std::string process(const std::string &templ, unsigned int current_extruder_id = 0, const DynamicConfig *config_override = nullptr, ContextData *context = nullptr) const
         { return this->process(templ, current_extruder_id, config_override, nullptr /* config_outputs */, context); }
 
+    // Template split into literal text, expression trees and {if} blocks, see CachedTemplate.
+    struct CompiledTemplate;
+    // A template processed repeatedly, for example the per layer custom G-code, is compiled with its first processing,
+    // the following calls with the same template process the compiled form instead of parsing the template again.
+    // Code blocks out of the compiled subset are still run through the grammar. The cache is owned by the caller.
+    struct CachedTemplate {
+        // Template, from which compiled was produced.
+        std::string                                 templ;
+        // nullptr if the template could not be compiled.
+        std::shared_ptr<const CompiledTemplate>     compiled;
+        bool                                        valid { false };
+    };
+    std::string process(const std::string &templ, CachedTemplate &cached, unsigned int current_extruder_id, const DynamicConfig *config_override, DynamicConfig *config_outputs, ContextData *context) const;
+
     // Evaluate a boolean expression using the full expressive power of the PlaceholderParser boolean expression syntax.
     // Throws Slic3r::PlaceholderParserError on syntax or runtime error.
     static bool evaluate_boolean_expression(const std::string &templ, const DynamicConfig &config, const DynamicConfig *config_override = nullptr);
@@ -13,6 +13,8 @@
 #include <set>
 #include <fstream>
 #include <unordered_set>
+#include <unordered_map>
+#include <functional>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/clamp.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -26,6 +28,9 @@
 #include <boost/log/trivial.hpp>
 #include <miniz/miniz.h>
 
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
 
 // Store the print/filament/printer presets into a "presets" subdirectory of the Slic3rPE config dir.
 // This breaks compatibility with the upstream Slic3r if the --datadir is used to switch between the two versions.
@@ -2636,11 +2641,73 @@ void PresetBundle::load_config_file_config(const std::string &name_or_path, bool
 }
 
 //BBS: Load a config bundle file from json
+namespace {
+
+// A preset subfile of a vendor profile, deserialized but not yet merged with its parent.
+struct ParsedPresetFile
+{
+    ParsedPresetFile(const std::pair<std::string, std::string> &subfile, ForwardCompatibilitySubstitutionRule compatibility_rule)
+        : subfile(&subfile), substitution_context(compatibility_rule) {}
+
+    // Preset name and path relative to the vendor directory, as listed in the vendor json.
+    const std::pair<std::string, std::string> *subfile;
+    DynamicPrintConfig                         config;
+    std::map<std::string, std::string>         key_values;
+    ConfigSubstitutionContext                  substitution_context;
+    std::string                                reason;
+};
+
+// Load the subfiles in parallel and order them topologically by the "inherits" key, so that each preset is preceded
+// by its parent if the parent is listed in subfiles as well. The vendor profiles are expected to be listed in that order
+// already, in which case the order is kept.
+std::vector<ParsedPresetFile> parse_preset_files(const std::string &dir, const std::vector<std::pair<std::string, std::string>> &subfiles,
+                                                 ForwardCompatibilitySubstitutionRule compatibility_rule)
+{
+    std::vector<ParsedPresetFile> parsed;
+    parsed.reserve(subfiles.size());
+    for (const std::pair<std::string, std::string> &subfile : subfiles)
+        parsed.emplace_back(subfile, compatibility_rule);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, parsed.size(), 8), [&dir, &parsed](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            ParsedPresetFile &file = parsed[i];
+            file.config.load_from_json(dir + "/" + file.subfile->second, file.substitution_context, false, file.key_values, file.reason);
+        }
+    });
+
+    std::unordered_map<std::string, size_t> name_to_idx;
+    for (size_t i = 0; i < parsed.size(); ++ i)
+        if (auto it = parsed[i].key_values.find(BBL_JSON_KEY_NAME); it != parsed[i].key_values.end())
+            name_to_idx.emplace(it->second, i);
+
+    std::vector<size_t> order;
+    std::vector<char>   visited(parsed.size(), false);
+    order.reserve(parsed.size());
+    std::function<void(size_t)> visit = [&](size_t idx) {
+        if (visited[idx])
+            return;
+        // Mark before visiting the parent to stop at inheritance cycles, those are reported when resolving the parent fails.
+        visited[idx] = true;
+        if (auto it = parsed[idx].key_values.find(BBL_JSON_KEY_INHERITS); it != parsed[idx].key_values.end())
+            if (auto it_parent = name_to_idx.find(it->second); it_parent != name_to_idx.end())
+                visit(it_parent->second);
+        order.emplace_back(idx);
+    };
+    for (size_t i = 0; i < parsed.size(); ++ i)
+        visit(i);
+
+    std::vector<ParsedPresetFile> sorted;
+    sorted.reserve(parsed.size());
+    for (size_t idx : order)
+        sorted.emplace_back(std::move(parsed[idx]));
+    return sorted;
+}
+
+} // namespace
+
 std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_from_json(
     const std::string &path, const std::string &vendor_name, LoadConfigBundleAttributes flags, ForwardCompatibilitySubstitutionRule compatibility_rule, const PresetBundle* base_bundle)
 {
-    // Enable substitutions for user config bundle, throw an exception when loading a system profile.
-    ConfigSubstitutionContext  substitution_context { compatibility_rule };
     PresetsConfigSubstitutions substitutions;
 
     //BBS: add config related logs
@@ -2846,16 +2913,23 @@ std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_
     PresetCollection         *presets = nullptr;
     size_t                   presets_loaded = 0;
 
+    // Reading and deserializing the JSON files is independent of the other presets, thus all the subfiles of the vendor
+    // are parsed in parallel up front. Resolving the inheritance and filling in the collections stays serial.
+    std::vector<ParsedPresetFile> process_files  = parse_preset_files(path + "/" + vendor_name, process_subfiles, compatibility_rule);
+    std::vector<ParsedPresetFile> filament_files = parse_preset_files(path + "/" + vendor_name, filament_subfiles, compatibility_rule);
+    std::vector<ParsedPresetFile> machine_files  = parse_preset_files(path + "/" + vendor_name, machine_subfiles, compatibility_rule);
+
     auto parse_subfile = [this, path, vendor_name, presets_loaded, current_vendor_profile, base_bundle](
-        ConfigSubstitutionContext& substitution_context,
+        ParsedPresetFile& parsed,
         PresetsConfigSubstitutions& substitutions,
         LoadConfigBundleAttributes& flags,
-        std::pair<std::string, std::string>& subfile_iter,
         std::map<std::string, DynamicPrintConfig>& config_maps,
         std::map<std::string, std::string>& filament_id_maps,
         PresetCollection* presets_collection,
         size_t& count, bool is_from_lib = false) -> std::string {
 
+        const std::pair<std::string, std::string> &subfile_iter = *parsed.subfile;
+        ConfigSubstitutionContext &substitution_context = parsed.substitution_context;
         std::string subfile = path + "/" + vendor_name + "/" + subfile_iter.second;
         // Load the print, filament or printer preset.
         std::string               preset_name;
@@ -2863,15 +2937,10 @@ std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_
         std::string 			  alias_name, inherits, description, instantiation, setting_id, filament_id;
         std::vector<std::string>  renamed_from;
         const DynamicPrintConfig* default_config = nullptr;
-        std::string               reason;
+        std::string               reason = std::move(parsed.reason);
         try {
-            std::map<std::string, std::string> key_values;
-            substitution_context.substitutions.clear();
-
-            //parse the json elements
-            DynamicPrintConfig config_src;
-            std::string _renamed_from_str;
-            config_src.load_from_json(subfile, substitution_context, false, key_values, reason);
+            std::map<std::string, std::string> &key_values = parsed.key_values;
+            DynamicPrintConfig                 &config_src = parsed.config;
             if (!reason.empty()) {
                 ++m_errors;
                 BOOST_LOG_TRIVIAL(error) << __FUNCTION__<< ": load config file "<<subfile<<" Failed!";
@@ -3081,13 +3150,13 @@ std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_
     presets = &this->prints;
     configs.clear();
     filament_id_maps.clear();
-    for (auto& subfile : process_subfiles)
+    for (ParsedPresetFile& parsed : process_files)
     {
-        std::string reason = parse_subfile(substitution_context, substitutions, flags, subfile, configs, filament_id_maps, presets, presets_loaded);
+        std::string reason = parse_subfile(parsed, substitutions, flags, configs, filament_id_maps, presets, presets_loaded);
         if (!reason.empty()) {
             ++m_errors;
             //parse error
-            std::string subfile_path = path + "/" + vendor_name + "/" + subfile.second;
+            std::string subfile_path = path + "/" + vendor_name + "/" + parsed.subfile->second;
             BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << boost::format(", got error when parse process setting from %1%") % subfile_path;
             throw ConfigurationError((boost::format("Failed loading configuration file %1%\nSuggest cleaning the directory %2% firstly") % subfile_path % path).str());
         }
@@ -3098,14 +3167,14 @@ std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_
     configs.clear();
     filament_id_maps.clear();
     const auto is_orca_lib = vendor_name == ORCA_FILAMENT_LIBRARY;
-    for (auto& subfile : filament_subfiles)
+    for (ParsedPresetFile& parsed : filament_files)
     {
-        std::string reason = parse_subfile(substitution_context, substitutions, flags, subfile, configs, filament_id_maps, presets,
+        std::string reason = parse_subfile(parsed, substitutions, flags, configs, filament_id_maps, presets,
                                            presets_loaded, is_orca_lib);
         if (!reason.empty()) {
             ++m_errors;
             //parse error
-            std::string subfile_path = path + "/" + vendor_name + "/" + subfile.second;
+            std::string subfile_path = path + "/" + vendor_name + "/" + parsed.subfile->second;
             BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << boost::format(", got error when parse filament setting from %1%") % subfile_path;
             throw ConfigurationError((boost::format("Failed loading configuration file %1%\nSuggest cleaning the directory %2% firstly") % subfile_path % path).str());
         }
@@ -3119,13 +3188,13 @@ std::pair<PresetsConfigSubstitutions, size_t> PresetBundle::load_vendor_configs_
     presets = &this->printers;
     configs.clear();
     filament_id_maps.clear();
-    for (auto& subfile : machine_subfiles)
+    for (ParsedPresetFile& parsed : machine_files)
     {
-        std::string reason = parse_subfile(substitution_context, substitutions, flags, subfile, configs, filament_id_maps, presets, presets_loaded);
+        std::string reason = parse_subfile(parsed, substitutions, flags, configs, filament_id_maps, presets, presets_loaded);
         if (!reason.empty()) {
             ++m_errors;
             //parse error
-            std::string subfile_path = path + "/" + vendor_name + "/" + subfile.second;
+            std::string subfile_path = path + "/" + vendor_name + "/" + parsed.subfile->second;
             BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << boost::format(", got error when parse printer setting from %1%") % subfile_path;
             throw ConfigurationError((boost::format("Failed loading configuration file %1%\nSuggest cleaning the directory %2% firstly") % subfile_path % path).str());
         }
@@ -14,6 +14,7 @@
 #include "GCode.hpp"
 #include "GCode/WipeTower.hpp"
 #include "GCode/WipeTower2.hpp"
+#include "Format/SliceCache.hpp"
 #include "Utils.hpp"
 #include "PrintConfig.hpp"
 #include "Model.hpp"
@@ -23,7 +24,12 @@
 #include "libslic3r/FileSystem/Log.hpp"
 
 #include <algorithm>
+#include <array>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <mutex>
 #include <unordered_set>
 #include <boost/filesystem/path.hpp>
 #include <boost/format.hpp>
@@ -31,8 +37,11 @@
 #include <boost/regex.hpp>
 #include <boost/nowide/fstream.hpp>
 
+#include <openssl/md5.h>
+
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
+#include <tbb/task_group.h>
 
 //BBS: add json support
 #include "nlohmann/json.hpp"
@@ -68,17 +77,13 @@ void Print::clear()
 	m_objects.clear();
     m_print_regions.clear();
     m_model.clear_objects();
+    m_gcode_generator_cache.reset();
 }
 
-// Called by Print::apply().
-// This method only accepts PrintConfig option keys.
-bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+// Cache the plenty of parameters, which influence the G-code generator only,
+// or they are only notes not influencing the generated G-code.
+static const std::unordered_set<std::string>& print_options_gcode_only()
 {
-    if (opt_keys.empty())
-        return false;
-
-    // Cache the plenty of parameters, which influence the G-code generator only,
-    // or they are only notes not influencing the generated G-code.
     static std::unordered_set<std::string> steps_gcode = {
         //BBS
         "additional_cooling_fan_speed",
@@ -210,12 +215,18 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
         "filament_long_retractions_when_cut",
         "filament_retraction_distances_when_cut"
     };
+    return steps_gcode;
+}
+
+// Collects the steps depending on opt_keys, see invalidate_state_by_config_options(). The slicing cache keys are built from the same steps.
+// This method only accepts PrintConfig option keys.
+bool Print::steps_of_config_options(const std::vector<t_config_option_key> &opt_keys, std::vector<PrintStep> &steps, std::vector<PrintObjectStep> &osteps)
+{
+    const std::unordered_set<std::string> &steps_gcode = print_options_gcode_only();
 
     static std::unordered_set<std::string> steps_ignore;
 
-    std::vector<PrintStep> steps;
-    std::vector<PrintObjectStep> osteps;
-    bool invalidated = false;
+    bool all_handled = true;
 
     for (const t_config_option_key &opt_key : opt_keys) {
         if (steps_gcode.find(opt_key) != steps_gcode.end()) {
@@ -349,10 +360,25 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
         } else {
             // for legacy, if we can't handle this option let's invalidate all steps
             //FIXME invalidate all steps of all objects as well?
-            invalidated |= this->invalidate_all_steps();
+            all_handled = false;
             // Continue with the other opt_keys to possibly invalidate any object specific steps.
         }
     }
+    return all_handled;
+}
+
+// Called by Print::apply().
+// This method only accepts PrintConfig option keys.
+bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+{
+    if (opt_keys.empty())
+        return false;
+
+    std::vector<PrintStep> steps;
+    std::vector<PrintObjectStep> osteps;
+    bool invalidated = false;
+    if (! steps_of_config_options(opt_keys, steps, osteps))
+        invalidated |= this->invalidate_all_steps();
 
     sort_remove_duplicates(steps);
     for (PrintStep step : steps)
@@ -1918,71 +1944,72 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
 
     BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": total object counts %1% in current print, need to slice %2%")%m_objects.size()%need_slicing_objects.size();
     BOOST_LOG_TRIVIAL(info) << "Starting the slicing process." << log_memory_info();
+    // Objects sliced from scratch, which were not found complete in the persistent slicing cache, with their cache keys.
+    std::vector<SliceCacheMiss> slice_cache_misses;
     if (!use_cache) {
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->make_perimeters();
+        // Objects shared with another object only pass their steps through, they copy the layers of the shared object below.
+        auto skip_object_steps = [](PrintObject *obj) {
+            for (PrintObjectStep step : { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill, posIroning,
+                                          posSupportMaterial, posDetectOverhangsForLift })
+                if (obj->set_started(step))
+                    obj->set_done(step);
+        };
+        // Each object advances through its steps independently of the other objects, so that the steps of different objects
+        // overlap instead of waiting for each other on a barrier between the steps. The layers of a single object are still
+        // processed in parallel by the nested tbb::parallel_for() calls, which share the same TBB worker pool.
+        // The sliced layers of the objects not found in the slicing cache are stored before the other steps modify them.
+        auto process_object_steps = [this, &slice_cache_misses](PrintObject *obj) {
+            if (auto miss = std::find_if(slice_cache_misses.begin(), slice_cache_misses.end(), [obj](const SliceCacheMiss &m) { return m.print_object == obj; });
+                miss != slice_cache_misses.end() && ! miss->sliced_loaded) {
+                obj->slice();
+                m_slice_cache_store->store(*obj, miss->keys.sliced);
             }
-            else {
-                if (obj->set_started(posSlice))
-                    obj->set_done(posSlice);
-                if (obj->set_started(posPerimeters))
-                    obj->set_done(posPerimeters);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->estimate_curled_extrusions();
-            }
-            else {
-                if (obj->set_started(posEstimateCurledExtrusions))
-                    obj->set_done(posEstimateCurledExtrusions);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->infill();
-            }
-            else {
-                if (obj->set_started(posPrepareInfill))
-                    obj->set_done(posPrepareInfill);
-                if (obj->set_started(posInfill))
-                    obj->set_done(posInfill);
-            }
-        }
+            obj->make_perimeters();
+            obj->estimate_curled_extrusions();
+            obj->infill();
+            obj->ironing();
+            obj->generate_support_material();
+            obj->detect_overhangs_for_lift();
+        };
+        std::vector<PrintObject*> objects_to_slice;
         for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->ironing();
-            }
-            else {
-                if (obj->set_started(posIroning))
-                    obj->set_done(posIroning);
-            }
+            if (need_slicing_objects.count(obj) != 0)
+                objects_to_slice.emplace_back(obj);
+            else
+                skip_object_steps(obj);
         }
-
-        tbb::parallel_for(tbb::blocked_range<int>(0, int(m_objects.size())),
-            [this, need_slicing_objects](const tbb::blocked_range<int>& range) {
-                for (int i = range.begin(); i < range.end(); i++) {
-                    PrintObject* obj = m_objects[i];
-                    if (need_slicing_objects.count(obj) != 0) {
-                        obj->generate_support_material();
+        if (m_slice_cache_store != nullptr)
+            objects_to_slice = this->load_objects_from_slice_cache(objects_to_slice, slice_cache_misses);
+        if (objects_to_slice.size() == 1)
+            process_object_steps(objects_to_slice.front());
+        else if (! objects_to_slice.empty()) {
+            // Start the most expensive objects first, so that the small objects fill the gaps at the end.
+            std::vector<std::pair<double, PrintObject*>> ordered;
+            ordered.reserve(objects_to_slice.size());
+            for (PrintObject *obj : objects_to_slice)
+                ordered.emplace_back(double(obj->height()) * double(std::max<size_t>(obj->model_object()->facets_count(), 1)), obj);
+            std::stable_sort(ordered.begin(), ordered.end(), [](const auto &l, const auto &r) { return l.first > r.first; });
+            // An exception escaping a task would cancel the task group together with the nested parallel loops of the other
+            // objects, which would then finish their steps with partially processed layers and mark them as done.
+            // Each task keeps its exception, the first one (including CanceledException) is rethrown once all the tasks finished.
+            std::mutex         exception_mutex;
+            std::exception_ptr exception;
+            tbb::task_group    object_tasks;
+            for (const std::pair<double, PrintObject*> &item : ordered) {
+                PrintObject *obj = item.second;
+                object_tasks.run([obj, &process_object_steps, &exception_mutex, &exception]() {
+                    try {
+                        process_object_steps(obj);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(exception_mutex);
+                        if (! exception)
+                            exception = std::current_exception();
                     }
-                    else {
-                        if (obj->set_started(posSupportMaterial))
-                            obj->set_done(posSupportMaterial);
-                    }
-                }
-            }
-        );
-
-        for (PrintObject* obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->detect_overhangs_for_lift();
-            }
-            else {
-                if (obj->set_started(posDetectOverhangsForLift))
-                    obj->set_done(posDetectOverhangsForLift);
+                });
             }
+            object_tasks.wait();
+            if (exception)
+                std::rethrow_exception(exception);
         }
     }
     else {
@@ -2137,6 +2164,11 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
                 obj->set_done(posSimplifySupportPath);
         }
     }
+    // The simplified extrusions are stored, so that a cache hit skips the simplification as well.
+    for (const SliceCacheMiss &miss : slice_cache_misses)
+        m_slice_cache_store->store(*miss.print_object, miss.keys.complete);
+    if (! slice_cache_misses.empty())
+        m_slice_cache_store->evict();
 
     // BBS
     bool has_adaptive_layer_height = false;
@@ -2146,6 +2178,7 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
             break;
         }
     }
+    m_all_conflict_results.clear();
     // TODO adaptive layer height won't work with conflict checker because m_fake_wipe_tower's path is generated using fixed layer height
     if(!m_no_check && !has_adaptive_layer_height)
     {
@@ -2156,7 +2189,7 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
             m_fake_wipe_tower.set_pos({m_config.wipe_tower_x.get_at(m_plate_index), m_config.wipe_tower_y.get_at(m_plate_index)});
             wipe_tower_opt = std::make_optional<const FakeWipeTower *>(&m_fake_wipe_tower);
         }
-        auto            conflictRes = ConflictChecker::find_inter_of_lines_in_diff_objs(m_objects, wipe_tower_opt);
+        auto            conflictRes = ConflictChecker::find_inter_of_lines_in_diff_objs(m_objects, wipe_tower_opt, m_report_all_conflicts ? &m_all_conflict_results : nullptr);
         auto            endTime     = Clock::now();
         volatile double seconds     = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() / (double) 1000;
         BOOST_LOG_TRIVIAL(info) << "gcode path conflicts check takes " << seconds << " secs.";
@@ -2165,6 +2198,8 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
         if (conflictRes.has_value()) {
             BOOST_LOG_TRIVIAL(error) << boost::format("gcode path conflicts found between %1% and %2%")%conflictRes.value()._objName1 %conflictRes.value()._objName2;
         }
+        for (const ConflictResult &conflict : m_all_conflict_results)
+            BOOST_LOG_TRIVIAL(info) << boost::format("gcode path conflicts between %1% and %2% from z %3% to z %4%") % conflict._objName1 % conflict._objName2 % conflict._height % conflict._last_height;
     }
 
     BOOST_LOG_TRIVIAL(info) << "Slicing process finished." << log_memory_info();
@@ -3817,7 +3852,7 @@ static void from_json(const json& j, groupedVolumeSlices& firstlayer_group)
     }
 }
 
-int Print::export_cached_data(const std::string& directory, bool with_space)
+int Print::export_cached_data(const std::string& directory, bool with_space, bool json_format)
 {
     int ret = 0;
     boost::filesystem::path directory_path(directory);
@@ -3895,10 +3930,23 @@ int Print::export_cached_data(const std::string& directory, bool with_space)
         const PrintInstance &print_instance = obj->instances()[0];
         const ModelInstance *model_instance = print_instance.model_instance;
         size_t identify_id = (model_instance->loaded_id > 0)?model_instance->loaded_id: model_instance->id().id;
-        std::string file_name = directory +"/obj_"+std::to_string(identify_id)+".json";
+        std::string file_name = directory +"/obj_"+std::to_string(identify_id)+(json_format ? ".json" : SLICE_CACHE_EXTENSION);
 
         BOOST_LOG_TRIVIAL(info) << boost::format("begin to dump object %1%, identify_id %2% to %3%")%model_obj->name %identify_id %file_name;
 
+        if (!json_format) {
+            //the binary cache serializes the layers in parallel by itself
+            try {
+                store_slice_cache(*obj, identify_id, file_name);
+                count ++;
+            }
+            catch(std::exception &err) {
+                BOOST_LOG_TRIVIAL(error) << __FUNCTION__<< ": save to "<<file_name<<" got a generic exception, reason = " << err.what();
+                ret = CLI_EXPORT_CACHE_WRITE_FAILED;
+            }
+            continue;
+        }
+
         try {
             json root_json, layers_json = json::array(), support_layers_json = json::array(), first_layer_groups = json::array();
 
@@ -4128,7 +4176,18 @@ int Print::load_cached_data(const std::string& directory)
             BOOST_LOG_TRIVIAL(info) << __FUNCTION__<< boost::format(": object %1%'s loaded_id is 0, need to use the instance_id %2%")%model_obj->name %identify_id;
             //continue;
         }
-        std::string file_name = directory +"/obj_"+std::to_string(identify_id)+".json";
+        //prefer the binary cache, fall back to the json one
+        std::string file_name = directory +"/obj_"+std::to_string(identify_id)+SLICE_CACHE_EXTENSION;
+        if (fs::exists(file_name)) {
+            int load_ret = load_slice_cache(*obj, file_name, [obj, &find_region](size_t config_hash) { return find_region(obj, config_hash); });
+            if (load_ret) {
+                BOOST_LOG_TRIVIAL(error) << __FUNCTION__<< boost::format(": load binary cache %1% failed, ret=%2%")%file_name %load_ret;
+                return load_ret;
+            }
+            count ++;
+            continue;
+        }
+        file_name = directory +"/obj_"+std::to_string(identify_id)+".json";
 
         if (!fs::exists(file_name)) {
             BOOST_LOG_TRIVIAL(info) << __FUNCTION__<<boost::format(": file %1% not exist, maybe a shared object, skip it")%file_name;
@@ -4305,6 +4364,205 @@ int Print::load_cached_data(const std::string& directory)
     return ret;
 }
 
+std::vector<PrintObject*> Print::load_objects_from_slice_cache(const std::vector<PrintObject*> &objects, std::vector<SliceCacheMiss> &misses)
+{
+    enum class Loaded : char { None, Sliced, Complete };
+    std::vector<SliceCacheKeys> keys(objects.size());
+    std::vector<Loaded>         loaded(objects.size(), Loaded::None);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, objects.size()), [this, &objects, &keys, &loaded](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            PrintObject *obj = objects[i];
+            // An object with some of its steps still valid is finished incrementally.
+            if (obj->is_step_done(posSlice))
+                continue;
+            auto find_region = [obj](size_t config_hash) -> const PrintRegion* {
+                for (size_t idx = 0; idx < obj->num_printing_regions(); ++ idx)
+                    if (obj->printing_region(idx).config_hash() == config_hash)
+                        return &obj->printing_region(idx);
+                return nullptr;
+            };
+            keys[i] = this->slice_cache_keys(*obj);
+            for (auto [key, state] : { std::make_pair(&keys[i].complete, Loaded::Complete), std::make_pair(&keys[i].sliced, Loaded::Sliced) }) {
+                obj->clear_layers();
+                obj->clear_support_layers();
+                if (m_slice_cache_store->load(*obj, *key, find_region)) {
+                    loaded[i] = state;
+                    break;
+                }
+            }
+            if (loaded[i] == Loaded::None) {
+                // Drop the layers of a partially loaded file.
+                obj->clear_layers();
+                obj->clear_support_layers();
+            }
+        }
+    });
+
+    std::vector<PrintObject*> objects_to_slice;
+    for (size_t i = 0; i < objects.size(); ++ i) {
+        PrintObject *obj = objects[i];
+        if (loaded[i] == Loaded::Complete) {
+            // The stored layers were simplified already.
+            for (PrintObjectStep step : { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill, posIroning, posSupportMaterial,
+                                          posDetectOverhangsForLift, posSimplifyPath, posSimplifyInfill, posSimplifySupportPath })
+                if (obj->set_started(step))
+                    obj->set_done(step);
+        } else {
+            if (loaded[i] == Loaded::Sliced && obj->set_started(posSlice))
+                obj->set_done(posSlice);
+            objects_to_slice.emplace_back(obj);
+            if (! keys[i].complete.empty())
+                misses.push_back({ obj, std::move(keys[i]), loaded[i] == Loaded::Sliced });
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": %1% of %2% objects loaded from the slicing cache %3%, %4% continue from their sliced layers")
+        % std::count(loaded.begin(), loaded.end(), Loaded::Complete) % objects.size() % m_slice_cache_store->directory()
+        % std::count(loaded.begin(), loaded.end(), Loaded::Sliced);
+    return objects_to_slice;
+}
+
+Print::SliceCacheKeys Print::slice_cache_keys(const PrintObject &print_object) const
+{
+    // The object steps in the order their keys are chained: the key of a step covers the inputs of the steps before it.
+    static constexpr PrintObjectStep chained_steps[] = { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill, posIroning,
+        posSupportMaterial, posDetectOverhangsForLift, posSimplifyWall, posSimplifyPath, posSimplifyInfill, posSimplifySupportPath };
+    static constexpr size_t          num_steps       = std::size(chained_steps);
+    static_assert(num_steps == size_t(posCount), "All the object steps are expected to be chained");
+    // Index of the first of steps in chained_steps, num_steps if steps is empty. An unhandled option invalidates all the steps, it goes to posSlice.
+    auto first_step = [](bool handled, const std::vector<PrintObjectStep> &steps) {
+        if (! handled)
+            return size_t(0);
+        size_t idx = num_steps;
+        for (PrintObjectStep step : steps)
+            idx = std::min(idx, size_t(std::find(std::begin(chained_steps), std::end(chained_steps), step) - std::begin(chained_steps)));
+        return idx;
+    };
+
+    // Inputs of each step are hashed separately, then chained.
+    std::array<MD5_CTX, num_steps> ctx;
+    for (MD5_CTX &c : ctx)
+        MD5_Init(&c);
+    auto add_data = [&ctx](size_t step, const void *data, size_t len) { MD5_Update(&ctx[step], data, len); };
+    auto add_size = [&add_data](size_t step, uint64_t value) { add_data(step, &value, sizeof(value)); };
+    auto add_string = [&add_data, &add_size](size_t step, const std::string &value) { add_size(step, value.size()); add_data(step, value.data(), value.size()); };
+    // Options are added by name, so that the keys do not depend on the order of the option definitions. Each option is added to the first step
+    // depending on it, as classified for the step invalidation. The options not influencing the object steps are left out.
+    // Options are prefixed with the index of their config, so that the same options of two configs do not map to the same data.
+    uint64_t config_idx = 0;
+    auto add_config = [&add_size, &add_string, &config_idx](const ConfigBase &config, const std::function<size_t(const t_config_option_key&)> &step_of_option) {
+        t_config_option_keys keys = config.keys();
+        std::sort(keys.begin(), keys.end());
+        for (const t_config_option_key &key : keys)
+            if (size_t step = step_of_option(key); step < num_steps) {
+                add_size(step, config_idx);
+                add_string(step, key);
+                add_string(step, config.opt_serialize(key));
+            }
+        ++ config_idx;
+    };
+    auto add_object_config = [&add_config, &print_object, &first_step](const ConfigBase &config) {
+        add_config(config, [&config, &print_object, &first_step](const t_config_option_key &key) {
+            std::vector<PrintObjectStep> steps;
+            std::vector<PrintStep>       print_steps;
+            bool handled = print_object.steps_of_config_options(config, config, { key }, steps, print_steps);
+            return first_step(handled, steps);
+        });
+    };
+    auto add_facets = [&add_data, &add_size](const FacetsAnnotation &facets) {
+        const TriangleSelector::TriangleSplittingData &data = facets.get_data();
+        add_size(0, data.triangles_to_split.size());
+        for (const TriangleSelector::TriangleBitStreamMapping &mapping : data.triangles_to_split) {
+            add_data(0, &mapping.triangle_idx, sizeof(mapping.triangle_idx));
+            add_data(0, &mapping.bitstream_start_idx, sizeof(mapping.bitstream_start_idx));
+        }
+        std::vector<uint8_t> bits((data.bitstream.size() + 7) / 8, 0);
+        for (size_t i = 0; i < data.bitstream.size(); ++ i)
+            if (data.bitstream[i])
+                bits[i / 8] |= uint8_t(1 << (i % 8));
+        add_size(0, data.bitstream.size());
+        add_data(0, bits.data(), bits.size());
+    };
+
+    // A new version of the slicer or of the cache format may slice the same object differently.
+    add_string(0, LightMaker_VERSION);
+    add_size(0, SLICE_CACHE_VERSION);
+
+    // The meshes are sliced in the coordinate system of trafo_centered(), see PrintObject::slice_volumes().
+    // The raw meshes are hashed together with their transformation instead of transforming each vertex.
+    const ModelObject *model_object = print_object.model_object();
+    const Transform3d  trafo        = print_object.trafo_centered();
+    add_size(0, model_object->volumes.size());
+    for (const ModelVolume *volume : model_object->volumes) {
+        const indexed_triangle_set &its    = volume->mesh().its;
+        const Transform3d           matrix = trafo * volume->get_matrix();
+        add_size(0, size_t(volume->type()));
+        add_data(0, matrix.data(), 16 * sizeof(double));
+        add_size(0, its.vertices.size());
+        add_data(0, its.vertices.data(), its.vertices.size() * sizeof(stl_vertex));
+        add_size(0, its.indices.size());
+        add_data(0, its.indices.data(), its.indices.size() * sizeof(stl_triangle_vertex_indices));
+        add_facets(volume->supported_facets);
+        add_facets(volume->seam_facets);
+        add_facets(volume->mmu_segmentation_facets);
+        add_object_config(volume->config.get());
+    }
+    add_object_config(model_object->config.get());
+    const std::vector<coordf_t> layer_height_profile = model_object->layer_height_profile.get();
+    add_size(0, layer_height_profile.size());
+    add_data(0, layer_height_profile.data(), layer_height_profile.size() * sizeof(coordf_t));
+    add_size(0, model_object->layer_config_ranges.size());
+    for (const auto &[range, config] : model_object->layer_config_ranges) {
+        add_data(0, &range.first, sizeof(range.first));
+        add_data(0, &range.second, sizeof(range.second));
+        add_object_config(config.get());
+    }
+
+    // Assignment of the volumes and of the painted areas to the printing regions, which the region slices are split by.
+    const PrintObjectRegions *regions   = print_object.shared_regions();
+    auto                      region_id = [](const PrintRegion *region) { return region == nullptr ? uint64_t(-1) : uint64_t(region->print_object_region_id()); };
+    add_size(0, print_object.num_printing_regions());
+    add_size(0, regions->layer_ranges.size());
+    for (const PrintObjectRegions::LayerRangeRegions &layer_range : regions->layer_ranges) {
+        add_data(0, &layer_range.layer_height_range.first, sizeof(layer_range.layer_height_range.first));
+        add_data(0, &layer_range.layer_height_range.second, sizeof(layer_range.layer_height_range.second));
+        add_size(0, layer_range.volume_regions.size());
+        for (const PrintObjectRegions::VolumeRegion &volume_region : layer_range.volume_regions) {
+            add_size(0, std::find(model_object->volumes.begin(), model_object->volumes.end(), volume_region.model_volume) - model_object->volumes.begin());
+            add_size(0, uint64_t(volume_region.parent));
+            add_size(0, region_id(volume_region.region));
+        }
+        add_size(0, layer_range.painted_regions.size());
+        for (const PrintObjectRegions::PaintedRegion &painted_region : layer_range.painted_regions) {
+            add_size(0, painted_region.extruder_id);
+            add_size(0, uint64_t(painted_region.parent));
+            add_size(0, region_id(painted_region.region));
+        }
+    }
+
+    // The resolved configs.
+    add_config(m_config, [&first_step](const t_config_option_key &key) {
+        std::vector<PrintStep>       steps;
+        std::vector<PrintObjectStep> osteps;
+        bool handled = steps_of_config_options({ key }, steps, osteps);
+        return first_step(handled, osteps);
+    });
+    add_object_config(print_object.config());
+    for (size_t i = 0; i < print_object.num_printing_regions(); ++ i)
+        add_object_config(print_object.printing_region(i).config());
+
+    std::vector<std::string> keys(num_steps);
+    unsigned char            digest[MD5_DIGEST_LENGTH];
+    for (size_t step = 0; step < num_steps; ++ step) {
+        if (step > 0)
+            add_data(step, digest, MD5_DIGEST_LENGTH);
+        MD5_Final(digest, &ctx[step]);
+        keys[step].reserve(2 * MD5_DIGEST_LENGTH);
+        for (int i = 0; i < MD5_DIGEST_LENGTH; ++ i)
+            keys[step] += (boost::format("%02x") % (unsigned int)digest[i]).str();
+    }
+    return { keys.front(), keys.back() };
+}
+
 BoundingBoxf3 PrintInstance::get_bounding_box() {
     return print_object->model_object()->instance_bounding_box(*model_instance, false);
 }
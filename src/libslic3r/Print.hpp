@@ -37,6 +37,9 @@ class SupportLayer;
 // BBS
 class TreeSupportData;
 class TreeSupport;
+class GCodeExportProfiler;
+class SliceCacheStore;
+struct GCodeGeneratorCache;
 
 #define MAX_OUTER_NOZZLE_DIAMETER   4
 // BBS: move from PrintObjectSlice.cpp
@@ -468,6 +471,10 @@ public:
     // It may be called for both the PrintObjectConfig and PrintRegionConfig.
     bool                    invalidate_state_by_config_options(
         const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys);
+    // Collect the steps depending on opt_keys, the steps invalidated by invalidate_state_by_config_options().
+    // Returns false if some of opt_keys is not handled, which invalidates all the steps.
+    bool                    steps_of_config_options(const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config,
+        const std::vector<t_config_option_key> &opt_keys, std::vector<PrintObjectStep> &steps, std::vector<PrintStep> &print_steps) const;
     // If ! m_slicing_params.valid, recalculate.
     void                    update_slicing_parameters();
 
@@ -844,8 +851,18 @@ public:
     // If preview_data is not null, the preview_data is filled in for the G-code visualization (not used by the command line Slic3r).
     std::string         export_gcode(const std::string& path_template, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb = nullptr);
     //return 0 means successful
-    int                 export_cached_data(const std::string& dir_path, bool with_space=false);
+    int                 export_cached_data(const std::string& dir_path, bool with_space=false, bool json_format=false);
     int                 load_cached_data(const std::string& directory);
+    // Keys of print_object in the persistent slicing cache. A key is chained over the object steps: the key of a step is the MD5
+    // of the key of the previous step and of the inputs of the step, the first step covers the transformed meshes, painted facets,
+    // layer height profile and region layout. A configuration option is an input of the first step invalidated by its change.
+    struct SliceCacheKeys {
+        // Key of the layers sliced by PrintObject::slice(), before the other steps modify them.
+        std::string     sliced;
+        // Key of the object with all its steps done.
+        std::string     complete;
+    };
+    SliceCacheKeys      slice_cache_keys(const PrintObject &print_object) const;
 
     // methods for handling state
     bool                is_step_done(PrintStep step) const { return Inherited::is_step_done(step); }
@@ -952,6 +969,18 @@ public:
     //BBS
     static StringObjectException sequential_print_clearance_valid(const Print &print, Polygons *polygons = nullptr, std::vector<std::pair<Polygon, float>>* height_polygons = nullptr);
     ConflictResultOpt            get_conflict_result() const { return m_conflict_result; }
+    // Enumerate every pair of objects with conflicting paths instead of stopping at the first conflict, used for automated plate QA.
+    void                         set_report_all_conflicts(bool report_all) { m_report_all_conflicts = report_all; }
+    // Record the timing of the G-code export pipeline stages, see GCodeExportProfiler. Not owned by the Print.
+    void                         set_gcode_export_profiler(GCodeExportProfiler *profiler) { m_gcode_export_profiler = profiler; }
+    GCodeExportProfiler*         gcode_export_profiler() const { return m_gcode_export_profiler; }
+    // Finalize the exported G-code in place instead of rewriting it, see GCodeProcessor::enable_single_pass_finalization().
+    void                         set_single_pass_gcode_finalization(bool single_pass) { m_single_pass_gcode_finalization = single_pass; }
+    bool                         single_pass_gcode_finalization() const { return m_single_pass_gcode_finalization; }
+    // Load the objects sliced from scratch from a persistent slicing cache and store them there after slicing. Not owned by the Print.
+    void                         set_slice_cache_store(SliceCacheStore *store) { m_slice_cache_store = store; }
+    SliceCacheStore*             slice_cache_store() const { return m_slice_cache_store; }
+    const ConflictResults&       get_all_conflict_results() const { return m_all_conflict_results; }
 
     // Return 4 wipe tower corners in the world coordinates (shifted and rotated), including the wipe tower brim.
     std::vector<Point>  first_layer_wipe_tower_corners(bool check_wipe_tower_existance=true) const;
@@ -997,10 +1026,23 @@ private:
     static StringObjectException check_multi_filament_valid(const Print &print);
 
     bool                invalidate_state_by_config_options(const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys);
+    // Collect the steps depending on opt_keys, the steps invalidated by invalidate_state_by_config_options().
+    // Returns false if some of opt_keys is not handled, which invalidates all the steps.
+    static bool         steps_of_config_options(const std::vector<t_config_option_key> &opt_keys, std::vector<PrintStep> &steps, std::vector<PrintObjectStep> &osteps);
 
     void                _make_skirt();
     void                _make_wipe_tower();
     void                finalize_first_layer_convex_hull();
+    // Object not found complete in the persistent slicing cache, to be stored once processed.
+    struct SliceCacheMiss {
+        PrintObject    *print_object;
+        SliceCacheKeys  keys;
+        // The sliced layers were loaded from the cache, thus only the complete object is stored.
+        bool            sliced_loaded;
+    };
+    // Load the objects sliced from scratch from m_slice_cache_store. Returns the objects left to be processed, an object
+    // whose sliced layers were found in the cache continues with its perimeters. The objects not found complete are returned in misses.
+    std::vector<PrintObject*> load_objects_from_slice_cache(const std::vector<PrintObject*> &objects, std::vector<SliceCacheMiss> &misses);
 
     // Islands of objects and their supports extruded at the 1st layer.
     Polygons            first_layer_islands() const;
@@ -1027,6 +1069,9 @@ private:
     // Following section will be consumed by the GCodeGenerator.
     ToolOrdering 							m_tool_ordering;
     WipeTowerData                           m_wipe_tower_data {m_tool_ordering};
+    // Layers generated by the last G-code export, reused by the next export up to the first changed layer.
+    // Replaced by GCode::process_layers(), which receives a const Print.
+    mutable std::shared_ptr<GCodeGeneratorCache> m_gcode_generator_cache;
 
     // Estimated print time, filament consumed.
     PrintStatistics                         m_print_statistics;
@@ -1038,6 +1083,11 @@ private:
     int     m_modified_count {0};
     //BBS
     ConflictResultOpt m_conflict_result;
+    ConflictResults   m_all_conflict_results;
+    bool              m_report_all_conflicts {false};
+    GCodeExportProfiler *m_gcode_export_profiler {nullptr};
+    bool              m_single_pass_gcode_finalization {false};
+    SliceCacheStore  *m_slice_cache_store {nullptr};
     FakeWipeTower     m_fake_wipe_tower;
     
     //SoftFever: calibration
@@ -145,6 +145,12 @@ std::function<void()> PrintObjectBase::cancel_callback(PrintBase *print)
 	return print->cancel_callback();
 }
 
+void PrintObjectBase::step_state_changed(PrintBase *print, const PrintObjectBase *print_object, int step, bool done)
+{
+    if (print->m_step_callback)
+        print->m_step_callback(print_object, step, done);
+}
+
 void PrintObjectBase::status_update_warnings(PrintBase *print, int step, PrintStateBase::WarningLevel warning_level,
     const std::string &message, PrintStateBase::SlicingNotificationType message_id)
 {
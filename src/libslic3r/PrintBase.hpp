@@ -342,6 +342,8 @@ protected:
     // Declared here to allow access from PrintBase through friendship.
 	static std::mutex&                  state_mutex(PrintBase *print);
 	static std::function<void()>        cancel_callback(PrintBase *print);
+	// Notify the step observer registered on print (if any) about a step being entered or finished.
+	static void                         step_state_changed(PrintBase *print, const PrintObjectBase *print_object, int step, bool done);
 	// Notify UI about a new warning of a milestone "step" on this PrintObjectBase.
 	// The UI will be notified by calling a status callback registered on print.
 	// If no status callback is registered, the message is printed to console.
@@ -424,7 +426,7 @@ public:
     virtual void            set_task(const TaskParams &params) {}
     // Perform the calculation. This is the only method that is to be called at a worker thread.
     virtual void            process(long long *time_cost_with_cache = nullptr, bool use_cache = false) = 0;
-    virtual int             export_cached_data(const std::string& dir_path, bool with_space=false) { return 0;}
+    virtual int             export_cached_data(const std::string& dir_path, bool with_space=false, bool json_format=false) { return 0;}
     virtual int            load_cached_data(const std::string& directory) { return 0;}
     // Clean up after process() finished, either with success, error or if canceled.
     // The adjustments on the Print / PrintObject data due to set_task() are to be reverted here.
@@ -476,9 +478,17 @@ public:
     void                    set_status_silent() { m_status_callback = [](const SlicingStatus&){}; }
     // Register a custom status callback.
     void                    set_status_callback(status_callback_type cb) { m_status_callback = cb; }
+    const status_callback_type& status_callback() const { return m_status_callback; }
     // Calls a registered callback to update the status, or print out the default message.
     void                    set_status(int percent, const std::string &message, unsigned int flags = SlicingStatus::DEFAULT, int warning_step = -1) const;
 
+    // Observer of the Print / PrintObject step transitions, used by the headless slicer to profile the individual steps.
+    // print_object is null for the Print steps, step is then a PrintStep, otherwise a PrintObjectStep.
+    // done is false when the step is entered and true when the step is finished.
+    // The callback may be called from the TBB worker threads.
+    typedef std::function<void(const PrintObjectBase *print_object, int step, bool done)> step_callback_type;
+    void                    set_step_callback(step_callback_type cb) { m_step_callback = cb; }
+
     typedef std::function<void()>  cancel_callback_type;
     // Various methods will call this callback to stop the background processing (the Print::process() call)
     // in case a successive change of the Print / PrintObject / PrintRegion instances changed
@@ -561,6 +571,8 @@ protected:
 
     // Callback to be evoked regularly to update state of the UI thread.
     status_callback_type                    m_status_callback;
+    // Callback to be evoked when a step is entered or finished, see set_step_callback().
+    step_callback_type                      m_step_callback;
 
 private:
     std::atomic<CancelStatus>               m_cancel_status;
@@ -594,9 +606,16 @@ public:
             this->status_update_warnings(static_cast<int>(active_step.first), warning_level, message, nullptr, message_id);
     }
 protected:
-    bool            set_started(PrintStepEnum step) { return m_state.set_started(step, this->state_mutex(), [this](){ this->throw_if_canceled(); }); }
+    bool            set_started(PrintStepEnum step) {
+        bool started = m_state.set_started(step, this->state_mutex(), [this](){ this->throw_if_canceled(); });
+        if (started && m_step_callback)
+            m_step_callback(nullptr, static_cast<int>(step), false);
+        return started;
+    }
 	PrintStateBase::TimeStamp set_done(PrintStepEnum step) {
 		std::pair<PrintStateBase::TimeStamp, bool> status = m_state.set_done(step, this->state_mutex(), [this](){ this->throw_if_canceled(); });
+        if (m_step_callback)
+            m_step_callback(nullptr, static_cast<int>(step), true);
         if (status.second)
             this->status_update_warnings(static_cast<int>(step), PrintStateBase::WarningLevel::NON_CRITICAL, std::string());
         return status.first;
@@ -634,10 +653,15 @@ public:
 protected:
 	PrintObjectBaseWithState(PrintType *print, ModelObject *model_object) : PrintObjectBase(model_object), m_print(print) {}
 
-    bool            set_started(PrintObjectStepEnum step)
-        { return m_state.set_started(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); }); }
+    bool            set_started(PrintObjectStepEnum step) {
+        bool started = m_state.set_started(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); });
+        if (started)
+            PrintObjectBase::step_state_changed(m_print, this, static_cast<int>(step), false);
+        return started;
+    }
 	PrintStateBase::TimeStamp set_done(PrintObjectStepEnum step) {
 		std::pair<PrintStateBase::TimeStamp, bool> status = m_state.set_done(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); });
+        PrintObjectBase::step_state_changed(m_print, this, static_cast<int>(step), true);
         if (status.second)
             this->status_update_warnings(m_print, static_cast<int>(step), PrintStateBase::WarningLevel::NON_CRITICAL, std::string());
         return status.first;
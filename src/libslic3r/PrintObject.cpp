@@ -16,6 +16,7 @@
 #include "Tesselate.hpp"
 #include "TriangleMeshSlicer.hpp"
 #include "Utils.hpp"
+#include "Arachne/utils/HalfEdgeGraph.hpp"
 #include "Fill/FillAdaptive.hpp"
 #include "Fill/FillLightning.hpp"
 #include "Format/STL.hpp"
@@ -25,6 +26,7 @@
 #include <float.h>
 #include <oneapi/tbb/blocked_range.h>
 #include <oneapi/tbb/concurrent_vector.h>
+#include <oneapi/tbb/enumerable_thread_specific.h>
 #include <oneapi/tbb/parallel_for.h>
 #include <string_view>
 #include <utility>
@@ -381,15 +383,20 @@ void PrintObject::make_perimeters()
     }
 
     BOOST_LOG_TRIVIAL(debug) << "Generating perimeters in parallel - start";
-    tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, m_layers.size()),
-        [this](const tbb::blocked_range<size_t>& range) {
-            for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
-                m_print->throw_if_canceled();
-                m_layers[layer_idx]->make_perimeters();
+    {
+        // The Arachne graphs of the layers processed by a thread reuse the memory of the previous layers.
+        tbb::enumerable_thread_specific<Arachne::HalfEdgeGraphArena> graph_arenas;
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, m_layers.size()),
+            [this, &graph_arenas](const tbb::blocked_range<size_t>& range) {
+                for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                    m_print->throw_if_canceled();
+                    Arachne::HalfEdgeGraphArenaScope graph_arena_scope(graph_arenas.local());
+                    m_layers[layer_idx]->make_perimeters();
+                }
             }
-        }
-    );
+        );
+    }
     m_print->throw_if_canceled();
     BOOST_LOG_TRIVIAL(debug) << "Generating perimeters in parallel - end";
 
@@ -546,15 +553,20 @@ void PrintObject::infill()
         const auto& support_fill_octree = this->m_adaptive_fill_octrees.second;
 
         BOOST_LOG_TRIVIAL(debug) << "Filling layers in parallel - start";
-        tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, m_layers.size()),
-            [this, &adaptive_fill_octree = adaptive_fill_octree, &support_fill_octree = support_fill_octree](const tbb::blocked_range<size_t>& range) {
-                for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
-                    m_print->throw_if_canceled();
-                    m_layers[layer_idx]->make_fills(adaptive_fill_octree.get(), support_fill_octree.get(), this->m_lightning_generator.get());
+        {
+            // For the Arachne graphs of the concentric infill, see make_perimeters().
+            tbb::enumerable_thread_specific<Arachne::HalfEdgeGraphArena> graph_arenas;
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, m_layers.size()),
+                [this, &adaptive_fill_octree = adaptive_fill_octree, &support_fill_octree = support_fill_octree, &graph_arenas](const tbb::blocked_range<size_t>& range) {
+                    for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                        m_print->throw_if_canceled();
+                        Arachne::HalfEdgeGraphArenaScope graph_arena_scope(graph_arenas.local());
+                        m_layers[layer_idx]->make_fills(adaptive_fill_octree.get(), support_fill_octree.get(), this->m_lightning_generator.get());
+                    }
                 }
-            }
-        );
+            );
+        }
         m_print->throw_if_canceled();
         BOOST_LOG_TRIVIAL(debug) << "Filling layers in parallel - end";
         /*  we could free memory now, but this would make this step not idempotent
@@ -871,16 +883,13 @@ SupportLayerPtrs::iterator PrintObject::insert_support_layer(SupportLayerPtrs::i
     return m_support_layers.insert(pos, new SupportLayer(id, interface_id, this, height, print_z, slice_z));
 }
 
-// Called by Print::apply().
+// Collects the steps depending on opt_keys, see invalidate_state_by_config_options(). The slicing cache keys are built from the same steps.
+// Returns false if any of opt_keys is not handled, all the steps depend on such an option.
 // This method only accepts PrintObjectConfig and PrintRegionConfig option keys.
-bool PrintObject::invalidate_state_by_config_options(
-    const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys)
+bool PrintObject::steps_of_config_options(const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys,
+    std::vector<PrintObjectStep> &steps, std::vector<PrintStep> &print_steps) const
 {
-    if (opt_keys.empty())
-        return false;
-
-    std::vector<PrintObjectStep> steps;
-    bool invalidated = false;
+    bool all_handled = true;
     for (const t_config_option_key &opt_key : opt_keys) {
         if (   opt_key == "brim_width"
             || opt_key == "brim_object_gap"
@@ -1184,20 +1193,40 @@ bool PrintObject::invalidate_state_by_config_options(
             || opt_key == "bed_mesh_max"
             || opt_key == "adaptive_bed_mesh_margin"
             || opt_key == "bed_mesh_probe_distance") {
-            invalidated |= m_print->invalidate_step(psGCodeExport);
+            print_steps.emplace_back(psGCodeExport);
         } else if (
                opt_key == "flush_into_infill"
             || opt_key == "flush_into_objects"
             || opt_key == "flush_into_support") {
-            invalidated |= m_print->invalidate_step(psWipeTower);
-            invalidated |= m_print->invalidate_step(psGCodeExport);
+            print_steps.emplace_back(psWipeTower);
+            print_steps.emplace_back(psGCodeExport);
         } else {
             // for legacy, if we can't handle this option let's invalidate all steps
-            this->invalidate_all_steps();
-            invalidated = true;
+            all_handled = false;
         }
     }
+    return all_handled;
+}
+
+// Called by Print::apply().
+// This method only accepts PrintObjectConfig and PrintRegionConfig option keys.
+bool PrintObject::invalidate_state_by_config_options(
+    const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys)
+{
+    if (opt_keys.empty())
+        return false;
+
+    std::vector<PrintObjectStep> steps;
+    std::vector<PrintStep>       print_steps;
+    bool invalidated = false;
+    if (! this->steps_of_config_options(old_config, new_config, opt_keys, steps, print_steps)) {
+        this->invalidate_all_steps();
+        invalidated = true;
+    }
 
+    sort_remove_duplicates(print_steps);
+    for (PrintStep step : print_steps)
+        invalidated |= m_print->invalidate_step(step);
     sort_remove_duplicates(steps);
     for (PrintObjectStep step : steps)
         invalidated |= this->invalidate_step(step);
@@ -11,6 +11,8 @@
 
 #include <boost/log/trivial.hpp>
 
+#include <numeric>
+
 #include <tbb/parallel_for.h>
 
 //! macro used to mark string used at localization, return same string
@@ -132,10 +134,6 @@ static std::vector<VolumeSlices> slice_volumes_inner(
     std::vector<VolumeSlices> out;
     out.reserve(model_volumes.size());
 
-    std::vector<t_layer_height_range> slicing_ranges;
-    if (layer_ranges.size() > 1)
-        slicing_ranges.reserve(layer_ranges.size());
-
     MeshSlicingParamsEx params_base;
     params_base.closing_radius = print_object_config.slice_closing_radius.value;
     params_base.extra_offset   = 0;
@@ -159,6 +157,17 @@ static std::vector<VolumeSlices> slice_volumes_inner(
     //const auto   extra_offset  = is_mm_painted ? 0.f : std::max(0.f, float(print_object_config.xy_contour_compensation.value));
     const auto   extra_offset = 0.f;
 
+    // Collect the volumes to be sliced with their slicing parameters first, then slice them in parallel.
+    // Each volume is sliced in parallel over its facets and layers as well, objects made of many small parts
+    // would not saturate the machine when sliced one volume after the other.
+    struct VolumeToSlice {
+        const ModelVolume                  *model_volume;
+        MeshSlicingParamsEx                 params;
+        // Empty if all layers are sliced.
+        std::vector<t_layer_height_range>   ranges;
+    };
+    std::vector<VolumeToSlice> volumes_to_slice;
+    volumes_to_slice.reserve(model_volumes.size());
     for (const ModelVolume *model_volume : model_volumes)
         if (model_volume_needs_slicing(*model_volume)) {
             MeshSlicingParamsEx params { params_base };
@@ -177,27 +186,40 @@ static std::vector<VolumeSlices> slice_volumes_inner(
                         for (; params.slicing_mode_normal_below_layer < zs.size() && zs[params.slicing_mode_normal_below_layer] < region_config.bottom_shell_thickness - EPSILON;
                             ++ params.slicing_mode_normal_below_layer);
                     }
-                    out.push_back({
-                        model_volume->id(),
-                        slice_volume(*model_volume, zs, params, throw_on_cancel_callback)
-                    });
+                    volumes_to_slice.push_back({ model_volume, params, {} });
                 }
             } else {
                 assert(! print_config.spiral_mode);
-                slicing_ranges.clear();
+                std::vector<t_layer_height_range> slicing_ranges;
                 for (const PrintObjectRegions::LayerRangeRegions &layer_range : layer_ranges)
                     if (layer_range.has_volume(model_volume->id()))
                         slicing_ranges.emplace_back(layer_range.layer_height_range);
                 if (! slicing_ranges.empty())
-                    out.push_back({
-                        model_volume->id(),
-                        slice_volume(*model_volume, zs, slicing_ranges, params, throw_on_cancel_callback)
-                    });
+                    volumes_to_slice.push_back({ model_volume, params, std::move(slicing_ranges) });
             }
-            if (! out.empty() && out.back().slices.empty())
-                out.pop_back();
         }
 
+    // Start with the largest volumes, so that the small ones fill in the idle threads.
+    std::vector<size_t> order(volumes_to_slice.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&volumes_to_slice](size_t l, size_t r) {
+        return volumes_to_slice[l].model_volume->mesh().facets_count() > volumes_to_slice[r].model_volume->mesh().facets_count(); });
+    std::vector<std::vector<ExPolygons>> slices(volumes_to_slice.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, order.size(), 1),
+        [&volumes_to_slice, &order, &slices, &zs, &layer_ranges, &throw_on_cancel_callback](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                const VolumeToSlice &volume = volumes_to_slice[order[i]];
+                slices[order[i]] = layer_ranges.size() == 1 ?
+                    slice_volume(*volume.model_volume, zs, volume.params, throw_on_cancel_callback) :
+                    slice_volume(*volume.model_volume, zs, volume.ranges, volume.params, throw_on_cancel_callback);
+            }
+        });
+
+    // Merge in the order of ModelVolume::id().
+    for (size_t i = 0; i < volumes_to_slice.size(); ++ i)
+        if (! slices[i].empty())
+            out.push_back({ volumes_to_slice[i].model_volume->id(), std::move(slices[i]) });
+
     return out;
 }
 
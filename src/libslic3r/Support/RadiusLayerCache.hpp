@@ -0,0 +1,327 @@
+#ifndef slic3r_RadiusLayerCache_hpp
+#define slic3r_RadiusLayerCache_hpp
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "../ExPolygon.hpp"
+#include "../Polygon.hpp"
+#include "../FileSystem/Log.hpp"
+
+namespace Slic3r {
+
+// Estimated heap memory of the areas stored in a RadiusLayerCache.
+inline size_t radius_layer_cache_memory(const Polygons &polygons)
+{
+    size_t out = polygons.capacity() * sizeof(Polygon);
+    for (const Polygon &polygon : polygons)
+        out += polygon.points.capacity() * sizeof(Point);
+    return out;
+}
+
+inline size_t radius_layer_cache_memory(const ExPolygons &expolygons)
+{
+    size_t out = expolygons.capacity() * sizeof(ExPolygon);
+    for (const ExPolygon &expolygon : expolygons) {
+        out += expolygon.contour.points.capacity() * sizeof(Point);
+        out += radius_layer_cache_memory(expolygon.holes);
+    }
+    return out;
+}
+
+// Memory of the areas stored by all the RadiusLayerCache instances of the process. The tree supports of the objects
+// generated in parallel share a single budget of a quarter of the physical memory.
+class RadiusLayerCacheMemory
+{
+public:
+    static size_t used()        { return s_used.load(std::memory_order_relaxed); }
+    static size_t budget()      { static const size_t budget = total_physical_memory() / 4; return budget; }
+    static bool   over_budget() { return used() > budget(); }
+    // Bytes to release to get back to three quarters of the budget, so that the caches are not trimmed again right away.
+    // Zero if within the budget.
+    static size_t excess()      { size_t used = RadiusLayerCacheMemory::used(); return used > budget() ? used - budget() * 3 / 4 : 0; }
+
+    static void   add(size_t bytes)     { s_used.fetch_add(bytes, std::memory_order_relaxed); }
+    static void   release(size_t bytes) { s_used.fetch_sub(bytes, std::memory_order_relaxed); }
+
+private:
+    static inline std::atomic<size_t> s_used { 0 };
+};
+
+// Cache of areas per layer and per radius, shared by the tree support generators (TreeSupport and TreeSupport3D).
+//
+// Lookups and insertions are lock free. The layers are allocated in segments of growing size, which are never moved.
+// Each layer keeps its entries in a singly linked list sorted by radius, new entries are linked in by compare and swap.
+// An entry is never modified once inserted, thus the references returned stay valid until clear(), clear_all_but_lowest_radius()
+// or evict(), which must not run concurrently with any other access.
+//
+// The cache accounts for the memory of the stored areas, also in the process wide RadiusLayerCacheMemory. Every lookup stamps the entry
+// with the current epoch, evict() then drops the least recently used entries of the largest radii first.
+template<typename Radius, typename Value>
+class RadiusLayerCache
+{
+public:
+    RadiusLayerCache() = default;
+    RadiusLayerCache(RadiusLayerCache &&rhs) { this->move_from(rhs); }
+    RadiusLayerCache& operator=(RadiusLayerCache &&rhs) { if (this != &rhs) { this->clear(); this->move_from(rhs); } return *this; }
+    ~RadiusLayerCache() { this->clear(); }
+
+    RadiusLayerCache(const RadiusLayerCache&) = delete;
+    RadiusLayerCache& operator=(const RadiusLayerCache&) = delete;
+
+    // Store value for radius at layer_idx and return the stored value. If the cache already contains an area for radius and layer_idx,
+    // value is dropped and the area stored before is returned.
+    const Value& insert(Radius radius, size_t layer_idx, Value &&value)
+    {
+        Layer &layer = this->allocate_layer(layer_idx);
+        Entry *entry = new Entry(radius, std::move(value), m_epoch.load(std::memory_order_relaxed));
+        std::atomic<Entry*> *link = &layer.head;
+        for (;;) {
+            Entry *next = link->load(std::memory_order_acquire);
+            while (next != nullptr && next->radius < radius) {
+                link = &next->next;
+                next = link->load(std::memory_order_acquire);
+            }
+            if (next != nullptr && ! (radius < next->radius)) {
+                delete entry;
+                return next->value;
+            }
+            entry->next.store(next, std::memory_order_relaxed);
+            // On failure another entry was linked in after the last entry with a lower radius, continue the search from there.
+            if (link->compare_exchange_weak(next, entry, std::memory_order_release, std::memory_order_relaxed)) {
+                m_memory.fetch_add(entry->memory, std::memory_order_relaxed);
+                RadiusLayerCacheMemory::add(entry->memory);
+                m_size.fetch_add(1, std::memory_order_relaxed);
+                return entry->value;
+            }
+        }
+    }
+
+    // Area stored for radius at layer_idx, nullptr if not cached.
+    const Value* find(Radius radius, size_t layer_idx) const
+    {
+        for (const Entry *entry = this->first_entry(layer_idx); entry != nullptr && ! (radius < entry->radius); entry = entry->next.load(std::memory_order_acquire))
+            if (! (entry->radius < radius)) {
+                this->touch(*entry);
+                return &entry->value;
+            }
+        return nullptr;
+    }
+
+    // Area stored at layer_idx for the largest radius lower or equal to radius.
+    std::optional<std::pair<Radius, std::reference_wrapper<const Value>>> find_lower_bound(Radius radius, size_t layer_idx) const
+    {
+        const Entry *found = nullptr;
+        for (const Entry *entry = this->first_entry(layer_idx); entry != nullptr && ! (radius < entry->radius); entry = entry->next.load(std::memory_order_acquire))
+            found = entry;
+        if (found == nullptr)
+            return {};
+        this->touch(*found);
+        return std::make_pair(found->radius, std::cref(found->value));
+    }
+
+    // One more than the highest layer index inserted.
+    size_t num_layers() const { return m_num_layers.load(std::memory_order_acquire); }
+    // Number of the stored areas.
+    size_t size() const { return m_size.load(std::memory_order_relaxed); }
+    // Estimated memory of the stored areas in bytes.
+    size_t memory() const { return m_memory.load(std::memory_order_relaxed); }
+
+    // Start a new epoch of the least recently used statistics.
+    void next_epoch() { m_epoch.fetch_add(1, std::memory_order_relaxed); }
+
+    // Call fn(layer_idx, radius, value) for all the stored areas, sorted by layer index, then by radius.
+    template<typename Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (size_t layer_idx = 0; layer_idx < this->num_layers(); ++ layer_idx)
+            for (const Entry *entry = this->first_entry(layer_idx); entry != nullptr; entry = entry->next.load(std::memory_order_acquire))
+                fn(layer_idx, entry->radius, entry->value);
+    }
+
+    // Not thread safe.
+    void clear()
+    {
+        for (size_t i = 0; i < m_segments.size(); ++ i)
+            if (Layer *segment = m_segments[i].exchange(nullptr); segment != nullptr) {
+                for (size_t j = 0; j < segment_size(i); ++ j)
+                    delete_entries(segment[j].head.exchange(nullptr));
+                delete[] segment;
+            }
+        RadiusLayerCacheMemory::release(m_memory.exchange(0));
+        m_num_layers = 0;
+        m_size       = 0;
+    }
+
+    // Keep just the area with the lowest radius at each layer. Not thread safe.
+    void clear_all_but_lowest_radius()
+    {
+        for (size_t layer_idx = 0; layer_idx < this->num_layers(); ++ layer_idx)
+            if (Entry *first = const_cast<Entry*>(this->first_entry(layer_idx)); first != nullptr)
+                this->remove_entries(first->next, [](const Entry&) { return true; });
+    }
+
+    // Drop the areas of radii larger than min_radius at layers min_layer_idx and above, until at least bytes of memory are released.
+    // A radius is always dropped from all these layers at once, thus the layers calculated for a radius stay contiguous from the bottom
+    // and the areas dropped may be calculated again from the highest layer remaining. The radii least recently used are dropped first,
+    // from the largest one. Not thread safe. Returns the memory released in bytes, the radii dropped are appended to evicted_radii.
+    size_t evict(size_t bytes, size_t min_layer_idx, Radius min_radius, std::vector<Radius> *evicted_radii = nullptr)
+    {
+        struct Group {
+            Radius   radius;
+            uint32_t last_used;
+            size_t   memory;
+        };
+        std::vector<Group> groups;
+        for (size_t layer_idx = min_layer_idx; layer_idx < this->num_layers(); ++ layer_idx)
+            for (const Entry *entry = this->first_entry(layer_idx); entry != nullptr; entry = entry->next.load(std::memory_order_relaxed))
+                if (min_radius < entry->radius) {
+                    auto it = std::find_if(groups.begin(), groups.end(), [entry](const Group &g) { return ! (g.radius < entry->radius) && ! (entry->radius < g.radius); });
+                    if (it == groups.end())
+                        groups.push_back({ entry->radius, entry->last_used.load(std::memory_order_relaxed), entry->memory });
+                    else {
+                        it->last_used  = std::max(it->last_used, entry->last_used.load(std::memory_order_relaxed));
+                        it->memory    += entry->memory;
+                    }
+                }
+        const uint32_t epoch = m_epoch.load(std::memory_order_relaxed);
+        // Age relative to the current epoch, so that a wrap around of the epoch counter does not matter.
+        std::sort(groups.begin(), groups.end(), [epoch](const Group &l, const Group &r) {
+            return uint32_t(epoch - l.last_used) > uint32_t(epoch - r.last_used) || (l.last_used == r.last_used && r.radius < l.radius);
+        });
+        std::vector<Radius> evicted;
+        size_t              released = 0;
+        for (const Group &group : groups) {
+            if (released >= bytes)
+                break;
+            evicted.emplace_back(group.radius);
+            released += group.memory;
+        }
+        if (evicted.empty())
+            return 0;
+        std::sort(evicted.begin(), evicted.end());
+        if (evicted_radii)
+            evicted_radii->insert(evicted_radii->end(), evicted.begin(), evicted.end());
+        for (size_t layer_idx = min_layer_idx; layer_idx < this->num_layers(); ++ layer_idx)
+            if (Layer *layer = this->find_layer(layer_idx); layer != nullptr)
+                this->remove_entries(layer->head, [&evicted](const Entry &entry) { return std::binary_search(evicted.begin(), evicted.end(), entry.radius); });
+        return released;
+    }
+
+private:
+    struct Entry
+    {
+        Entry(Radius radius, Value &&value, uint32_t epoch) :
+            radius(radius), value(std::move(value)), memory(sizeof(Entry) + radius_layer_cache_memory(this->value)), last_used(epoch) {}
+
+        const Radius                  radius;
+        const Value                   value;
+        const size_t                  memory;
+        mutable std::atomic<uint32_t> last_used;
+        std::atomic<Entry*>           next { nullptr };
+    };
+
+    struct Layer
+    {
+        std::atomic<Entry*> head { nullptr };
+    };
+
+    // Segment i holds the layers [2^i - 1, 2^(i+1) - 1).
+    static constexpr size_t num_segments = 32;
+    static size_t segment_size(size_t segment_idx) { return size_t(1) << segment_idx; }
+    static size_t segment_idx(size_t layer_idx)
+    {
+        size_t idx = 0;
+        for (size_t n = (layer_idx + 1) >> 1; n != 0; n >>= 1)
+            ++ idx;
+        return idx;
+    }
+
+    Layer* find_layer(size_t layer_idx) const
+    {
+        size_t idx     = segment_idx(layer_idx);
+        Layer *segment = m_segments[idx].load(std::memory_order_acquire);
+        return segment == nullptr ? nullptr : segment + (layer_idx + 1 - segment_size(idx));
+    }
+
+    const Entry* first_entry(size_t layer_idx) const
+    {
+        const Layer *layer = this->find_layer(layer_idx);
+        return layer == nullptr ? nullptr : layer->head.load(std::memory_order_acquire);
+    }
+
+    Layer& allocate_layer(size_t layer_idx)
+    {
+        size_t idx     = segment_idx(layer_idx);
+        Layer *segment = m_segments[idx].load(std::memory_order_acquire);
+        if (segment == nullptr) {
+            Layer *new_segment = new Layer[segment_size(idx)];
+            if (m_segments[idx].compare_exchange_strong(segment, new_segment, std::memory_order_acq_rel, std::memory_order_acquire))
+                segment = new_segment;
+            else
+                // Allocated by another thread in the meantime.
+                delete[] new_segment;
+        }
+        for (size_t num_layers = m_num_layers.load(std::memory_order_relaxed); num_layers < layer_idx + 1 &&
+             ! m_num_layers.compare_exchange_weak(num_layers, layer_idx + 1, std::memory_order_release, std::memory_order_relaxed);) ;
+        return segment[layer_idx + 1 - segment_size(idx)];
+    }
+
+    void touch(const Entry &entry) const
+    {
+        // Avoid writing to the cache line of the entry, if it was already used in this epoch.
+        if (uint32_t epoch = m_epoch.load(std::memory_order_relaxed); entry.last_used.load(std::memory_order_relaxed) != epoch)
+            entry.last_used.store(epoch, std::memory_order_relaxed);
+    }
+
+    // Unlink and delete the entries starting with link, for which pred returns true.
+    template<typename Pred>
+    void remove_entries(std::atomic<Entry*> &link, Pred &&pred)
+    {
+        std::atomic<Entry*> *plink = &link;
+        while (Entry *entry = plink->load(std::memory_order_relaxed)) {
+            if (pred(*entry)) {
+                plink->store(entry->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                m_memory.fetch_sub(entry->memory, std::memory_order_relaxed);
+                RadiusLayerCacheMemory::release(entry->memory);
+                m_size.fetch_sub(1, std::memory_order_relaxed);
+                delete entry;
+            } else
+                plink = &entry->next;
+        }
+    }
+
+    static void delete_entries(Entry *entry)
+    {
+        while (entry != nullptr) {
+            Entry *next = entry->next.load(std::memory_order_relaxed);
+            delete entry;
+            entry = next;
+        }
+    }
+
+    void move_from(RadiusLayerCache &rhs)
+    {
+        for (size_t i = 0; i < m_segments.size(); ++ i)
+            m_segments[i].store(rhs.m_segments[i].exchange(nullptr));
+        m_num_layers.store(rhs.m_num_layers.exchange(0));
+        m_size.store(rhs.m_size.exchange(0));
+        m_memory.store(rhs.m_memory.exchange(0));
+        m_epoch.store(rhs.m_epoch.load());
+    }
+
+    std::array<std::atomic<Layer*>, num_segments> m_segments {};
+    std::atomic<size_t>                           m_num_layers { 0 };
+    std::atomic<size_t>                           m_size { 0 };
+    std::atomic<size_t>                           m_memory { 0 };
+    std::atomic<uint32_t>                         m_epoch { 0 };
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_RadiusLayerCache_hpp
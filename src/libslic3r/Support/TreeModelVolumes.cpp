@@ -18,6 +18,7 @@
 #include "../PrintConfig.hpp"
 #include "../Utils.hpp"
 #include "../format.hpp"
+#include "../FileSystem/Log.hpp"
 
 #include <string_view>
 
@@ -223,7 +224,7 @@ void TreeModelVolumes::precalculate(const PrintObject& print_object, const coord
     std::vector<RadiusLayerPair> relevant_collision_radiis{ radius_until_layer.begin(), radius_until_layer.end() };
 
     // Calculate the relevant collisions
-    calculateCollision(relevant_collision_radiis, throw_on_cancel);
+    calculateCollision(relevant_collision_radiis, throw_on_cancel, true);
 
     // calculate a separate Collisions with all holes removed. These are relevant for some avoidances that try to avoid holes (called safe)
     std::vector<RadiusLayerPair> relevant_hole_collision_radiis;
@@ -232,18 +233,18 @@ void TreeModelVolumes::precalculate(const PrintObject& print_object, const coord
             relevant_hole_collision_radiis.emplace_back(key);
 
     // Calculate collisions without holes, built from regular collision
-    calculateCollisionHolefree(relevant_hole_collision_radiis, throw_on_cancel);
+    calculateCollisionHolefree(relevant_hole_collision_radiis, throw_on_cancel, true);
     // Let placables be calculated from calculateAvoidance() for better parallelization.
     if (m_support_rests_on_model)
-        calculatePlaceables(relevant_avoidance_radiis, throw_on_cancel);
+        calculatePlaceables(relevant_avoidance_radiis, throw_on_cancel, true);
 
     auto t_coll = std::chrono::high_resolution_clock::now();
 
     // Calculate the relevant avoidances in parallel as far as possible
     {
         tbb::task_group task_group;
-        task_group.run([this, relevant_avoidance_radiis, throw_on_cancel]{ calculateAvoidance(relevant_avoidance_radiis, true, m_support_rests_on_model, throw_on_cancel); });
-        task_group.run([this, relevant_avoidance_radiis, throw_on_cancel]{ calculateWallRestrictions(relevant_avoidance_radiis, throw_on_cancel); });
+        task_group.run([this, relevant_avoidance_radiis, throw_on_cancel]{ calculateAvoidance(relevant_avoidance_radiis, true, m_support_rests_on_model, throw_on_cancel, true); });
+        task_group.run([this, relevant_avoidance_radiis, throw_on_cancel]{ calculateWallRestrictions(relevant_avoidance_radiis, throw_on_cancel, true); });
         task_group.wait();
     }
     auto t_end = std::chrono::high_resolution_clock::now();
@@ -296,7 +297,7 @@ const Polygons& TreeModelVolumes::getCollision(const coord_t orig_radius, LayerI
     const coord_t radius = this->ceilRadius(orig_radius, min_xy_dist);
     if (std::optional<std::reference_wrapper<const Polygons>> result = m_collision_cache.getArea({ radius, layer_idx }); result)
         return (*result).get();
-    if (m_precalculated) {
+    if (m_precalculated && ! m_collision_cache.released(radius)) {
         BOOST_LOG_TRIVIAL(error_level_not_in_cache) << "Had to calculate collision at radius " << radius << " and layer " << layer_idx << ", but precalculate was called. Performance may suffer!";
         tree_supports_show_error("Not precalculated Collision requested."sv, false);
     }
@@ -319,7 +320,7 @@ const Polygons& TreeModelVolumes::getCollisionHolefree(coord_t radius, LayerInde
     assert(radius < m_increase_until_radius + m_current_min_xy_dist_delta);
     if (std::optional<std::reference_wrapper<const Polygons>> result = m_collision_cache_holefree.getArea({ radius, layer_idx }); result)
         return (*result).get();
-    if (m_precalculated) {
+    if (m_precalculated && ! m_collision_cache_holefree.released(radius)) {
         BOOST_LOG_TRIVIAL(error_level_not_in_cache) << "Had to calculate collision holefree at radius " << radius << " and layer " << layer_idx << ", but precalculate was called. Performance may suffer!";
         tree_supports_show_error("Not precalculated Holefree Collision requested."sv, false);
     }
@@ -342,7 +343,7 @@ const Polygons& TreeModelVolumes::getAvoidance(const coord_t orig_radius, LayerI
         result)
         return (*result).get();
 
-    if (m_precalculated) {
+    if (m_precalculated && ! this->avoidance_cache(type, to_model).released(radius)) {
         if (to_model) {
             BOOST_LOG_TRIVIAL(error_level_not_in_cache) << "Had to calculate Avoidance to model at radius " << radius << " and layer " << layer_idx << ", but precalculate was called. Performance may suffer!";
             tree_supports_show_error("Not precalculated Avoidance(to model) requested."sv, false);
@@ -361,7 +362,7 @@ const Polygons& TreeModelVolumes::getPlaceableAreas(const coord_t orig_radius, L
     const coord_t radius = ceilRadius(orig_radius);
     if (std::optional<std::reference_wrapper<const Polygons>> result = m_placeable_areas_cache.getArea({ radius, layer_idx }); result)
         return (*result).get();
-    if (m_precalculated) {
+    if (m_precalculated && ! m_placeable_areas_cache.released(radius)) {
         BOOST_LOG_TRIVIAL(error_level_not_in_cache) << "Had to calculate Placeable Areas at radius " << radius << " and layer " << layer_idx << ", but precalculate was called. Performance may suffer!";
         tree_supports_show_error(format("Not precalculated Placeable areas requested, radius %1%, layer %2%", radius, layer_idx), false);
     }
@@ -387,7 +388,7 @@ const Polygons& TreeModelVolumes::getWallRestriction(const coord_t orig_radius,
         (min_xy_dist ? m_wall_restrictions_cache_min : m_wall_restrictions_cache).getArea({ radius, layer_idx });
         result)
         return (*result).get();
-    if (m_precalculated) {
+    if (m_precalculated && ! (min_xy_dist ? m_wall_restrictions_cache_min : m_wall_restrictions_cache).released(radius)) {
         BOOST_LOG_TRIVIAL(error_level_not_in_cache) << "Had to calculate Wall restricions at radius " << radius << " and layer " << layer_idx << ", but precalculate was called. Performance may suffer!";
         tree_supports_show_error(
             min_xy_dist ? 
@@ -399,13 +400,51 @@ const Polygons& TreeModelVolumes::getWallRestriction(const coord_t orig_radius,
     return getWallRestriction(orig_radius, layer_idx, min_xy_dist); // Retrieve failed and correct result was calculated. Now it has to be retrieved.
 }
 
-void TreeModelVolumes::calculateCollision(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel)
+void TreeModelVolumes::trim_caches(LayerIndex min_layer) const
+{
+    auto *self = const_cast<TreeModelVolumes*>(this);
+    // Sorted by the order of release: The avoidances are the largest and they are calculated again from the collisions, thus they go first.
+    RadiusLayerPolygonCache *caches[] = {
+        &self->m_avoidance_cache, &self->m_avoidance_cache_slow, &self->m_avoidance_cache_to_model, &self->m_avoidance_cache_to_model_slow,
+        &self->m_avoidance_cache_holefree, &self->m_avoidance_cache_holefree_to_model,
+        &self->m_wall_restrictions_cache, &self->m_wall_restrictions_cache_min, &self->m_placeable_areas_cache,
+        &self->m_collision_cache_holefree, &self->m_collision_cache
+    };
+    size_t memory = 0;
+    for (RadiusLayerPolygonCache *cache : caches) {
+        cache->next_epoch();
+        memory += cache->memory();
+    }
+    // The budget is shared with the tree supports of the other objects, but only the caches of this object may be trimmed here.
+    const size_t to_release = RadiusLayerCacheMemory::excess();
+    if (to_release == 0)
+        return;
+    size_t released = 0;
+    for (RadiusLayerPolygonCache *cache : caches)
+        if (released < to_release)
+            released += cache->evict(to_release - released, min_layer);
+    BOOST_LOG_TRIVIAL(debug) << "Tree support volumes: released " << released << " of " << memory << " bytes of cached areas above layer " << min_layer <<
+        ", all tree supports keep " << RadiusLayerCacheMemory::used() << " bytes";
+}
+
+bool TreeModelVolumes::skip_precalculation(RadiusLayerPolygonCache &cache, coord_t radius)
+{
+    // The collisions of radius zero are expected to be precalculated, see get_collision_lower_bound_area().
+    if (radius == 0 || ! RadiusLayerCacheMemory::over_budget())
+        return false;
+    cache.mark_released(radius);
+    return true;
+}
+
+void TreeModelVolumes::calculateCollision(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation)
 {
     tbb::parallel_for(tbb::blocked_range<size_t>(0, keys.size()),
         [&](const tbb::blocked_range<size_t> &range) {
         for (size_t ikey = range.begin(); ikey != range.end(); ++ ikey) {
             const LayerIndex radius        = keys[ikey].first;
             const size_t     max_layer_idx = keys[ikey].second;
+            if (precalculation && skip_precalculation(m_collision_cache, radius))
+                continue;
             // recursive call to parallel_for.
             calculateCollision(radius, max_layer_idx, throw_on_cancel);
         }
@@ -579,8 +618,15 @@ void TreeModelVolumes::calculateCollision(const coord_t radius, const LayerIndex
         m_placeable_areas_cache.insert(std::move(data_placeable), radius);
 }
 
-void TreeModelVolumes::calculateCollisionHolefree(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel)
+void TreeModelVolumes::calculateCollisionHolefree(const std::vector<RadiusLayerPair> &keys_in, std::function<void()> throw_on_cancel, bool precalculation)
 {
+    std::vector<RadiusLayerPair> keys;
+    for (const RadiusLayerPair &key : keys_in)
+        if (! precalculation || ! skip_precalculation(m_collision_cache_holefree, key.first))
+            keys.emplace_back(key);
+    if (keys.empty())
+        return;
+
     LayerIndex max_layer = 0;
     for (long long unsigned int i = 0; i < keys.size(); i++)
         max_layer = std::max(max_layer, keys[i].second);
@@ -611,7 +657,7 @@ void TreeModelVolumes::calculateCollisionHolefree(const std::vector<RadiusLayerP
     });
 }
 
-void TreeModelVolumes::calculateAvoidance(const std::vector<RadiusLayerPair> &keys, bool to_build_plate, bool to_model, std::function<void()> throw_on_cancel)
+void TreeModelVolumes::calculateAvoidance(const std::vector<RadiusLayerPair> &keys, bool to_build_plate, bool to_model, std::function<void()> throw_on_cancel, bool precalculation)
 {
     // For every RadiusLayer pair there are 3 avoidances that have to be calculated.
     // Prepare tasks for parallelization.
@@ -651,9 +697,11 @@ void TreeModelVolumes::calculateAvoidance(const std::vector<RadiusLayerPair> &ke
         throw_on_cancel();
 
     tbb::parallel_for(tbb::blocked_range<size_t>(0, avoidance_tasks.size(), 1),
-        [this, &avoidance_tasks, &throw_on_cancel](const tbb::blocked_range<size_t> &range) {
+        [this, &avoidance_tasks, &throw_on_cancel, precalculation](const tbb::blocked_range<size_t> &range) {
         for (size_t task_idx = range.begin(); task_idx < range.end(); ++ task_idx) {
             const AvoidanceTask &task = avoidance_tasks[task_idx];
+            if (precalculation && skip_precalculation(avoidance_cache(task.type, task.to_model), task.radius))
+                continue;
             assert(! task.holefree() || task.radius < m_increase_until_radius + m_current_min_xy_dist_delta);
             if (task.to_model)
                 // ensuring Placeableareas are calculated
@@ -713,12 +761,13 @@ void TreeModelVolumes::calculateAvoidance(const std::vector<RadiusLayerPair> &ke
 }
 
 
-void TreeModelVolumes::calculatePlaceables(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel)
+void TreeModelVolumes::calculatePlaceables(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation)
 {
     tbb::parallel_for(tbb::blocked_range<size_t>(0, keys.size()),
         [&, keys](const tbb::blocked_range<size_t>& range) {
             for (size_t key_idx = range.begin(); key_idx < range.end(); ++ key_idx)
-                this->calculatePlaceables(keys[key_idx].first, keys[key_idx].second, throw_on_cancel);
+                if (! precalculation || ! skip_precalculation(m_placeable_areas_cache, keys[key_idx].first))
+                    this->calculatePlaceables(keys[key_idx].first, keys[key_idx].second, throw_on_cancel);
         });
 }
 
@@ -761,7 +810,7 @@ void TreeModelVolumes::calculatePlaceables(const coord_t radius, const LayerInde
     m_placeable_areas_cache.insert(std::move(data), start_layer, radius);
 }
 
-void TreeModelVolumes::calculateWallRestrictions(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel)
+void TreeModelVolumes::calculateWallRestrictions(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation)
 {
     // Wall restrictions are mainly important when they represent actual walls that are printed, and not "just" the configured z_distance, because technically valid placement is no excuse for moving through a wall.
     // As they exist to prevent accidentially moving though a wall at high speed between layers like thie (x = wall,i = influence area,o= empty space,d = blocked area because of z distance) Assume maximum movement distance is two characters and maximum safe movement distance of one character
@@ -802,6 +851,10 @@ void TreeModelVolumes::calculateWallRestrictions(const std::vector<RadiusLayerPa
         for (size_t key_idx = range.begin(); key_idx < range.end(); ++ key_idx) {
             const coord_t    radius             = keys[key_idx].first;
             const LayerIndex max_required_layer = keys[key_idx].second;
+            if (precalculation && skip_precalculation(m_wall_restrictions_cache, radius)) {
+                m_wall_restrictions_cache_min.mark_released(radius);
+                continue;
+            }
             const coord_t    min_layer_bottom   = std::max(1, m_wall_restrictions_cache.getMaxCalculatedLayer(radius));
             const size_t     buffer_size        = max_required_layer + 1 - min_layer_bottom;
             std::vector<Polygons> data(buffer_size, Polygons{});
@@ -860,24 +913,13 @@ coord_t TreeModelVolumes::ceilRadius(const coord_t radius) const
     return out;
 }
 
-void TreeModelVolumes::RadiusLayerPolygonCache::allocate_layers(size_t num_layers)
-{
-    if (num_layers > m_data.size()) {
-        if (num_layers > m_data.capacity())
-            reserve_power_of_2(m_data, num_layers);
-        m_data.resize(num_layers, {});
-    }
-}
-
 // For debugging purposes, sorted by layer index, then by radius.
 std::vector<std::pair<TreeModelVolumes::RadiusLayerPair, std::reference_wrapper<const Polygons>>> TreeModelVolumes::RadiusLayerPolygonCache::sorted() const
 {
     std::vector<std::pair<RadiusLayerPair, std::reference_wrapper<const Polygons>>> out;
-    for (auto &layer : m_data) {
-        auto layer_idx = LayerIndex(&layer - m_data.data());
-        for (auto &radius_polygons : layer)
-            out.emplace_back(std::make_pair(radius_polygons.first, layer_idx), radius_polygons.second);
-    }
+    m_data.for_each([&out](size_t layer_idx, coord_t radius, const Polygons &polygons) {
+        out.emplace_back(std::make_pair(radius, LayerIndex(layer_idx)), polygons);
+    });
     assert(std::is_sorted(out.begin(), out.end(), [](auto &l, auto &r){ return l.first.second < r.first.second || (l.first.second == r.first.second) && l.first.first < r.first.first; }));
     return out;
 }
@@ -14,6 +14,7 @@
 
 #include <boost/functional/hash.hpp>
 
+#include "RadiusLayerCache.hpp"
 #include "TreeSupportCommon.hpp"
 
 #include "../Point.hpp"
@@ -70,6 +71,15 @@ public:
         m_wall_restrictions_cache_min.clear();
     }
 
+    /*!
+     * \brief Release the least recently used areas of layers min_layer and above if the caches of all the tree supports
+     * grew over their common memory budget, see RadiusLayerCacheMemory.
+     *
+     * The areas of radius zero are always kept, the released areas are calculated again when requested.
+     * Must not be called while other threads access the volumes, nor while references to cached areas are held.
+     */
+    void trim_caches(LayerIndex min_layer) const;
+
     enum class AvoidanceType : int8_t
     {
         Slow,
@@ -197,43 +207,31 @@ private:
      * \brief Convenience typedef for the keys to the caches
      */
     using RadiusLayerPair             = std::pair<coord_t, LayerIndex>;
+    // Lock free cache of areas by layer and radius, see RadiusLayerCache.
     class RadiusLayerPolygonCache {
-        // Map from radius to Polygons. Cache of one layer collision regions.
-        using LayerData = std::map<coord_t, Polygons>;
-        // Vector of layers, at each layer map of radius to Polygons.
-        // Reference to Polygons returned shall be stable to insertion.
-        using Layers = std::vector<LayerData>;
+        using Cache = RadiusLayerCache<coord_t, Polygons>;
     public:
         RadiusLayerPolygonCache() = default;
-        RadiusLayerPolygonCache(RadiusLayerPolygonCache &&rhs) : m_data(std::move(rhs.m_data)) {}
-        RadiusLayerPolygonCache& operator=(RadiusLayerPolygonCache &&rhs) { m_data = std::move(rhs.m_data); return *this; }
-
         RadiusLayerPolygonCache(const RadiusLayerPolygonCache&) = delete;
         RadiusLayerPolygonCache& operator=(const RadiusLayerPolygonCache&) = delete;
 
         void insert(std::vector<std::pair<RadiusLayerPair, Polygons>> &&in) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             for (auto &d : in)
-                this->get_allocate_layer_data(d.first.second).emplace(d.first.first, std::move(d.second));
+                m_data.insert(d.first.first, d.first.second, std::move(d.second));
         }
         // by layer
         void insert(std::vector<std::pair<coord_t, Polygons>> &&in, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             for (auto &d : in)
-                this->get_allocate_layer_data(d.first).emplace(radius, std::move(d.second));
+                m_data.insert(radius, d.first, std::move(d.second));
         }
         void insert(std::vector<Polygons> &&in, coord_t first_layer_idx, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            allocate_layers(first_layer_idx + in.size());
             for (auto &d : in)
-                m_data[first_layer_idx ++].emplace(radius, std::move(d));
+                m_data.insert(radius, first_layer_idx ++, std::move(d));
         }
         void insert(LayerPolygonCache &&in, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             LayerIndex i = in.begin();
-            allocate_layers(i + LayerIndex(in.size()));
             for (auto &d : in.polygons_mutable())
-                m_data[i ++].emplace(radius, std::move(d));
+                m_data.insert(radius, i ++, std::move(d));
         }
         /*!
          * \brief Checks a cache for a given RadiusLayerPair and returns it if it is found
@@ -241,29 +239,15 @@ private:
          * \return A wrapped optional reference of the requested area (if it was found, an empty optional if nothing was found)
          */
         std::optional<std::reference_wrapper<const Polygons>> getArea(const TreeModelVolumes::RadiusLayerPair &key) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            if (key.second >= LayerIndex(m_data.size()))
-                return std::optional<std::reference_wrapper<const Polygons>>{};
-            const auto &layer = m_data[key.second];
-            auto it = layer.find(key.first);
-            return it == layer.end() ? 
-                std::optional<std::reference_wrapper<const Polygons>>{} : std::optional<std::reference_wrapper<const Polygons>>{ it->second };
+            const Polygons *area = key.second < 0 ? nullptr : m_data.find(key.first, key.second);
+            return area == nullptr ?
+                std::optional<std::reference_wrapper<const Polygons>>{} : std::optional<std::reference_wrapper<const Polygons>>{ *area };
         }
         // Get a collision area at a given layer for a radius that is a lower or equial to the key radius.
         std::optional<std::pair<coord_t, std::reference_wrapper<const Polygons>>> get_lower_bound_area(const TreeModelVolumes::RadiusLayerPair &key) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            if (key.second >= LayerIndex(m_data.size()))
+            if (key.second < 0)
                 return {};
-            const auto &layer = m_data[key.second];
-            if (layer.empty())
-                return {};
-            auto it = layer.lower_bound(key.first);
-            if (it == layer.end() || it->first != key.first) {
-                if (it == layer.begin())
-                    return {};
-                -- it;
-            }
-            return std::make_pair(it->first, std::reference_wrapper<const Polygons>(it->second));
+            return m_data.find_lower_bound(key.first, key.second);
         }
         /*!
          * \brief Get the highest already calculated layer in the cache.
@@ -273,10 +257,9 @@ private:
          * \return A wrapped optional reference of the requested area (if it was found, an empty optional if nothing was found)
          */
         LayerIndex getMaxCalculatedLayer(coord_t radius) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            auto layer_idx = LayerIndex(m_data.size()) - 1;
+            auto layer_idx = LayerIndex(m_data.num_layers()) - 1;
             for (; layer_idx > 0; -- layer_idx)
-                if (const auto &layer = m_data[layer_idx]; layer.find(radius) != layer.end())
+                if (m_data.find(radius, layer_idx) != nullptr)
                     break;
             // The placeable on model areas do not exist on layer 0, as there can not be model below it. As such it may be possible that layer 1 is available, but layer 0 does not exist.
             return layer_idx == 0 ? -1 : layer_idx;
@@ -285,25 +268,37 @@ private:
         // For debugging purposes, sorted by layer index, then by radius.
         [[nodiscard]] std::vector<std::pair<RadiusLayerPair, std::reference_wrapper<const Polygons>>> sorted() const;
 
-        void clear() { m_data.clear(); }
-        void clear_all_but_radius0() { 
-            for (LayerData &l : m_data) {
-                auto begin = l.begin();
-                auto end = l.end();
-                if (begin != end && ++ begin != end)
-                    l.erase(begin, end);
-            }
+        // Estimated memory of the cached areas in bytes.
+        size_t memory() const { return m_data.memory(); }
+        void   next_epoch() { m_data.next_epoch(); }
+        // Drop the least recently used areas of radii above 0 from layer min_layer_idx up, see RadiusLayerCache::evict().
+        size_t evict(size_t bytes, LayerIndex min_layer_idx) {
+            std::vector<coord_t> evicted;
+            size_t released = m_data.evict(bytes, size_t(std::max<LayerIndex>(0, min_layer_idx)), 0, &evicted);
+            for (coord_t radius : evicted)
+                this->mark_released(radius);
+            return released;
         }
-
-    private:
-        LayerData&          get_allocate_layer_data(LayerIndex layer_idx) {
-            allocate_layers(layer_idx + 1);
-            return m_data[layer_idx];
+        // The areas of radius were released or not precalculated to stay within the memory budget,
+        // thus they are calculated on demand without a warning. Thread safe.
+        void mark_released(coord_t radius) {
+            std::lock_guard<std::mutex> lock(m_released_mutex);
+            if (auto it = std::lower_bound(m_released.begin(), m_released.end(), radius); it == m_released.end() || *it != radius)
+                m_released.insert(it, radius);
+        }
+        bool released(coord_t radius) const {
+            std::lock_guard<std::mutex> lock(m_released_mutex);
+            return std::binary_search(m_released.begin(), m_released.end(), radius);
         }
-        void                allocate_layers(size_t num_layers);
 
-        Layers              m_data;
-        mutable std::mutex  m_mutex;
+        void clear() { m_data.clear(); }
+        void clear_all_but_radius0() { m_data.clear_all_but_lowest_radius(); }
+
+    private:
+        Cache                   m_data;
+        // Sorted radii, see mark_released().
+        std::vector<coord_t>    m_released;
+        mutable std::mutex      m_released_mutex;
     };
 
 
@@ -334,8 +329,9 @@ private:
      * The result is a 2D area that would cause nodes of given radius to
      * collide with the model. Result is saved in the cache.
      * \param keys RadiusLayerPairs of all requested areas. Every radius will be calculated up to the provided layer.
+     * \param precalculation Called by precalculate(), the radii above zero are skipped if the caches are over their memory budget.
      */
-    void calculateCollision(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel);
+    void calculateCollision(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation = false);
     void calculateCollision(const coord_t radius, const LayerIndex max_layer_idx, std::function<void()> throw_on_cancel);
     /*!
      * \brief Creates the areas that have to be avoided by the tree's branches to prevent collision with the model on this layer. Holes are removed.
@@ -344,8 +340,9 @@ private:
      * collide with the model or be inside a hole. Result is saved in the cache.
      * A Hole is defined as an area, in which a branch with m_increase_until_radius radius would collide with the wall.
      * \param keys RadiusLayerPairs of all requested areas. Every radius will be calculated up to the provided layer.
+     * \param precalculation Called by precalculate(), the radii above zero are skipped if the caches are over their memory budget.
      */
-    void calculateCollisionHolefree(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel);
+    void calculateCollisionHolefree(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation = false);
 
     /*!
      * \brief Creates the areas that have to be avoided by the tree's branches to prevent collision with the model on this layer. Holes are removed.
@@ -366,8 +363,9 @@ private:
      * The result is a 2D area that would cause nodes of radius \p radius to
      * collide with the model. Result is saved in the cache.
      * \param keys RadiusLayerPairs of all requested areas. Every radius will be calculated up to the provided layer.
+     * \param precalculation Called by precalculate(), the radii above zero are skipped if the caches are over their memory budget.
      */
-    void calculateAvoidance(const std::vector<RadiusLayerPair> &keys, bool to_build_plate, bool to_model, std::function<void()> throw_on_cancel);
+    void calculateAvoidance(const std::vector<RadiusLayerPair> &keys, bool to_build_plate, bool to_model, std::function<void()> throw_on_cancel, bool precalculation = false);
 
     /*!
      * \brief Creates the areas that have to be avoided by the tree's branches to prevent collision with the model.
@@ -393,8 +391,9 @@ private:
      * \brief Creates the areas where a branch of a given radius can be placed on the model.
      * Result is saved in the cache.
      * \param keys RadiusLayerPair of the requested areas. The radius will be calculated up to the provided layer.
+     * \param precalculation Called by precalculate(), the radii above zero are skipped if the caches are over their memory budget.
      */
-    void calculatePlaceables(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel);
+    void calculatePlaceables(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation = false);
 
     /*!
      * \brief Creates the areas that can not be passed when expanding an area downwards. As such these areas are an somewhat abstract representation of a wall (as in a printed object).
@@ -402,8 +401,9 @@ private:
      * These areas are at least xy_min_dist wide. When calculating it is always assumed that every wall is printed on top of another (as in has an overlap with the wall a layer below). Result is saved in the corresponding cache.
      *
      * \param keys RadiusLayerPairs of all requested areas. Every radius will be calculated up to the provided layer.
+     * \param precalculation Called by precalculate(), the radii above zero are skipped if the caches are over their memory budget.
      */
-    void calculateWallRestrictions(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel);
+    void calculateWallRestrictions(const std::vector<RadiusLayerPair> &keys, std::function<void()> throw_on_cancel, bool precalculation = false);
 
     /*!
      * \brief Creates the areas that can not be passed when expanding an area downwards. As such these areas are an somewhat abstract representation of a wall (as in a printed object).
@@ -415,6 +415,12 @@ private:
         calculateWallRestrictions(std::vector<RadiusLayerPair>{ RadiusLayerPair(key) }, []{});
     }
 
+    /*!
+     * \brief Should the precalculation of radius into cache be skipped to stay within the memory budget of the caches?
+     * The radius is then marked as released in cache, to be calculated on demand without a warning.
+     */
+    static bool skip_precalculation(RadiusLayerPolygonCache &cache, coord_t radius);
+
     /*!
      * \brief The maximum distance that the center point of a tree branch may move in consecutive layers if it has to avoid the model.
      */
@@ -2474,6 +2474,9 @@ void TreeSupport::drop_nodes()
         // parallel pre-compute avoidance
         tbb::parallel_for(tbb::blocked_range<size_t>(0, contact_nodes.size() - 1), [&](const tbb::blocked_range<size_t> &range) {
             for (size_t layer_nr = range.begin(); layer_nr < range.end(); layer_nr++) {
+            // Over the memory budget the rest of the areas is calculated on demand by drop_nodes(), which trims the caches.
+            if (RadiusLayerCacheMemory::over_budget())
+                break;
             for (auto node_radius : all_layer_radius[layer_nr]) {
                 size_t obj_layer_nr= layer_heights[layer_nr].obj_layer_nr;
                 m_ts_data->get_avoidance(node_radius, obj_layer_nr);
@@ -2485,6 +2488,7 @@ void TreeSupport::drop_nodes()
 
         double duration{ std::chrono::duration_cast<second_>(clock_::now() - t0).count() };
         BOOST_LOG_TRIVIAL(debug) << "finish pre calculate_avoidance. before m_avoidance_cache.size()=" << m_ts_data->m_avoidance_cache.size()
+            << ", memory=" << m_ts_data->m_avoidance_cache.memory()
             << ", takes " << duration << " secs.";
     }
 
@@ -2495,6 +2499,8 @@ void TreeSupport::drop_nodes()
     {
         if (m_object->print()->canceled())
             break;
+        // The layers above this one are not queried anymore and no reference to the cached areas is held between the layers.
+        m_ts_data->trim_caches(layer_heights[layer_nr].obj_layer_nr + 1);
 
         auto& layer_contact_nodes = contact_nodes[layer_nr];
         if (layer_contact_nodes.empty())
@@ -2929,7 +2935,7 @@ void TreeSupport::drop_nodes()
         }
     }
 
-    BOOST_LOG_TRIVIAL(debug) << "after m_avoidance_cache.size()=" << m_ts_data->m_avoidance_cache.size();
+    BOOST_LOG_TRIVIAL(debug) << "after m_avoidance_cache.size()=" << m_ts_data->m_avoidance_cache.size() << ", memory=" << m_ts_data->m_avoidance_cache.memory();
 }
 
 void TreeSupport::smooth_nodes()
@@ -3416,8 +3422,8 @@ const ExPolygons& TreeSupportData::get_collision(coordf_t radius, size_t layer_n
     profiler.tic();
     radius = ceil_radius(radius);
     RadiusLayerPair key{radius, layer_nr};
-    const auto it = m_collision_cache.find(key);
-    const ExPolygons& collision = it != m_collision_cache.end() ? it->second : calculate_collision(key);
+    const ExPolygons *cached = m_collision_cache.find(key.radius, key.layer_nr);
+    const ExPolygons& collision = cached != nullptr ? *cached : calculate_collision(key);
     profiler.stage_add(STAGE_get_collision);
     return collision;
 }
@@ -3427,13 +3433,28 @@ const ExPolygons& TreeSupportData::get_avoidance(coordf_t radius, size_t layer_n
     profiler.tic();
     radius = ceil_radius(radius);
     RadiusLayerPair key{radius, layer_nr, recursions };
-    const auto it = m_avoidance_cache.find(key);
-    const ExPolygons& avoidance = it != m_avoidance_cache.end() ? it->second : calculate_avoidance(key);
+    const ExPolygons *cached = m_avoidance_cache.find(key.radius, key.layer_nr);
+    const ExPolygons& avoidance = cached != nullptr ? *cached : calculate_avoidance(key);
 
     profiler.stage_add(STAGE_GET_AVOIDANCE);
     return avoidance;
 }
 
+void TreeSupportData::trim_caches(size_t min_layer) const
+{
+    m_avoidance_cache.next_epoch();
+    m_collision_cache.next_epoch();
+    const size_t to_release = RadiusLayerCacheMemory::excess();
+    if (to_release == 0)
+        return;
+    // The avoidances are calculated again from the collisions, thus they go first.
+    size_t released = m_avoidance_cache.evict(to_release, min_layer, 0.);
+    if (released < to_release)
+        released += m_collision_cache.evict(to_release - released, min_layer, 0.);
+    BOOST_LOG_TRIVIAL(debug) << "Tree support: released " << released << " bytes of cached areas above layer " << min_layer <<
+        ", all tree supports keep " << RadiusLayerCacheMemory::used() << " bytes";
+}
+
 Polygons TreeSupportData::get_contours(size_t layer_nr) const
 {
     Polygons contours;
@@ -3492,8 +3513,7 @@ const ExPolygons& TreeSupportData::calculate_collision(const RadiusLayerPair& ke
     ExPolygons collision_areas = offset_ex(m_layer_outlines[key.layer_nr], scale_(key.radius+m_xy_distance));
     collision_areas = expolygons_simplify(collision_areas, scale_(m_radius_sample_resolution));
     // collision_areas.emplace_back(m_machine_border);
-    const auto ret = m_collision_cache.insert({ key, std::move(collision_areas) });
-    return ret.first->second;
+    return m_collision_cache.insert(key.radius, key.layer_nr, std::move(collision_areas));
 }
 
 const ExPolygons& TreeSupportData::calculate_avoidance(const RadiusLayerPair& key) const
@@ -3509,7 +3529,7 @@ const ExPolygons& TreeSupportData::calculate_avoidance(const RadiusLayerPair& ke
         // below our current one.
         constexpr auto max_recursion_depth = 100;
         // Check if we would exceed the recursion limit by trying to process this layer
-        if (layer_nr >= max_recursion_depth && m_avoidance_cache.find({radius, layer_nr - max_recursion_depth}) == m_avoidance_cache.end()) {
+        if (layer_nr >= max_recursion_depth && m_avoidance_cache.find(radius, layer_nr - max_recursion_depth) == nullptr) {
             // Force the calculation of the layer `max_recursion_depth` below our current one, ignoring the result.
             get_avoidance(radius, layer_nr - max_recursion_depth);
         }
@@ -3519,9 +3539,7 @@ const ExPolygons& TreeSupportData::calculate_avoidance(const RadiusLayerPair& ke
     const ExPolygons &collision       = get_collision(radius, layer_nr);
     avoidance_areas.insert(avoidance_areas.end(), collision.begin(), collision.end());
     avoidance_areas = std::move(union_ex(avoidance_areas));
-    auto ret = m_avoidance_cache.insert({key, std::move(avoidance_areas)});
-    //assert(ret.second);
-    return ret.first->second;
+    return m_avoidance_cache.insert(key.radius, key.layer_nr, std::move(avoidance_areas));
 }
 
 } //namespace Slic3r
@@ -11,6 +11,7 @@
 #include "Flow.hpp"
 #include "PrintConfig.hpp"
 #include "Fill/Lightning/Generator.hpp"
+#include "RadiusLayerCache.hpp"
 #include "TreeModelVolumes.hpp"
 #include "TreeSupport3D.hpp"
 
@@ -238,6 +239,14 @@ public:
      */
     const ExPolygons& get_avoidance(coordf_t radius, size_t layer_idx, int recursions=0) const;
 
+    /*!
+     * \brief Release the least recently used areas of layers min_layer and above if the caches of all the tree supports
+     * grew over their common memory budget, see RadiusLayerCacheMemory. The areas of radius zero are always kept.
+     *
+     * Must not be called while other threads access the caches, nor while references to cached areas are held.
+     */
+    void trim_caches(size_t min_layer) const;
+
     Polygons get_contours(size_t layer_nr) const;
     Polygons get_contours_with_holes(size_t layer_nr) const;
 
@@ -259,16 +268,6 @@ private:
         int recursions;
 
     };
-    struct RadiusLayerPairEquality {
-        constexpr bool operator()(const RadiusLayerPair& _Left, const RadiusLayerPair& _Right) const {
-            return _Left.radius == _Right.radius && _Left.layer_nr == _Right.layer_nr;
-        }
-    };
-    struct RadiusLayerPairHash {
-        size_t operator()(const RadiusLayerPair& elem) const {
-            return std::hash<coord_t>()(elem.radius) ^ std::hash<coord_t>()(elem.layer_nr * 7919);
-        }
-    };
 
     /*!
      * \brief Round \p radius upwards to a multiple of m_radius_sample_resolution
@@ -334,9 +333,10 @@ public:
      *
      * coconut: previously stl::unordered_map is used which seems problematic with tbb::parallel_for.
      * So we change to tbb::concurrent_unordered_map
+     * Now a RadiusLayerCache indexed by layer, which is looked up without hashing and locking.
      */
-    mutable tbb::concurrent_unordered_map<RadiusLayerPair, ExPolygons, RadiusLayerPairHash, RadiusLayerPairEquality> m_collision_cache;
-    mutable tbb::concurrent_unordered_map<RadiusLayerPair, ExPolygons, RadiusLayerPairHash, RadiusLayerPairEquality> m_avoidance_cache;
+    mutable RadiusLayerCache<coordf_t, ExPolygons> m_collision_cache;
+    mutable RadiusLayerCache<coordf_t, ExPolygons> m_avoidance_cache;
 
     friend TreeSupport;
 };
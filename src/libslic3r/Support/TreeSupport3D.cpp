@@ -2540,6 +2540,9 @@ static void create_layer_pathing(const TreeModelVolumes &volumes, const TreeSupp
             Progress::messageProgress(Progress::Stage::SUPPORT, progress_total * m_progress_multiplier + m_progress_offset, TREE_PROGRESS_TOTAL);
     #endif
             throw_on_cancel();
+            // The layers above this one are not queried by the pathing anymore and no reference to the cached areas is held
+            // between the layers, thus this is the safe point to release the cached areas over the memory budget.
+            volumes.trim_caches(layer_idx);
         }
 
     BOOST_LOG_TRIVIAL(info) << "Time spent with creating influence areas' subtasks: Increasing areas " << dur_inc.count() / 1000000 <<
@@ -27,6 +27,9 @@
 #include <boost/nowide/cstdio.hpp>
 #include <boost/predef/other/endian.h>
 
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
 #include <Eigen/Core>
 #include <Eigen/Dense>
 
@@ -677,7 +680,8 @@ int its_merge_vertices(indexed_triangle_set &its, bool shrink_to_fit)
     auto sorted = reserve_vector<int>(its.vertices.size());
     for (int i = 0; i < int(its.vertices.size()); ++ i)
         sorted.emplace_back(i);
-    std::sort(sorted.begin(), sorted.end(), [&its](int il, int ir) {
+    // The index is part of the key, therefore the order is unique and the parallel sort is deterministic.
+    tbb::parallel_sort(sorted.begin(), sorted.end(), [&its](int il, int ir) {
         const Vec3f &l = its.vertices[il];
         const Vec3f &r = its.vertices[ir];
         // Sort lexicographically by coordinates AND vertex index.
@@ -722,9 +726,13 @@ int its_merge_vertices(indexed_triangle_set &its, bool shrink_to_fit)
         // Shrink the vertices.
         its.vertices.erase(its.vertices.begin() + k, its.vertices.end());
         // Remap face indices.
-        for (stl_triangle_vertex_indices &face : its.indices)
-            for (int i = 0; i < 3; ++ i)
-                face(i) = map_vertices[face(i)];
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, its.indices.size()), [&its, &map_vertices](const tbb::blocked_range<size_t> &range) {
+            for (size_t face_idx = range.begin(); face_idx < range.end(); ++ face_idx) {
+                stl_triangle_vertex_indices &face = its.indices[face_idx];
+                for (int i = 0; i < 3; ++ i)
+                    face(i) = map_vertices[face(i)];
+            }
+        });
         // Optionally shrink to fit (reallocate) vertices.
         if (shrink_to_fit)
             its.vertices.shrink_to_fit();
@@ -10,13 +10,14 @@
 #include <algorithm>
 #include <cmath>
 #include <deque>
-#include <queue>
 #include <mutex>
+#include <queue>
 #include <utility>
 
 #include <boost/log/trivial.hpp>
 
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
 #ifndef NDEBUG
 //    #define EXPENSIVE_DEBUG_CHECKS
@@ -31,8 +32,6 @@
 #endif
 
 #include <assert.h>
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/lock_guard.hpp>
 
 // #define SLIC3R_DEBUG_SLICE_PROCESSING
 
@@ -472,7 +471,7 @@ static FacetSliceType slice_facet_for_cut_mesh(
     return FacetSliceType::NoSlice;
 }
 
-template<typename TransformVertex>
+template<typename TransformVertex, typename EmitLine>
 void slice_facet_at_zs(
     // Scaled or unscaled vertices. transform_vertex_fn may scale zs.
     const std::vector<Vec3f>                         &mesh_vertices,
@@ -481,8 +480,8 @@ void slice_facet_at_zs(
     const Vec3i32                                      &edge_ids,
     // Scaled or unscaled zs. If vertices have their zs scaled or transform_vertex_fn scales them, then zs have to be scaled as well.
     const std::vector<float>                         &zs,
-    std::vector<IntersectionLines>                   &lines,
-    std::array<std::mutex, 64>                       &lines_mutex)
+    // emit_line(slice_id, intersection_line)
+    EmitLine                                         &&emit_line)
 {
     stl_vertex vertices[3] { transform_vertex_fn(mesh_vertices[indices(0)]), transform_vertex_fn(mesh_vertices[indices(1)]), transform_vertex_fn(mesh_vertices[indices(2)]) };
 
@@ -500,13 +499,88 @@ void slice_facet_at_zs(
         // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
         if (min_z != max_z && slice_facet(*it, vertices, indices, edge_ids, idx_vertex_lowest, false, il) == FacetSliceType::Slicing) {
             assert(il.edge_type != IntersectionLine::FacetEdgeType::Horizontal);
-            size_t slice_id = it - zs.begin();
-            boost::lock_guard<std::mutex> l(lines_mutex[slice_id % lines_mutex.size()]);
-            lines[slice_id].emplace_back(il);
+            emit_line(size_t(it - zs.begin()), il);
         }
     }
 }
 
+// Intersection lines of a contiguous range of faces bucketed by layer. Only the layers touched by the faces are allocated,
+// the range is extended on demand in both directions.
+class LayerRangeBuckets
+{
+public:
+    IntersectionLines& operator[](size_t layer_idx) {
+        if (m_layers.empty()) {
+            m_first = layer_idx;
+            m_layers.emplace_back();
+        } else if (layer_idx < m_first) {
+            // Extend by at least the current size to keep the extension amortized for faces sorted top down.
+            size_t first = std::min(layer_idx, m_first - std::min(m_first, m_layers.size()));
+            m_layers.insert(m_layers.begin(), m_first - first, IntersectionLines());
+            m_first = first;
+        } else if (layer_idx >= m_first + m_layers.size())
+            m_layers.resize(layer_idx + 1 - m_first);
+        return m_layers[layer_idx - m_first];
+    }
+    // nullptr if no face of the range touched the layer.
+    IntersectionLines* find(size_t layer_idx) {
+        return layer_idx >= m_first && layer_idx < m_first + m_layers.size() ? &m_layers[layer_idx - m_first] : nullptr;
+    }
+
+private:
+    size_t                          m_first { 0 };
+    std::vector<IntersectionLines>  m_layers;
+};
+
+// Slices faces [0, num_faces) in parallel with slice_face(face_idx, chunk_lines). Each contiguous range of faces gets its own
+// per layer buffers chunk_lines, one set for each of the outputs. The buffers are then appended to the outputs in the order
+// of the face ranges, thus no locking is needed and the lines of a layer are ordered by the index of the face producing them.
+template<typename SliceFace, typename ThrowOnCancel>
+static void slice_faces_to_buckets(
+    const size_t                                        num_faces,
+    const std::vector<std::vector<IntersectionLines>*> &outputs,
+    SliceFace                                           slice_face,
+    const ThrowOnCancel                                 throw_on_cancel_fn)
+{
+    // Enough chunks to balance the load. Each chunk allocates buckets for the layers spanned by its faces only.
+    const size_t num_chunks  = std::clamp<size_t>(num_faces / 4096, 1, 4 * size_t(tbb::this_task_arena::max_concurrency()));
+    const size_t num_outputs = outputs.size();
+    std::vector<LayerRangeBuckets> chunks(num_chunks * num_outputs);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks, 1),
+        [num_faces, num_chunks, num_outputs, &chunks, &slice_face, throw_on_cancel_fn](const tbb::blocked_range<size_t> &range) {
+            for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                LayerRangeBuckets *lines = chunks.data() + chunk_idx * num_outputs;
+                size_t face_end = num_faces * (chunk_idx + 1) / num_chunks;
+                for (size_t face_idx = num_faces * chunk_idx / num_chunks; face_idx < face_end; ++ face_idx) {
+                    if ((face_idx & 0x0ffff) == 0)
+                        throw_on_cancel_fn();
+                    slice_face(face_idx, lines);
+                }
+            }
+        });
+    for (size_t i = 0; i < num_outputs; ++ i) {
+        std::vector<IntersectionLines> &out = *outputs[i];
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, out.size()),
+            [num_chunks, num_outputs, i, &out, &chunks](const tbb::blocked_range<size_t> &range) {
+                for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                    IntersectionLines &dst = out[layer_idx];
+                    size_t             cnt = dst.size();
+                    for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++ chunk_idx)
+                        if (const IntersectionLines *src = chunks[chunk_idx * num_outputs + i].find(layer_idx); src)
+                            cnt += src->size();
+                    dst.reserve(cnt);
+                    for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++ chunk_idx)
+                        if (IntersectionLines *src = chunks[chunk_idx * num_outputs + i].find(layer_idx); src) {
+                            dst.insert(dst.end(), src->begin(), src->end());
+                            IntersectionLines().swap(*src);
+                        }
+                }
+            });
+    }
+}
+
 template<typename TransformVertex, typename ThrowOnCancel>
 static inline std::vector<IntersectionLines> slice_make_lines(
     const std::vector<stl_vertex>                   &vertices,
@@ -517,17 +591,11 @@ static inline std::vector<IntersectionLines> slice_make_lines(
     const ThrowOnCancel                              throw_on_cancel_fn)
 {
     std::vector<IntersectionLines>  lines(zs.size(), IntersectionLines());
-    std::array<std::mutex, 64>      lines_mutex;
-    tbb::parallel_for(
-        tbb::blocked_range<int>(0, int(indices.size())),
-        [&vertices, &transform_vertex_fn, &indices, &face_edge_ids, &zs, &lines, &lines_mutex, throw_on_cancel_fn](const tbb::blocked_range<int> &range) {
-            for (int face_idx = range.begin(); face_idx < range.end(); ++ face_idx) {
-                if ((face_idx & 0x0ffff) == 0)
-                    throw_on_cancel_fn();
-                slice_facet_at_zs(vertices, transform_vertex_fn, indices[face_idx], face_edge_ids[face_idx], zs, lines, lines_mutex);
-            }
-        }
-    );
+    slice_faces_to_buckets(indices.size(), { &lines },
+        [&vertices, &transform_vertex_fn, &indices, &face_edge_ids, &zs](size_t face_idx, LayerRangeBuckets *chunk_lines) {
+            slice_facet_at_zs(vertices, transform_vertex_fn, indices[face_idx], face_edge_ids[face_idx], zs,
+                [chunk_lines](size_t slice_id, const IntersectionLine &il) { chunk_lines[0][slice_id].emplace_back(il); });
+        }, throw_on_cancel_fn);
     return lines;
 }
 
@@ -583,7 +651,7 @@ enum class FaceOrientation : char {
     Degenerate
 };
 
-template<bool ProjectionFromTop>
+template<bool ProjectionFromTop, typename EmitAtSlice, typename EmitBetweenSlices>
 void slice_facet_with_slabs(
     // Scaled or unscaled vertices. transform_vertex_fn may scale zs.
     const std::vector<Vec3f>                         &mesh_vertices,
@@ -595,8 +663,9 @@ void slice_facet_with_slabs(
     // from bottom plane of the slab to the top plane of the slab and vice versa.
     const int                                         num_edges,
     const std::vector<float>                         &zs,
-    SlabLines                                        &lines,
-    std::array<std::mutex, 64>                       &lines_mutex)
+    // emit_at_slice(slice_id, intersection_line), emit_between_slices(slab_id, intersection_line)
+    EmitAtSlice                                      &emit_at_slice,
+    EmitBetweenSlices                                &emit_between_slices)
 {
     const stl_triangle_vertex_indices &indices = mesh_triangles[facet_idx];
     stl_vertex vertices[3] { mesh_vertices[indices(0)], mesh_vertices[indices(1)], mesh_vertices[indices(2)] };
@@ -612,11 +681,10 @@ void slice_facet_with_slabs(
     assert(min_layer == zs.end() ? max_layer == zs.end() : *min_layer >= min_z);
     assert(max_layer == zs.end() || *max_layer > max_z);
 
-    auto emit_slab_edge = [&lines, &lines_mutex](IntersectionLine il, size_t slab_id, bool reverse) {
+    auto emit_slab_edge = [&emit_between_slices](IntersectionLine il, size_t slab_id, bool reverse) {
         if (reverse)
             il.reverse();
-        boost::lock_guard<std::mutex> l(lines_mutex[(slab_id + lines_mutex.size() / 2) % lines_mutex.size()]);
-        lines.between_slices[slab_id].emplace_back(il);
+        emit_between_slices(slab_id, il);
     };
 
     if (min_layer == max_layer || horizontal) {
@@ -636,7 +704,7 @@ void slice_facet_with_slabs(
 #else
             // Project the coplanar bottom facing triangles to the plane above the slicing plane to match the behavior of slice_mesh() / slice_mesh_ex(),
             // where the slicing plane slices the top facing surfaces, but misses the bottom facing surfaces.
-            if (size_t line_id = ProjectionFromTop ? slice_id : slice_id + 1; ProjectionFromTop || line_id < lines.at_slice.size())
+            if (size_t line_id = ProjectionFromTop ? slice_id : slice_id + 1; ProjectionFromTop || line_id < zs.size())
 #endif
                 for (int iedge = 0; iedge < 3; ++ iedge)
                     if (facet_neighbors(iedge) == -1) {
@@ -651,8 +719,7 @@ void slice_facet_with_slabs(
                         };
                         // Don't flip the FacetEdgeType::Top edge, it will be flipped when chaining.
                         // if (! ProjectionFromTop) il.reverse();
-                        boost::lock_guard<std::mutex> l(lines_mutex[line_id % lines_mutex.size()]);
-                        lines.at_slice[line_id].emplace_back(il);
+                        emit_at_slice(line_id, il);
                     }
         } else {
             // Triangle is completely between two slicing planes, the triangle may or may not be horizontal, which 
@@ -769,9 +836,7 @@ void slice_facet_with_slabs(
                 if (type == FacetSliceType::Slicing) {
                     if (! ProjectionFromTop)
                         il.reverse();
-                    size_t line_id = it - zs.begin();
-                    boost::lock_guard<std::mutex> l(lines_mutex[line_id % lines_mutex.size()]);
-                    lines.at_slice[line_id].emplace_back(il);
+                    emit_at_slice(size_t(it - zs.begin()), il);
                 }
             }
             if (! ProjectionFromTop || it != zs.begin()) {
@@ -925,8 +990,6 @@ inline std::pair<SlabLines, SlabLines> slice_slabs_make_lines(
     std::pair<SlabLines, SlabLines> out;
     SlabLines   &lines_top      = out.first;
     SlabLines   &lines_bottom   = out.second;
-    std::array<std::mutex, 64> lines_mutex_top;
-    std::array<std::mutex, 64> lines_mutex_bottom;
 
     if (top) {
         lines_top.at_slice.assign(zs.size(), IntersectionLines());
@@ -937,40 +1000,42 @@ inline std::pair<SlabLines, SlabLines> slice_slabs_make_lines(
         lines_bottom.between_slices.assign(zs.size(), IntersectionLines());        
     }
 
-    tbb::parallel_for(
-        tbb::blocked_range<int>(0, int(indices.size())),
-        [&vertices, &indices, &face_neighbors, &face_edge_ids, num_edges, &face_orientation, &zs, top, bottom, &lines_top, &lines_bottom, &lines_mutex_top, &lines_mutex_bottom, throw_on_cancel_fn]
-        (const tbb::blocked_range<int> &range) {
-            for (int face_idx = range.begin(); face_idx < range.end(); ++ face_idx) {
-                if ((face_idx & 0x0ffff) == 0)
-                    throw_on_cancel_fn();
-                FaceOrientation fo       = face_orientation[face_idx];
-                Vec3i32           edge_ids = face_edge_ids[face_idx];
-                if (top && (fo == FaceOrientation::Up || fo == FaceOrientation::Degenerate)) {
-                    Vec3i32 neighbors = face_neighbors[face_idx];
-                    // Reset neighborship of this triangle in case the other triangle is oriented backwards from this one.
-                    for (int i = 0; i < 3; ++ i)
-                        if (neighbors(i) != -1) {
-                            FaceOrientation fo2 = face_orientation[neighbors(i)];
-                            if (fo2 != FaceOrientation::Up && fo2 != FaceOrientation::Degenerate)
-                                neighbors(i) = -1;
-                        }
-                    slice_facet_with_slabs<true>(vertices, indices, face_idx, neighbors, edge_ids, num_edges, zs, lines_top, lines_mutex_top);
-                }
-                if (bottom && (fo == FaceOrientation::Down || fo == FaceOrientation::Degenerate)) {
-                    Vec3i32 neighbors = face_neighbors[face_idx];
-                    // Reset neighborship of this triangle in case the other triangle is oriented backwards from this one.
-                    for (int i = 0; i < 3; ++ i)
-                        if (neighbors(i) != -1) {
-                            FaceOrientation fo2 = face_orientation[neighbors(i)];
-                            if (fo2 != FaceOrientation::Down && fo2 != FaceOrientation::Degenerate)
-                                neighbors(i) = -1;
-                        }
-                    slice_facet_with_slabs<false>(vertices, indices, face_idx, neighbors, edge_ids, num_edges, zs, lines_bottom, lines_mutex_bottom);
-                }
+    // Slice a single face, passing the lines to the emit functors of the top and bottom SlabLines.
+    auto slice_face = [&vertices, &indices, &face_neighbors, &face_edge_ids, num_edges, &face_orientation, &zs, top, bottom]
+        (size_t face_idx, auto &&emit_top_at_slice, auto &&emit_top_between_slices, auto &&emit_bottom_at_slice, auto &&emit_bottom_between_slices) {
+            FaceOrientation fo       = face_orientation[face_idx];
+            Vec3i32           edge_ids = face_edge_ids[face_idx];
+            if (top && (fo == FaceOrientation::Up || fo == FaceOrientation::Degenerate)) {
+                Vec3i32 neighbors = face_neighbors[face_idx];
+                // Reset neighborship of this triangle in case the other triangle is oriented backwards from this one.
+                for (int i = 0; i < 3; ++ i)
+                    if (neighbors(i) != -1) {
+                        FaceOrientation fo2 = face_orientation[neighbors(i)];
+                        if (fo2 != FaceOrientation::Up && fo2 != FaceOrientation::Degenerate)
+                            neighbors(i) = -1;
+                    }
+                slice_facet_with_slabs<true>(vertices, indices, face_idx, neighbors, edge_ids, num_edges, zs, emit_top_at_slice, emit_top_between_slices);
             }
-        }
-    );
+            if (bottom && (fo == FaceOrientation::Down || fo == FaceOrientation::Degenerate)) {
+                Vec3i32 neighbors = face_neighbors[face_idx];
+                // Reset neighborship of this triangle in case the other triangle is oriented backwards from this one.
+                for (int i = 0; i < 3; ++ i)
+                    if (neighbors(i) != -1) {
+                        FaceOrientation fo2 = face_orientation[neighbors(i)];
+                        if (fo2 != FaceOrientation::Down && fo2 != FaceOrientation::Degenerate)
+                            neighbors(i) = -1;
+                    }
+                slice_facet_with_slabs<false>(vertices, indices, face_idx, neighbors, edge_ids, num_edges, zs, emit_bottom_at_slice, emit_bottom_between_slices);
+            }
+        };
+
+    slice_faces_to_buckets(indices.size(), { &lines_top.at_slice, &lines_top.between_slices, &lines_bottom.at_slice, &lines_bottom.between_slices },
+        [&slice_face](size_t face_idx, LayerRangeBuckets *chunk_lines) {
+            auto emitter = [chunk_lines](size_t output_idx) {
+                return [lines = chunk_lines + output_idx](size_t id, const IntersectionLine &il) { (*lines)[id].emplace_back(il); };
+            };
+            slice_face(face_idx, emitter(0), emitter(1), emitter(2), emitter(3));
+        }, throw_on_cancel_fn);
     return out;
 }
 
@@ -1938,6 +2003,35 @@ std::vector<Polygons> slice_mesh(
 }
 
 // Specialized version for a single slicing plane only, running on a single thread.
+std::vector<Lines> slice_mesh_lines(const indexed_triangle_set &mesh, const std::vector<float> &zs, MeshSlicingLineCollection collection)
+{
+    std::vector<Vec3i32>           face_edge_ids = its_face_edge_ids(mesh);
+    std::vector<stl_vertex>        vertices      = transform_mesh_vertices_for_slicing(mesh, Transform3d::Identity());
+    auto                           identity      = [](const Vec3f &p) { return p; };
+    std::vector<IntersectionLines> lines;
+    if (collection == MeshSlicingLineCollection::Bucketed) {
+        lines = slice_make_lines(vertices, identity, mesh.indices, face_edge_ids, zs, []{});
+    } else {
+        // The lines of each layer are pushed to a vector shared by all the threads, guarded by a pool of mutexes.
+        lines.assign(zs.size(), IntersectionLines());
+        std::array<std::mutex, 64> lines_mutex;
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, mesh.indices.size()),
+            [&vertices, &identity, &mesh, &face_edge_ids, &zs, &lines, &lines_mutex](const tbb::blocked_range<size_t> &range) {
+                for (size_t face_idx = range.begin(); face_idx < range.end(); ++ face_idx)
+                    slice_facet_at_zs(vertices, identity, mesh.indices[face_idx], face_edge_ids[face_idx], zs,
+                        [&lines, &lines_mutex](size_t slice_id, const IntersectionLine &il) {
+                            std::lock_guard<std::mutex> l(lines_mutex[slice_id % lines_mutex.size()]);
+                            lines[slice_id].emplace_back(il);
+                        });
+            });
+    }
+    std::vector<Lines> out(lines.size());
+    for (size_t i = 0; i < lines.size(); ++ i)
+        out[i].assign(lines[i].begin(), lines[i].end());
+    return out;
+}
+
 Polygons slice_mesh(
     const indexed_triangle_set       &mesh,
     // Unscaled Zs
@@ -69,6 +69,21 @@ Polygons                        slice_mesh(
     const float                       plane_z,
     const MeshSlicingParams          &params);
 
+// How slice_mesh_lines() collects the intersection lines produced by the faces sliced in parallel.
+enum class MeshSlicingLineCollection {
+    // Per face range buckets appended in the order of the faces, as slice_mesh() does.
+    Bucketed,
+    // Per layer vectors shared by all the threads and guarded by a pool of mutexes.
+    Locked,
+};
+
+// Intersection lines of the mesh with the planes zs, scaled in XY and not chained into loops.
+// For benchmarking the collection of the lines, the order of the lines of a layer is nondeterministic with Locked.
+std::vector<Lines>              slice_mesh_lines(
+    const indexed_triangle_set       &mesh,
+    const std::vector<float>         &zs,
+    MeshSlicingLineCollection         collection);
+
 std::vector<ExPolygons>         slice_mesh_ex(
     const indexed_triangle_set       &mesh,
     const std::vector<float>         &zs,
@@ -398,7 +398,7 @@ void GCodeRenderer::refresh_render_paths(bool keep_sequential_current_first, boo
                                     size_t move_id = m_data->m_ssid_to_moveid_map[i];
                                     const GCodeProcessorResult::MoveVertex& curr = m_data->m_gcode_result->moves[move_id];
                                     if (curr.is_arc_move()) {
-                                        offset += curr.interpolation_points.size();
+                                        offset += curr.interpolation_points_count;
                                     }
                                 }
                                 offset = 2 * offset - 1;
@@ -410,7 +410,7 @@ void GCodeRenderer::refresh_render_paths(bool keep_sequential_current_first, boo
                                     size_t move_id = m_data->m_ssid_to_moveid_map[i];
                                     const GCodeProcessorResult::MoveVertex& curr = m_data->m_gcode_result->moves[move_id];
                                     if (curr.is_arc_move()) {
-                                        offset += curr.interpolation_points.size();
+                                        offset += curr.interpolation_points_count;
                                     }
                                 }
                                 offset = indices_count * (offset - 1) + (indices_count - 2);
@@ -508,7 +508,7 @@ void GCodeRenderer::refresh_render_paths(bool keep_sequential_current_first, boo
                 size_t move_id = m_data->m_ssid_to_moveid_map[i];
                 const GCodeProcessorResult::MoveVertex& curr = m_data->m_gcode_result->moves[move_id];
                 if (curr.is_arc_move()) {
-                    segments_count += curr.interpolation_points.size();
+                    segments_count += curr.interpolation_points_count;
                 }
             }
             size_in_indices = buffer.indices_per_segment() * segments_count;
@@ -7,24 +7,53 @@
 
 #include <GL/glew.h>
 
+#include <chrono>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 namespace Slic3r {
 namespace GUI{
 namespace GCode {
 
+// count of the segments of a move, arc moves are split at their interpolation points
+static size_t move_segments_count(const GCodeProcessorResult::MoveVertex& curr) {
+    return curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points_count + 1 : 1;
+}
+
+// count of floats written by add_vertices_as_line()
+static size_t line_vertices_size_floats(const GCodeProcessorResult::MoveVertex& curr) {
+    // 2 vertices of 3 floats per segment
+    return move_segments_count(curr) * 2 * 3;
+}
+
+// count of floats written by add_vertices_as_solid()
+static size_t solid_vertices_size_floats(const GCodeProcessorResult::MoveVertex& curr, bool first_segment) {
+    // 8 vertices for the first segment of a path or of a vertex buffer, 6 vertices otherwise, 4 floats each
+    return ((first_segment ? 8 : 6) + 6 * (move_segments_count(curr) - 1)) * 4;
+}
+
+// count of floats written by add_vertices_as_model_batch()
+static size_t model_batch_vertices_size_floats(const GLModel::Geometry& data) {
+    return data.vertices_count() * 4;
+}
+
 // format data into the buffers to be rendered as lines
-static void add_vertices_as_line(const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, VertexBuffer& vertices) {
+// writes line_vertices_size_floats() floats starting at vertices
+static void add_vertices_as_line(const GCodeProcessorResult& gcode_result, const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, float* vertices) {
     auto add_vertex = [&vertices](const Vec3f& position) {
         // add position
-        vertices.push_back(position.x());
-        vertices.push_back(position.y());
-        vertices.push_back(position.z());
+        *vertices++ = position.x();
+        *vertices++ = position.y();
+        *vertices++ = position.z();
     };
     // x component of the normal to the current segment (the normal is parallel to the XY plane)
     //BBS: Has modified a lot for this function to support arc move
-    size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() : 0;
+    const GCodeProcessorResult::InterpolationPoints curr_points = gcode_result.interpolation_points(curr);
+    size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr_points.size() : 0;
     for (size_t i = 0; i < loop_num + 1; i++) {
-        const Vec3f &previous = (i == 0? prev.position : curr.interpolation_points[i-1]);
-        const Vec3f &current = (i == loop_num? curr.position : curr.interpolation_points[i]);
+        const Vec3f &previous = (i == 0? prev.position : curr_points[i-1]);
+        const Vec3f &current = (i == loop_num? curr.position : curr_points[i]);
         // add previous vertex
         add_vertex(previous);
         // add current vertex
@@ -42,7 +71,7 @@ static void add_indices_as_line(const GCodeProcessorResult::MoveVertex& prev, co
         }
 
         Path& last_path = buffer.paths.back();
-        size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() : 0;
+        size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points_count : 0;
         for (size_t i = 0; i < loop_num + 1; i++) {
             //BBS: add previous index
             indices.push_back(static_cast<IBufferType>(indices.size()));
@@ -53,13 +82,30 @@ static void add_indices_as_line(const GCodeProcessorResult::MoveVertex& prev, co
         last_path.sub_paths.back().last = { ibuffer_id, indices.size() - 1, move_id, curr.position };
 }
 
+// update the paths of the buffer for a move to be rendered as solid, the vertices are written later by add_vertices_as_solid()
+// vbuffer_size is the size in floats of the current vertex buffer, it is increased by the size of the vertices of the move
+// returns whether the move starts with the first segment of a path or of a vertex buffer
+static bool add_path_as_solid(const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, TBuffer& buffer, unsigned int vbuffer_id, size_t& vbuffer_size, size_t move_id) {
+    if (buffer.paths.empty() || prev.type != curr.type || !buffer.paths.back().matches(curr)) {
+        buffer.add_path(curr, vbuffer_id, vbuffer_size, move_id - 1);
+        buffer.paths.back().sub_paths.back().first.position = prev.position;
+    }
+
+    Path& last_path = buffer.paths.back();
+    const bool first_segment = last_path.vertices_count() == 1 || vbuffer_size == 0;
+    vbuffer_size += solid_vertices_size_floats(curr, first_segment);
+    last_path.sub_paths.back().last = { vbuffer_id, vbuffer_size, move_id, curr.position };
+    return first_segment;
+}
+
 // format data into the buffers to be rendered as solid.
-static void add_vertices_as_solid(const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, TBuffer& buffer, unsigned int vbuffer_id, VertexBuffer& vertices, size_t move_id) {
-    auto store_vertex = [](VertexBuffer& vertices, const Vec3f& position, const Vec3f& normal) {
+// writes solid_vertices_size_floats() floats starting at vertices
+static void add_vertices_as_solid(const GCodeProcessorResult& gcode_result, const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, const Path& path, bool first_segment, float* vertices) {
+    auto store_vertex = [](float*& vertices, const Vec3f& position, const Vec3f& normal) {
         // append position
-        vertices.push_back(position.x());
-        vertices.push_back(position.y());
-        vertices.push_back(position.z());
+        *vertices++ = position.x();
+        *vertices++ = position.y();
+        *vertices++ = position.z();
         // append normal as 3 bytes + 1 byte padding (4 bytes total)
         // Convert normal from [-1,1] to [0,255] range
         unsigned char nx = static_cast<unsigned char>((normal.x() + 1.0f) * 127.5f);
@@ -72,28 +118,23 @@ static void add_vertices_as_solid(const GCodeProcessorResult::MoveVertex& prev,
                              (static_cast<unsigned int>(ny) << 16) | 
                              (static_cast<unsigned int>(nz) << 8) | 
                              static_cast<unsigned int>(padding);
-        vertices.push_back(*reinterpret_cast<float*>(&packed));
+        *vertices++ = *reinterpret_cast<float*>(&packed);
     };
 
-    if (buffer.paths.empty() || prev.type != curr.type || !buffer.paths.back().matches(curr)) {
-        buffer.add_path(curr, vbuffer_id, vertices.size(), move_id - 1);
-        buffer.paths.back().sub_paths.back().first.position = prev.position;
-    }
-
-    Path& last_path = buffer.paths.back();
     //BBS: Has modified a lot for this function to support arc move
-    size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() : 0;
+    const GCodeProcessorResult::InterpolationPoints curr_points = gcode_result.interpolation_points(curr);
+    size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr_points.size() : 0;
     for (size_t i = 0; i < loop_num + 1; i++) {
-        const Vec3f &prev_position = (i == 0? prev.position : curr.interpolation_points[i-1]);
-        const Vec3f &curr_position = (i == loop_num? curr.position : curr.interpolation_points[i]);
+        const Vec3f &prev_position = (i == 0? prev.position : curr_points[i-1]);
+        const Vec3f &curr_position = (i == loop_num? curr.position : curr_points[i]);
 
         const Vec3f dir = (curr_position - prev_position).normalized();
         const Vec3f right = Vec3f(dir.y(), -dir.x(), 0.0f).normalized();
         const Vec3f left = -right;
         const Vec3f up = right.cross(dir);
         const Vec3f down = -up;
-        const float half_width = 0.5f * last_path.width;
-        const float half_height = 0.5f * last_path.height;
+        const float half_width = 0.5f * path.width;
+        const float half_height = 0.5f * path.height;
         const Vec3f prev_pos = prev_position - half_height * up;
         const Vec3f curr_pos = curr_position - half_height * up;
         const Vec3f d_up = half_height * up;
@@ -101,7 +142,7 @@ static void add_vertices_as_solid(const GCodeProcessorResult::MoveVertex& prev,
         const Vec3f d_right = half_width * right;
         const Vec3f d_left = -half_width * right;
 
-        if ((last_path.vertices_count() == 1 || vertices.empty()) && i == 0) {
+        if (first_segment && i == 0) {
             store_vertex(vertices, prev_pos + d_up, up);
             store_vertex(vertices, prev_pos + d_right, right);
             store_vertex(vertices, prev_pos + d_down, down);
@@ -116,11 +157,9 @@ static void add_vertices_as_solid(const GCodeProcessorResult::MoveVertex& prev,
         store_vertex(vertices, curr_pos + d_down, down);
         store_vertex(vertices, curr_pos + d_left, left);
     }
-
-    last_path.sub_paths.back().last = { vbuffer_id, vertices.size(), move_id, curr.position };
 }
 
-static void add_indices_as_solid (const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, const GCodeProcessorResult::MoveVertex* next,
+static void add_indices_as_solid (const GCodeProcessorResult& gcode_result, const GCodeProcessorResult::MoveVertex& prev, const GCodeProcessorResult::MoveVertex& curr, const GCodeProcessorResult::MoveVertex* next,
     TBuffer& buffer, size_t& vbuffer_size, unsigned int ibuffer_id, IndexBuffer& indices, size_t move_id) {
         static Vec3f prev_dir;
         static Vec3f prev_up;
@@ -177,10 +216,11 @@ static void add_indices_as_solid (const GCodeProcessorResult::MoveVertex& prev,
         std::array<IBufferType, 8> first_seg_v_offsets = convert_vertices_offset(vbuffer_size, { 0, 1, 2, 3, 4, 5, 6, 7 });
         std::array<IBufferType, 8> non_first_seg_v_offsets = convert_vertices_offset(vbuffer_size, { -4, 0, -2, 1, 2, 3, 4, 5 });
 
-        size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() : 0;
+        const GCodeProcessorResult::InterpolationPoints curr_points = gcode_result.interpolation_points(curr);
+        size_t loop_num = curr.is_arc_move_with_interpolation_points() ? curr_points.size() : 0;
         for (size_t i = 0; i < loop_num + 1; i++) {
-            const Vec3f &prev_position = (i == 0? prev.position : curr.interpolation_points[i-1]);
-            const Vec3f &curr_position = (i == loop_num? curr.position : curr.interpolation_points[i]);
+            const Vec3f &prev_position = (i == 0? prev.position : curr_points[i-1]);
+            const Vec3f &curr_position = (i == loop_num? curr.position : curr_points[i]);
 
             const Vec3f dir = (curr_position - prev_position).normalized();
             const Vec3f right = Vec3f(dir.y(), -dir.x(), 0.0f).normalized();
@@ -276,7 +316,8 @@ static void add_model_instance(const GCodeProcessorResult::MoveVertex& curr, Ins
 }
 
 // format data into the buffers to be rendered as batched model
-static void add_vertices_as_model_batch(const GCodeProcessorResult::MoveVertex& curr, const GLModel::Geometry& data, VertexBuffer& vertices, InstanceBuffer& instances, InstanceIdBuffer& instances_ids, size_t move_id) {
+// writes model_batch_vertices_size_floats() floats starting at vertices, the instance is appended by add_model_batch_instance()
+static void add_vertices_as_model_batch(const GCodeProcessorResult::MoveVertex& curr, const GLModel::Geometry& data, float* vertices) {
     const double width = static_cast<double>(1.5f * curr.width);
     const double height = static_cast<double>(1.5f * curr.height);
 
@@ -288,9 +329,9 @@ static void add_vertices_as_model_batch(const GCodeProcessorResult::MoveVertex&
     for (size_t i = 0; i < vertices_count; ++i) {
         // append position
         const Vec3d position = trafo * data.extract_position_3(i).cast<double>();
-        vertices.push_back(float(position.x()));
-        vertices.push_back(float(position.y()));
-        vertices.push_back(float(position.z()));
+        *vertices++ = float(position.x());
+        *vertices++ = float(position.y());
+        *vertices++ = float(position.z());
 
         // append normal as 3 bytes + 1 byte padding (4 bytes total)
         const Vec3d normal = normal_matrix * data.extract_normal_3(i).cast<double>();
@@ -305,9 +346,11 @@ static void add_vertices_as_model_batch(const GCodeProcessorResult::MoveVertex&
                              (static_cast<unsigned int>(ny) << 16) | 
                              (static_cast<unsigned int>(nz) << 8) | 
                              static_cast<unsigned int>(padding);
-        vertices.push_back(*reinterpret_cast<float*>(&packed));
+        *vertices++ = *reinterpret_cast<float*>(&packed);
     }
+}
 
+static void add_model_batch_instance(const GCodeProcessorResult::MoveVertex& curr, InstanceBuffer& instances, InstanceIdBuffer& instances_ids, size_t move_id) {
     // append instance position
     instances.push_back(curr.position.x());
     instances.push_back(curr.position.y());
@@ -341,11 +384,11 @@ static void smooth_triangle_toolpaths_corners(const GCodeProcessorResult& gcode_
             size_t temp_offset = prev_sub_path.last.s_id - curr_s_id;
             for (size_t i = prev_sub_path.last.s_id; i > curr_s_id; i--) {
                 size_t move_id = m_ssid_to_moveid_map[i];
-                temp_offset += (gcode_result.moves[move_id].is_arc_move() ? gcode_result.moves[move_id].interpolation_points.size() : 0);
+                temp_offset += (gcode_result.moves[move_id].is_arc_move() ? gcode_result.moves[move_id].interpolation_points_count : 0);
             }
             if (is_internal_point) {
                 size_t move_id = m_ssid_to_moveid_map[curr_s_id];
-                temp_offset += (gcode_result.moves[move_id].interpolation_points.size() - interpolation_point_id);
+                temp_offset += (gcode_result.moves[move_id].interpolation_points_count - interpolation_point_id);
             }
             const size_t next_1st_offset = temp_offset * 6 * vertex_size_floats;
             // offset into the vertex buffer of the right vertex of the previous segment
@@ -383,11 +426,11 @@ static void smooth_triangle_toolpaths_corners(const GCodeProcessorResult& gcode_
             size_t temp_offset = prev_sub_path.last.s_id - curr_s_id;
             for (size_t i = prev_sub_path.last.s_id; i > curr_s_id; i--) {
                 size_t move_id = m_ssid_to_moveid_map[i];
-                temp_offset += (gcode_result.moves[move_id].is_arc_move() ? gcode_result.moves[move_id].interpolation_points.size() : 0);
+                temp_offset += (gcode_result.moves[move_id].is_arc_move() ? gcode_result.moves[move_id].interpolation_points_count : 0);
             }
             if (is_internal_point) {
                 size_t move_id = m_ssid_to_moveid_map[curr_s_id];
-                temp_offset += (gcode_result.moves[move_id].interpolation_points.size() - interpolation_point_id);
+                temp_offset += (gcode_result.moves[move_id].interpolation_points_count - interpolation_point_id);
             }
             const size_t next_1st_offset = temp_offset * 6 * vertex_size_floats;
             // offset into the vertex buffer of the left vertex of the previous segment
@@ -430,7 +473,7 @@ static void smooth_triangle_toolpaths_corners(const GCodeProcessorResult& gcode_
             size_t curr_s_id = path.sub_paths.front().first.s_id + j;
             size_t move_id = m_ssid_to_moveid_map[curr_s_id];
             int interpolation_points_num = gcode_result.moves[move_id].is_arc_move_with_interpolation_points()?
-                                                gcode_result.moves[move_id].interpolation_points.size() : 0;
+                                                gcode_result.moves[move_id].interpolation_points_count : 0;
             int loop_num = interpolation_points_num;
             //BBS: select the subpaths which contains the previous/next segments
             if (!path.sub_paths[prev_sub_path_id].contains(curr_s_id))
@@ -451,15 +494,15 @@ static void smooth_triangle_toolpaths_corners(const GCodeProcessorResult& gcode_
             for (int k = 0; k <= loop_num; k++) {
                 const Vec3f& prev = k==0?
                                     gcode_result.moves[move_id - 1].position :
-                                    gcode_result.moves[move_id].interpolation_points[k-1];
+                                    gcode_result.interpolation_points(gcode_result.moves[move_id])[k-1];
                 const Vec3f& curr = k==interpolation_points_num?
                                     gcode_result.moves[move_id].position :
-                                    gcode_result.moves[move_id].interpolation_points[k];
+                                    gcode_result.interpolation_points(gcode_result.moves[move_id])[k];
                 const Vec3f& next = k < interpolation_points_num - 1?
-                                    gcode_result.moves[move_id].interpolation_points[k+1]:
+                                    gcode_result.interpolation_points(gcode_result.moves[move_id])[k+1]:
                                     (k == interpolation_points_num - 1? gcode_result.moves[move_id].position :
                                     (gcode_result.moves[move_id + 1].is_arc_move_with_interpolation_points()?
-                                    gcode_result.moves[move_id + 1].interpolation_points[0] :
+                                    gcode_result.interpolation_points(gcode_result.moves[move_id + 1])[0] :
                                     gcode_result.moves[move_id + 1].position));
 
                 const Vec3f prev_dir = (curr - prev).normalized();
@@ -805,6 +848,8 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
 {
     // max index buffer size, in bytes
     static const size_t IBUFFER_THRESHOLD_BYTES = 64 * 1024 * 1024;
+    // count of moves processed by a task of the parallel loops
+    static const size_t MOVES_CHUNK_SIZE = 65536;
 
     m_moves_count = gcode_result.moves.size();
     if (m_moves_count == 0)
@@ -825,27 +870,46 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
     Points pts;
 
     // extract approximate paths bounding box from result
-    //BBS: add only gcode mode
-    for (const GCodeProcessorResult::MoveVertex& move : gcode_result.moves) {
-        if (move.type == EMoveType::Extrude && move.extrusion_role != erCustom && move.width != 0.0f && move.height != 0.0f) {
-            m_paths_bounding_box.merge(move.position.cast<double>());
-            //BBS: use convex_hull for toolpath outside check
-            pts.emplace_back(Point(scale_(move.position.x()), scale_(move.position.y())));
-        }
-    }
-
-    // BBS: also merge the point on arc to bounding box
-    for (const GCodeProcessorResult::MoveVertex& move : gcode_result.moves) {
-        // continue if not arc path
-        if (!move.is_arc_move_with_interpolation_points())
-            continue;
-
-        if (move.type == EMoveType::Extrude && move.width != 0.0f && move.height != 0.0f)
-            for (int i = 0; i < move.interpolation_points.size(); i++) {
-                m_paths_bounding_box.merge(move.interpolation_points[i].cast<double>());
-                //BBS: use convex_hull for toolpath outside check
-                pts.emplace_back(Point(scale_(move.interpolation_points[i].x()), scale_(move.interpolation_points[i].y())));
+    // the moves are scanned in parallel chunks, which are merged in order
+    {
+        struct BoundingChunk
+        {
+            BoundingBoxf3 bounding_box;
+            Points        pts;
+        };
+        std::vector<BoundingChunk> chunks((m_moves_count + MOVES_CHUNK_SIZE - 1) / MOVES_CHUNK_SIZE);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1), [&gcode_result, &chunks, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk_id = range.begin(); chunk_id < range.end(); ++chunk_id) {
+                BoundingChunk& chunk = chunks[chunk_id];
+                const size_t   end   = std::min(m_moves_count, (chunk_id + 1) * MOVES_CHUNK_SIZE);
+                for (size_t i = chunk_id * MOVES_CHUNK_SIZE; i < end; ++i) {
+                    const GCodeProcessorResult::MoveVertex& move = gcode_result.moves[i];
+                    if (move.type != EMoveType::Extrude || move.width == 0.0f || move.height == 0.0f)
+                        continue;
+                    //BBS: add only gcode mode
+                    if (move.extrusion_role != erCustom) {
+                        chunk.bounding_box.merge(move.position.cast<double>());
+                        //BBS: use convex_hull for toolpath outside check
+                        chunk.pts.emplace_back(Point(scale_(move.position.x()), scale_(move.position.y())));
+                    }
+                    // BBS: also merge the point on arc to bounding box
+                    if (move.is_arc_move_with_interpolation_points())
+                        for (const Vec3f& point : gcode_result.interpolation_points(move)) {
+                            chunk.bounding_box.merge(point.cast<double>());
+                            //BBS: use convex_hull for toolpath outside check
+                            chunk.pts.emplace_back(Point(scale_(point.x()), scale_(point.y())));
+                        }
+                }
             }
+        });
+        size_t pts_count = 0;
+        for (const BoundingChunk& chunk : chunks)
+            pts_count += chunk.pts.size();
+        pts.reserve(pts_count);
+        for (BoundingChunk& chunk : chunks) {
+            m_paths_bounding_box.merge(chunk.bounding_box);
+            append(pts, std::move(chunk.pts));
+        }
     }
 
     // set approximate max bounding box (take in account also the tool marker)
@@ -895,7 +959,28 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
     size_t seams_count = 0;
     std::vector<size_t> biased_seams_ids;
 
+    // placement of the vertices of a move into the vertex buffers
+    struct VertexSlot
+    {
+        // index of the vertex buffer in the multibuffer
+        unsigned int vbuffer_id{ 0 };
+        // offset of the first float into the vertex buffer
+        unsigned int offset{ 0 };
+        // index of the path in TBuffer::paths, used by triangles only
+        unsigned int path_id{ 0 };
+        unsigned char tbuffer_id{ 0 };
+        // the move starts a path or a vertex buffer, used by triangles only
+        bool first_segment{ false };
+    };
+    std::vector<VertexSlot> vertex_slots(m_moves_count);
+    // sizes in floats of the vertex buffers
+    std::vector<std::vector<size_t>> vbuffer_sizes(m_buffers.size());
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+
     // toolpaths data -> extract vertices from result
+    // the sizes of the vertices of the moves are summed up first together with the paths, buffers splits and instances,
+    // then the vertices are generated in parallel at the resulting offsets, thus the buffers match the ones of a serial generation
     for (size_t i = 0; i < m_moves_count; ++i) {
         const GCodeProcessorResult::MoveVertex& curr = gcode_result.moves[i];
         if (curr.type == EMoveType::Seam) {
@@ -911,51 +996,45 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
 
         const GCodeProcessorResult::MoveVertex& prev = gcode_result.moves[i - 1];
 
-        //// update progress dialog
-        //++progress_count;
-        //if (progress_dialog != nullptr && progress_count % progress_threshold == 0) {
-        //    progress_dialog->Update(int(100.0f * float(i) / (2.0f * float(m_moves_count))),
-        //        _L("Generating geometry vertex data") + ": " + wxNumberFormatter::ToString(100.0 * double(i) / double(m_moves_count), 0, wxNumberFormatter::Style_None) + "%");
-        //    progress_dialog->Fit();
-        //    progress_count = 0;
-        //}
-
         const unsigned char id = buffer_id(curr.type);
         TBuffer& t_buffer = m_buffers[id];
-        MultiVertexBuffer& v_multibuffer = vertices[id];
+        std::vector<size_t>& v_sizes = vbuffer_sizes[id];
         InstanceBuffer& inst_buffer = instances[id];
         InstanceIdBuffer& inst_id_buffer = instances_ids[id];
         InstancesOffsets& inst_offsets = instances_offsets[id];
 
-        /*if (i%1000 == 1) {
-            BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":i=%1%, buffer_id %2% render_type %3%, gcode_id %4%\n")
-                %i %(int)id %(int)t_buffer.render_primitive_type %curr.gcode_id;
-        }*/
-
         // ensure there is at least one vertex buffer
-        if (v_multibuffer.empty())
-            v_multibuffer.push_back(VertexBuffer());
+        if (v_sizes.empty())
+            v_sizes.push_back(0);
 
         // if adding the vertices for the current segment exceeds the threshold size of the current vertex buffer
         // add another vertex buffer
         // BBS: get the point number and then judge whether the remaining buffer is enough
-        size_t points_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() + 1 : 1;
+        size_t points_num = move_segments_count(curr);
         size_t vertices_size_to_add = (t_buffer.render_primitive_type == TBuffer::ERenderPrimitiveType::BatchedModel) ? t_buffer.model.data.vertices_size_bytes() : points_num * t_buffer.max_vertices_per_segment_size_bytes();
-        if (v_multibuffer.back().size() * sizeof(float) > t_buffer.vertices.max_size_bytes() - vertices_size_to_add) {
-            v_multibuffer.push_back(VertexBuffer());
+        if (v_sizes.back() * sizeof(float) > t_buffer.vertices.max_size_bytes() - vertices_size_to_add) {
+            v_sizes.push_back(0);
             if (t_buffer.render_primitive_type == TBuffer::ERenderPrimitiveType::Triangle) {
                 Path& last_path = t_buffer.paths.back();
                 if (prev.type == curr.type && last_path.matches(curr))
-                    last_path.add_sub_path(prev, static_cast<unsigned int>(v_multibuffer.size()) - 1, 0, move_id - 1);
+                    last_path.add_sub_path(prev, static_cast<unsigned int>(v_sizes.size()) - 1, 0, move_id - 1);
             }
         }
 
-        VertexBuffer& v_buffer = v_multibuffer.back();
+        VertexSlot& slot = vertex_slots[i];
+        slot.tbuffer_id = id;
+        slot.vbuffer_id = static_cast<unsigned int>(v_sizes.size()) - 1;
+        slot.offset     = static_cast<unsigned int>(v_sizes.back());
 
         switch (t_buffer.render_primitive_type)
         {
-        case TBuffer::ERenderPrimitiveType::Line:     { add_vertices_as_line(prev, curr, v_buffer); break; }
-        case TBuffer::ERenderPrimitiveType::Triangle: { add_vertices_as_solid(prev, curr, t_buffer, static_cast<unsigned int>(v_multibuffer.size()) - 1, v_buffer, move_id); break; }
+        case TBuffer::ERenderPrimitiveType::Line:     { v_sizes.back() += line_vertices_size_floats(curr); break; }
+        case TBuffer::ERenderPrimitiveType::Triangle:
+        {
+            slot.first_segment = add_path_as_solid(prev, curr, t_buffer, slot.vbuffer_id, v_sizes.back(), move_id);
+            slot.path_id = static_cast<unsigned int>(t_buffer.paths.size()) - 1;
+            break;
+        }
         case TBuffer::ERenderPrimitiveType::InstancedModel:
         {
             add_model_instance(curr, inst_buffer, inst_id_buffer, move_id);
@@ -964,7 +1043,8 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
         }
         case TBuffer::ERenderPrimitiveType::BatchedModel:
         {
-            add_vertices_as_model_batch(curr, t_buffer.model.data, v_buffer, inst_buffer, inst_id_buffer, move_id);
+            v_sizes.back() += model_batch_vertices_size_floats(t_buffer.model.data);
+            add_model_batch_instance(curr, inst_buffer, inst_id_buffer, move_id);
             inst_offsets.push_back(prev.position - curr.position);
             break;
         }
@@ -978,6 +1058,40 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
         }
     }
 
+    for (size_t b = 0; b < vertices.size(); ++b) {
+        vertices[b].resize(vbuffer_sizes[b].size());
+        for (size_t v = 0; v < vbuffer_sizes[b].size(); ++v)
+            vertices[b][v].resize(vbuffer_sizes[b][v]);
+    }
+    std::vector<std::vector<size_t>>().swap(vbuffer_sizes);
+
+    auto t_layout = std::chrono::high_resolution_clock::now();
+
+    // every move writes into its own range of a vertex buffer, the paths are not modified anymore
+    tbb::parallel_for(tbb::blocked_range<size_t>(1, std::max<size_t>(1, m_moves_count), MOVES_CHUNK_SIZE / 16),
+        [&gcode_result, &vertex_slots, &vertices, this](const tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+            const GCodeProcessorResult::MoveVertex& curr = gcode_result.moves[i];
+            const GCodeProcessorResult::MoveVertex& prev = gcode_result.moves[i - 1];
+            const VertexSlot& slot = vertex_slots[i];
+            const TBuffer& t_buffer = m_buffers[slot.tbuffer_id];
+            float* v_data = vertices[slot.tbuffer_id][slot.vbuffer_id].data() + slot.offset;
+            switch (t_buffer.render_primitive_type)
+            {
+            case TBuffer::ERenderPrimitiveType::Line:         { add_vertices_as_line(gcode_result, prev, curr, v_data); break; }
+            case TBuffer::ERenderPrimitiveType::Triangle:     { add_vertices_as_solid(gcode_result, prev, curr, t_buffer.paths[slot.path_id], slot.first_segment, v_data); break; }
+            case TBuffer::ERenderPrimitiveType::BatchedModel: { add_vertices_as_model_batch(curr, t_buffer.model.data, v_data); break; }
+            default: { break; }
+            }
+        }
+    });
+    std::vector<VertexSlot>().swap(vertex_slots);
+
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": generated vertices of %1% moves, layout %2% ms, vertices %3% ms")
+        % m_moves_count
+        % std::chrono::duration_cast<std::chrono::milliseconds>(t_layout - t_start).count()
+        % std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_layout).count();
+
     /*for (size_t b = 0; b < vertices.size(); ++b) {
         MultiVertexBuffer& v_multibuffer = vertices[b];
         BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":b=%1%, vertex buffer count %2%\n")
@@ -1128,7 +1242,7 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
         // if adding the indices for the current segment exceeds the threshold size of the current index buffer
         // create another index buffer
         // BBS: get the point number and then judge whether the remaining buffer is enough
-        size_t points_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points.size() + 1 : 1;
+        size_t points_num = curr.is_arc_move_with_interpolation_points() ? curr.interpolation_points_count + 1 : 1;
         size_t indiced_size_to_add = (t_buffer.render_primitive_type == TBuffer::ERenderPrimitiveType::BatchedModel) ? t_buffer.model.data.indices_size_bytes() : points_num * t_buffer.max_indices_per_segment_size_bytes();
         if (i_multibuffer.back().size() * sizeof(IBufferType) >= IBUFFER_THRESHOLD_BYTES - indiced_size_to_add) {
             i_multibuffer.push_back(IndexBuffer());
@@ -1165,7 +1279,7 @@ void GCodeViewerData::load_toolpaths(const GCodeProcessorResult& gcode_result,
             break;
         }
         case TBuffer::ERenderPrimitiveType::Triangle: {
-            add_indices_as_solid(prev, curr, next, t_buffer, curr_vertex_buffer.second, static_cast<unsigned int>(i_multibuffer.size()) - 1, i_buffer, move_id);
+            add_indices_as_solid(gcode_result, prev, curr, next, t_buffer, curr_vertex_buffer.second, static_cast<unsigned int>(i_multibuffer.size()) - 1, i_buffer, move_id);
             break;
         }
         case TBuffer::ERenderPrimitiveType::BatchedModel: {
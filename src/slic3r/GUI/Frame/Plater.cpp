@@ -2410,13 +2410,12 @@ void Plater::load_gcode(const wxString& filename)
                             move.position.x() += offset.x();
                             move.position.y() += offset.y();
                             move.position.z() += offset.z();
-                            if (move.is_arc_move_with_interpolation_points()) {
-                                for (auto& pt : move.interpolation_points) {
-                                    pt.x() += offset.x();
-                                    pt.y() += offset.y();
-                                    pt.z() += offset.z();
-                                }
-                            }
+                        }
+                        // the pool only holds the interpolation points of the arc moves
+                        for (auto& pt : current_result->interpolation_points_pool) {
+                            pt.x() += offset.x();
+                            pt.y() += offset.y();
+                            pt.z() += offset.z();
                         }
                     }
                 }
@@ -1,5 +1,6 @@
 #include "PlaterPrivate.hpp"
 #include "libslic3r/FileSystem/FileHelp.hpp"
+#include "libslic3r/FileSystem/Log.hpp"
 
 #include "slic3r/Scene/ObjectDataViewModel.hpp"
 #include "slic3r/Global/InstanceCheck.hpp"
@@ -3465,6 +3466,7 @@ void Plater::priv::on_process_completed(SlicingProcessCompletedEvent &evt)
     {
         BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":finished, reload print soon");
         m_is_slicing = false;
+        background_process.stop_preslicing();
         this->preview->reload_print(false);
 
         q->SetDropTarget(new PlaterDropTarget(*main_panel, *q));
@@ -3481,6 +3483,7 @@ void Plater::priv::on_process_completed(SlicingProcessCompletedEvent &evt)
         if (ret) {
             BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":slicing all, plate %1% can not be sliced, will stop")%m_cur_slice_plate;
             m_is_slicing = false;
+            background_process.stop_preslicing();
         }
         //not the last plate
         update_fff_scene_only_shells();
@@ -3535,6 +3538,7 @@ void Plater::priv::on_action_slice_plate(SimpleEvent&)
     if (q != nullptr) {
         BOOST_LOG_TRIVIAL(debug) << __FUNCTION__ << ":received slice plate event\n" ;
         m_slice_all = false;
+        background_process.stop_preslicing();
         q->reslice();
         q->select_preview();
     }
@@ -3550,6 +3554,15 @@ void Plater::priv::on_action_slice_all(SimpleEvent&)
         m_cur_slice_plate = 0;
         //select plate
         q->select_plate(m_cur_slice_plate);
+        // Process the other plates concurrently while the first one is being sliced, the serial loop below
+        // then only waits for them and exports their G-code.
+        size_t concurrent_plates = size_t(std::max(0, std::atoi(AppAdapter::app_config()->get("slice_all_concurrent_plates").c_str())));
+        if (concurrent_plates > 0 && partplate_list.get_plate_count() > 1) {
+            std::vector<PartPlate*> plates;
+            for (int i = 1; i < partplate_list.get_plate_count(); ++ i)
+                plates.emplace_back(partplate_list.get_plate(i));
+            background_process.start_preslicing(plates, concurrent_plates, total_physical_memory() / 2);
+        }
         q->reslice();
         q->select_preview();
         //BBS: wish to select all plates stats item
@@ -4037,6 +4050,7 @@ void Plater::priv::init_notification_manager()
     auto cancel_callback = [this]() {
         if (this->background_process.idle())
             return false;
+        this->background_process.stop_preslicing();
         this->background_process.stop();
         return true;
     };
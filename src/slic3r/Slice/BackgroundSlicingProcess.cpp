@@ -3,6 +3,7 @@
 #include "libslic3r/Utils.hpp"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/Base/Thread.hpp"
+#include "libslic3r/FileSystem/Log.hpp"
 #include "libslic3r/PresetBundle.hpp"
 #include "libslic3r/GCode/PostProcessor.hpp"
 
@@ -28,6 +29,7 @@ BackgroundSlicingProcess::BackgroundSlicingProcess()
 
 BackgroundSlicingProcess::~BackgroundSlicingProcess()
 {
+	this->stop_preslicing();
 	this->stop();
 	this->join_background_thread();
 }
@@ -91,6 +93,7 @@ Print* 				BackgroundSlicingProcess::fff_print()
 void BackgroundSlicingProcess::process_fff()
 {
 	get_current_plate()->set_slicing_progress_index(get_current_plate()->get_index());
+	this->wait_for_preslicing(get_current_plate());
 
 	std::vector<Print*> prints = m_gcode_result_wrapper->get_prints();
 	std::vector<GCodeResult*> gcode_results = m_gcode_result_wrapper->get_all_result();
@@ -429,6 +432,7 @@ bool BackgroundSlicingProcess::stop()
 
 bool BackgroundSlicingProcess::reset()
 {
+	this->stop_preslicing();
 	bool stopped = this->stop();
 	return stopped;
 }
@@ -559,14 +563,21 @@ StringObjectException BackgroundSlicingProcess::validate(StringObjectException *
 // processed steps to be invalidated, therefore the task will need to be restarted.
 Print::ApplyStatus BackgroundSlicingProcess::apply()
 {
-	DynamicPrintConfig new_config = app_preset_bundle()->full_config();
-	new_config.apply(*m_plater_config);
-
 	assert(m_current_plate);
 	assert(m_gcode_result_wrapper);
 
-	std::vector<Print*> prints = m_gcode_result_wrapper->get_prints();
-	std::vector<GCodeResult*> gcode_results = m_gcode_result_wrapper->get_all_result();
+	// The prints of a plate processed ahead must not be modified while Print::process() runs on them.
+	this->take_over_preslicing(m_current_plate);
+	return this->apply_plate(m_current_plate);
+}
+
+Print::ApplyStatus BackgroundSlicingProcess::apply_plate(GUI::PartPlate *plate)
+{
+	DynamicPrintConfig new_config = app_preset_bundle()->full_config();
+	new_config.apply(*m_plater_config);
+
+	std::vector<Print*> prints = plate->get_gcode_result()->get_prints();
+	std::vector<GCodeResult*> gcode_results = plate->get_gcode_result()->get_all_result();
 
 	int num_prints = (int)prints.size();
 
@@ -583,7 +594,7 @@ Print::ApplyStatus BackgroundSlicingProcess::apply()
 		}
 
 		double  print_height = new_config.opt_float("printable_height");
-		const std::vector<Pointfs>& pp_bed_shape = m_current_plate->get_shape();
+		const std::vector<Pointfs>& pp_bed_shape = plate->get_shape();
 
 		Pointfs bedfs;
 		if(num_prints == 1)
@@ -622,6 +633,165 @@ Print::ApplyStatus BackgroundSlicingProcess::apply()
 	return invalidated;
 }
 
+void BackgroundSlicingProcess::start_preslicing(const std::vector<GUI::PartPlate*> &plates, size_t max_plates, size_t memory_budget)
+{
+	this->stop_preslicing();
+	if (plates.empty() || max_plates == 0)
+		return;
+
+	for (GUI::PartPlate *plate : plates) {
+		if (! plate->has_printable_instances())
+			continue;
+		this->apply_plate(plate);
+		auto job = std::make_shared<PreslicingJob>();
+		job->plate = plate;
+		for (Print *print : plate->get_gcode_result()->get_prints()) {
+			if (print->empty() || print->finished())
+				continue;
+			StringObjectException warning;
+			if (! print->validate(&warning).string.empty()) {
+				// Leave the plate to the serial loop, which reports the error.
+				job->prints.clear();
+				break;
+			}
+			job->prints.emplace_back(print);
+		}
+		if (! job->prints.empty())
+			m_preslicing_jobs.emplace_back(std::move(job));
+	}
+	// Applying the other plates updated the print volume state of the model instances, restore it for the current plate.
+	if (m_current_plate)
+		this->apply_plate(m_current_plate);
+
+	if (m_preslicing_jobs.empty())
+		return;
+	BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": %1% plates, %2% at once, memory budget %3% MB")
+		% m_preslicing_jobs.size() % max_plates % (memory_budget >> 20);
+	m_preslicing_memory_budget = memory_budget;
+	m_preslicing_stop          = false;
+	for (size_t i = 0; i < std::min(max_plates, m_preslicing_jobs.size()); ++ i)
+		m_preslicing_threads.emplace_back(create_thread([this]{ this->preslicing_proc(); }));
+}
+
+void BackgroundSlicingProcess::stop_preslicing()
+{
+	{
+		std::unique_lock<std::mutex> lck(m_preslicing_mutex);
+		m_preslicing_stop = true;
+		for (const std::shared_ptr<PreslicingJob> &job : m_preslicing_jobs)
+			if (job->processing)
+				job->processing->cancel();
+	}
+	m_preslicing_condition.notify_all();
+	for (boost::thread &thread : m_preslicing_threads)
+		thread.join();
+	m_preslicing_threads.clear();
+	m_preslicing_jobs.clear();
+	m_preslicing_running = 0;
+}
+
+void BackgroundSlicingProcess::wait_for_preslicing(GUI::PartPlate *plate)
+{
+	std::unique_lock<std::mutex> lck(m_preslicing_mutex);
+	auto it = std::find_if(m_preslicing_jobs.begin(), m_preslicing_jobs.end(), [plate](const std::shared_ptr<PreslicingJob> &job) { return job->plate == plate; });
+	if (it == m_preslicing_jobs.end())
+		return;
+	std::shared_ptr<PreslicingJob> job = *it;
+	if (job->state == PreslicingJob::Queued)
+		// Not started yet, the caller will process the plate itself.
+		job->state = PreslicingJob::Finished;
+	else
+		m_preslicing_condition.wait(lck, [&job](){ return job->state == PreslicingJob::Finished; });
+}
+
+void BackgroundSlicingProcess::take_over_preslicing(GUI::PartPlate *plate)
+{
+	std::unique_lock<std::mutex> lck(m_preslicing_mutex);
+	auto it = std::find_if(m_preslicing_jobs.begin(), m_preslicing_jobs.end(), [plate](const std::shared_ptr<PreslicingJob> &job) { return job->plate == plate; });
+	if (it == m_preslicing_jobs.end())
+		return;
+	std::shared_ptr<PreslicingJob> job = *it;
+	if (job->state == PreslicingJob::Queued) {
+		job->state = PreslicingJob::Finished;
+		return;
+	}
+	if (job->state == PreslicingJob::Running)
+		// Called from the UI thread, which must not wait for the plate to be sliced. The worker finishes the print
+		// being processed unless the following Print::apply() invalidates its steps through cancel_preslicing(),
+		// process_fff() waits for it on the background thread and continues with the remaining prints.
+		job->taken_over = true;
+}
+
+void BackgroundSlicingProcess::cancel_preslicing(PreslicingJob &job, Print *print)
+{
+	// print->state_mutex() is held by Print::apply().
+	std::unique_lock<std::mutex> lck(m_preslicing_mutex);
+	if (job.processing != print || boost::this_thread::get_id() == job.worker_id)
+		return;
+	// Set the print state to canceled before unlocking the state_mutex(), so when the worker thread wakes up,
+	// it throws the CanceledException().
+	print->cancel_internal();
+	// Allow the worker thread to wake up if blocking on a milestone.
+	print->state_mutex().unlock();
+	m_preslicing_condition.wait(lck, [&job, print](){ return job.processing != print; });
+	lck.unlock();
+	// Lock it back to be in a consistent state.
+	print->state_mutex().lock();
+}
+
+void BackgroundSlicingProcess::preslicing_proc()
+{
+	set_current_thread_name("bbl_PreSlcPcs");
+	std::unique_lock<std::mutex> lck(m_preslicing_mutex);
+	for (;;) {
+		auto it = std::find_if(m_preslicing_jobs.begin(), m_preslicing_jobs.end(), [](const std::shared_ptr<PreslicingJob> &job) { return job->state == PreslicingJob::Queued; });
+		if (m_preslicing_stop || it == m_preslicing_jobs.end())
+			break;
+		// Keep at least one plate running, start the others only while the memory budget allows.
+		if (m_preslicing_running > 0 && process_resident_memory() > m_preslicing_memory_budget) {
+			m_preslicing_condition.wait_for(lck, std::chrono::milliseconds(500));
+			continue;
+		}
+		std::shared_ptr<PreslicingJob> job = *it;
+		job->state     = PreslicingJob::Running;
+		job->worker_id = boost::this_thread::get_id();
+		++ m_preslicing_running;
+
+		BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": processing plate %1% ahead") % job->plate->get_index();
+		for (Print *print : job->prints) {
+			if (job->taken_over || m_preslicing_stop)
+				// The remaining prints are processed by the serial loop.
+				break;
+			// Kept installed after Print::process() returns, it does nothing once job->processing was reset.
+			// The serial loop installs its own callback before processing the print.
+			print->set_cancel_callback([this, job, print]() { this->cancel_preslicing(*job, print); });
+			job->processing = print;
+			lck.unlock();
+			// The progress and the warnings are reported by the serial loop once the plate becomes the current one.
+			PrintBase::status_callback_type status_callback = print->status_callback();
+			print->set_status_silent();
+			try {
+				print->process();
+			} catch (CanceledException &) {
+				BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": plate %1% canceled") % job->plate->get_index();
+			} catch (std::exception &ex) {
+				// Print::process() is called again by the serial loop, which reports the error.
+				BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << boost::format(": plate %1% failed: %2%") % job->plate->get_index() % ex.what();
+			}
+			print->set_status_callback(status_callback);
+			lck.lock();
+			job->processing = nullptr;
+			// Clear the cancelation for the serial loop, cancel_preslicing() does not cancel the print anymore.
+			print->restart();
+			m_preslicing_condition.notify_all();
+		}
+
+		job->state = PreslicingJob::Finished;
+		-- m_preslicing_running;
+		m_preslicing_condition.notify_all();
+	}
+}
+
 void BackgroundSlicingProcess::throw_if_canceled() const 
 { 
 	// if (m_print->canceled()) 
@@ -3,6 +3,8 @@
 
 #include "libslic3r/PrintBase.hpp"
 
+#include <list>
+
 namespace boost { namespace filesystem { class path; } }
 
 namespace Slic3r {
@@ -60,6 +62,14 @@ public:
 	// processed steps to be invalidated, therefore the task will need to be restarted.
     PrintBase::ApplyStatus apply();
 
+	//BBS: slice all, run Print::process() of the given plates concurrently ahead of the serial slicing loop.
+	// The prints are applied and validated on the UI thread first. At most max_plates plates are processed at once
+	// and a new plate is only started while the resident memory of the process stays below memory_budget bytes.
+	// The G-code export still runs on the background thread once the plate becomes the current one.
+	void start_preslicing(const std::vector<GUI::PartPlate*> &plates, size_t max_plates, size_t memory_budget);
+	// Cancel the plates being processed ahead and join their threads.
+	void stop_preslicing();
+
 	// After calling apply, the empty() call will report whether there is anything to slice.
 	bool 		empty() const;
 	// Validate the print. Returns an empty string if valid, returns an error message if invalid.
@@ -119,6 +129,17 @@ private:
 	// Helper to wrap the FFF slicing & G-code generation.
 	void	process_fff();
 
+	// Apply the model and config to the prints of plate, reset the G-code results of the invalidated prints.
+	PrintBase::ApplyStatus apply_plate(GUI::PartPlate *plate);
+	// Wait until the plate processed ahead finished, or drop it from the queue if it did not start yet.
+	// Called from the background thread.
+	void	wait_for_preslicing(GUI::PartPlate *plate);
+	// Leave the remaining prints of the plate processed ahead to the serial loop, or drop the plate from the queue
+	// if it did not start yet. Called from the UI thread, it does not wait for the print being processed.
+	void	take_over_preslicing(GUI::PartPlate *plate);
+	// Worker of start_preslicing(), picks the queued plates in order.
+	void	preslicing_proc();
+
     // Call Print::process() and catch all exceptions into ex, thus no exception could be thrown
     // by this method. This exception behavior is required to combine C++ exceptions with Win32 SEH exceptions
     // on the same thread.
@@ -166,6 +187,34 @@ private:
     // thread is blocking until the UI thread calculation finishes.
     std::shared_ptr<UITask> 	m_ui_task;
 
+	//BBS: slice all, plates processed ahead of the serial slicing loop.
+	struct PreslicingJob {
+		enum State {
+			Queued,
+			Running,
+			Finished,
+		};
+		GUI::PartPlate     *plate = nullptr;
+		std::vector<Print*> prints;
+		State               state = Queued;
+		// Set by take_over_preslicing(), the remaining prints of the plate are left to the serial loop.
+		bool                taken_over = false;
+		// Print being processed by the worker thread, guarded by m_preslicing_mutex.
+		Print              *processing = nullptr;
+		boost::thread::id   worker_id;
+	};
+	// Cancel callback of a print processed ahead, called by Print::apply() with the state mutex held
+	// when a step is to be invalidated. Waits until the worker leaves Print::process().
+	void	cancel_preslicing(PreslicingJob &job, Print *print);
+	// Shared with the threads waiting for a job, stop_preslicing() may clear the list meanwhile.
+	std::list<std::shared_ptr<PreslicingJob>> m_preslicing_jobs;
+	std::vector<boost::thread>  m_preslicing_threads;
+	std::mutex                  m_preslicing_mutex;
+	std::condition_variable     m_preslicing_condition;
+	size_t                      m_preslicing_memory_budget = 0;
+	size_t                      m_preslicing_running = 0;
+	bool                        m_preslicing_stop = false;
+
 	//BBS: partplate related
 	GUI::PartPlate* m_current_plate;
 	bool m_internal_cancelled = false;